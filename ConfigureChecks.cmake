@@ -14,11 +14,18 @@ CHECK_INCLUDE_FILE(libgen.h HAVE_LIBGEN_H)
 CHECK_INCLUDE_FILE(unistd.h HAVE_UNISTD_H)
 CHECK_INCLUDE_FILE(direct.h HAVE_DIRECT_H)
 CHECK_INCLUDE_FILE(stdint.h HAVE_STDINT_H)
+CHECK_INCLUDE_FILE(sys/stat.h HAVE_SYS_STAT_H)
+CHECK_INCLUDE_FILE(sys/mman.h HAVE_SYS_MMAN_H)
+CHECK_INCLUDE_FILE(sys/resource.h HAVE_SYS_RESOURCE_H)
 
 CHECK_SYMBOL_EXISTS(abort "stdlib.h" HAVE_ABORT)
 
 CHECK_FUNCTION_EXISTS(getcwd HAVE_GETCWD)
 CHECK_FUNCTION_EXISTS(toascii HAVE_TOASCII)
+CHECK_FUNCTION_EXISTS(mmap HAVE_MMAP)
+CHECK_FUNCTION_EXISTS(copy_file_range HAVE_COPY_FILE_RANGE)
+CHECK_FUNCTION_EXISTS(getrusage HAVE_GETRUSAGE)
+CHECK_FUNCTION_EXISTS(clock_gettime HAVE_CLOCK_GETTIME)
 
 CHECK_LIBRARY_EXISTS(dl dlopen "" HAVE_LIBDL)
 
@@ -28,6 +35,12 @@ ELSE (HAVE_LIBDL)
     SET(LIBDL "")
 ENDIF (HAVE_LIBDL)
 
+# Worker threads for parallel optimization/output (optional)
+FIND_PACKAGE(Threads)
+IF (CMAKE_USE_PTHREADS_INIT)
+    SET(HAVE_PTHREAD 1)
+ENDIF (CMAKE_USE_PTHREADS_INIT)
+
 CONFIGURE_FILE(libyasm-stdint.h.cmake
                ${CMAKE_CURRENT_BINARY_DIR}/libyasm-stdint.h)
 CONFIGURE_FILE(config.h.cmake ${CMAKE_CURRENT_BINARY_DIR}/config.h)
@@ -259,6 +259,7 @@ do_assemble(void)
     yasm_object *object;
     const char *base_filename;
     /*@null@*/ FILE *obj = NULL;
+    yasm_outsink *sink;
     yasm_arch_create_error arch_error;
     yasm_linemap *linemap;
     yasm_errwarns *errwarns = yasm_errwarns_create();
@@ -384,13 +385,25 @@ do_assemble(void)
         }
     }
 
-    /* Write the object file */
-    yasm_objfmt_output(object, obj?obj:stderr,
+    /* Write the object file.  Real object files are built in memory and
+     * written out in one go; the dbg objfmt streams straight to stderr.
+     */
+    if (obj)
+        sink = yasm_outsink_create_mem();
+    else
+        sink = yasm_outsink_create_file(stderr);
+    yasm_objfmt_output(object, sink,
                        strcmp(cur_dbgfmt_module->keyword, "null"), errwarns);
 
-    /* Close object file */
-    if (obj)
+    /* Flush and close object file */
+    if (obj) {
+        if (yasm_outsink_write_to_file(sink, obj) != 0) {
+            yasm_error_set(YASM_ERROR_IO, N_("error writing object file"));
+            yasm_errwarn_propagate(errwarns, 0);
+        }
         fclose(obj);
+    }
+    yasm_outsink_destroy(sink);
 
     /* If we had an error at this point, we also need to delete the output
      * object file (to make sure it's not left newer than the source).
@@ -619,6 +632,7 @@ cleanup(yasm_object *object)
         yasm_intnum_cleanup();
 
         yasm_errwarn_cleanup();
+        yasm_checksum_cleanup();
 
         BitVector_Shutdown();
     }
@@ -257,6 +257,7 @@ do_assemble(const char *in_filename)
     char *fn = NULL;
     char *obj_filename, *list_filename = NULL, *map_filename = NULL;
     /*@null@*/ FILE *obj = NULL;
+    yasm_outsink *sink;
     yasm_arch_create_error arch_error;
     yasm_linemap *linemap;
     yasm_arch *arch = NULL;
@@ -457,13 +458,25 @@ do_assemble(const char *in_filename)
         }
     }
 
-    /* Write the object file */
-    yasm_objfmt_output(object, obj?obj:stderr,
+    /* Write the object file.  Real object files are built in memory and
+     * written out in one go; the dbg objfmt streams straight to stderr.
+     */
+    if (obj)
+        sink = yasm_outsink_create_mem();
+    else
+        sink = yasm_outsink_create_file(stderr);
+    yasm_objfmt_output(object, sink,
                        strcmp(cur_dbgfmt_module->keyword, "null"), errwarns);
 
-    /* Close object file */
-    if (obj)
+    /* Flush and close object file */
+    if (obj) {
+        if (yasm_outsink_write_to_file(sink, obj) != 0) {
+            yasm_error_set(YASM_ERROR_IO, N_("error writing object file"));
+            yasm_errwarn_propagate(errwarns, 0);
+        }
         fclose(obj);
+    }
+    yasm_outsink_destroy(sink);
 
     /* If we had an error at this point, we also need to delete the output
      * object file (to make sure it's not left newer than the source).
@@ -756,6 +769,7 @@ cleanup(void)
         yasm_intnum_cleanup();
 
         yasm_errwarn_cleanup();
+        yasm_checksum_cleanup();
 
         BitVector_Shutdown();
     }
@@ -0,0 +1,378 @@
+/*
+ * Phase Profiling
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/* Need clock_gettime() and getrusage() (POSIX) */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <util.h>
+
+#include <time.h>
+
+#if defined(HAVE_SYS_RESOURCE_H) && defined(HAVE_GETRUSAGE)
+#include <sys/resource.h>
+#define USE_GETRUSAGE
+#endif
+
+#include <libyasm/coretype.h>
+#include <libyasm/errwarn.h>
+
+#include "yasm-profile.h"
+
+
+#define PROFILE_MAX_DEPTH   16
+
+typedef struct profile_counter {
+    /*@only@*/ char *name;
+    unsigned long value;
+} profile_counter;
+
+/* Phases are kept in the order they were started; the children of a phase
+ * are the phases following it with a greater depth.
+ */
+typedef struct profile_phase {
+    /*@observer@*/ const char *name;
+    int depth;
+    double wall_start, wall_end;    /* seconds since the epoch */
+    double cpu_start, cpu_end;      /* seconds */
+    long peak_rss;                  /* kilobytes at end; -1 if unknown */
+    /*@only@*/ /*@null@*/ profile_counter *counters;
+    size_t num_counters;
+} profile_phase;
+
+struct profile {
+    /*@only@*/ char *name;
+    int per_thread;
+
+    /*@only@*/ /*@null@*/ profile_phase *phases;
+    size_t num_phases, max_phases;
+
+    /* phases in progress, innermost last */
+    size_t stack[PROFILE_MAX_DEPTH];
+    int depth;
+
+    /* last top-level phase started */
+    size_t last_top;
+};
+
+static double epoch = -1.0;
+
+static double
+wall_now(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+    /* Wall time on Windows; elsewhere the best we can do portably. */
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static double
+cpu_now(int per_thread)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_PROCESS_CPUTIME_ID)
+    struct timespec ts;
+    clockid_t id = CLOCK_PROCESS_CPUTIME_ID;
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    if (per_thread)
+        id = CLOCK_THREAD_CPUTIME_ID;
+#endif
+    if (clock_gettime(id, &ts) == 0)
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/* Peak resident set size of the process so far, in kilobytes, or -1 if
+ * unknown.
+ */
+static long
+peak_rss_now(void)
+{
+#ifdef USE_GETRUSAGE
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+#ifdef __APPLE__
+        return (long)(ru.ru_maxrss / 1024);     /* bytes */
+#else
+        return (long)ru.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+profile *
+profile_create(const char *name, int per_thread)
+{
+    profile *prof = yasm_xmalloc(sizeof(profile));
+
+    if (epoch < 0.0)
+        epoch = wall_now();
+
+    prof->name = yasm__xstrdup(name);
+    prof->per_thread = per_thread;
+    prof->phases = NULL;
+    prof->num_phases = 0;
+    prof->max_phases = 0;
+    prof->depth = 0;
+    prof->last_top = 0;
+    return prof;
+}
+
+void
+profile_destroy(profile *prof)
+{
+    size_t i, j;
+
+    for (i=0; i<prof->num_phases; i++) {
+        profile_phase *phase = &prof->phases[i];
+        for (j=0; j<phase->num_counters; j++)
+            yasm_xfree(phase->counters[j].name);
+        if (phase->counters)
+            yasm_xfree(phase->counters);
+    }
+    if (prof->phases)
+        yasm_xfree(prof->phases);
+    yasm_xfree(prof->name);
+    yasm_xfree(prof);
+}
+
+void
+profile_begin(profile *prof, const char *name)
+{
+    profile_phase *phase;
+
+    if (!prof)
+        return;
+    if (prof->depth >= PROFILE_MAX_DEPTH)
+        yasm_internal_error(N_("profile phases nested too deeply"));
+
+    if (prof->num_phases >= prof->max_phases) {
+        prof->max_phases = prof->max_phases ? prof->max_phases*2 : 16;
+        prof->phases = yasm_xrealloc(prof->phases,
+                                     prof->max_phases*sizeof(profile_phase));
+    }
+    if (prof->depth == 0)
+        prof->last_top = prof->num_phases;
+    prof->stack[prof->depth++] = prof->num_phases;
+
+    phase = &prof->phases[prof->num_phases++];
+    phase->name = name;
+    phase->depth = prof->depth - 1;
+    phase->counters = NULL;
+    phase->num_counters = 0;
+    phase->peak_rss = -1;
+    phase->cpu_start = cpu_now(prof->per_thread);
+    phase->wall_start = wall_now() - epoch;
+    phase->wall_end = phase->wall_start;
+    phase->cpu_end = phase->cpu_start;
+}
+
+void
+profile_end(profile *prof)
+{
+    profile_phase *phase;
+
+    if (!prof)
+        return;
+    if (prof->depth == 0)
+        yasm_internal_error(N_("no profile phase in progress"));
+
+    phase = &prof->phases[prof->stack[--prof->depth]];
+    phase->wall_end = wall_now() - epoch;
+    phase->cpu_end = cpu_now(prof->per_thread);
+    phase->peak_rss = peak_rss_now();
+}
+
+void
+profile_end_all(profile *prof)
+{
+    while (prof && prof->depth > 0)
+        profile_end(prof);
+}
+
+void
+profile_count(profile *prof, const char *name, unsigned long value)
+{
+    profile_phase *phase;
+
+    if (!prof || prof->num_phases == 0)
+        return;
+    if (prof->depth > 0)
+        phase = &prof->phases[prof->stack[prof->depth-1]];
+    else
+        phase = &prof->phases[prof->last_top];
+
+    phase->counters = yasm_xrealloc(phase->counters,
+        (phase->num_counters+1)*sizeof(profile_counter));
+    phase->counters[phase->num_counters].name = yasm__xstrdup(name);
+    phase->counters[phase->num_counters].value = value;
+    phase->num_counters++;
+}
+
+/* Write a string as a JSON string literal. */
+static void
+json_string(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void
+json_counters(FILE *f, const profile_phase *phase)
+{
+    size_t i;
+
+    for (i=0; i<phase->num_counters; i++) {
+        if (i > 0)
+            fputs(", ", f);
+        json_string(f, phase->counters[i].name);
+        fprintf(f, ": %lu", phase->counters[i].value);
+    }
+}
+
+/* Write phase *index and its children; on return, *index is the phase
+ * following them.
+ */
+static void
+report_phase(FILE *f, const profile *prof, size_t *index, int indent)
+{
+    const profile_phase *phase = &prof->phases[(*index)++];
+    int first = 1;
+
+    fprintf(f, "%*s{\"name\": ", indent, "");
+    json_string(f, phase->name);
+    fprintf(f, ", \"start_us\": %.1f, \"wall_us\": %.1f, \"cpu_us\": %.1f",
+            phase->wall_start * 1e6,
+            (phase->wall_end - phase->wall_start) * 1e6,
+            (phase->cpu_end - phase->cpu_start) * 1e6);
+    if (phase->peak_rss >= 0)
+        fprintf(f, ", \"peak_rss_kb\": %ld", phase->peak_rss);
+    if (phase->num_counters > 0) {
+        fputs(",\n", f);
+        fprintf(f, "%*s \"counters\": {", indent, "");
+        json_counters(f, phase);
+        fputc('}', f);
+    }
+    while (*index < prof->num_phases
+           && prof->phases[*index].depth > phase->depth) {
+        if (first) {
+            fputs(",\n", f);
+            fprintf(f, "%*s \"phases\": [\n", indent, "");
+            first = 0;
+        } else
+            fputs(",\n", f);
+        report_phase(f, prof, index, indent+2);
+    }
+    if (!first)
+        fprintf(f, "\n%*s ]", indent, "");
+    fputc('}', f);
+}
+
+static void
+trace_profile(FILE *f, const profile *prof, unsigned long tid, int *first)
+{
+    size_t i;
+
+    fputs(*first ? "\n" : ",\n", f);
+    *first = 0;
+    fprintf(f, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+            "\"tid\": %lu, \"args\": {\"name\": ", tid);
+    json_string(f, prof->name);
+    fputs("}}", f);
+
+    for (i=0; i<prof->num_phases; i++) {
+        const profile_phase *phase = &prof->phases[i];
+
+        fputs(",\n{\"name\": ", f);
+        json_string(f, phase->name);
+        fprintf(f, ", \"cat\": \"yasm\", \"ph\": \"X\", \"pid\": 1, "
+                "\"tid\": %lu, \"ts\": %.1f, \"dur\": %.1f, "
+                "\"args\": {\"cpu_us\": %.1f", tid,
+                phase->wall_start * 1e6,
+                (phase->wall_end - phase->wall_start) * 1e6,
+                (phase->cpu_end - phase->cpu_start) * 1e6);
+        if (phase->num_counters > 0) {
+            fputs(", ", f);
+            json_counters(f, phase);
+        }
+        fputs("}}", f);
+
+        if (phase->peak_rss >= 0)
+            fprintf(f, ",\n{\"name\": \"peak RSS\", \"ph\": \"C\", "
+                    "\"pid\": 1, \"ts\": %.1f, \"args\": {\"kB\": %ld}}",
+                    phase->wall_end * 1e6, phase->peak_rss);
+    }
+}
+
+int
+profile_write(FILE *report, FILE *trace, profile * const *profs,
+              size_t nprofs)
+{
+    size_t i, index;
+    int first = 1;
+
+    fputs("{\"version\": ", report);
+    json_string(report, PACKAGE_STRING);
+    fputs(",\n \"units\": [", report);
+    for (i=0; i<nprofs; i++) {
+        const profile *prof = profs[i];
+
+        fputs(i > 0 ? ",\n  {\"name\": " : "\n  {\"name\": ", report);
+        json_string(report, prof->name);
+        fputs(",\n   \"phases\": [\n", report);
+        index = 0;
+        while (index < prof->num_phases) {
+            if (index > 0)
+                fputs(",\n", report);
+            report_phase(report, prof, &index, 4);
+        }
+        fputs("\n   ]}", report);
+    }
+    fputs("\n ]}\n", report);
+
+    if (trace) {
+        fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [", trace);
+        for (i=0; i<nprofs; i++)
+            trace_profile(trace, profs[i], (unsigned long)i+1, &first);
+        fputs("\n]}\n", trace);
+    }
+
+    return ferror(report) || (trace && ferror(trace));
+}
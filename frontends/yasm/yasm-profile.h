@@ -0,0 +1,71 @@
+/*
+ * Phase Profiling Header File
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef YASM_PROFILE_H
+#define YASM_PROFILE_H
+
+/* A profile records nested phases of processing one input file: wall and
+ * CPU time, the peak resident set size at the end of each phase, and named
+ * counters attached to phases.
+ */
+typedef struct profile profile;
+
+/* Create a profile for the named input.  If per_thread is nonzero, CPU
+ * time is that of the calling thread only (where supported), so profiles
+ * of inputs processed concurrently don't include each other's time.
+ * Times are relative to the first call; calls must not be concurrent.
+ */
+/*@only@*/ profile *profile_create(const char *name, int per_thread);
+
+void profile_destroy(/*@only@*/ profile *prof);
+
+/* The following do nothing if prof is NULL, so callers need not check
+ * whether profiling is enabled.
+ */
+
+/* Start a phase nested in the current one.  The name is not copied. */
+void profile_begin(/*@null@*/ profile *prof,
+                   /*@observer@*/ const char *phase);
+
+/* End the current phase. */
+void profile_end(/*@null@*/ profile *prof);
+
+/* End all phases still in progress (e.g. after an error). */
+void profile_end_all(/*@null@*/ profile *prof);
+
+/* Attach a counter to the current phase (or the most recently ended
+ * top-level phase if none is in progress).  The name is copied.
+ */
+void profile_count(/*@null@*/ profile *prof, const char *name,
+                   unsigned long value);
+
+/* Write the profiles as a JSON report and (if trace is not NULL) in Chrome
+ * trace event format, one track per profile.  Returns nonzero on error.
+ */
+int profile_write(FILE *report, /*@null@*/ FILE *trace,
+                  profile * const *profs, size_t nprofs);
+
+#endif
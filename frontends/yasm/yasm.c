@@ -24,9 +24,15 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+/* Need vsnprintf() (POSIX) to hold back diagnostics in batch mode */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <util.h>
 
 #include <ctype.h>
+#include <stdarg.h>
 #include <libyasm/compat-queue.h>
 #include <libyasm/bitvect.h>
 #include <libyasm.h>
@@ -36,6 +42,7 @@
 #endif
 
 #include "yasm-options.h"
+#include "yasm-profile.h"
 
 #ifdef CMAKE_BUILD
 #include "yasm-plugin.h"
@@ -46,17 +53,22 @@
 /* Preprocess-only buffer size */
 #define PREPROC_BUF_SIZE    16384
 
+/* Maximum length of a batch file line and of a buffered message */
+#define BATCH_LINE_MAX      8192
+#define ERRMSG_MAX          4096
+
 /*@null@*/ /*@only@*/ static char *obj_filename = NULL, *in_filename = NULL;
+/*@null@*/ /*@only@*/ static char *batch_filename = NULL;
+/*@null@*/ /*@only@*/ static char *macro_cache_filename = NULL;
+/*@null@*/ /*@only@*/ static char *profile_filename = NULL;
 /*@null@*/ /*@only@*/ static char *global_prefix = NULL, *global_suffix = NULL;
 /*@null@*/ /*@only@*/ static char *list_filename = NULL, *map_filename = NULL;
 /*@null@*/ /*@only@*/ static char *machine_name = NULL;
 static int special_options = 0;
-/*@null@*/ /*@dependent@*/ static yasm_arch *cur_arch = NULL;
 /*@null@*/ /*@dependent@*/ static const yasm_arch_module *
     cur_arch_module = NULL;
 /*@null@*/ /*@dependent@*/ static const yasm_parser_module *
     cur_parser_module = NULL;
-/*@null@*/ /*@dependent@*/ static yasm_preproc *cur_preproc = NULL;
 /*@null@*/ /*@dependent@*/ static const yasm_preproc_module *
     cur_preproc_module = NULL;
 /*@null@*/ static char *objfmt_keyword = NULL;
@@ -64,11 +76,16 @@ static int special_options = 0;
     cur_objfmt_module = NULL;
 /*@null@*/ /*@dependent@*/ static const yasm_dbgfmt_module *
     cur_dbgfmt_module = NULL;
-/*@null@*/ /*@dependent@*/ static yasm_listfmt *cur_listfmt = NULL;
 /*@null@*/ /*@dependent@*/ static const yasm_listfmt_module *
     cur_listfmt_module = NULL;
 static int preproc_only = 0;
 static unsigned int force_strict = 0;
+static int optimize_full = 0;
+static unsigned int threads = 0;
+static int strtab_tail_merge = 0;
+static int sort_relocs = 0;
+static int arena_stats = 0;
+static int pp_stats = 0;
 static int generate_make_dependencies = 0;
 static int warning_error = 0;   /* warnings being treated as errors */
 static FILE *errfile;
@@ -78,12 +95,34 @@ static enum {
     EWSTYLE_VC
 } ewmsg_style = EWSTYLE_GNU;
 
+/* Growable text buffer. */
+typedef struct textbuf {
+    /*@only@*/ /*@null@*/ char *str;
+    size_t len, max;
+} textbuf;
+
+/* An input file and its output.  The command line names a single unit;
+ * with --batch, each line of the batch file is a unit.  Units in a batch
+ * are independent and are processed concurrently, so each holds back its
+ * diagnostics and make dependencies until the whole batch is done.
+ */
+typedef struct assemble_unit {
+    /*@only@*/ char *in_filename;
+    /*@only@*/ /*@null@*/ char *obj_filename;   /* NULL for default */
+    textbuf errout;         /* diagnostics (batch mode) */
+    textbuf depout;         /* make dependencies */
+    /*@null@*/ profile *prof;   /* phase profile (--profile) */
+    int status;             /* EXIT_SUCCESS or EXIT_FAILURE */
+} assemble_unit;
+
+/* Where diagnostics for the unit being processed by this thread go; NULL
+ * to write them to errfile directly.
+ */
+/*@null@*/ /*@dependent@*/ static YASM_THREAD_LOCAL textbuf *cur_errout = NULL;
+
 /*@null@*/ /*@dependent@*/ static FILE *open_file(const char *filename,
                                                   const char *mode);
-static void check_errors(/*@only@*/ yasm_errwarns *errwarns,
-                         /*@only@*/ yasm_object *object,
-                         /*@only@*/ yasm_linemap *linemap);
-static void cleanup(/*@null@*/ /*@only@*/ yasm_object *object);
+static void cleanup(void);
 
 /* Forward declarations: cmd line parser handlers */
 static int opt_special_handler(char *cmd, /*@null@*/ char *param, int extra);
@@ -98,12 +137,25 @@ static int opt_objfile_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_mapfile_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_machine_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_strict_handler(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_fullopt_handler(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_threads_handler(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_tailmerge_handler(char *cmd, /*@null@*/ char *param,
+                                 int extra);
+static int opt_sortrelocs_handler(char *cmd, /*@null@*/ char *param,
+                                  int extra);
+static int opt_batch_handler(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_pp_stats_handler(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_arena_stats_handler(char *cmd, /*@null@*/ char *param,
+                                   int extra);
+static int opt_profile_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_warning_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_error_file(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_error_stdout(char *cmd, /*@null@*/ char *param, int extra);
 static int preproc_only_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_include_option(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_preproc_option(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_macro_cache_handler(char *cmd, /*@null@*/ char *param,
+                                   int extra);
 static int opt_ewmsg_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_makedep_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_prefix_handler(char *cmd, /*@null@*/ char *param, int extra);
@@ -115,6 +167,7 @@ static int opt_plugin_handler(char *cmd, /*@null@*/ char *param, int extra);
 static /*@only@*/ char *replace_extension(const char *orig, /*@null@*/
                                           const char *ext, const char *def);
 static void print_error(const char *fmt, ...);
+static void errprintf(const char *fmt, ...);
 
 static /*@exits@*/ void handle_yasm_int_error(const char *file,
                                               unsigned int line,
@@ -128,9 +181,10 @@ static void print_yasm_error(const char *filename, unsigned long line,
 static void print_yasm_warning(const char *filename, unsigned long line,
                                const char *msg);
 
-static void apply_preproc_builtins(void);
-static void apply_preproc_standard_macros(const yasm_stdmac *stdmacs);
-static void apply_preproc_saved_options(void);
+static void apply_preproc_builtins(yasm_preproc *preproc);
+static void apply_preproc_standard_macros(yasm_preproc *preproc,
+                                          const yasm_stdmac *stdmacs);
+static void apply_preproc_saved_options(yasm_preproc *preproc);
 static void print_list_keyword_desc(const char *name, const char *keyword);
 
 /* values for special_options */
@@ -170,6 +224,26 @@ static opt_option options[] =
       N_("select machine (list with -m help)"), N_("machine") },
     { 0, "force-strict", 0, opt_strict_handler, 0,
       N_("treat all sized operands as if `strict' was used"), NULL },
+    { 0, "full-opt", 0, opt_fullopt_handler, 0,
+      N_("recompute all offsets on each optimizer pass (slower)"), NULL },
+    { 0, "threads", 1, opt_threads_handler, 0,
+      N_("use up to n threads for independent sections or batch files"),
+      N_("n") },
+    { 0, "strtab-tail-merge", 0, opt_tailmerge_handler, 0,
+      N_("share string table space between names with common tails"),
+      NULL },
+    { 0, "sort-relocs", 0, opt_sortrelocs_handler, 0,
+      N_("write relocations sorted by address (ELF and COFF)"), NULL },
+    { 0, "batch", 1, opt_batch_handler, 0,
+      N_("assemble each `input [output]' line of file (- for stdin)"),
+      N_("file") },
+    { 0, "arena-stats", 0, opt_arena_stats_handler, 0,
+      N_("report peak arena memory usage"), NULL },
+    { 0, "pp-stats", 0, opt_pp_stats_handler, 0,
+      N_("report preprocessor statistics"), NULL },
+    { 0, "profile", 1, opt_profile_handler, 0,
+      N_("write per-phase time and memory profile to file (JSON)"),
+      N_("file") },
     { 'w', NULL, 0, opt_warning_handler, 1,
       N_("inhibits warning messages"), NULL },
     { 'W', NULL, 0, opt_warning_handler, 0,
@@ -188,6 +262,9 @@ static opt_option options[] =
       N_("add include path"), N_("path") },
     { 'P', NULL, 1, opt_preproc_option, 0,
       N_("pre-include file"), N_("filename") },
+    { 0, "macro-cache", 1, opt_macro_cache_handler, 0,
+      N_("cache macros defined by standard macros and pre-includes in file"),
+      N_("file") },
     { 'd', NULL, 1, opt_preproc_option, 1,
       N_("pre-define a macro, optionally to value"), N_("macro[=value]") },
     { 'D', NULL, 1, opt_preproc_option, 1,
@@ -242,81 +319,224 @@ typedef struct constcharparam {
 
 static constcharparam_head preproc_options;
 
+static void
+textbuf_append(textbuf *tb, const char *str, size_t len)
+{
+    if (tb->len + len + 1 > tb->max) {
+        tb->max = tb->max ? tb->max*2 : 256;
+        if (tb->max < tb->len + len + 1)
+            tb->max = tb->len + len + 1;
+        tb->str = yasm_xrealloc(tb->str, tb->max);
+    }
+    memcpy(tb->str + tb->len, str, len);
+    tb->len += len;
+    tb->str[tb->len] = '\0';
+}
+
+/* Write out and empty a text buffer. */
+static void
+textbuf_flush(textbuf *tb, FILE *f)
+{
+    if (tb->len > 0)
+        fwrite(tb->str, tb->len, 1, f);
+    if (tb->str)
+        yasm_xfree(tb->str);
+    tb->str = NULL;
+    tb->len = 0;
+    tb->max = 0;
+}
+
+static void
+unit_init(assemble_unit *unit, const char *in, /*@null@*/ const char *obj)
+{
+    unit->in_filename = yasm__xstrdup(in);
+    unit->obj_filename = obj ? yasm__xstrdup(obj) : NULL;
+    unit->errout.str = NULL;
+    unit->errout.len = unit->errout.max = 0;
+    unit->depout.str = NULL;
+    unit->depout.len = unit->depout.max = 0;
+    /* Units in a batch run concurrently, so time only their own thread */
+    unit->prof = profile_filename ?
+        profile_create(in, batch_filename != NULL) : NULL;
+    unit->status = EXIT_SUCCESS;
+}
+
+static void
+unit_delete(assemble_unit *unit)
+{
+    yasm_xfree(unit->in_filename);
+    if (unit->obj_filename)
+        yasm_xfree(unit->obj_filename);
+    textbuf_flush(&unit->errout, errfile);
+    textbuf_flush(&unit->depout, stdout);
+    if (unit->prof)
+        profile_destroy(unit->prof);
+}
+
+/* Determine the object filename if not specified. */
+static void
+unit_default_obj_filename(assemble_unit *unit)
+{
+    const char *base_filename;
+
+    if (unit->obj_filename)
+        return;
+
+    /* replace (or add) extension to base filename */
+    yasm__splitpath(unit->in_filename, &base_filename);
+    if (base_filename[0] == '\0')
+        unit->obj_filename = yasm__xstrdup("yasm.out");
+    else
+        unit->obj_filename = replace_extension(base_filename,
+                                               cur_objfmt_module->extension,
+                                               "yasm.out");
+}
+
+static void
+print_pp_stat(const char *name, unsigned long value, /*@unused@*/ void *d)
+{
+    print_error("%s: %s: %lu", cur_preproc_module->keyword, name, value);
+}
+
+static void
+profile_pp_stat(const char *name, unsigned long value, void *d)
+{
+    profile_count((profile *)d, name, value);
+}
+
+static int
+profile_count_relocs(yasm_section *sect, void *d)
+{
+    unsigned long *count = (unsigned long *)d;
+    unsigned long nrelocs;
+
+    yasm_section_relocs(sect, &nrelocs);
+    *count += nrelocs;
+    return 0;
+}
+
+/* Write the profiles of the units to profile_filename, and as a Chrome
+ * trace to the same name with .json replaced (or suffixed) by .trace.json.
+ * Returns nonzero on error.
+ */
 static int
-do_preproc_only(void)
+write_profile(assemble_unit *units, size_t nunits)
+{
+    profile **profs;
+    FILE *report, *trace;
+    char *trace_filename;
+    size_t i, len = strlen(profile_filename);
+    int error;
+
+    if (len > 5 && strcmp(profile_filename+len-5, ".json") == 0)
+        len -= 5;
+    trace_filename = yasm_xmalloc(len+12);
+    memcpy(trace_filename, profile_filename, len);
+    strcpy(trace_filename+len, ".trace.json");
+
+    report = open_file(profile_filename, "wt");
+    trace = report ? open_file(trace_filename, "wt") : NULL;
+    yasm_xfree(trace_filename);
+    if (!trace) {
+        if (report)
+            fclose(report);
+        return 1;
+    }
+
+    profs = yasm_xmalloc((nunits ? nunits : 1)*sizeof(profile *));
+    for (i=0; i<nunits; i++)
+        profs[i] = units[i].prof;
+    error = profile_write(report, trace, profs, nunits);
+    yasm_xfree(profs);
+
+    if (fclose(report) != 0)
+        error = 1;
+    if (fclose(trace) != 0)
+        error = 1;
+    if (error)
+        print_error(_("error writing profile"));
+    return error;
+}
+
+static int
+do_preproc_only(assemble_unit *unit)
 {
     yasm_linemap *linemap;
+    yasm_preproc *preproc;
     char *preproc_buf;
     size_t got;
-    const char *base_filename;
     FILE *out = NULL;
     yasm_errwarns *errwarns = yasm_errwarns_create();
+    int status = EXIT_SUCCESS;
+
+    profile_begin(unit->prof, "preprocess");
 
     /* Initialize line map */
     linemap = yasm_linemap_create();
-    yasm_linemap_set(linemap, in_filename, 0, 1, 1);
+    yasm_linemap_set(linemap, unit->in_filename, 0, 1, 1);
 
     /* Default output to stdout if not specified or generating dependency
        makefiles */
-    if (!obj_filename || generate_make_dependencies) {
+    if (!unit->obj_filename || generate_make_dependencies) {
         out = stdout;
 
         /* determine the object filename if not specified, but we need a
             file name for the makefile rule */
-        if (generate_make_dependencies && !obj_filename) {
-            if (in_filename == NULL)
-                /* Default to yasm.out if no obj filename specified */
-                obj_filename = yasm__xstrdup("yasm.out");
-            else {
-                /* replace (or add) extension to base filename */
-                yasm__splitpath(in_filename, &base_filename);
-                if (base_filename[0] == '\0')
-                    obj_filename = yasm__xstrdup("yasm.out");
-                else
-                    obj_filename = replace_extension(base_filename,
-                        cur_objfmt_module->extension, "yasm.out");
-            }
-        }
+        if (generate_make_dependencies)
+            unit_default_obj_filename(unit);
     } else {
         /* Open output (object) file */
-        out = open_file(obj_filename, "wt");
-        if (!out)
+        out = open_file(unit->obj_filename, "wt");
+        if (!out) {
+            yasm_linemap_destroy(linemap);
+            yasm_errwarns_destroy(errwarns);
+            profile_end(unit->prof);
             return EXIT_FAILURE;
+        }
     }
 
     /* Create preprocessor */
-    cur_preproc = yasm_preproc_create(cur_preproc_module, in_filename, NULL,
-                                      linemap, errwarns);
+    preproc = yasm_preproc_create(cur_preproc_module, unit->in_filename,
+                                  NULL, linemap, errwarns);
 
     /* Apply macros */
-    apply_preproc_builtins();
-    apply_preproc_standard_macros(cur_parser_module->stdmacs);
-    apply_preproc_standard_macros(cur_objfmt_module->stdmacs);
-    apply_preproc_saved_options();
+    apply_preproc_builtins(preproc);
+    apply_preproc_standard_macros(preproc, cur_parser_module->stdmacs);
+    apply_preproc_standard_macros(preproc, cur_objfmt_module->stdmacs);
+    apply_preproc_saved_options(preproc);
+    if (macro_cache_filename)
+        yasm_preproc_set_macro_cache(preproc, macro_cache_filename);
 
     /* Pre-process until done */
     if (generate_make_dependencies) {
+        textbuf *deps = &unit->depout;
         size_t totlen;
 
         preproc_buf = yasm_xmalloc(PREPROC_BUF_SIZE);
 
-        fprintf(stdout, "%s: %s", obj_filename, in_filename);
-        totlen = strlen(obj_filename)+2+strlen(in_filename);
+        textbuf_append(deps, unit->obj_filename, strlen(unit->obj_filename));
+        textbuf_append(deps, ": ", 2);
+        textbuf_append(deps, unit->in_filename, strlen(unit->in_filename));
+        totlen = strlen(unit->obj_filename)+2+strlen(unit->in_filename);
 
-        while ((got = yasm_preproc_get_included_file(cur_preproc, preproc_buf,
+        while ((got = yasm_preproc_get_included_file(preproc, preproc_buf,
                                                      PREPROC_BUF_SIZE)) != 0) {
             totlen += got;
             if (totlen > 72) {
-                fputs(" \\\n  ", stdout);
+                textbuf_append(deps, " \\\n  ", 5);
                 totlen = 2;
             }
-            fputc(' ', stdout);
-            fwrite(preproc_buf, got, 1, stdout);
+            textbuf_append(deps, " ", 1);
+            textbuf_append(deps, preproc_buf, got);
         }
-        fputc('\n', stdout);
+        textbuf_append(deps, "\n", 1);
         yasm_xfree(preproc_buf);
+
+        /* A batch prints everything once it's done */
+        if (!batch_filename)
+            textbuf_flush(deps, stdout);
     } else {
-        while ((preproc_buf = yasm_preproc_get_line(cur_preproc)) != NULL) {
+        while ((preproc_buf = yasm_preproc_get_line(preproc)) != NULL) {
             fputs(preproc_buf, out);
             fputc('\n', out);
             yasm_xfree(preproc_buf);
@@ -327,70 +547,62 @@ do_preproc_only(void)
         fclose(out);
 
     if (yasm_errwarns_num_errors(errwarns, warning_error) > 0) {
-        yasm_errwarns_output_all(errwarns, linemap, warning_error,
-                                 print_yasm_error, print_yasm_warning);
         if (out != stdout)
-            remove(obj_filename);
-        yasm_linemap_destroy(linemap);
-        yasm_errwarns_destroy(errwarns);
-        cleanup(NULL);
-        return EXIT_FAILURE;
+            remove(unit->obj_filename);
+        status = EXIT_FAILURE;
     }
 
     yasm_errwarns_output_all(errwarns, linemap, warning_error,
                              print_yasm_error, print_yasm_warning);
+    if (pp_stats)
+        yasm_preproc_get_stats(preproc, print_pp_stat, NULL);
+    if (unit->prof)
+        yasm_preproc_get_stats(preproc, profile_pp_stat, unit->prof);
+    profile_end(unit->prof);
+    yasm_preproc_destroy(preproc);
     yasm_linemap_destroy(linemap);
     yasm_errwarns_destroy(errwarns);
-    cleanup(NULL);
-    return EXIT_SUCCESS;
+    return status;
 }
 
+/* Define DO_FREE to 1 to enable deallocation of all data structures.
+ * Useful for detecting memory leaks, but slows down execution unnecessarily
+ * (as the OS will free everything we miss here).  Otherwise we exit without
+ * tearing down the object, which for large inputs can take a noticeable
+ * fraction of the total run time.  Units in a batch are always torn down,
+ * as the process keeps going.
+ */
+#ifdef WITH_DMALLOC
+#define DO_FREE         1
+#else
+#define DO_FREE         0
+#endif
+
 static int
-do_assemble(void)
+do_assemble(assemble_unit *unit)
 {
-    yasm_object *object;
-    const char *base_filename;
+    /*@null@*/ yasm_object *object = NULL;
+    /*@null@*/ yasm_preproc *preproc = NULL;
+    /*@null@*/ yasm_listfmt *listfmt = NULL;
+    const yasm_objfmt_module *objfmt_module;
     /*@null@*/ FILE *obj = NULL;
+    yasm_outsink *sink;
+    yasm_arch *arch;
     yasm_arch_create_error arch_error;
     yasm_linemap *linemap;
     yasm_errwarns *errwarns = yasm_errwarns_create();
     int i, matched;
     const char *machine;
+    int status = EXIT_FAILURE;
+
+    profile_begin(unit->prof, "assemble");
+    profile_begin(unit->prof, "setup");
 
     /* Initialize line map */
     linemap = yasm_linemap_create();
-    yasm_linemap_set(linemap, in_filename, 0, 1, 1);
+    yasm_linemap_set(linemap, unit->in_filename, 0, 1, 1);
 
-    /* determine the object filename if not specified */
-    if (!obj_filename) {
-        if (in_filename == NULL)
-            /* Default to yasm.out if no obj filename specified */
-            obj_filename = yasm__xstrdup("yasm.out");
-        else {
-            /* replace (or add) extension to base filename */
-            yasm__splitpath(in_filename, &base_filename);
-            if (base_filename[0] == '\0')
-                obj_filename = yasm__xstrdup("yasm.out");
-            else
-                obj_filename = replace_extension(base_filename,
-                                                 cur_objfmt_module->extension,
-                                                 "yasm.out");
-        }
-    }
-
-    /* Set up architecture using machine and parser. */
-    if (!machine_name) {
-        /* If we're using x86 and the default objfmt bits is 64, default the
-         * machine to amd64.  When we get more arches with multiple machines,
-         * we should do this in a more modular fashion.
-         */
-        if (strcmp(cur_arch_module->keyword, "x86") == 0 &&
-            cur_objfmt_module->default_x86_mode_bits == 64)
-            machine_name = yasm__xstrdup("amd64");
-        else
-            machine_name =
-                yasm__xstrdup(cur_arch_module->default_machine_keyword);
-    }
+    unit_default_obj_filename(unit);
 
     /* If we're using amd64 and the default objfmt is elfx32, change the
      * machine to "x32".
@@ -401,9 +613,9 @@ do_assemble(void)
     else
       machine = machine_name;
 
-    cur_arch = yasm_arch_create(cur_arch_module, machine,
-                                cur_parser_module->keyword, &arch_error);
-    if (!cur_arch) {
+    arch = yasm_arch_create(cur_arch_module, machine,
+                            cur_parser_module->keyword, &arch_error);
+    if (!arch) {
         switch (arch_error) {
             case YASM_ARCH_CREATE_BAD_MACHINE:
                 print_error(_("%s: `%s' is not a valid %s for %s `%s'"),
@@ -420,11 +632,11 @@ do_assemble(void)
                 print_error(_("%s: unknown architecture error"), _("FATAL"));
         }
 
-        return EXIT_FAILURE;
+        goto done;
     }
 
     /* Create object */
-    object = yasm_object_create(in_filename, obj_filename, cur_arch,
+    object = yasm_object_create(unit->in_filename, unit->obj_filename, arch,
                                 cur_objfmt_module, cur_dbgfmt_module);
     if (!object) {
         yasm_error_class eclass;
@@ -435,13 +647,11 @@ do_assemble(void)
         print_error("%s: %s", _("FATAL"), estr);
         yasm_xfree(estr);
         yasm_xfree(xrefstr);
-
-        cleanup(object);
-        return EXIT_FAILURE;
+        goto done;
     }
 
     /* Get a fresh copy of objfmt_module as it may have changed. */
-    cur_objfmt_module = ((yasm_objfmt_base *)object->objfmt)->module;
+    objfmt_module = ((yasm_objfmt_base *)object->objfmt)->module;
 
     /* Check to see if the requested preprocessor is in the allowed list
      * for the active parser.
@@ -460,36 +670,43 @@ do_assemble(void)
         print_error(_("%s: `%s' is not a valid %s for %s `%s'"), _("FATAL"),
                     cur_preproc_module->keyword, _("preprocessor"),
                     _("parser"), cur_parser_module->keyword);
-        cleanup(object);
-        return EXIT_FAILURE;
+        goto done;
     }
 
+    object->optimize_full = optimize_full;
+    /* In a batch, the threads are busy with other units */
+    object->threads = batch_filename ? 0 : threads;
+    object->strtab_tail_merge = strtab_tail_merge;
+    object->sort_relocs = sort_relocs;
+
     if (global_prefix)
         yasm_object_set_global_prefix(object, global_prefix);
     if (global_suffix)
         yasm_object_set_global_suffix(object, global_suffix);
 
-    cur_preproc = yasm_preproc_create(cur_preproc_module, in_filename,
-                                      object->symtab, linemap, errwarns);
+    preproc = yasm_preproc_create(cur_preproc_module, unit->in_filename,
+                                  object->symtab, linemap, errwarns);
 
-    apply_preproc_builtins();
-    apply_preproc_standard_macros(cur_parser_module->stdmacs);
-    apply_preproc_standard_macros(cur_objfmt_module->stdmacs);
-    apply_preproc_saved_options();
+    apply_preproc_builtins(preproc);
+    apply_preproc_standard_macros(preproc, cur_parser_module->stdmacs);
+    apply_preproc_standard_macros(preproc, objfmt_module->stdmacs);
+    apply_preproc_saved_options(preproc);
+    if (macro_cache_filename)
+        yasm_preproc_set_macro_cache(preproc, macro_cache_filename);
 
     /* Get initial x86 BITS setting from object format */
     if (strcmp(cur_arch_module->keyword, "x86") == 0) {
-        yasm_arch_set_var(cur_arch, "mode_bits",
-                          cur_objfmt_module->default_x86_mode_bits);
+        yasm_arch_set_var(arch, "mode_bits",
+                          objfmt_module->default_x86_mode_bits);
     }
 
-    yasm_arch_set_var(cur_arch, "force_strict", force_strict);
+    yasm_arch_set_var(arch, "force_strict", force_strict);
 
     /* Try to enable the map file via a map NASM directive.  This is
      * somewhat of a hack.
      */
     if (map_filename) {
-        const yasm_directive *dir = &cur_objfmt_module->directives[0];
+        const yasm_directive *dir = &objfmt_module->directives[0];
         matched = 0;
         for (; dir && dir->name; dir++) {
             if (yasm__strcasecmp(dir->name, "map") == 0 &&
@@ -507,73 +724,257 @@ do_assemble(void)
         if (!matched) {
             print_error(
                 _("warning: object format `%s' does not support map files"),
-                cur_objfmt_module->keyword);
+                objfmt_module->keyword);
         }
     }
 
+    profile_end(unit->prof);
+
     /* Parse! */
-    cur_parser_module->do_parse(object, cur_preproc, list_filename != NULL,
+    profile_begin(unit->prof, "parse");
+    cur_parser_module->do_parse(object, preproc, list_filename != NULL,
                                 linemap, errwarns);
-
-    check_errors(errwarns, object, linemap);
+    if (unit->prof)
+        yasm_preproc_get_stats(preproc, profile_pp_stat, unit->prof);
+    profile_end(unit->prof);
+    if (yasm_errwarns_num_errors(errwarns, warning_error) > 0)
+        goto done;
 
     /* Finalize parse */
+    profile_begin(unit->prof, "finalize");
     yasm_object_finalize(object, errwarns);
-    check_errors(errwarns, object, linemap);
+    profile_end(unit->prof);
+    if (yasm_errwarns_num_errors(errwarns, warning_error) > 0)
+        goto done;
 
     /* Optimize */
+    profile_begin(unit->prof, "optimize");
     yasm_object_optimize(object, errwarns);
-    check_errors(errwarns, object, linemap);
+    profile_count(unit->prof, "bytecodes", object->optimize_stats.bytecodes);
+    profile_count(unit->prof, "spans", object->optimize_stats.spans);
+    profile_count(unit->prof, "span expansions",
+                  object->optimize_stats.expansions);
+    profile_count(unit->prof, "span iterations",
+                  object->optimize_stats.iterations);
+    profile_end(unit->prof);
+    if (yasm_errwarns_num_errors(errwarns, warning_error) > 0)
+        goto done;
 
     /* generate any debugging information */
+    profile_begin(unit->prof, "debug info");
     yasm_dbgfmt_generate(object, linemap, errwarns);
-    check_errors(errwarns, object, linemap);
+    profile_end(unit->prof);
+    if (yasm_errwarns_num_errors(errwarns, warning_error) > 0)
+        goto done;
+
+    profile_begin(unit->prof, "output");
 
     /* open the object file for output (if not already opened by dbg objfmt) */
-    if (!obj && strcmp(cur_objfmt_module->keyword, "dbg") != 0) {
-        obj = open_file(obj_filename, "wb");
-        if (!obj) {
-            cleanup(object);
-            return EXIT_FAILURE;
-        }
+    if (!obj && strcmp(objfmt_module->keyword, "dbg") != 0) {
+        obj = open_file(unit->obj_filename, "wb");
+        if (!obj)
+            goto done;
     }
 
-    /* Write the object file */
-    yasm_objfmt_output(object, obj?obj:stderr,
-                       strcmp(cur_dbgfmt_module->keyword, "null"), errwarns);
-
-    /* Close object file */
+    /* Write the object file.  Real object files are built in memory and
+     * written out in one go; the dbg objfmt streams straight to stderr.
+     */
     if (obj)
+        sink = yasm_outsink_create_mem();
+    else
+        sink = yasm_outsink_create_file(stderr);
+    profile_begin(unit->prof, "objfmt");
+    yasm_objfmt_output(object, sink,
+                       strcmp(cur_dbgfmt_module->keyword, "null"), errwarns);
+    if (unit->prof) {
+        unsigned long relocs = 0;
+        yasm_object_sections_traverse(object, &relocs, profile_count_relocs);
+        profile_count(unit->prof, "relocations", relocs);
+    }
+    profile_end(unit->prof);
+
+    /* Flush and close object file */
+    if (obj) {
+        profile_begin(unit->prof, "write");
+        if (yasm_outsink_write_to_file(sink, obj) != 0) {
+            yasm_error_set(YASM_ERROR_IO, N_("error writing object file"));
+            yasm_errwarn_propagate(errwarns, 0);
+        }
         fclose(obj);
+        profile_end(unit->prof);
+    }
+    yasm_outsink_destroy(sink);
+    profile_end(unit->prof);
 
     /* If we had an error at this point, we also need to delete the output
      * object file (to make sure it's not left newer than the source).
      */
-    if (yasm_errwarns_num_errors(errwarns, warning_error) > 0)
-        remove(obj_filename);
-    check_errors(errwarns, object, linemap);
+    if (yasm_errwarns_num_errors(errwarns, warning_error) > 0) {
+        remove(unit->obj_filename);
+        goto done;
+    }
 
     /* Open and write the list file */
     if (list_filename) {
         FILE *list = open_file(list_filename, "wt");
-        if (!list) {
-            cleanup(object);
-            return EXIT_FAILURE;
-        }
+        if (!list)
+            goto done;
+        profile_begin(unit->prof, "list");
         /* Initialize the list format */
-        cur_listfmt = yasm_listfmt_create(cur_listfmt_module, in_filename,
-                                          obj_filename);
-        yasm_listfmt_output(cur_listfmt, list, linemap, cur_arch);
+        listfmt = yasm_listfmt_create(cur_listfmt_module, unit->in_filename,
+                                      unit->obj_filename);
+        yasm_listfmt_output(listfmt, list, linemap, arch);
         fclose(list);
+        profile_end(unit->prof);
     }
 
+    status = EXIT_SUCCESS;
+
+done:
     yasm_errwarns_output_all(errwarns, linemap, warning_error,
                              print_yasm_error, print_yasm_warning);
 
+    if (pp_stats && preproc)
+        yasm_preproc_get_stats(preproc, print_pp_stat, NULL);
+
+    if (arena_stats && object) {
+        unsigned long peak, reserved;
+        yasm_arena_get_stats(object->arena, &peak, &reserved);
+        print_error(_("arena: %lu bytes peak usage, %lu bytes reserved"),
+                    peak, reserved);
+    }
+
+    /* Close any phase cut short by an error */
+    profile_end_all(unit->prof);
+    if (unit->prof && object) {
+        unsigned long peak, reserved;
+        yasm_arena_get_stats(object->arena, &peak, &reserved);
+        profile_count(unit->prof, "arena peak bytes", peak);
+        profile_count(unit->prof, "arena reserved bytes", reserved);
+    }
+
+    if (DO_FREE || batch_filename) {
+        if (listfmt)
+            yasm_listfmt_destroy(listfmt);
+        if (preproc)
+            yasm_preproc_destroy(preproc);
+        if (object)
+            yasm_object_destroy(object);
+    }
     yasm_linemap_destroy(linemap);
     yasm_errwarns_destroy(errwarns);
-    cleanup(object);
-    return EXIT_SUCCESS;
+    return status;
+}
+
+/* Run one unit of a batch. */
+static void
+batch_unit_run(unsigned long job, void *d)
+{
+    assemble_unit *unit = &((assemble_unit *)d)[job];
+
+    cur_errout = &unit->errout;
+    if (generate_make_dependencies)
+        unit->status = do_preproc_only(unit);
+    else
+        unit->status = do_assemble(unit);
+    cur_errout = NULL;
+}
+
+/* Read the batch file.  Each line names an input file and optionally the
+ * output file, separated by whitespace; blank lines and lines starting
+ * with `#' are ignored.  Returns the number of units, or -1 on error.
+ */
+static long
+read_batch_file(/*@out@*/ assemble_unit **units_out)
+{
+    FILE *f;
+    char *line;
+    assemble_unit *units = NULL;
+    unsigned long nunits = 0, maxunits = 0, lineno = 0;
+    int bad = 0;
+
+    if (strcmp(batch_filename, "-") == 0)
+        f = stdin;
+    else {
+        f = open_file(batch_filename, "rt");
+        if (!f)
+            return -1;
+    }
+
+    line = yasm_xmalloc(BATCH_LINE_MAX);
+    while (!bad && fgets(line, BATCH_LINE_MAX, f)) {
+        char *in, *obj, *extra;
+        size_t len = strlen(line);
+
+        lineno++;
+        if (len == BATCH_LINE_MAX-1 && line[len-1] != '\n') {
+            print_error(_("%s:%lu: line too long"), batch_filename, lineno);
+            bad = 1;
+            break;
+        }
+
+        in = strtok(line, " \t\r\n");
+        if (!in || in[0] == '#')
+            continue;
+        obj = strtok(NULL, " \t\r\n");
+        extra = obj ? strtok(NULL, " \t\r\n") : NULL;
+        if (extra) {
+            print_error(_("%s:%lu: expected input and output file names"),
+                        batch_filename, lineno);
+            bad = 1;
+            break;
+        }
+
+        if (nunits >= maxunits) {
+            maxunits = maxunits ? maxunits*2 : 64;
+            units = yasm_xrealloc(units, maxunits*sizeof(assemble_unit));
+        }
+        unit_init(&units[nunits++], in, obj);
+    }
+    yasm_xfree(line);
+
+    if (f != stdin)
+        fclose(f);
+
+    if (bad) {
+        while (nunits > 0)
+            unit_delete(&units[--nunits]);
+        if (units)
+            yasm_xfree(units);
+        return -1;
+    }
+    *units_out = units;
+    return (long)nunits;
+}
+
+/* Assemble (or generate dependencies for) every unit in the batch file on
+ * up to `threads' threads.  Diagnostics and dependencies are printed in
+ * batch file order once all units are done.
+ */
+static int
+do_batch(void)
+{
+    assemble_unit *units = NULL;
+    long nunits, i;
+    int status = EXIT_SUCCESS;
+
+    nunits = read_batch_file(&units);
+    if (nunits < 0)
+        return EXIT_FAILURE;
+
+    yasm_parallel_run(threads, (unsigned long)nunits, units, batch_unit_run);
+
+    if (profile_filename && write_profile(units, (size_t)nunits) != 0)
+        status = EXIT_FAILURE;
+
+    for (i=0; i<nunits; i++) {
+        if (units[i].status != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
+        unit_delete(&units[i]);
+    }
+    if (units)
+        yasm_xfree(units);
+    return status;
 }
 
 /* main function */
@@ -582,6 +983,7 @@ int
 main(int argc, char *argv[])
 {
     size_t i;
+    int retval;
 
     errfile = stderr;
 
@@ -688,7 +1090,7 @@ main(int argc, char *argv[])
         if (!cur_parser_module) {
             print_error(_("%s: could not load default %s"), _("FATAL"),
                         _("parser"));
-            cleanup(NULL);
+            cleanup();
             return EXIT_FAILURE;
         }
     }
@@ -700,20 +1102,52 @@ main(int argc, char *argv[])
         if (!cur_preproc_module) {
             print_error(_("%s: could not load default %s"), _("FATAL"),
                         _("preprocessor"));
-            cleanup(NULL);
+            cleanup();
             return EXIT_FAILURE;
         }
     }
 
-    /* Determine input filename and open input file. */
-    if (!in_filename) {
+    if (batch_filename) {
+        /* Everything else comes from the batch file, and only things that
+         * can be produced for each unit independently are supported.
+         */
+        const char *opt = NULL;
+        if (in_filename)
+            opt = _("input file");
+        else if (obj_filename)
+            opt = "-o";
+        else if (list_filename)
+            opt = "-l";
+        else if (map_filename)
+            opt = "--mapfile";
+        else if (preproc_only && !generate_make_dependencies)
+            opt = "-e";
+        if (opt) {
+            print_error(_("%s: `%s' cannot be used with --batch"), _("FATAL"),
+                        opt);
+            return EXIT_FAILURE;
+        }
+    } else if (!in_filename) {
+        /* Determine input filename and open input file. */
         print_error(_("No input files specified"));
         return EXIT_FAILURE;
     }
 
     /* handle preproc-only case here */
-    if (preproc_only)
-        return do_preproc_only();
+    if (preproc_only) {
+        if (batch_filename)
+            retval = do_batch();
+        else {
+            assemble_unit unit;
+            unit_init(&unit, in_filename, obj_filename);
+            retval = do_preproc_only(&unit);
+            if (profile_filename && write_profile(&unit, 1) != 0)
+                retval = EXIT_FAILURE;
+            unit_delete(&unit);
+        }
+        cleanup();
+        return retval;
+    }
 
     /* If list file enabled, make sure we have a list format loaded. */
     if (list_filename) {
@@ -738,7 +1172,32 @@ main(int argc, char *argv[])
         }
     }
 
-    return do_assemble();
+    /* Set up architecture using machine and parser. */
+    if (!machine_name) {
+        /* If we're using x86 and the default objfmt bits is 64, default the
+         * machine to amd64.  When we get more arches with multiple machines,
+         * we should do this in a more modular fashion.
+         */
+        if (strcmp(cur_arch_module->keyword, "x86") == 0 &&
+            cur_objfmt_module->default_x86_mode_bits == 64)
+            machine_name = yasm__xstrdup("amd64");
+        else
+            machine_name =
+                yasm__xstrdup(cur_arch_module->default_machine_keyword);
+    }
+
+    if (batch_filename)
+        retval = do_batch();
+    else {
+        assemble_unit unit;
+        unit_init(&unit, in_filename, obj_filename);
+        retval = do_assemble(&unit);
+        if (profile_filename && write_profile(&unit, 1) != 0)
+            retval = EXIT_FAILURE;
+        unit_delete(&unit);
+    }
+    cleanup();
+    return retval;
 }
 /*@=globstate =unrecog@*/
 
@@ -754,47 +1213,31 @@ open_file(const char *filename, const char *mode)
     return f;
 }
 
-static void
-check_errors(yasm_errwarns *errwarns, yasm_object *object,
-             yasm_linemap *linemap)
-{
-    if (yasm_errwarns_num_errors(errwarns, warning_error) > 0) {
-        yasm_errwarns_output_all(errwarns, linemap, warning_error,
-                                 print_yasm_error, print_yasm_warning);
-        yasm_linemap_destroy(linemap);
-        yasm_errwarns_destroy(errwarns);
-        cleanup(object);
-        exit(EXIT_FAILURE);
-    }
-}
-
-/* Define DO_FREE to 1 to enable deallocation of all data structures.
- * Useful for detecting memory leaks, but slows down execution unnecessarily
- * (as the OS will free everything we miss here).
- */
-#define DO_FREE         1
-
 /* Cleans up all allocated structures. */
 static void
-cleanup(yasm_object *object)
+cleanup(void)
 {
     if (DO_FREE) {
-        if (cur_listfmt)
-            yasm_listfmt_destroy(cur_listfmt);
-        if (cur_preproc)
-            yasm_preproc_destroy(cur_preproc);
-        if (object)
-            yasm_object_destroy(object);
-
         yasm_floatnum_cleanup();
         yasm_intnum_cleanup();
 
         yasm_errwarn_cleanup();
+        yasm_checksum_cleanup();
 
         BitVector_Shutdown();
     }
 
     if (DO_FREE) {
+        constcharparam *cp, *cpnext;
+
+        cp = STAILQ_FIRST(&preproc_options);
+        while (cp != NULL) {
+            cpnext = STAILQ_NEXT(cp, link);
+            yasm_xfree(cp);
+            cp = cpnext;
+        }
+        STAILQ_INIT(&preproc_options);
+
         if (in_filename)
             yasm_xfree(in_filename);
         if (obj_filename)
@@ -807,6 +1250,12 @@ cleanup(yasm_object *object)
             yasm_xfree(machine_name);
         if (objfmt_keyword)
             yasm_xfree(objfmt_keyword);
+        if (batch_filename)
+            yasm_xfree(batch_filename);
+        if (macro_cache_filename)
+            yasm_xfree(macro_cache_filename);
+        if (profile_filename)
+            yasm_xfree(profile_filename);
     }
 
     if (errfile != stderr && errfile != stdout)
@@ -1049,6 +1498,93 @@ opt_strict_handler(/*@unused@*/ char *cmd,
     return 0;
 }
 
+static int
+opt_fullopt_handler(/*@unused@*/ char *cmd,
+                    /*@unused@*/ /*@null@*/ char *param,
+                    /*@unused@*/ int extra)
+{
+    optimize_full = 1;
+    return 0;
+}
+
+static int
+opt_threads_handler(/*@unused@*/ char *cmd, char *param,
+                    /*@unused@*/ int extra)
+{
+    char *end;
+    unsigned long n = strtoul(param, &end, 10);
+
+    if (*param == '\0' || *end != '\0' || n > 1024) {
+        print_error(_("warning: invalid thread count `%s'"), param);
+        return 0;
+    }
+    if (n > 1 && !yasm_parallel_supported())
+        print_error(_("warning: threads not supported, using 1 thread"));
+    threads = (unsigned int)n;
+    return 0;
+}
+
+static int
+opt_tailmerge_handler(/*@unused@*/ char *cmd,
+                      /*@unused@*/ /*@null@*/ char *param,
+                      /*@unused@*/ int extra)
+{
+    strtab_tail_merge = 1;
+    return 0;
+}
+
+static int
+opt_sortrelocs_handler(/*@unused@*/ char *cmd,
+                       /*@unused@*/ /*@null@*/ char *param,
+                       /*@unused@*/ int extra)
+{
+    sort_relocs = 1;
+    return 0;
+}
+
+static int
+opt_batch_handler(/*@unused@*/ char *cmd, char *param, /*@unused@*/ int extra)
+{
+    if (batch_filename)
+        yasm_xfree(batch_filename);
+
+    assert(param != NULL);
+    batch_filename = yasm__xstrdup(param);
+
+    return 0;
+}
+
+static int
+opt_arena_stats_handler(/*@unused@*/ char *cmd,
+                        /*@unused@*/ /*@null@*/ char *param,
+                        /*@unused@*/ int extra)
+{
+    arena_stats = 1;
+    return 0;
+}
+
+static int
+opt_pp_stats_handler(/*@unused@*/ char *cmd,
+                     /*@unused@*/ /*@null@*/ char *param,
+                     /*@unused@*/ int extra)
+{
+    pp_stats = 1;
+    return 0;
+}
+
+static int
+opt_profile_handler(/*@unused@*/ char *cmd, char *param,
+                    /*@unused@*/ int extra)
+{
+    if (profile_filename)
+        yasm_xfree(profile_filename);
+
+    assert(param != NULL);
+    profile_filename = yasm__xstrdup(param);
+
+    return 0;
+}
+
 static int
 opt_warning_handler(char *cmd, /*@unused@*/ char *param, int extra)
 {
@@ -1143,6 +1679,19 @@ opt_preproc_option(/*@unused@*/ char *cmd, char *param, int extra)
     return 0;
 }
 
+static int
+opt_macro_cache_handler(/*@unused@*/ char *cmd, char *param,
+                        /*@unused@*/ int extra)
+{
+    if (macro_cache_filename)
+        yasm_xfree(macro_cache_filename);
+
+    assert(param != NULL);
+    macro_cache_filename = yasm__xstrdup(param);
+
+    return 0;
+}
+
 static int
 opt_ewmsg_handler(/*@unused@*/ char *cmd, char *param, /*@unused@*/ int extra)
 {
@@ -1204,7 +1753,7 @@ opt_plugin_handler(/*@unused@*/ char *cmd, char *param,
 #endif
 
 static void
-apply_preproc_builtins()
+apply_preproc_builtins(yasm_preproc *preproc)
 {
     char *predef;
 
@@ -1213,12 +1762,13 @@ apply_preproc_builtins()
                           + strlen(objfmt_keyword) + 1);
     strcpy(predef, "__YASM_OBJFMT__=");
     strcat(predef, objfmt_keyword);
-    yasm_preproc_define_builtin(cur_preproc, predef);
+    yasm_preproc_define_builtin(preproc, predef);
     yasm_xfree(predef);
 }
 
 static void
-apply_preproc_standard_macros(const yasm_stdmac *stdmacs)
+apply_preproc_standard_macros(yasm_preproc *preproc,
+                              const yasm_stdmac *stdmacs)
 {
     int i, matched;
 
@@ -1233,13 +1783,16 @@ apply_preproc_standard_macros(const yasm_stdmac *stdmacs)
                              cur_preproc_module->keyword) == 0)
             matched = i;
     if (matched >= 0 && stdmacs[matched].macros)
-        yasm_preproc_add_standard(cur_preproc, stdmacs[matched].macros);
+        yasm_preproc_add_standard(preproc, stdmacs[matched].macros);
 }
 
+/* Apply the saved preprocessor options.  The list is kept, as every unit
+ * of a batch needs it.
+ */
 static void
-apply_preproc_saved_options()
+apply_preproc_saved_options(yasm_preproc *preproc)
 {
-    constcharparam *cp, *cpnext;
+    constcharparam *cp;
 
     void (*funcs[3])(yasm_preproc *, const char *);
     funcs[0] = cur_preproc_module->add_include_file;
@@ -1248,16 +1801,8 @@ apply_preproc_saved_options()
 
     STAILQ_FOREACH(cp, &preproc_options, link) {
         if (0 <= cp->id && cp->id < 3 && funcs[cp->id])
-            funcs[cp->id](cur_preproc, cp->param);
+            funcs[cp->id](preproc, cp->param);
     }
-
-    cp = STAILQ_FIRST(&preproc_options);
-    while (cp != NULL) {
-        cpnext = STAILQ_NEXT(cp, link);
-        yasm_xfree(cp);
-        cp = cpnext;
-    }
-    STAILQ_INIT(&preproc_options);
 }
 
 /* Replace extension on a filename (or append one if none is present).
@@ -1329,15 +1874,39 @@ print_list_keyword_desc(const char *name, const char *keyword)
     printf("%4s%-12s%s\n", "", keyword, name);
 }
 
+/* Print to errfile, or hold back for the current batch unit. */
+static void
+errprintf_va(const char *fmt, va_list va)
+{
+    char msg[ERRMSG_MAX];
+
+    if (!cur_errout) {
+        vfprintf(errfile, fmt, va);
+        return;
+    }
+    vsnprintf(msg, ERRMSG_MAX, fmt, va);
+    msg[ERRMSG_MAX-1] = '\0';
+    textbuf_append(cur_errout, msg, strlen(msg));
+}
+
+static void
+errprintf(const char *fmt, ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    errprintf_va(fmt, va);
+    va_end(va);
+}
+
 static void
 print_error(const char *fmt, ...)
 {
     va_list va;
-    fprintf(errfile, "yasm: ");
+    errprintf("yasm: ");
     va_start(va, fmt);
-    vfprintf(errfile, fmt, va);
+    errprintf_va(fmt, va);
     va_end(va);
-    fputc('\n', errfile);
+    errprintf("\n");
 }
 
 static /*@exits@*/ void
@@ -1383,17 +1952,17 @@ print_yasm_error(const char *filename, unsigned long line, const char *msg,
                  const char *xref_msg)
 {
     if (line)
-        fprintf(errfile, fmt[ewmsg_style], filename, line, _("error: "), msg);
+        errprintf(fmt[ewmsg_style], filename, line, _("error: "), msg);
     else
-        fprintf(errfile, fmt_noline[ewmsg_style], filename, _("error: "), msg);
+        errprintf(fmt_noline[ewmsg_style], filename, _("error: "), msg);
 
     if (xref_fn && xref_msg) {
         if (xref_line)
-            fprintf(errfile, fmt[ewmsg_style], xref_fn, xref_line, _("error: "),
-                    xref_msg);
+            errprintf(fmt[ewmsg_style], xref_fn, xref_line, _("error: "),
+                      xref_msg);
         else
-            fprintf(errfile, fmt_noline[ewmsg_style], xref_fn, _("error: "),
-                    xref_msg);
+            errprintf(fmt_noline[ewmsg_style], xref_fn, _("error: "),
+                      xref_msg);
     }
 }
 
@@ -1401,9 +1970,7 @@ static void
 print_yasm_warning(const char *filename, unsigned long line, const char *msg)
 {
     if (line)
-        fprintf(errfile, fmt[ewmsg_style], filename, line, _("warning: "),
-                msg);
+        errprintf(fmt[ewmsg_style], filename, line, _("warning: "), msg);
     else
-        fprintf(errfile, fmt_noline[ewmsg_style], filename, _("warning: "),
-                msg);
+        errprintf(fmt_noline[ewmsg_style], filename, _("warning: "), msg);
 }
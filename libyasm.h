@@ -44,6 +44,7 @@ typedef unsigned long uintptr_t;
 #include <libyasm/compat-queue.h>
 
 #include <libyasm/coretype.h>
+#include <libyasm/arena.h>
 #include <libyasm/valparam.h>
 
 #include <libyasm/linemap.h>
@@ -68,8 +69,15 @@ typedef unsigned long uintptr_t;
 
 #include <libyasm/file.h>
 #include <libyasm/module.h>
+#include <libyasm/assemble.h>
 
 #include <libyasm/hamt.h>
 #include <libyasm/md5.h>
+#include <libyasm/sha256.h>
+#include <libyasm/checksum.h>
+#include <libyasm/incfile.h>
+#include <libyasm/outsink.h>
+#include <libyasm/strtab.h>
+#include <libyasm/parallel.h>
 
 #endif
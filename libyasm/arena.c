@@ -0,0 +1,344 @@
+/*
+ * Memory arenas
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util.h"
+
+#include "coretype.h"
+#include "arena.h"
+
+
+/* Blocks of up to ARENA_MAX_SMALL bytes are rounded up to a multiple of
+ * ARENA_GRAIN bytes, larger ones to a power of two.  Each size has its own
+ * free list.  Blocks larger than ARENA_MAX_LARGE come straight from the heap.
+ */
+#define ARENA_GRAIN         16
+#define ARENA_NUM_SMALL     32
+#define ARENA_MAX_SMALL     (ARENA_GRAIN*ARENA_NUM_SMALL)
+#define ARENA_NUM_LARGE     16
+#define ARENA_MAX_LARGE     (ARENA_MAX_SMALL<<ARENA_NUM_LARGE)
+#define ARENA_NUM_CLASSES   (ARENA_NUM_SMALL+ARENA_NUM_LARGE)
+#define ARENA_CHUNK_SIZE    (64*1024)
+
+/* Header in front of every block. */
+typedef union arena_header {
+    struct {
+        /* Root arena the block came from (NULL if from the heap) */
+        /*@null@*/ /*@dependent@*/ yasm_arena *root;
+        size_t size;            /* rounded block size */
+    } h;
+    /* Force ARENA_GRAIN alignment of the block on common hosts */
+    double align_d;
+    long align_l;
+    void *align_p;
+} arena_header;
+
+#define ARENA_HDRSIZE \
+    ((sizeof(arena_header)+ARENA_GRAIN-1) & ~(size_t)(ARENA_GRAIN-1))
+
+/* Free blocks are linked through their first bytes. */
+typedef struct arena_free {
+    /*@null@*/ struct arena_free *next;
+} arena_free;
+
+/* Chunks are linked through their first bytes. */
+typedef struct arena_chunk {
+    /*@null@*/ /*@only@*/ struct arena_chunk *next;
+} arena_chunk;
+
+#define ARENA_CHUNK_HDRSIZE \
+    ((sizeof(arena_chunk)+ARENA_GRAIN-1) & ~(size_t)(ARENA_GRAIN-1))
+
+struct yasm_arena {
+    /* Arena blocks are accounted to: itself, or the parent of a child */
+    /*@dependent@*/ yasm_arena *root;
+
+    /*@null@*/ arena_free *free_list[ARENA_NUM_CLASSES];
+
+    /*@null@*/ /*@only@*/ arena_chunk *chunks;
+    /*@null@*/ /*@dependent@*/ unsigned char *next, *end;
+
+    /* Statistics.  For a child, in_use may go negative (it may free blocks
+     * allocated by the parent) and peak is relative to the parent.
+     */
+    long in_use;
+    long peak;
+    unsigned long reserved;
+};
+
+static YASM_THREAD_LOCAL /*@null@*/ yasm_arena *cur_arena = NULL;
+
+static yasm_arena *
+arena_new(yasm_arena *root)
+{
+    yasm_arena *arena = yasm_xmalloc(sizeof(yasm_arena));
+    int i;
+
+    arena->root = root ? root : arena;
+    for (i=0; i<ARENA_NUM_CLASSES; i++)
+        arena->free_list[i] = NULL;
+    arena->chunks = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->in_use = 0;
+    arena->peak = 0;
+    arena->reserved = 0;
+    return arena;
+}
+
+yasm_arena *
+yasm_arena_create(void)
+{
+    return arena_new(NULL);
+}
+
+yasm_arena *
+yasm_arena_create_child(yasm_arena *parent)
+{
+    return arena_new(parent->root);
+}
+
+static void
+arena_free_chunks(yasm_arena *arena)
+{
+    arena_chunk *chunk = arena->chunks;
+    while (chunk) {
+        arena_chunk *next = chunk->next;
+        yasm_xfree(chunk);
+        chunk = next;
+    }
+}
+
+void
+yasm_arena_destroy(yasm_arena *arena)
+{
+    if (cur_arena == arena)
+        cur_arena = NULL;
+    arena_free_chunks(arena);
+    yasm_xfree(arena);
+}
+
+void
+yasm_arena_merge(yasm_arena *child)
+{
+    yasm_arena *parent = child->root;
+    arena_chunk *chunk;
+    int i;
+
+    if (cur_arena == child)
+        cur_arena = NULL;
+
+    /* Hand over the free lists and chunks */
+    for (i=0; i<ARENA_NUM_CLASSES; i++) {
+        arena_free *last = child->free_list[i];
+        if (!last)
+            continue;
+        while (last->next)
+            last = last->next;
+        last->next = parent->free_list[i];
+        parent->free_list[i] = child->free_list[i];
+    }
+    if (child->chunks) {
+        chunk = child->chunks;
+        while (chunk->next)
+            chunk = chunk->next;
+        chunk->next = parent->chunks;
+        parent->chunks = child->chunks;
+    }
+
+    if (parent->in_use + child->peak > parent->peak)
+        parent->peak = parent->in_use + child->peak;
+    parent->in_use += child->in_use;
+    parent->reserved += child->reserved;
+
+    yasm_xfree(child);
+}
+
+yasm_arena *
+yasm_arena_get_current(void)
+{
+    return cur_arena;
+}
+
+yasm_arena *
+yasm_arena_set_current(yasm_arena *arena)
+{
+    yasm_arena *prev = cur_arena;
+    cur_arena = arena;
+    return prev;
+}
+
+/* Round a block size (including header) and get its size class; -1 if the
+ * block is too large to come from an arena.
+ */
+static size_t
+arena_round(size_t size, /*@out@*/ int *cls)
+{
+    size_t rounded;
+
+    if (size <= ARENA_MAX_SMALL) {
+        size = (size + ARENA_GRAIN-1) & ~(size_t)(ARENA_GRAIN-1);
+        *cls = (int)(size/ARENA_GRAIN)-1;
+        return size;
+    }
+    if (size > ARENA_MAX_LARGE) {
+        *cls = -1;
+        return size;
+    }
+    *cls = ARENA_NUM_SMALL;
+    rounded = ARENA_MAX_SMALL*2;
+    while (rounded < size) {
+        rounded <<= 1;
+        (*cls)++;
+    }
+    return rounded;
+}
+
+/* Carve a new block of the given (rounded) size out of arena's chunks. */
+static unsigned char *
+arena_carve(yasm_arena *arena, size_t size)
+{
+    unsigned char *p;
+
+    if (size > ARENA_CHUNK_SIZE - ARENA_CHUNK_HDRSIZE) {
+        /* Chunk of its own */
+        arena_chunk *chunk = yasm_xmalloc(ARENA_CHUNK_HDRSIZE + size);
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->reserved += (unsigned long)(ARENA_CHUNK_HDRSIZE + size);
+        return (unsigned char *)chunk + ARENA_CHUNK_HDRSIZE;
+    }
+
+    if (!arena->next || (size_t)(arena->end - arena->next) < size) {
+        arena_chunk *chunk = yasm_xmalloc(ARENA_CHUNK_SIZE);
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->next = (unsigned char *)chunk + ARENA_CHUNK_HDRSIZE;
+        arena->end = (unsigned char *)chunk + ARENA_CHUNK_SIZE;
+        arena->reserved += ARENA_CHUNK_SIZE;
+    }
+    p = arena->next;
+    arena->next += size;
+    return p;
+}
+
+void *
+yasm_arena_alloc(size_t size)
+{
+    yasm_arena *arena = cur_arena;
+    arena_header *hdr;
+    int cls;
+
+    size = arena_round(size + ARENA_HDRSIZE, &cls);
+
+#ifdef WITH_DMALLOC
+    /* Let dmalloc see every allocation */
+    arena = NULL;
+#endif
+    if (cls < 0)
+        arena = NULL;
+    if (!arena)
+        hdr = yasm_xmalloc(size);
+    else {
+        arena_free **list = &arena->free_list[cls];
+        if (*list) {
+            hdr = (arena_header *)*list;
+            *list = (*list)->next;
+        } else
+            hdr = (arena_header *)arena_carve(arena, size);
+
+        arena->in_use += (long)size;
+        if (arena->in_use > arena->peak)
+            arena->peak = arena->in_use;
+        arena = arena->root;
+    }
+
+    hdr->h.root = arena;
+    hdr->h.size = size;
+    return (unsigned char *)hdr + ARENA_HDRSIZE;
+}
+
+void
+yasm_arena_free(void *ptr)
+{
+    arena_header *hdr;
+    yasm_arena *arena;
+    arena_free *f;
+    size_t size;
+    int cls;
+
+    if (!ptr)
+        return;
+    hdr = (arena_header *)((unsigned char *)ptr - ARENA_HDRSIZE);
+    size = hdr->h.size;
+
+    if (!hdr->h.root) {
+        yasm_xfree(hdr);
+        return;
+    }
+
+    /* Prefer the current arena, so that worker threads don't touch the
+     * parent's free lists.
+     */
+    arena = cur_arena;
+    if (!arena || arena->root != hdr->h.root)
+        arena = hdr->h.root;
+    arena->in_use -= (long)size;
+
+    arena_round(size, &cls);
+    f = (arena_free *)hdr;
+    f->next = arena->free_list[cls];
+    arena->free_list[cls] = f;
+}
+
+void *
+yasm_arena_realloc(void *ptr, size_t size)
+{
+    arena_header *hdr;
+    size_t oldsize;
+    void *newptr;
+    int cls;
+
+    if (!ptr)
+        return yasm_arena_alloc(size);
+
+    hdr = (arena_header *)((unsigned char *)ptr - ARENA_HDRSIZE);
+    if (hdr->h.root && arena_round(size + ARENA_HDRSIZE, &cls) == hdr->h.size)
+        return ptr;     /* same block size */
+    oldsize = hdr->h.size - ARENA_HDRSIZE;
+
+    newptr = yasm_arena_alloc(size);
+    memcpy(newptr, ptr, size < oldsize ? size : oldsize);
+    yasm_arena_free(ptr);
+    return newptr;
+}
+
+void
+yasm_arena_get_stats(const yasm_arena *arena, unsigned long *peak,
+                     unsigned long *reserved)
+{
+    *peak = arena->peak > 0 ? (unsigned long)arena->peak : 0;
+    *reserved = arena->reserved;
+}
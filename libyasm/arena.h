@@ -0,0 +1,125 @@
+/**
+ * \file libyasm/arena.h
+ * \brief YASM memory arena interface.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_ARENA_H
+#define YASM_ARENA_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/* An arena is a region allocator for the small, short-lived core objects
+ * (expressions, intnums, bytecodes, optimizer spans).  Each #yasm_object has
+ * one; freed blocks are kept on per-size free lists for reuse, and all of
+ * the arena's memory is released at once when it is destroyed.
+ *
+ * The allocation functions below allocate from the "current" arena of the
+ * calling thread, or from the heap if there is no current arena.  Blocks
+ * remember where they came from, so any block may be passed to
+ * yasm_arena_free() or yasm_arena_realloc() regardless of the current arena,
+ * provided that its arena has not yet been destroyed.
+ */
+
+/** Create a new, empty arena.
+ * \return New arena.
+ */
+YASM_LIB_DECL
+/*@only@*/ yasm_arena *yasm_arena_create(void);
+
+/** Destroy an arena, releasing all memory allocated from it in bulk.  If
+ * the arena is the current arena, there is no current arena afterwards.
+ * \param arena     arena
+ */
+YASM_LIB_DECL
+void yasm_arena_destroy(/*@only@*/ yasm_arena *arena);
+
+/** Get the current arena of the calling thread.
+ * \return Current arena, or NULL if none.
+ */
+YASM_LIB_DECL
+/*@null@*/ /*@dependent@*/ yasm_arena *yasm_arena_get_current(void);
+
+/** Set the current arena of the calling thread.
+ * \param arena     new current arena (NULL to allocate from the heap)
+ * \return Previous current arena.
+ */
+YASM_LIB_DECL
+/*@null@*/ /*@dependent@*/ yasm_arena *yasm_arena_set_current
+    (/*@null@*/ /*@dependent@*/ yasm_arena *arena);
+
+/** Create a child arena for use as the current arena of a worker thread
+ * while the parent is in use by another thread.  Blocks allocated from a
+ * child belong to the parent once yasm_arena_merge() is called.
+ * \param parent    parent arena
+ * \return New child arena.
+ */
+YASM_LIB_DECL
+/*@only@*/ yasm_arena *yasm_arena_create_child(yasm_arena *parent);
+
+/** Merge a child arena (see yasm_arena_create_child()) into its parent and
+ * delete it.  Must not be called concurrently with other uses of the parent.
+ * \param child     child arena
+ */
+YASM_LIB_DECL
+void yasm_arena_merge(/*@only@*/ yasm_arena *child);
+
+/** Allocate a block from the current arena.
+ * \param size      number of bytes
+ * \return Allocated block; never NULL (out of memory is fatal).
+ */
+YASM_LIB_DECL
+/*@only@*/ void *yasm_arena_alloc(size_t size);
+
+/** Resize a block allocated by yasm_arena_alloc().
+ * \param ptr       block (may be NULL)
+ * \param size      new number of bytes
+ * \return Resized block (may be moved).
+ */
+YASM_LIB_DECL
+/*@only@*/ void *yasm_arena_realloc(/*@only@*/ /*@null@*/ void *ptr,
+                                    size_t size);
+
+/** Free a block allocated by yasm_arena_alloc().
+ * \param ptr       block (may be NULL)
+ */
+YASM_LIB_DECL
+void yasm_arena_free(/*@only@*/ /*@null@*/ void *ptr);
+
+/** Get usage statistics for an arena.  With worker threads, the peak is
+ * an approximation.
+ * \param arena     arena
+ * \param peak      peak number of bytes allocated at any one time (output)
+ * \param reserved  number of bytes obtained from the heap (output)
+ */
+YASM_LIB_DECL
+void yasm_arena_get_stats(const yasm_arena *arena,
+                          /*@out@*/ unsigned long *peak,
+                          /*@out@*/ unsigned long *reserved);
+
+#endif
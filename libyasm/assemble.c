@@ -0,0 +1,350 @@
+/*
+ * In-process assembly
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util.h"
+
+#include "coretype.h"
+#include "errwarn.h"
+#include "intnum.h"
+#include "linemap.h"
+#include "section.h"
+#include "arch.h"
+#include "objfmt.h"
+#include "dbgfmt.h"
+#include "parser.h"
+#include "preproc.h"
+#include "module.h"
+#include "outsink.h"
+#include "assemble.h"
+
+
+void
+yasm_assemble_options_init(yasm_assemble_options *opts)
+{
+    opts->arch = NULL;
+    opts->machine = NULL;
+    opts->parser = NULL;
+    opts->preproc = NULL;
+    opts->objfmt = NULL;
+    opts->dbgfmt = NULL;
+    opts->src_filename = NULL;
+    opts->obj_filename = NULL;
+    opts->predefines = NULL;
+    opts->warning_error = 0;
+    opts->force_strict = 0;
+}
+
+/* Fail before assembly starts with a single error message.  fmt takes up
+ * to four string arguments; unused ones are ignored.
+ */
+static int
+assemble_error(yasm_assemble_result *result, const char *fmt, const char *a1,
+               const char *a2, const char *a3, const char *a4)
+{
+    const char *prefix = yasm_gettext_hook(N_("error: "));
+
+    fmt = yasm_gettext_hook(fmt);
+    result->messages = yasm_xmalloc(strlen(prefix) + strlen(fmt) +
+                                    strlen(a1) + strlen(a2) + strlen(a3) +
+                                    strlen(a4) + 2);
+    strcpy(result->messages, prefix);
+    sprintf(result->messages + strlen(prefix), fmt, a1, a2, a3, a4);
+    strcat(result->messages, "\n");
+    result->num_errors = 1;
+    return 1;
+}
+
+/* Add the standard macros for the parser/preprocessor combination. */
+static void
+assemble_add_standard(yasm_preproc *preproc, const yasm_stdmac *stdmacs,
+                      const char *parser, const char *preproc_keyword)
+{
+    int i, matched;
+
+    if (!stdmacs)
+        return;
+
+    matched = -1;
+    for (i=0; stdmacs[i].parser; i++)
+        if (yasm__strcasecmp(stdmacs[i].parser, parser) == 0 &&
+            yasm__strcasecmp(stdmacs[i].preproc, preproc_keyword) == 0)
+            matched = i;
+    if (matched >= 0 && stdmacs[matched].macros)
+        yasm_preproc_add_standard(preproc, stdmacs[matched].macros);
+}
+
+static int
+assemble(const char *source, size_t len, const yasm_assemble_options *opts,
+         yasm_assemble_result *result)
+{
+    yasm_assemble_options defopts;
+    yasm_arch_module *arch_module;
+    yasm_parser_module *parser_module;
+    yasm_preproc_module *preproc_module;
+    yasm_objfmt_module *objfmt_module;
+    yasm_dbgfmt_module *dbgfmt_module;
+    const yasm_objfmt_module *objfmt;
+    yasm_arch_create_error arch_error;
+    yasm_arch *arch;
+    yasm_object *object;
+    yasm_linemap *linemap;
+    yasm_errwarns *errwarns;
+    yasm_preproc *preproc;
+    yasm_outsink *sink;
+    const char *arch_keyword, *parser_keyword, *preproc_keyword;
+    const char *objfmt_keyword, *dbgfmt_keyword, *machine;
+    const char *src_filename, *obj_filename;
+    char *predef;
+    int i, matched;
+
+    result->obj = NULL;
+    result->obj_len = 0;
+    result->messages = NULL;
+    result->num_errors = 0;
+
+    /* Start with a clean error/warning indicator */
+    yasm_error_clear();
+    yasm_warn_clear();
+    yasm_warn_set_suppressed(0);
+
+    if (!opts) {
+        yasm_assemble_options_init(&defopts);
+        opts = &defopts;
+    }
+
+    arch_keyword = opts->arch ? opts->arch : "x86";
+    parser_keyword = opts->parser ? opts->parser : "nasm";
+    objfmt_keyword = opts->objfmt ? opts->objfmt : "bin";
+    dbgfmt_keyword = opts->dbgfmt ? opts->dbgfmt : "null";
+    src_filename = opts->src_filename ? opts->src_filename : "-";
+    obj_filename = opts->obj_filename ? opts->obj_filename : "yasm.out";
+
+    /* Load modules */
+    arch_module = yasm_load_arch(arch_keyword);
+    if (!arch_module)
+        return assemble_error(result, N_("unrecognized %s `%s'"),
+                              "architecture", arch_keyword, "", "");
+    parser_module = yasm_load_parser(parser_keyword);
+    if (!parser_module)
+        return assemble_error(result, N_("unrecognized %s `%s'"),
+                              "parser", parser_keyword, "", "");
+    preproc_keyword = opts->preproc ? opts->preproc :
+        parser_module->default_preproc_keyword;
+    preproc_module = yasm_load_preproc(preproc_keyword);
+    if (!preproc_module)
+        return assemble_error(result, N_("unrecognized %s `%s'"),
+                              "preprocessor", preproc_keyword, "", "");
+    objfmt_module = yasm_load_objfmt(objfmt_keyword);
+    if (!objfmt_module)
+        return assemble_error(result, N_("unrecognized %s `%s'"),
+                              "object format", objfmt_keyword, "", "");
+    dbgfmt_module = yasm_load_dbgfmt(dbgfmt_keyword);
+    if (!dbgfmt_module)
+        return assemble_error(result, N_("unrecognized %s `%s'"),
+                              "debug format", dbgfmt_keyword, "", "");
+
+    /* Check to see if the requested preprocessor is in the allowed list
+     * for the active parser, and that it can read from memory.
+     */
+    matched = 0;
+    for (i=0; parser_module->preproc_keywords[i]; i++)
+    {
+        if (yasm__strcasecmp(parser_module->preproc_keywords[i],
+                             preproc_module->keyword) == 0) {
+            matched = 1;
+            break;
+        }
+    }
+    if (!matched)
+        return assemble_error(result, N_("`%s' is not a valid %s for %s `%s'"),
+                              preproc_module->keyword, "preprocessor",
+                              "parser", parser_module->keyword);
+    if (!preproc_module->create_mem)
+        return assemble_error(result,
+                              N_("%s `%s' cannot read from memory"),
+                              "preprocessor", preproc_module->keyword,
+                              "", "");
+
+    /* Set up architecture using machine and parser; see the yasm frontend
+     * for why these are the defaults.
+     */
+    if (opts->machine)
+        machine = opts->machine;
+    else if (strcmp(arch_module->keyword, "x86") == 0 &&
+             objfmt_module->default_x86_mode_bits == 64)
+        machine = "amd64";
+    else
+        machine = arch_module->default_machine_keyword;
+    if (strcmp(machine, "amd64") == 0 &&
+        strcmp(objfmt_module->keyword, "elfx32") == 0)
+        machine = "x32";
+
+    arch = yasm_arch_create(arch_module, machine, parser_module->keyword,
+                            &arch_error);
+    if (!arch) {
+        if (arch_error == YASM_ARCH_CREATE_BAD_MACHINE)
+            return assemble_error(result,
+                                  N_("`%s' is not a valid %s for %s `%s'"),
+                                  machine, "machine", "architecture",
+                                  arch_module->keyword);
+        if (arch_error == YASM_ARCH_CREATE_BAD_PARSER)
+            return assemble_error(result,
+                                  N_("`%s' is not a valid %s for %s `%s'"),
+                                  parser_module->keyword, "parser",
+                                  "architecture", arch_module->keyword);
+        return assemble_error(result, N_("unknown architecture error"),
+                              "", "", "", "");
+    }
+
+    /* Create object (this takes ownership of arch, even on error) */
+    object = yasm_object_create(src_filename, obj_filename, arch,
+                                objfmt_module, dbgfmt_module);
+    if (!object) {
+        yasm_error_class eclass;
+        unsigned long xrefline;
+        /*@only@*/ /*@null@*/ char *estr, *xrefstr;
+
+        yasm_error_fetch(&eclass, &estr, &xrefline, &xrefstr);
+        assemble_error(result, "%s", estr ? estr : "", "", "", "");
+        if (estr)
+            yasm_xfree(estr);
+        if (xrefstr)
+            yasm_xfree(xrefstr);
+        return 1;
+    }
+
+    /* The object format module may have changed (e.g. win32 for coff). */
+    objfmt = ((yasm_objfmt_base *)object->objfmt)->module;
+
+    linemap = yasm_linemap_create();
+    yasm_linemap_set(linemap, src_filename, 0, 1, 1);
+    errwarns = yasm_errwarns_create();
+
+    preproc = yasm_preproc_create_mem(preproc_module, src_filename, source,
+                                      len, object->symtab, linemap,
+                                      errwarns);
+
+    predef = yasm_xmalloc(strlen("__YASM_OBJFMT__=")
+                          + strlen(objfmt_keyword) + 1);
+    strcpy(predef, "__YASM_OBJFMT__=");
+    strcat(predef, objfmt_keyword);
+    yasm_preproc_define_builtin(preproc, predef);
+    yasm_xfree(predef);
+
+    assemble_add_standard(preproc, parser_module->stdmacs,
+                          parser_module->keyword, preproc_module->keyword);
+    assemble_add_standard(preproc, objfmt->stdmacs,
+                          parser_module->keyword, preproc_module->keyword);
+
+    if (opts->predefines) {
+        for (i=0; opts->predefines[i]; i++)
+            yasm_preproc_predefine_macro(preproc, opts->predefines[i]);
+    }
+
+    /* Get initial x86 BITS setting from object format */
+    if (strcmp(arch_module->keyword, "x86") == 0)
+        yasm_arch_set_var(arch, "mode_bits", objfmt->default_x86_mode_bits);
+    yasm_arch_set_var(arch, "force_strict", (unsigned long)opts->force_strict);
+
+    /* Assemble, stopping after the first stage with errors */
+    parser_module->do_parse(object, preproc, 0, linemap, errwarns);
+    if (yasm_errwarns_num_errors(errwarns, opts->warning_error) > 0)
+        goto done;
+
+    yasm_object_finalize(object, errwarns);
+    if (yasm_errwarns_num_errors(errwarns, opts->warning_error) > 0)
+        goto done;
+
+    yasm_object_optimize(object, errwarns);
+    if (yasm_errwarns_num_errors(errwarns, opts->warning_error) > 0)
+        goto done;
+
+    yasm_dbgfmt_generate(object, linemap, errwarns);
+    if (yasm_errwarns_num_errors(errwarns, opts->warning_error) > 0)
+        goto done;
+
+    sink = yasm_outsink_create_mem();
+    yasm_objfmt_output(object, sink, strcmp(dbgfmt_module->keyword, "null"),
+                       errwarns);
+    if (yasm_errwarns_num_errors(errwarns, opts->warning_error) == 0) {
+        const unsigned char *image;
+        unsigned long image_len;
+
+        image = yasm_outsink_get_image(sink, &image_len);
+        result->obj = yasm_xmalloc(image_len > 0 ? image_len : 1);
+        if (image_len > 0)
+            memcpy(result->obj, image, image_len);
+        result->obj_len = image_len;
+    }
+    yasm_outsink_destroy(sink);
+
+done:
+    result->num_errors = yasm_errwarns_num_errors(errwarns,
+                                                  opts->warning_error);
+    result->messages = yasm_errwarns_output_string(errwarns, linemap,
+                                                   opts->warning_error);
+
+    yasm_preproc_destroy(preproc);
+    yasm_object_destroy(object);
+    yasm_linemap_destroy(linemap);
+    yasm_errwarns_destroy(errwarns);
+
+    /* Don't leave anything that wasn't propagated for the next unit */
+    yasm_error_clear();
+    yasm_warn_clear();
+    yasm_warn_set_suppressed(0);
+
+    return result->num_errors > 0;
+}
+
+int
+yasm_assemble(const char *source, size_t len,
+              const yasm_assemble_options *opts,
+              yasm_assemble_result *result)
+{
+    int retval;
+
+    /* The intnum scratch space and error/warning indicators are
+     * per-thread; make sure this one has them
+     */
+    yasm_intnum_initialize();
+    yasm_errwarn_thread_initialize();
+    retval = assemble(source, len, opts, result);
+    yasm_intnum_cleanup();
+    return retval;
+}
+
+void
+yasm_assemble_result_delete(yasm_assemble_result *result)
+{
+    if (result->obj)
+        yasm_xfree(result->obj);
+    if (result->messages)
+        yasm_xfree(result->messages);
+    result->obj = NULL;
+    result->obj_len = 0;
+    result->messages = NULL;
+}
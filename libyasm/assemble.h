@@ -0,0 +1,138 @@
+/**
+ * \file libyasm/assemble.h
+ * \brief YASM in-process assembly interface.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_ASSEMBLE_H
+#define YASM_ASSEMBLE_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/** Options for yasm_assemble().  Call yasm_assemble_options_init() before
+ * setting any members so that unset members get their defaults.
+ */
+typedef struct yasm_assemble_options {
+    /** Architecture keyword (default "x86"). */
+    /*@null@*/ const char *arch;
+
+    /** Machine keyword (default chosen from the architecture and object
+     * format, as the command line does).
+     */
+    /*@null@*/ const char *machine;
+
+    /** Parser keyword (default "nasm"). */
+    /*@null@*/ const char *parser;
+
+    /** Preprocessor keyword (default is the parser's default).  The
+     * preprocessor must be able to read from memory (see
+     * yasm_preproc_module.create_mem).
+     */
+    /*@null@*/ const char *preproc;
+
+    /** Object format keyword (default "bin"). */
+    /*@null@*/ const char *objfmt;
+
+    /** Debug format keyword (default "null"). */
+    /*@null@*/ const char *dbgfmt;
+
+    /** Source filename, used in messages and debug information (default
+     * "-").  Never opened.
+     */
+    /*@null@*/ const char *src_filename;
+
+    /** Object filename, recorded by some object and debug formats (default
+     * "yasm.out").  Never opened.
+     */
+    /*@null@*/ const char *obj_filename;
+
+    /** NULL-terminated list of "name=value" macros to predefine, or NULL. */
+    /*@null@*/ const char * const *predefines;
+
+    /** Treat warnings as errors. */
+    int warning_error;
+
+    /** Treat all sized operands as if "strict" was used. */
+    int force_strict;
+} yasm_assemble_options;
+
+/** Output of yasm_assemble(). */
+typedef struct yasm_assemble_result {
+    /** Object file image, or NULL if assembly failed. */
+    /*@only@*/ /*@null@*/ unsigned char *obj;
+
+    /** Length of object file image in bytes. */
+    unsigned long obj_len;
+
+    /** Errors and warnings, one per line, formatted as
+     * "file:line: error: message"; empty if there are none.
+     */
+    /*@only@*/ char *messages;
+
+    /** Number of errors (including warnings if warning_error was set). */
+    unsigned int num_errors;
+} yasm_assemble_result;
+
+/** Initialize assembly options to their defaults.
+ * \param opts      options
+ */
+YASM_LIB_DECL
+void yasm_assemble_options_init(/*@out@*/ yasm_assemble_options *opts);
+
+/** Assemble source text held in memory into an object file image in memory,
+ * without touching the filesystem (other than for files the source itself
+ * includes).  Everything created for the assembly is destroyed before
+ * returning, so any number of units can be assembled back to back in one
+ * process, and (where libyasm is built with thread support) concurrently
+ * from several threads.
+ * \param source    source text
+ * \param len       length of source text in bytes
+ * \param opts      options (NULL for all defaults)
+ * \param result    (returned) object image and messages; free with
+ *                  yasm_assemble_result_delete()
+ * \return 0 on success, nonzero if there were errors.
+ * \note libyasm must already be initialized (BitVector_Boot(),
+ *       yasm_floatnum_initialize(), yasm_errwarn_initialize()) by the
+ *       main thread, and the requested modules must be loadable with
+ *       yasm_load_module().  The per-thread intnum and error/warning
+ *       state is set up here.
+ *       Fatal and internal errors still go through #yasm_fatal and
+ *       #yasm_internal_error_.
+ */
+YASM_LIB_DECL
+int yasm_assemble(const char *source, size_t len,
+                  /*@null@*/ const yasm_assemble_options *opts,
+                  /*@out@*/ yasm_assemble_result *result);
+
+/** Free the contents of an assembly result.
+ * \param result    result filled in by yasm_assemble()
+ */
+YASM_LIB_DECL
+void yasm_assemble_result_delete(yasm_assemble_result *result);
+
+#endif
@@ -49,6 +49,10 @@ struct yasm_dataval {
         struct {
             /*@only@*/ unsigned char *contents;
             unsigned long len;
+            /* allocated size if constants may be appended (see
+             * yasm_dvs_append_intnum()), 0 otherwise.
+             */
+            unsigned long alloc;
         } raw;
     } data;
 
@@ -113,6 +117,15 @@ bc_data_finalize(yasm_bytecode *bc, yasm_bytecode *prev_bc)
     /* Convert values from simple expr to value. */
     STAILQ_FOREACH(dv, &bc_data->datahead, link) {
         switch (dv->type) {
+            case DV_RAW:
+                /* Trim space left for appending constants */
+                if (dv->data.raw.alloc > dv->data.raw.len) {
+                    dv->data.raw.contents =
+                        yasm_xrealloc(dv->data.raw.contents,
+                                      dv->data.raw.len);
+                    dv->data.raw.alloc = dv->data.raw.len;
+                }
+                break;
             case DV_VALUE:
                 if (yasm_value_finalize(&dv->data.val, prev_bc)) {
                     yasm_error_set(YASM_ERROR_TOO_COMPLEX,
@@ -273,6 +286,17 @@ yasm_bc_create_data(yasm_datavalhead *datahead, unsigned int size,
     yasm_dvs_initialize(&data->datahead);
     data->item_size = size;
 
+    /* A list that's just a run of constants (see yasm_dvs_append_intnum())
+     * is already in its final form; take it over rather than copying it.
+     */
+    dv = STAILQ_FIRST(datahead);
+    if (dv && !STAILQ_NEXT(dv, link) && dv->type == DV_RAW
+        && dv->data.raw.alloc != 0 && !dv->multiple && !append_zero
+        && size != 0 && dv->data.raw.len % size == 0) {
+        STAILQ_INSERT_TAIL(&data->datahead, dv, link);
+        return bc;
+    }
+
     /* Prescan input data for length, etc.  Careful: this needs to be
      * precisely paired with the second loop.
      */
@@ -421,6 +445,47 @@ yasm_bc_create_data(yasm_datavalhead *datahead, unsigned int size,
     return bc;
 }
 
+/* Is the data bytecode just a run of constants? */
+static /*@null@*/ yasm_dataval *
+bc_data_const_run(yasm_bytecode *bc)
+{
+    bytecode_data *bc_data = (bytecode_data *)bc->contents;
+    yasm_dataval *dv = STAILQ_FIRST(&bc_data->datahead);
+
+    if (bc->callback != &bc_data_callback || bc->multiple || !dv
+        || STAILQ_NEXT(dv, link) || dv->type != DV_RAW
+        || dv->data.raw.alloc == 0 || dv->multiple)
+        return NULL;
+    return dv;
+}
+
+int
+yasm_bc_data_merge(yasm_bytecode *bc, yasm_bytecode *next)
+{
+    yasm_dataval *dv, *ndv;
+    unsigned long len;
+
+    if (bc->symrecs || !(dv = bc_data_const_run(bc))
+        || !(ndv = bc_data_const_run(next))
+        || ((bytecode_data *)bc->contents)->item_size !=
+           ((bytecode_data *)next->contents)->item_size)
+        return 0;
+
+    len = dv->data.raw.len + ndv->data.raw.len;
+    if (len > dv->data.raw.alloc) {
+        dv->data.raw.alloc *= 2;
+        if (len > dv->data.raw.alloc)
+            dv->data.raw.alloc = len;
+        dv->data.raw.contents = yasm_xrealloc(dv->data.raw.contents,
+                                              dv->data.raw.alloc);
+    }
+    memcpy(&dv->data.raw.contents[dv->data.raw.len], ndv->data.raw.contents,
+           ndv->data.raw.len);
+    dv->data.raw.len = len;
+    yasm_bc_destroy(next);
+    return 1;
+}
+
 yasm_bytecode *
 yasm_bc_create_leb128(yasm_datavalhead *datahead, int sign, unsigned long line)
 {
@@ -464,11 +529,40 @@ yasm_dv_create_raw(unsigned char *contents, unsigned long len)
     retval->type = DV_RAW;
     retval->data.raw.contents = contents;
     retval->data.raw.len = len;
+    retval->data.raw.alloc = 0;
     retval->multiple = NULL;
 
     return retval;
 }
 
+void
+yasm_dvs_append_intnum(yasm_datavalhead *headp, const yasm_intnum *intn,
+                       unsigned int size, yasm_arch *arch)
+{
+    yasm_dataval *dv = STAILQ_LAST(headp, yasm_dataval, link);
+    unsigned char *buf;
+
+    /* Start a new run of constants if the list doesn't end with one */
+    if (!dv || dv->type != DV_RAW || dv->data.raw.alloc == 0
+        || dv->multiple) {
+        dv = yasm_dv_create_raw(yasm_xmalloc(16*size), 0);
+        dv->data.raw.alloc = 16*size;
+        STAILQ_INSERT_TAIL(headp, dv, link);
+    } else if (dv->data.raw.len + size > dv->data.raw.alloc) {
+        dv->data.raw.alloc *= 2;
+        dv->data.raw.contents = yasm_xrealloc(dv->data.raw.contents,
+                                              dv->data.raw.alloc);
+    }
+
+    /* Same conversion as yasm_bc_create_data() */
+    buf = &dv->data.raw.contents[dv->data.raw.len];
+    if (size == 1)
+        yasm_intnum_get_sized(intn, buf, 1, 8, 0, 0, 1);
+    else
+        yasm_arch_intnum_tobytes(arch, intn, buf, size, size*8, 0, NULL, 1);
+    dv->data.raw.len += size;
+}
+
 yasm_dataval *
 yasm_dv_create_reserve(void)
 {
@@ -37,8 +37,10 @@
 #include "value.h"
 
 #include "bytecode.h"
+#include "section.h"
 
 #include "file.h"
+#include "incfile.h"
 
 
 typedef struct bytecode_incbin {
@@ -50,6 +52,10 @@ typedef struct bytecode_incbin {
 
     /* maximum number of bytes to read (NULL=no limit) */
     /*@only@*/ /*@null@*/ yasm_expr *maxlen;
+
+    /* file and starting offset, once the length has been calculated */
+    /*@dependent@*/ /*@null@*/ yasm_incfile *file;
+    unsigned long offset;
 } bytecode_incbin;
 
 static void bc_incbin_destroy(void *contents);
@@ -132,9 +138,9 @@ bc_incbin_calc_len(yasm_bytecode *bc, yasm_bc_add_span_func add_span,
                    void *add_span_data)
 {
     bytecode_incbin *incbin = (bytecode_incbin *)bc->contents;
-    FILE *f;
     /*@dependent@*/ /*@null@*/ const yasm_intnum *num;
     unsigned long start = 0, maxlen = 0xFFFFFFFFUL, flen;
+    yasm_object *object;
 
     /* Try to convert start to integer value */
     if (incbin->start) {
@@ -163,21 +169,16 @@ bc_incbin_calc_len(yasm_bytecode *bc, yasm_bc_add_span_func add_span,
     }
 
     /* Open file and determine its length */
-    f = yasm_fopen_include(incbin->filename, incbin->from, "rb", NULL);
-    if (!f) {
+    object = yasm_section_get_object(bc->section);
+    incbin->file = yasm_incfile_open(object->incfiles, incbin->filename,
+                                     incbin->from);
+    if (!incbin->file) {
         yasm_error_set(YASM_ERROR_IO,
                        N_("`incbin': unable to open file `%s'"),
                        incbin->filename);
         return -1;
     }
-    if (fseek(f, 0L, SEEK_END) < 0) {
-        yasm_error_set(YASM_ERROR_IO,
-                       N_("`incbin': unable to seek on file `%s'"),
-                       incbin->filename);
-        return -1;
-    }
-    flen = (unsigned long)ftell(f);
-    fclose(f);
+    flen = yasm_incfile_size(incbin->file);
 
     /* Compute length of incbin from start, maxlen, and len */
     if (start > flen) {
@@ -190,6 +191,7 @@ bc_incbin_calc_len(yasm_bytecode *bc, yasm_bc_add_span_func add_span,
     if (incbin->maxlen)
         if (maxlen < flen)
             flen = maxlen;
+    incbin->offset = start;
     bc->len += flen;
     return 0;
 }
@@ -201,47 +203,21 @@ bc_incbin_tobytes(yasm_bytecode *bc, unsigned char **bufp,
                   /*@unused@*/ yasm_output_reloc_func output_reloc)
 {
     bytecode_incbin *incbin = (bytecode_incbin *)bc->contents;
-    FILE *f;
-    /*@dependent@*/ /*@null@*/ const yasm_intnum *num;
-    unsigned long start = 0;
-
-    /* Convert start to integer value */
-    if (incbin->start) {
-        num = yasm_expr_get_intnum(&incbin->start, 0);
-        if (!num)
-            yasm_internal_error(
-                N_("could not determine start in bc_tobytes_incbin"));
-        start = yasm_intnum_get_uint(num);
-    }
-
-    /* Open file */
-    f = yasm_fopen_include(incbin->filename, incbin->from, "rb", NULL);
-    if (!f) {
-        yasm_error_set(YASM_ERROR_IO, N_("`incbin': unable to open file `%s'"),
-                       incbin->filename);
-        return 1;
-    }
 
-    /* Seek to start of data */
-    if (fseek(f, (long)start, SEEK_SET) < 0) {
-        yasm_error_set(YASM_ERROR_IO,
-                       N_("`incbin': unable to seek on file `%s'"),
-                       incbin->filename);
-        fclose(f);
-        return 1;
-    }
+    if (!incbin->file)
+        yasm_internal_error(
+            N_("file not opened in bc_tobytes_incbin"));
 
     /* Read len bytes */
-    if (fread(*bufp, 1, (size_t)bc->len, f) < (size_t)bc->len) {
+    if (yasm_incfile_read(incbin->file, incbin->offset, *bufp,
+                          (size_t)bc->len) != 0) {
         yasm_error_set(YASM_ERROR_IO,
                        N_("`incbin': unable to read %lu bytes from file `%s'"),
                        bc->len, incbin->filename);
-        fclose(f);
         return 1;
     }
 
     *bufp += bc->len;
-    fclose(f);
     return 0;
 }
 
@@ -260,6 +236,20 @@ yasm_bc_create_incbin(char *filename, yasm_expr *start, yasm_expr *maxlen,
     incbin->start = start;
     incbin->maxlen = maxlen;
     /*@=mustfree@*/
+    incbin->file = NULL;
+    incbin->offset = 0;
 
     return yasm_bc_create_common(&bc_incbin_callback, incbin, line);
 }
+
+yasm_incfile *
+yasm_bc_get_incbin(yasm_bytecode *bc, unsigned long *offset)
+{
+    bytecode_incbin *incbin;
+
+    if (bc->callback != &bc_incbin_callback || bc->mult_int != 1)
+        return NULL;
+    incbin = (bytecode_incbin *)bc->contents;
+    *offset = incbin->offset;
+    return incbin->file;
+}
@@ -613,20 +613,19 @@ void BitVector_Copy(wordptr X, wordptr Y)                           /* X = Y */
         lastX = X + sizeX - 1;
         if (sizeY > 0)
         {
+            /* Y is only read: it may be shared between threads */
             lastY = Y + sizeY - 1;
-            if ( (*lastY AND (maskY AND NOT (maskY >> 1))) == 0 ) *lastY &= maskY;
-            else
-            {
+            if ( (*lastY AND (maskY AND NOT (maskY >> 1))) != 0 )
                 fill = (N_word) ~0L;
-                *lastY |= NOT maskY;
-            }
             while ((sizeX > 0) and (sizeY > 0))
             {
-                *X++ = *Y++;
+                if (Y == lastY)
+                    *X++ = fill ? (*Y++ OR NOT maskY) : (*Y++ AND maskY);
+                else
+                    *X++ = *Y++;
                 sizeX--;
                 sizeY--;
             }
-            *lastY &= maskY;
         }
         while (sizeX-- > 0) *X++ = fill;
         *lastX &= maskX;
@@ -1348,7 +1347,9 @@ boolean BitVector_is_empty(wordptr addr)                    /* X == {} ?     */
 
     if (size > 0)
     {
-        *(addr+size-1) &= mask_(addr);
+        /* addr is only read: it may be shared between threads */
+        r = ( (*(addr+size-1) AND mask_(addr)) == 0 );
+        size--;
         while (r and (size-- > 0)) r = ( *addr++ == 0 );
     }
     return(r);
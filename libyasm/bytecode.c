@@ -28,6 +28,7 @@
 
 #include "libyasm-stdint.h"
 #include "coretype.h"
+#include "arena.h"
 
 #include "errwarn.h"
 #include "intnum.h"
@@ -96,7 +97,7 @@ yasm_bytecode *
 yasm_bc_create_common(const yasm_bytecode_callback *callback, void *contents,
                       unsigned long line)
 {
-    yasm_bytecode *bc = yasm_xmalloc(sizeof(yasm_bytecode));
+    yasm_bytecode *bc = yasm_arena_alloc(sizeof(yasm_bytecode));
 
     bc->callback = callback;
     bc->section = NULL;
@@ -149,7 +150,7 @@ yasm_bc_destroy(yasm_bytecode *bc)
     yasm_expr_destroy(bc->multiple);
     if (bc->symrecs)
         yasm_xfree(bc->symrecs);
-    yasm_xfree(bc);
+    yasm_arena_free(bc);
 }
 
 void
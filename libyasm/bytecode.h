@@ -320,6 +320,20 @@ YASM_LIB_DECL
 /*@only@*/ yasm_bytecode *yasm_bc_create_leb128
     (yasm_datavalhead *datahead, int sign, unsigned long line);
 
+/** Append the contents of a data bytecode to another, if both are just
+ * runs of constants of the same size (see yasm_dvs_append_intnum()), so
+ * that consecutive lines of constant data can share a bytecode.  This is
+ * only done if no labels follow bc.  The caller must ensure that bc is the
+ * last bytecode in the section next would be appended to, that nothing else
+ * refers to the position after bc, and that nothing needs the lines of
+ * next's data (e.g. listings or debug line information).
+ * \param bc            data bytecode
+ * \param next          data bytecode to append
+ * \return Nonzero if next was appended (and deleted), zero if not.
+ */
+YASM_LIB_DECL
+int yasm_bc_data_merge(yasm_bytecode *bc, /*@only@*/ yasm_bytecode *next);
+
 /** Create a bytecode reserving space.
  * \param numitems      number of reserve "items" (kept, do not free)
  * \param itemsize      reserved size (in bytes) for each item
@@ -358,6 +372,19 @@ YASM_LIB_DECL
      /*@only@*/ /*@null@*/ yasm_expr *maxlen, yasm_linemap *linemap,
      unsigned long line);
 
+/** Get the included file an incbin bytecode outputs, so that object formats
+ * can write it with yasm_outsink_write_file() instead of reading it through
+ * yasm_bc_tobytes().  Only valid after the bytecode length is calculated.
+ * \param bc            bytecode
+ * \param offset        offset in file of the data (returned); the length of
+ *                      the data is the bytecode length
+ * \return NULL if bc is not an incbin bytecode (or is repeated), otherwise
+ *         the included file.
+ */
+YASM_LIB_DECL
+/*@null@*/ /*@dependent@*/ yasm_incfile *yasm_bc_get_incbin
+    (yasm_bytecode *bc, /*@out@*/ unsigned long *offset);
+
 /** Create a bytecode that aligns the following bytecode to a boundary.
  * \param boundary      byte alignment (must be a power of two)
  * \param fill          fill data (if NULL, code_fill or 0 is used)
@@ -622,6 +649,21 @@ YASM_LIB_DECL
 /*@null@*/ yasm_dataval *yasm_dvs_append
     (yasm_datavalhead *headp, /*@returned@*/ /*@null@*/ yasm_dataval *dv);
 
+/** Add an integer constant to the end of a list of data values.  Runs of
+ * constants are packed into a single raw data value as they're added,
+ * rather than each being kept as an expression until the data bytecode is
+ * created, so long lists of numbers need little more memory than their
+ * output.  Conversion (and any overflow warning) happens immediately.
+ * \param headp         data value list
+ * \param intn          integer value
+ * \param size          storage size (in bytes) of the value
+ * \param arch          architecture; may be NULL only if size is 1
+ */
+YASM_LIB_DECL
+void yasm_dvs_append_intnum(yasm_datavalhead *headp,
+                            const yasm_intnum *intn, unsigned int size,
+                            /*@null@*/ yasm_arch *arch);
+
 /** Print a data value list.  For debugging purposes.
  * \param f             file
  * \param indent_level  indentation level
@@ -0,0 +1,267 @@
+/*
+ * Source file checksums
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/* Need fileno() (POSIX) for memory-mapped files */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "util.h"
+
+#ifdef YASM_HAVE_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#ifndef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#include <sys/mman.h>
+#define USE_MMAP
+#endif
+
+#include "coretype.h"
+#include "errwarn.h"
+#include "hamt.h"
+#include "md5.h"
+#include "sha256.h"
+#include "checksum.h"
+
+
+#define NUM_CHECKSUM_TYPES  2
+
+#define CHUNK_SIZE      65536   /* streamed read size */
+#define UPDATE_MAX      0x40000000UL    /* max length per update call */
+
+typedef struct checksum_ctx {
+    yasm_checksum_type type;
+    union {
+        yasm_md5_context md5;
+        yasm_sha256_context sha256;
+    } u;
+} checksum_ctx;
+
+/* Cached checksums of one file */
+typedef struct checksum_entry {
+    /*@owned@*/ char *filename;
+#ifdef HAVE_SYS_STAT_H
+    /* file state the checksums were computed for */
+    off_t size;
+    time_t mtime;
+#endif
+    int have[NUM_CHECKSUM_TYPES];
+    unsigned char digest[NUM_CHECKSUM_TYPES][YASM_CHECKSUM_MAX_SIZE];
+} checksum_entry;
+
+static /*@null@*/ /*@only@*/ HAMT *checksum_cache = NULL;
+#ifdef YASM_HAVE_THREADS
+static pthread_mutex_t checksum_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define CACHE_LOCK()    pthread_mutex_lock(&checksum_mutex)
+#define CACHE_UNLOCK()  pthread_mutex_unlock(&checksum_mutex)
+#else
+#define CACHE_LOCK()
+#define CACHE_UNLOCK()
+#endif
+
+static void
+checksum_init(/*@out@*/ checksum_ctx *ctx, yasm_checksum_type type)
+{
+    ctx->type = type;
+    if (type == YASM_CHECKSUM_SHA256)
+        yasm_sha256_init(&ctx->u.sha256);
+    else
+        yasm_md5_init(&ctx->u.md5);
+}
+
+static void
+checksum_update(checksum_ctx *ctx, const unsigned char *buf, size_t len)
+{
+    while (len > 0) {
+        unsigned long n = len > UPDATE_MAX ? UPDATE_MAX : (unsigned long)len;
+        if (ctx->type == YASM_CHECKSUM_SHA256)
+            yasm_sha256_update(&ctx->u.sha256, buf, n);
+        else
+            yasm_md5_update(&ctx->u.md5, buf, n);
+        buf += n;
+        len -= n;
+    }
+}
+
+static void
+checksum_final(checksum_ctx *ctx, unsigned char *digest)
+{
+    if (ctx->type == YASM_CHECKSUM_SHA256)
+        yasm_sha256_final(digest, &ctx->u.sha256);
+    else
+        yasm_md5_final(digest, &ctx->u.md5);
+}
+
+size_t
+yasm_checksum_size(yasm_checksum_type type)
+{
+    return type == YASM_CHECKSUM_SHA256 ? 32 : 16;
+}
+
+void
+yasm_checksum_buf(yasm_checksum_type type, const unsigned char *buf,
+                  size_t len, unsigned char *digest)
+{
+    checksum_ctx ctx;
+
+    checksum_init(&ctx, type);
+    checksum_update(&ctx, buf, len);
+    checksum_final(&ctx, digest);
+}
+
+/* Checksum a file's contents; memory map it if possible, otherwise stream
+ * it.  Returns nonzero on error.
+ */
+static int
+checksum_read(FILE *f, yasm_checksum_type type, unsigned char *digest)
+{
+    checksum_ctx ctx;
+    unsigned char *buf;
+    size_t len;
+#ifdef USE_MMAP
+    struct stat st;
+
+    if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+        && (off_t)(size_t)st.st_size == st.st_size) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                         fileno(f), 0);
+        if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            yasm_checksum_buf(type, map, (size_t)st.st_size, digest);
+            munmap(map, (size_t)st.st_size);
+            return 0;
+        }
+    }
+#endif
+
+    checksum_init(&ctx, type);
+    buf = yasm_xmalloc(CHUNK_SIZE);
+    while ((len = fread(buf, 1, CHUNK_SIZE, f)) > 0)
+        checksum_update(&ctx, buf, len);
+    yasm_xfree(buf);
+    checksum_final(&ctx, digest);
+    return ferror(f);
+}
+
+static void
+checksum_entry_delete(/*@only@*/ void *data)
+{
+    checksum_entry *entry = (checksum_entry *)data;
+    yasm_xfree(entry->filename);
+    yasm_xfree(entry);
+}
+
+int
+yasm_checksum_file(const char *filename, yasm_checksum_type type,
+                   unsigned char *digest)
+{
+    /*@null@*/ checksum_entry *entry;
+    size_t size = yasm_checksum_size(type);
+    FILE *f;
+    int error, replace = 0;
+#ifdef HAVE_SYS_STAT_H
+    struct stat st;
+
+    if (stat(filename, &st) != 0)
+        return 1;
+#endif
+
+    /* Use the cached checksum if the file hasn't changed */
+    CACHE_LOCK();
+    entry = checksum_cache ? HAMT_search(checksum_cache, filename) : NULL;
+    if (entry && entry->have[type]
+#ifdef HAVE_SYS_STAT_H
+        && entry->size == st.st_size && entry->mtime == st.st_mtime
+#endif
+        ) {
+        memcpy(digest, entry->digest[type], size);
+        CACHE_UNLOCK();
+        return 0;
+    }
+    CACHE_UNLOCK();
+
+    /* Not cached; read the file without holding the lock.  Two threads may
+     * both end up reading the same file; they'll get the same result.
+     */
+    f = fopen(filename, "rb");
+    if (!f)
+        return 1;
+    error = checksum_read(f, type, digest);
+    fclose(f);
+    if (error)
+        return 1;
+
+    CACHE_LOCK();
+    if (!checksum_cache)
+        checksum_cache = HAMT_create(0, yasm_internal_error_);
+    entry = HAMT_search(checksum_cache, filename);
+    if (!entry) {
+        entry = yasm_xmalloc(sizeof(checksum_entry));
+        entry->filename = yasm__xstrdup(filename);
+        entry->have[YASM_CHECKSUM_MD5] = 0;
+        entry->have[YASM_CHECKSUM_SHA256] = 0;
+#ifdef HAVE_SYS_STAT_H
+        entry->size = st.st_size;
+        entry->mtime = st.st_mtime;
+#endif
+        HAMT_insert(checksum_cache, entry->filename, entry, &replace,
+                    checksum_entry_delete);
+    }
+#ifdef HAVE_SYS_STAT_H
+    else if (entry->size != st.st_size || entry->mtime != st.st_mtime) {
+        /* File changed; forget checksums of the old contents */
+        entry->have[YASM_CHECKSUM_MD5] = 0;
+        entry->have[YASM_CHECKSUM_SHA256] = 0;
+        entry->size = st.st_size;
+        entry->mtime = st.st_mtime;
+    }
+#endif
+    memcpy(entry->digest[type], digest, size);
+    entry->have[type] = 1;
+    CACHE_UNLOCK();
+    return 0;
+}
+
+void
+yasm_checksum_cleanup(void)
+{
+    CACHE_LOCK();
+    if (checksum_cache) {
+        HAMT_destroy(checksum_cache, checksum_entry_delete);
+        checksum_cache = NULL;
+    }
+    CACHE_UNLOCK();
+}
@@ -0,0 +1,81 @@
+/**
+ * \file libyasm/checksum.h
+ * \brief YASM source file checksum interface.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_CHECKSUM_H
+#define YASM_CHECKSUM_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/** Checksum (message digest) algorithms. */
+typedef enum yasm_checksum_type {
+    YASM_CHECKSUM_MD5 = 0,      /**< MD5 (16 bytes) */
+    YASM_CHECKSUM_SHA256        /**< SHA-256 (32 bytes) */
+} yasm_checksum_type;
+
+/** Maximum size of a checksum, in bytes. */
+#define YASM_CHECKSUM_MAX_SIZE  32
+
+/** Get the size of a checksum.
+ * \param type      checksum type
+ * \return Size of checksum, in bytes.
+ */
+YASM_LIB_DECL
+size_t yasm_checksum_size(yasm_checksum_type type);
+
+/** Compute the checksum of a memory buffer.
+ * \param type      checksum type
+ * \param buf       data
+ * \param len       length of data, in bytes
+ * \param digest    checksum (output); yasm_checksum_size() bytes
+ */
+YASM_LIB_DECL
+void yasm_checksum_buf(yasm_checksum_type type, const unsigned char *buf,
+                       size_t len, /*@out@*/ unsigned char *digest);
+
+/** Compute the checksum of a file's contents.  The file is memory mapped
+ * where possible.  Results are cached for the life of the process (or until
+ * yasm_checksum_cleanup()), so a file referenced by many objects is only
+ * read once; a cached result is only used if the file's size and
+ * modification time are unchanged.  Safe to call from multiple threads.
+ * \param filename  file name
+ * \param type      checksum type
+ * \param digest    checksum (output); yasm_checksum_size() bytes
+ * \return Nonzero if the file could not be read.
+ */
+YASM_LIB_DECL
+int yasm_checksum_file(const char *filename, yasm_checksum_type type,
+                       /*@out@*/ unsigned char *digest);
+
+/** Free the file checksum cache. */
+YASM_LIB_DECL
+void yasm_checksum_cleanup(void);
+
+#endif
@@ -191,6 +191,29 @@ typedef struct yasm_value {
  */
 typedef struct yasm_linemap yasm_linemap;
 
+/** Memory arena (opaque type).  \see arena.h for related functions. */
+typedef struct yasm_arena yasm_arena;
+
+/** Object file output sink (opaque type).  \see outsink.h for related
+ * functions.
+ */
+typedef struct yasm_outsink yasm_outsink;
+
+/** Object file string table (opaque type).  \see strtab.h for related
+ * functions.
+ */
+typedef struct yasm_strtab yasm_strtab;
+
+/** File included verbatim in the output (opaque type).  \see incfile.h for
+ * related functions.
+ */
+typedef struct yasm_incfile yasm_incfile;
+
+/** Cache of files included verbatim in the output (opaque type).
+ * \see incfile.h for related functions.
+ */
+typedef struct yasm_incfile_cache yasm_incfile_cache;
+
 /** Value/parameter pair (opaque type).
  * \see valparam.h for related functions.
  */
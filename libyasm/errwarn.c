@@ -54,12 +54,11 @@ static const char *def_gettext_hook(const char *msgid);
 /*@exits@*/ void (*yasm_fatal) (const char *message, va_list va) = def_fatal;
 const char * (*yasm_gettext_hook) (const char *msgid) = def_gettext_hook;
 
-/* Error indicator */
-/* yasm_eclass is not static so that yasm_error_occurred macro can access it */
-yasm_error_class yasm_eclass;
-static /*@only@*/ /*@null@*/ char *yasm_estr;
-static unsigned long yasm_exrefline;
-static /*@only@*/ /*@null@*/ char *yasm_exrefstr;
+/* Error indicator (per-thread) */
+static YASM_THREAD_LOCAL yasm_error_class yasm_eclass;
+static YASM_THREAD_LOCAL /*@only@*/ /*@null@*/ char *yasm_estr;
+static YASM_THREAD_LOCAL unsigned long yasm_exrefline;
+static YASM_THREAD_LOCAL /*@only@*/ /*@null@*/ char *yasm_exrefstr;
 
 /* Warning indicator */
 typedef struct warn {
@@ -68,11 +67,21 @@ typedef struct warn {
     yasm_warn_class wclass;
     /*@owned@*/ /*@null@*/ char *wstr;
 } warn;
-static STAILQ_HEAD(warn_head, warn) yasm_warns;
+/* Warning indicator (per-thread).  Thread-local storage can't be statically
+ * initialized to point into itself, so each thread initializes its queue
+ * with yasm_errwarn_thread_initialize().
+ */
+static YASM_THREAD_LOCAL STAILQ_HEAD(warn_head, warn) yasm_warns;
 
-/* Enabled warnings.  See errwarn.h for a list. */
+/* Enabled warnings.  See errwarn.h for a list.  This is configuration,
+ * set up before assembly starts; parsers that need to turn a class off
+ * while running suppress it for their own thread instead.
+ */
 static unsigned long warn_class_enabled;
 
+/* Warnings suppressed on this thread. */
+static YASM_THREAD_LOCAL unsigned long warn_class_suppressed;
+
 typedef struct errwarn_data {
     /*@reldef@*/ SLIST_ENTRY(errwarn_data) link;
 
@@ -98,7 +107,7 @@ struct yasm_errwarns {
 };
 
 /* Static buffer for use by conv_unprint(). */
-static char unprint[5];
+static YASM_THREAD_LOCAL char unprint[5];
 
 
 static const char *
@@ -117,11 +126,15 @@ yasm_errwarn_initialize(void)
         (1UL<<YASM_WARN_UNINIT_CONTENTS) | (0UL<<YASM_WARN_SIZE_OVERRIDE) |
         (1UL<<YASM_WARN_IMPLICIT_SIZE_OVERRIDE);
 
-    yasm_eclass = YASM_ERROR_NONE;
-    yasm_estr = NULL;
-    yasm_exrefline = 0;
-    yasm_exrefstr = NULL;
+    yasm_errwarn_thread_initialize();
+}
 
+void
+yasm_errwarn_thread_initialize(void)
+{
+    /* Clearing is safe on a queue that was never initialized (all zero) */
+    yasm_error_clear();
+    yasm_warn_clear();
     STAILQ_INIT(&yasm_warns);
 }
 
@@ -257,6 +270,12 @@ yasm_error_clear(void)
     yasm_exrefstr = NULL;
 }
 
+yasm_error_class
+yasm_error_occurred(void)
+{
+    return yasm_eclass;
+}
+
 int
 yasm_error_matches(yasm_error_class eclass)
 {
@@ -357,7 +376,7 @@ yasm_warn_set_va(yasm_warn_class wclass, const char *format, va_list va)
 {
     warn *w;
 
-    if (!(warn_class_enabled & (1UL<<wclass)))
+    if (!(warn_class_enabled & ~warn_class_suppressed & (1UL<<wclass)))
         return;     /* warning is part of disabled class */
 
     w = yasm_xmalloc(sizeof(warn));
@@ -416,6 +435,30 @@ yasm_warn_disable_all(void)
     warn_class_enabled = 0;
 }
 
+void
+yasm_warn_suppress(yasm_warn_class num)
+{
+    warn_class_suppressed |= (1UL<<num);
+}
+
+void
+yasm_warn_unsuppress(yasm_warn_class num)
+{
+    warn_class_suppressed &= ~(1UL<<num);
+}
+
+unsigned long
+yasm_warn_get_suppressed(void)
+{
+    return warn_class_suppressed;
+}
+
+void
+yasm_warn_set_suppressed(unsigned long wclasses)
+{
+    warn_class_suppressed = wclasses;
+}
+
 yasm_errwarns *
 yasm_errwarns_create(void)
 {
@@ -473,6 +516,28 @@ yasm_errwarn_propagate(yasm_errwarns *errwarns, unsigned long line)
     }
 }
 
+void
+yasm_errwarns_merge(yasm_errwarns *errwarns, yasm_errwarns *from)
+{
+    while (!SLIST_EMPTY(&from->errwarns)) {
+        errwarn_data *src = SLIST_FIRST(&from->errwarns);
+        errwarn_data *we = errwarn_data_new(errwarns, src->line, 0);
+
+        we->type = src->type;
+        we->xrefline = src->xrefline;
+        we->msg = src->msg;
+        we->xrefmsg = src->xrefmsg;
+
+        SLIST_REMOVE_HEAD(&from->errwarns, link);
+        yasm_xfree(src);
+    }
+    errwarns->ecount += from->ecount;
+    errwarns->wcount += from->wcount;
+    from->ecount = 0;
+    from->wcount = 0;
+    from->previous_we = NULL;
+}
+
 unsigned int
 yasm_errwarns_num_errors(yasm_errwarns *errwarns, int warning_as_error)
 {
@@ -518,6 +583,62 @@ yasm_errwarns_output_all(yasm_errwarns *errwarns, yasm_linemap *lm,
     }
 }
 
+/* Append one formatted message line to a growable string. */
+static void
+errwarn_string_append(char **str, size_t *len, size_t *max,
+                      const char *filename, unsigned long line,
+                      const char *type, const char *msg)
+{
+    size_t need = strlen(filename) + strlen(type) + strlen(msg) + 32;
+
+    if (*len + need > *max) {
+        *max = (*len + need) * 2;
+        *str = yasm_xrealloc(*str, *max);
+    }
+    if (line)
+        sprintf(*str + *len, "%s:%lu: %s%s\n", filename, line, type, msg);
+    else
+        sprintf(*str + *len, "%s: %s%s\n", filename, type, msg);
+    *len += strlen(*str + *len);
+}
+
+char *
+yasm_errwarns_output_string(yasm_errwarns *errwarns, yasm_linemap *lm,
+                            int warning_as_error)
+{
+    errwarn_data *we;
+    const char *filename, *xref_filename;
+    const char *error_type = yasm_gettext_hook(N_("error: "));
+    unsigned long line, xref_line;
+    size_t len = 0, max = 256;
+    char *str = yasm_xmalloc(max);
+
+    str[0] = '\0';
+
+    /* If we're treating warnings as errors, tell the user about it. */
+    if (warning_as_error && warning_as_error != 2 &&
+        !SLIST_EMPTY(&errwarns->errwarns))
+        errwarn_string_append(&str, &len, &max, "", 0, error_type,
+            yasm_gettext_hook(N_("warnings being treated as errors")));
+
+    SLIST_FOREACH(we, &errwarns->errwarns, link) {
+        yasm_linemap_lookup(lm, we->line, &filename, &line);
+        if (we->type == WE_ERROR || we->type == WE_PARSERERROR) {
+            errwarn_string_append(&str, &len, &max, filename, line,
+                                  error_type, we->msg);
+            if (we->xrefline && we->xrefmsg) {
+                yasm_linemap_lookup(lm, we->xrefline, &xref_filename,
+                                    &xref_line);
+                errwarn_string_append(&str, &len, &max, xref_filename,
+                                      xref_line, error_type, we->xrefmsg);
+            }
+        } else
+            errwarn_string_append(&str, &len, &max, filename, line,
+                yasm_gettext_hook(N_("warning: ")), we->msg);
+    }
+    return str;
+}
+
 void
 yasm__fatal(const char *message, ...)
 {
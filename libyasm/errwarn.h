@@ -71,6 +71,15 @@ typedef enum yasm_error_class {
 YASM_LIB_DECL
 void yasm_errwarn_initialize(void);
 
+/** Initialize the calling thread's error and warning indicators.  Done for
+ * the initializing thread by yasm_errwarn_initialize(), for worker threads
+ * by yasm_parallel_run(), and by yasm_assemble(); any other thread must
+ * call this before setting a warning.  Any indicators already set on the
+ * thread are cleared.
+ */
+YASM_LIB_DECL
+void yasm_errwarn_thread_initialize(void);
+
 /** Clean up any memory allocated by yasm_errwarn_initialize() or other
  * functions.
  */
@@ -125,6 +134,7 @@ void yasm_error_clear(void);
  * be treated as a boolean value.
  * \return Current error indicator.
  */
+YASM_LIB_DECL
 yasm_error_class yasm_error_occurred(void);
 
 /** Check the error indicator against an error class.  To check if any error
@@ -137,12 +147,6 @@ yasm_error_class yasm_error_occurred(void);
 YASM_LIB_DECL
 int yasm_error_matches(yasm_error_class eclass);
 
-#ifndef YASM_DOXYGEN
-YASM_LIB_DECL
-extern yasm_error_class yasm_eclass;
-#define yasm_error_occurred()       yasm_eclass
-#endif
-
 /** Set the error indicator (va_list version).  Has no effect if the error
  * indicator is already set.
  * \param eclass    error class
@@ -263,6 +267,32 @@ void yasm_warn_disable(yasm_warn_class wclass);
 YASM_LIB_DECL
 void yasm_warn_disable_all(void);
 
+/** Suppress a class of warnings on the calling thread only.  Unlike
+ * yasm_warn_disable(), this is safe to use while other threads assemble.
+ * \param wclass    warning class
+ */
+YASM_LIB_DECL
+void yasm_warn_suppress(yasm_warn_class wclass);
+
+/** Undo yasm_warn_suppress() for a class of warnings.
+ * \param wclass    warning class
+ */
+YASM_LIB_DECL
+void yasm_warn_unsuppress(yasm_warn_class wclass);
+
+/** Get the classes of warnings suppressed on the calling thread.
+ * \return Bitmask of (1<<#yasm_warn_class) values.
+ */
+YASM_LIB_DECL
+unsigned long yasm_warn_get_suppressed(void);
+
+/** Set the classes of warnings suppressed on the calling thread, e.g. to
+ * carry them over to a worker thread or to clear them between units.
+ * \param wclasses  bitmask of (1<<#yasm_warn_class) values
+ */
+YASM_LIB_DECL
+void yasm_warn_set_suppressed(unsigned long wclasses);
+
 /** Create an error/warning set for collection of multiple error/warnings.
  * \return Newly allocated set.
  */
@@ -288,6 +318,15 @@ void yasm_errwarns_destroy(/*@only@*/ yasm_errwarns *errwarns);
 YASM_LIB_DECL
 void yasm_errwarn_propagate(yasm_errwarns *errwarns, unsigned long line);
 
+/** Move all errors and warnings from one error/warning set into another.
+ * Entries are inserted by line in the same way as yasm_errwarn_propagate(),
+ * so merging several sets in a fixed order gives a deterministic result.
+ * \param errwarns  error/warning set to merge into
+ * \param from      error/warning set to merge from (left empty)
+ */
+YASM_LIB_DECL
+void yasm_errwarns_merge(yasm_errwarns *errwarns, yasm_errwarns *from);
+
 /** Get total number of errors logged.
  * \param errwarns          error/warning set
  * \param warning_as_error  if nonzero, warnings are treated as errors.
@@ -330,6 +369,18 @@ void yasm_errwarns_output_all
     (yasm_errwarns *errwarns, yasm_linemap *lm, int warning_as_error,
      yasm_print_error_func print_error, yasm_print_warning_func print_warning);
 
+/** Outputs error/warning set in sorted order (sorted by virtual line number)
+ * into a string, one message per line, formatted as
+ * "file:line: error: message" (or "warning: ").
+ * \param errwarns          error/warning set
+ * \param lm    line map (to convert virtual lines into filename/line pairs)
+ * \param warning_as_error  if nonzero, treat warnings as errors.
+ * \return Newly allocated string; empty if there are no errors or warnings.
+ */
+YASM_LIB_DECL
+/*@only@*/ char *yasm_errwarns_output_string
+    (yasm_errwarns *errwarns, yasm_linemap *lm, int warning_as_error);
+
 /** Convert a possibly unprintable character into a printable string.
  * \internal
  * \param ch    possibly unprintable character
@@ -28,6 +28,7 @@
 
 #include "libyasm-stdint.h"
 #include "coretype.h"
+#include "arena.h"
 #include "bitvect.h"
 
 #include "errwarn.h"
@@ -50,12 +51,93 @@ static int expr_traverse_nodes_post(/*@null@*/ yasm_expr *e,
                                     int (*func) (/*@null@*/ yasm_expr *e,
                                                  /*@null@*/ void *d));
 static void expr_delete_term(yasm_expr__item *term, int recurse);
+static /*@only@*/ yasm_expr *expr_level_tree
+    (/*@returned@*/ /*@only@*/ yasm_expr *e, int fold_const,
+     int simplify_ident, int simplify_reg_mul, int calc_bc_dist,
+     yasm_expr_xform_func expr_xform_extra, void *expr_xform_extra_data);
 
 /* Bitmap of used items.  We should really never need more than 2 at a time,
  * so 31 is pretty much overkill.
  */
-static unsigned long itempool_used = 0;
-static yasm_expr__item itempool[31];
+static YASM_THREAD_LOCAL unsigned long itempool_used = 0;
+static YASM_THREAD_LOCAL yasm_expr__item itempool[31];
+
+/* Explicit stack for non-recursive tree walks, so that very deep trees
+ * (eg, from macro expansion) don't exhaust the C stack.  Most trees fit in
+ * the initial, non-allocated part.
+ */
+#define EXPR_WALK_INIT  32
+typedef struct expr_walk_frame {
+    yasm_expr **ep;         /* where the node is stored */
+    int term;               /* next term of the node to visit */
+
+    /* equ the node is the expansion of (expr_expand_equ() only) */
+    /*@null@*/ /*@dependent@*/ yasm_symrec *equ_sym;
+    int had_error;          /* error already set at start of expansion */
+} expr_walk_frame;
+
+typedef struct expr_walk {
+    expr_walk_frame *frames;
+    size_t depth, max;
+    expr_walk_frame init[EXPR_WALK_INIT];
+} expr_walk;
+
+static void
+expr_walk_init(expr_walk *w)
+{
+    w->frames = w->init;
+    w->depth = 0;
+    w->max = EXPR_WALK_INIT;
+}
+
+static void
+expr_walk_push(expr_walk *w, yasm_expr **ep)
+{
+    if (w->depth == w->max) {
+        w->max *= 2;
+        if (w->frames == w->init) {
+            w->frames = yasm_xmalloc(w->max*sizeof(expr_walk_frame));
+            memcpy(w->frames, w->init, sizeof(w->init));
+        } else
+            w->frames = yasm_xrealloc(w->frames,
+                                      w->max*sizeof(expr_walk_frame));
+    }
+    w->frames[w->depth].ep = ep;
+    w->frames[w->depth].term = 0;
+    w->frames[w->depth].equ_sym = NULL;
+    w->depth++;
+}
+
+/* Get the next subexpression term of the top node, or NULL if there are no
+ * more.
+ */
+static /*@null@*/ yasm_expr **
+expr_walk_next(expr_walk *w)
+{
+    expr_walk_frame *f = &w->frames[w->depth-1];
+    yasm_expr *e = *f->ep;
+
+    while (f->term < e->numterms) {
+        yasm_expr__item *term = &e->terms[f->term++];
+        if (term->type == YASM_EXPR_EXPR)
+            return &term->data.expn;
+    }
+    return NULL;
+}
+
+static void
+expr_walk_delete(expr_walk *w)
+{
+    if (w->frames != w->init)
+        yasm_xfree(w->frames);
+}
+
+/* Ops whose operands can be freely combined into one multi-term level. */
+#define expr_op_levels(op) \
+    ((op) == YASM_EXPR_ADD || (op) == YASM_EXPR_MUL || \
+     (op) == YASM_EXPR_OR || (op) == YASM_EXPR_AND || \
+     (op) == YASM_EXPR_LOR || (op) == YASM_EXPR_LAND || \
+     (op) == YASM_EXPR_LXOR || (op) == YASM_EXPR_XOR)
 
 /* allocate a new expression node, with children as defined.
  * If it's a unary operator, put the element in left and set right=NULL. */
@@ -66,7 +148,7 @@ yasm_expr_create(yasm_expr_op op, yasm_expr__item *left,
 {
     yasm_expr *ptr, *sube;
     unsigned long z;
-    ptr = yasm_xmalloc(sizeof(yasm_expr));
+    ptr = yasm_arena_alloc(sizeof(yasm_expr));
 
     ptr->op = op;
     ptr->numterms = 0;
@@ -88,7 +170,7 @@ yasm_expr_create(yasm_expr_op op, yasm_expr__item *left,
             sube = ptr->terms[0].data.expn;
             ptr->terms[0] = sube->terms[0];     /* structure copy */
             /*@-usereleased@*/
-            yasm_xfree(sube);
+            yasm_arena_free(sube);
             /*@=usereleased@*/
         }
     } else {
@@ -111,13 +193,33 @@ yasm_expr_create(yasm_expr_op op, yasm_expr__item *left,
             sube = ptr->terms[1].data.expn;
             ptr->terms[1] = sube->terms[0];     /* structure copy */
             /*@-usereleased@*/
-            yasm_xfree(sube);
+            yasm_arena_free(sube);
             /*@=usereleased@*/
         }
     }
 
     ptr->line = line;
 
+    /* Appending a term that can't be folded or leveled to an already
+     * leveled chain of the same op (eg, building a+b+c+...) can't change
+     * the rest of the chain; just add it to the end, rather than copying
+     * the whole chain into a new node.
+     */
+    if (ptr->numterms == 2 && expr_op_levels(op) &&
+        ptr->terms[0].type == YASM_EXPR_EXPR &&
+        ptr->terms[0].data.expn->op == op &&
+        ptr->terms[1].type != YASM_EXPR_INT &&
+        (ptr->terms[1].type != YASM_EXPR_EXPR ||
+         ptr->terms[1].data.expn->op != op)) {
+        sube = ptr->terms[0].data.expn;
+        sube = yasm_arena_realloc(sube, sizeof(yasm_expr) +
+                                  sizeof(yasm_expr__item)*(sube->numterms-1));
+        sube->terms[sube->numterms++] = ptr->terms[1];  /* structure copy */
+        sube->line = line;
+        yasm_arena_free(ptr);
+        return sube;
+    }
+
     return expr_level_op(ptr, 1, 1, 0);
 }
 /*@=compmempass@*/
@@ -283,7 +385,7 @@ expr_xform_bc_dist_base(/*@returned@*/ /*@only@*/ yasm_expr *e,
     }
     if (e->numterms != numterms) {
         e->numterms = numterms;
-        e = yasm_xrealloc(e, sizeof(yasm_expr)+((numterms<2) ? 0 :
+        e = yasm_arena_realloc(e, sizeof(yasm_expr)+((numterms<2) ? 0 :
                           sizeof(yasm_expr__item)*(numterms-2)));
         if (numterms == 1)
             e->op = YASM_EXPR_IDENT;
@@ -362,7 +464,7 @@ yasm_expr__bc_dist_subst(yasm_expr **ep, void *cbd,
 static void
 expr_xform_neg_item(yasm_expr *e, yasm_expr__item *ei)
 {
-    yasm_expr *sube = yasm_xmalloc(sizeof(yasm_expr));
+    yasm_expr *sube = yasm_arena_alloc(sizeof(yasm_expr));
 
     /* Build -1*ei subexpression */
     sube->op = YASM_EXPR_MUL;
@@ -435,7 +537,7 @@ expr_xform_neg_helper(/*@returned@*/ /*@only@*/ yasm_expr *e)
             /* Everything else.  MUL will be combined when it's leveled.
              * Make a new expr (to replace e) with -1*e.
              */
-            ne = yasm_xmalloc(sizeof(yasm_expr));
+            ne = yasm_arena_alloc(sizeof(yasm_expr));
             ne->op = YASM_EXPR_MUL;
             ne->line = e->line;
             ne->numterms = 2;
@@ -627,7 +729,7 @@ expr_level_op(/*@returned@*/ /*@only@*/ yasm_expr *e, int fold_const,
      */
     while (e->op == YASM_EXPR_IDENT && e->terms[0].type == YASM_EXPR_EXPR) {
         yasm_expr *sube = e->terms[0].data.expn;
-        yasm_xfree(e);
+        yasm_arena_free(e);
         e = sube;
     }
 
@@ -645,7 +747,7 @@ expr_level_op(/*@returned@*/ /*@only@*/ yasm_expr *e, int fold_const,
                e->terms[i].data.expn->op == YASM_EXPR_IDENT) {
             yasm_expr *sube = e->terms[i].data.expn;
             e->terms[i] = sube->terms[0];
-            yasm_xfree(sube);
+            yasm_arena_free(sube);
         }
 
         if (e->terms[i].type == YASM_EXPR_EXPR &&
@@ -710,14 +812,10 @@ expr_level_op(/*@returned@*/ /*@only@*/ yasm_expr *e, int fold_const,
     /* Only level operators that allow more than two operand terms.
      * Also don't bother leveling if it's not necessary to bring up any terms.
      */
-    if ((e->op != YASM_EXPR_ADD && e->op != YASM_EXPR_MUL &&
-         e->op != YASM_EXPR_OR && e->op != YASM_EXPR_AND &&
-         e->op != YASM_EXPR_LOR && e->op != YASM_EXPR_LAND &&
-         e->op != YASM_EXPR_LXOR && e->op != YASM_EXPR_XOR) ||
-        level_numterms <= fold_numterms) {
+    if (!expr_op_levels(e->op) || level_numterms <= fold_numterms) {
         /* Downsize e if necessary */
         if (fold_numterms < e->numterms && e->numterms > 2)
-            e = yasm_xrealloc(e, sizeof(yasm_expr)+((fold_numterms<2) ? 0 :
+            e = yasm_arena_realloc(e, sizeof(yasm_expr)+((fold_numterms<2) ? 0 :
                               sizeof(yasm_expr__item)*(fold_numterms-2)));
         /* Update numterms */
         e->numterms = fold_numterms;
@@ -734,7 +832,7 @@ expr_level_op(/*@returned@*/ /*@only@*/ yasm_expr *e, int fold_const,
     }
 
     /* Alloc more (or conceivably less, but not usually) space for e */
-    e = yasm_xrealloc(e, sizeof(yasm_expr)+((level_numterms<2) ? 0 :
+    e = yasm_arena_realloc(e, sizeof(yasm_expr)+((level_numterms<2) ? 0 :
                       sizeof(yasm_expr__item)*(level_numterms-2)));
 
     /* Copy up ExprItem's.  Iterate from right to left to keep the same
@@ -772,7 +870,7 @@ expr_level_op(/*@returned@*/ /*@only@*/ yasm_expr *e, int fold_const,
             /* delete subexpression, but *don't delete nodes* (as we've just
              * copied them!)
              */
-            yasm_xfree(sube);
+            yasm_arena_free(sube);
         } else if (o != i) {
             /* copy operand if it changed places */
             if (o == first_int_term)
@@ -800,92 +898,167 @@ expr_level_op(/*@returned@*/ /*@only@*/ yasm_expr *e, int fold_const,
 }
 /*@=mustfree@*/
 
-typedef SLIST_HEAD(yasm__exprhead, yasm__exprentry) yasm__exprhead;
-typedef struct yasm__exprentry {
-    /*@reldef@*/ SLIST_ENTRY(yasm__exprentry) next;
-    /*@null@*/ const yasm_expr *e;
-} yasm__exprentry;
+/* Returns 1 if a term could still change meaning later (a symbol not yet
+ * defined could yet become an equ).
+ */
+static int
+expr_equ_unsettled_callback(yasm_expr__item *ei, /*@unused@*/ void *d)
+{
+    return (ei->type == YASM_EXPR_SYM &&
+            !(yasm_symrec_get_status(ei->data.sym) & YASM_SYM_DEFINED));
+}
 
+/* Expand equ's, using an explicit stack (as expr_level_tree() does).  The
+ * equ's being expanded are on the stack, so it doubles as the chain used
+ * to detect circular references.
+ */
 static yasm_expr *
-expr_expand_equ(yasm_expr *e, yasm__exprhead *eh)
+expr_expand_equ(yasm_expr *e)
 {
-    int i;
-    yasm__exprentry ee;
+    expr_walk w;
+    expr_walk_frame *f;
 
-    /* traverse terms */
-    for (i=0; i<e->numterms; i++) {
+    expr_walk_init(&w);
+    expr_walk_push(&w, &e);
+
+    while (w.depth > 0) {
+        yasm_expr *n;
+        yasm_expr__item *term;
+        yasm_symrec *sym;
         const yasm_expr *equ_expr;
+        int had_error;
+        size_t i;
+
+        f = &w.frames[w.depth-1];
+        n = *f->ep;
+        if (f->term >= n->numterms) {
+            /* Done with this node.  If it's an equ expansion, level and
+             * cache it for later references, unless it failed or may still
+             * change.
+             */
+            w.depth--;
+            if (!f->equ_sym || f->had_error || yasm_error_occurred())
+                continue;
+            n = expr_level_tree(n, 1, 1, 0, 0, NULL, NULL);
+            *f->ep = n;
+            if (!yasm_error_occurred() &&
+                !yasm_expr__traverse_leaves_in(n, NULL,
+                                               expr_equ_unsettled_callback))
+                yasm_symrec__set_equ_cache(f->equ_sym, yasm_expr_copy(n));
+            continue;
+        }
 
-        /* Expand equ's. */
-        if (e->terms[i].type == YASM_EXPR_SYM &&
-            (equ_expr = yasm_symrec_get_equ(e->terms[i].data.sym))) {
-            yasm__exprentry *np;
-
-            /* Check for circular reference */
-            SLIST_FOREACH(np, eh, next) {
-                if (np->e == equ_expr) {
-                    yasm_error_set(YASM_ERROR_TOO_COMPLEX,
-                                   N_("circular reference detected"));
-                    return e;
-                }
+        /* traverse terms */
+        term = &n->terms[f->term++];
+        if (term->type == YASM_EXPR_EXPR) {
+            expr_walk_push(&w, &term->data.expn);
+            continue;
+        }
+        if (term->type != YASM_EXPR_SYM ||
+            !(equ_expr = yasm_symrec_get_equ(term->data.sym)))
+            continue;
+
+        /* Expand equ's.  Use the already expanded value if there is one;
+         * constants become a simple integer term.
+         */
+        sym = term->data.sym;
+        equ_expr = yasm_symrec__get_equ_cache(sym);
+        if (equ_expr) {
+            if (equ_expr->op == YASM_EXPR_IDENT &&
+                equ_expr->terms[0].type == YASM_EXPR_INT) {
+                term->type = YASM_EXPR_INT;
+                term->data.intn =
+                    yasm_intnum_copy(equ_expr->terms[0].data.intn);
+            } else {
+                term->type = YASM_EXPR_EXPR;
+                term->data.expn = yasm_expr_copy(equ_expr);
             }
+            continue;
+        }
+
+        /* Check for circular reference */
+        for (i=0; i<w.depth; i++) {
+            if (w.frames[i].equ_sym == sym)
+                break;
+        }
+        if (i < w.depth) {
+            yasm_error_set(YASM_ERROR_TOO_COMPLEX,
+                           N_("circular reference detected"));
+            f->term = n->numterms;      /* skip rest of this node */
+            continue;
+        }
+
+        term->type = YASM_EXPR_EXPR;
+        term->data.expn = yasm_expr_copy(yasm_symrec_get_equ(sym));
 
-            e->terms[i].type = YASM_EXPR_EXPR;
-            e->terms[i].data.expn = yasm_expr_copy(equ_expr);
-
-            /* Remember we saw this equ and recurse */
-            ee.e = equ_expr;
-            SLIST_INSERT_HEAD(eh, &ee, next);
-            e->terms[i].data.expn = expr_expand_equ(e->terms[i].data.expn, eh);
-            SLIST_REMOVE_HEAD(eh, next);
-        } else if (e->terms[i].type == YASM_EXPR_EXPR)
-            /* Recurse */
-            e->terms[i].data.expn = expr_expand_equ(e->terms[i].data.expn, eh);
+        /* Remember we saw this equ and descend */
+        had_error = yasm_error_occurred() != 0;
+        expr_walk_push(&w, &term->data.expn);
+        f = &w.frames[w.depth-1];
+        f->equ_sym = sym;
+        f->had_error = had_error;
     }
 
+    expr_walk_delete(&w);
     return e;
 }
 
+/* Levels the tree post-order (each node after its subexpressions), using an
+ * explicit stack rather than recursion.
+ */
 static yasm_expr *
 expr_level_tree(yasm_expr *e, int fold_const, int simplify_ident,
                 int simplify_reg_mul, int calc_bc_dist,
                 yasm_expr_xform_func expr_xform_extra,
                 void *expr_xform_extra_data)
 {
-    int i;
+    expr_walk w;
+    yasm_expr **ep;
 
+    expr_walk_init(&w);
     e = expr_xform_neg(e);
+    expr_walk_push(&w, &e);
 
-    /* traverse terms */
-    for (i=0; i<e->numterms; i++) {
-        /* Recurse */
-        if (e->terms[i].type == YASM_EXPR_EXPR)
-            e->terms[i].data.expn =
-                expr_level_tree(e->terms[i].data.expn, fold_const,
-                                simplify_ident, simplify_reg_mul, calc_bc_dist,
-                                expr_xform_extra, expr_xform_extra_data);
-    }
+    while (w.depth > 0) {
+        yasm_expr *n;
 
-    /* Check for SEG of SEG:OFF, if we match, simplify to just the segment */
-    if (e->op == YASM_EXPR_SEG && e->terms[0].type == YASM_EXPR_EXPR &&
-        e->terms[0].data.expn->op == YASM_EXPR_SEGOFF) {
-        e->op = YASM_EXPR_IDENT;
-        e->terms[0].data.expn->op = YASM_EXPR_IDENT;
-        /* Destroy the second (offset) term */
-        e->terms[0].data.expn->numterms = 1;
-        expr_delete_term(&e->terms[0].data.expn->terms[1], 1);
-    }
+        /* traverse terms */
+        ep = expr_walk_next(&w);
+        if (ep) {
+            *ep = expr_xform_neg(*ep);
+            expr_walk_push(&w, ep);
+            continue;
+        }
+
+        ep = w.frames[--w.depth].ep;
+        n = *ep;
+
+        /* Check for SEG of SEG:OFF, if we match, simplify to just the
+         * segment
+         */
+        if (n->op == YASM_EXPR_SEG && n->terms[0].type == YASM_EXPR_EXPR &&
+            n->terms[0].data.expn->op == YASM_EXPR_SEGOFF) {
+            n->op = YASM_EXPR_IDENT;
+            n->terms[0].data.expn->op = YASM_EXPR_IDENT;
+            /* Destroy the second (offset) term */
+            n->terms[0].data.expn->numterms = 1;
+            expr_delete_term(&n->terms[0].data.expn->terms[1], 1);
+        }
 
-    /* do callback */
-    e = expr_level_op(e, fold_const, simplify_ident, simplify_reg_mul);
-    if (calc_bc_dist || expr_xform_extra) {
-        if (calc_bc_dist)
-            e = expr_xform_bc_dist(e);
-        if (expr_xform_extra)
-            e = expr_xform_extra(e, expr_xform_extra_data);
-        e = expr_level_tree(e, fold_const, simplify_ident, simplify_reg_mul,
-                            0, NULL, NULL);
+        /* do callback */
+        n = expr_level_op(n, fold_const, simplify_ident, simplify_reg_mul);
+        if (calc_bc_dist || expr_xform_extra) {
+            if (calc_bc_dist)
+                n = expr_xform_bc_dist(n);
+            if (expr_xform_extra)
+                n = expr_xform_extra(n, expr_xform_extra_data);
+            n = expr_level_tree(n, fold_const, simplify_ident,
+                                simplify_reg_mul, 0, NULL, NULL);
+        }
+        *ep = n;
     }
+
+    expr_walk_delete(&w);
     return e;
 }
 
@@ -896,13 +1069,10 @@ yasm_expr__level_tree(yasm_expr *e, int fold_const, int simplify_ident,
                       yasm_expr_xform_func expr_xform_extra,
                       void *expr_xform_extra_data)
 {
-    yasm__exprhead eh;
-    SLIST_INIT(&eh);
-
     if (!e)
         return 0;
 
-    e = expr_expand_equ(e, &eh);
+    e = expr_expand_equ(e);
     e = expr_level_tree(e, fold_const, simplify_ident, simplify_reg_mul,
                         calc_bc_dist, expr_xform_extra, expr_xform_extra_data);
 
@@ -943,12 +1113,23 @@ yasm_expr__order_terms(yasm_expr *e)
         case YASM_EXPR_LOR:
         case YASM_EXPR_LAND:
         case YASM_EXPR_LXOR:
-            /* Use mergesort to sort.  It's fast on already sorted values and a
-             * stable sort (multiple terms of same type are kept in the same
-             * order).
+            /* Use a stable sort (multiple terms of same type are kept in the
+             * same order).  Most expressions only have a few terms, so do
+             * those with an insertion sort; mergesort needs a temporary
+             * allocation, but is fast on already sorted values.
              */
-            yasm__mergesort(e->terms, (size_t)e->numterms,
-                            sizeof(yasm_expr__item), expr_order_terms_compare);
+            if (e->numterms <= 16) {
+                int i, j;
+                for (i=1; i<e->numterms; i++) {
+                    yasm_expr__item term = e->terms[i];
+                    for (j=i; j>0 && e->terms[j-1].type > term.type; j--)
+                        e->terms[j] = e->terms[j-1];
+                    e->terms[j] = term;
+                }
+            } else
+                yasm__mergesort(e->terms, (size_t)e->numterms,
+                                sizeof(yasm_expr__item),
+                                expr_order_terms_compare);
             break;
         default:
             break;
@@ -995,7 +1176,7 @@ yasm_expr__copy_except(const yasm_expr *e, int except)
     yasm_expr *n;
     int i;
     
-    n = yasm_xmalloc(sizeof(yasm_expr) +
+    n = yasm_arena_alloc(sizeof(yasm_expr) +
                      sizeof(yasm_expr__item)*(e->numterms<2?0:e->numterms-2));
 
     n->op = e->op;
@@ -1034,7 +1215,7 @@ expr_destroy_each(/*@only@*/ yasm_expr *e, /*@unused@*/ void *d)
     int i;
     for (i=0; i<e->numterms; i++)
         expr_delete_term(&e->terms[i], 0);
-    yasm_xfree(e);      /* free ourselves */
+    yasm_arena_free(e);      /* free ourselves */
     return 0;   /* don't stop recursion */
 }
 
@@ -1103,20 +1284,31 @@ expr_traverse_nodes_post(yasm_expr *e, void *d,
                          int (*func) (/*@null@*/ yasm_expr *e,
                                       /*@null@*/ void *d))
 {
-    int i;
+    expr_walk w;
+    yasm_expr **ep;
+    int retval = 0;
 
     if (!e)
         return 0;
 
-    /* traverse terms */
-    for (i=0; i<e->numterms; i++) {
-        if (e->terms[i].type == YASM_EXPR_EXPR &&
-            expr_traverse_nodes_post(e->terms[i].data.expn, d, func))
-            return 1;
-    }
+    expr_walk_init(&w);
+    expr_walk_push(&w, &e);
+    while (w.depth > 0) {
+        /* traverse terms */
+        ep = expr_walk_next(&w);
+        if (ep) {
+            expr_walk_push(&w, ep);
+            continue;
+        }
 
-    /* do callback */
-    return func(e, d);
+        /* do callback */
+        if (func(*w.frames[--w.depth].ep, d)) {
+            retval = 1;
+            break;
+        }
+    }
+    expr_walk_delete(&w);
+    return retval;
 }
 
 /* Traverse over expression tree in order, calling func for each leaf
@@ -1212,7 +1404,7 @@ yasm_expr_extract_segoff(yasm_expr **ep)
         retval = e->terms[0].data.expn;
     else {
         /* Need to build IDENT expression to hold non-expression contents */
-        retval = yasm_xmalloc(sizeof(yasm_expr));
+        retval = yasm_arena_alloc(sizeof(yasm_expr));
         retval->op = YASM_EXPR_IDENT;
         retval->numterms = 1;
         retval->terms[0] = e->terms[0]; /* structure copy */
@@ -1241,7 +1433,7 @@ yasm_expr_extract_wrt(yasm_expr **ep)
         retval = e->terms[1].data.expn;
     else {
         /* Need to build IDENT expression to hold non-expression contents */
-        retval = yasm_xmalloc(sizeof(yasm_expr));
+        retval = yasm_arena_alloc(sizeof(yasm_expr));
         retval->op = YASM_EXPR_IDENT;
         retval->numterms = 1;
         retval->terms[0] = e->terms[1]; /* structure copy */
@@ -24,6 +24,11 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+/* Need fileno() (POSIX) for memory-mapped source buffers */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <util.h>
 
 /* Need either unistd.h or direct.h to prototype getcwd() and mkdir() */
@@ -43,6 +48,14 @@
 #include <sys/stat.h>
 #endif
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#ifndef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#include <sys/mman.h>
+#define USE_MMAP
+#endif
+
 #include <ctype.h>
 #include <errno.h>
 
@@ -50,6 +63,21 @@
 #include "file.h"
 
 #define BSIZE   8192        /* Fill block size */
+#define SRCBUF_BSIZE    65536   /* Source buffer streamed read size */
+
+struct yasm_srcbuf {
+    /*@null@*/ FILE *f;     /* file to stream from; NULL if mapped/memory */
+    /*@null@*/ void *map;   /* memory mapping, if mapped */
+    size_t maplen;          /* length of mapping */
+
+    /*@null@*/ char *buf;   /* stream buffer */
+    size_t bufsize;         /* allocated size of buf */
+
+    const char *cur;        /* start of next line */
+    const char *lim;        /* end of valid data */
+    int eof;                /* no more data to read */
+    int error;              /* read error occurred */
+};
 
 
 void
@@ -115,6 +143,157 @@ yasm_fill_helper(yasm_scanner *s, unsigned char **cursor,
     return first;
 }
 
+yasm_srcbuf *
+yasm_srcbuf_create(FILE *f)
+{
+    yasm_srcbuf *srcbuf = yasm_xmalloc(sizeof(yasm_srcbuf));
+#ifdef USE_MMAP
+    struct stat st;
+    long pos;
+#endif
+
+    srcbuf->f = f;
+    srcbuf->map = NULL;
+    srcbuf->maplen = 0;
+    srcbuf->buf = NULL;
+    srcbuf->bufsize = 0;
+    srcbuf->cur = NULL;
+    srcbuf->lim = NULL;
+    srcbuf->eof = 0;
+    srcbuf->error = 0;
+
+#ifdef USE_MMAP
+    /* Map regular files; anything else (or any failure) gets streamed. */
+    pos = ftell(f);
+    if (pos >= 0 && fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode)
+        && st.st_size > (off_t)pos
+        && (off_t)(size_t)st.st_size == st.st_size) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                         fileno(f), 0);
+        if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            srcbuf->f = NULL;
+            srcbuf->map = map;
+            srcbuf->maplen = (size_t)st.st_size;
+            srcbuf->cur = (const char *)map + pos;
+            srcbuf->lim = (const char *)map + srcbuf->maplen;
+            srcbuf->eof = 1;
+        }
+    }
+#endif
+
+    return srcbuf;
+}
+
+yasm_srcbuf *
+yasm_srcbuf_create_mem(const char *buf, size_t len)
+{
+    yasm_srcbuf *srcbuf = yasm_xmalloc(sizeof(yasm_srcbuf));
+
+    srcbuf->f = NULL;
+    srcbuf->map = NULL;
+    srcbuf->maplen = 0;
+    srcbuf->buf = NULL;
+    srcbuf->bufsize = 0;
+    srcbuf->cur = buf;
+    srcbuf->lim = buf + len;
+    srcbuf->eof = 1;
+    srcbuf->error = 0;
+    return srcbuf;
+}
+
+void
+yasm_srcbuf_destroy(yasm_srcbuf *srcbuf)
+{
+#ifdef USE_MMAP
+    if (srcbuf->map)
+        munmap(srcbuf->map, srcbuf->maplen);
+#endif
+    if (srcbuf->buf)
+        yasm_xfree(srcbuf->buf);
+    yasm_xfree(srcbuf);
+}
+
+/* Read another block of a streamed file, keeping the unconsumed data (moved
+ * to the start of the buffer, which is grown if there's not enough room left
+ * to read a full block).
+ */
+static void
+srcbuf_fill(yasm_srcbuf *srcbuf)
+{
+    size_t avail = (size_t)(srcbuf->lim - srcbuf->cur);
+
+    if (avail > 0 && srcbuf->cur != srcbuf->buf)
+        memmove(srcbuf->buf, srcbuf->cur, avail);
+    if (srcbuf->bufsize - avail < SRCBUF_BSIZE) {
+        srcbuf->bufsize = srcbuf->bufsize*2 + SRCBUF_BSIZE;
+        srcbuf->buf = yasm_xrealloc(srcbuf->buf, srcbuf->bufsize);
+    }
+    srcbuf->cur = srcbuf->buf;
+    srcbuf->lim = srcbuf->buf + avail;
+
+    avail = fread(srcbuf->buf + avail, 1, srcbuf->bufsize - avail,
+                  srcbuf->f);
+    srcbuf->lim += avail;
+    if (avail == 0) {
+        srcbuf->eof = 1;
+        srcbuf->error = ferror(srcbuf->f) != 0;
+    }
+}
+
+const char *
+yasm_srcbuf_get_line(yasm_srcbuf *srcbuf, size_t *len)
+{
+    const char *line, *nl;
+    size_t scanned = 0;
+
+    for (;;) {
+        size_t avail = (size_t)(srcbuf->lim - srcbuf->cur);
+
+        nl = NULL;
+        if (avail > scanned)
+            nl = memchr(srcbuf->cur + scanned, '\n', avail - scanned);
+        if (nl) {
+            line = srcbuf->cur;
+            *len = (size_t)(nl - line) + 1;
+            srcbuf->cur = nl + 1;
+            return line;
+        }
+        if (srcbuf->eof) {
+            /* Last line with no terminating newline */
+            if (avail == 0)
+                return NULL;
+            line = srcbuf->cur;
+            *len = avail;
+            srcbuf->cur = srcbuf->lim;
+            return line;
+        }
+        scanned = avail;
+        srcbuf_fill(srcbuf);
+    }
+}
+
+const char *
+yasm_srcbuf_get_rest(yasm_srcbuf *srcbuf, size_t *len)
+{
+    const char *rest;
+
+    while (!srcbuf->eof)
+        srcbuf_fill(srcbuf);
+    rest = srcbuf->cur;
+    *len = (size_t)(srcbuf->lim - rest);
+    srcbuf->cur = srcbuf->lim;
+    return rest;
+}
+
+int
+yasm_srcbuf_error(const yasm_srcbuf *srcbuf)
+{
+    return srcbuf->error;
+}
+
 void
 yasm_unescape_cstring(unsigned char *str, size_t *len)
 {
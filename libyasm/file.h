@@ -72,6 +72,70 @@ int yasm_fill_helper
      size_t (*input_func) (void *d, unsigned char *buf, size_t max),
      void *input_func_data);
 
+/** Source buffer.  Provides whole-file, line-at-a-time access to an input
+ * file.  Regular files are memory mapped where supported, so lines are
+ * sliced directly out of the mapping; other inputs (stdin, pipes) are read
+ * into a growing buffer in large blocks.
+ */
+typedef struct yasm_srcbuf yasm_srcbuf;
+
+/** Create a source buffer reading from an open file.  Reading starts at the
+ * current file position.  The file is not closed by yasm_srcbuf_destroy(),
+ * and should not be otherwise read from while the source buffer exists.
+ * \param f     input file
+ * \return Newly allocated source buffer.
+ */
+YASM_LIB_DECL
+/*@only@*/ yasm_srcbuf *yasm_srcbuf_create(FILE *f);
+
+/** Create a source buffer reading from memory.  The buffer is not copied,
+ * so it must remain valid (and unchanged) until the source buffer is
+ * destroyed.
+ * \param buf   source text
+ * \param len   length of source text in bytes
+ * \return Newly allocated source buffer.
+ */
+YASM_LIB_DECL
+/*@only@*/ yasm_srcbuf *yasm_srcbuf_create_mem(const char *buf, size_t len);
+
+/** Free a source buffer.  Does not close the underlying file.
+ * \param srcbuf    source buffer
+ */
+YASM_LIB_DECL
+void yasm_srcbuf_destroy(/*@only@*/ yasm_srcbuf *srcbuf);
+
+/** Get the next line from a source buffer.  The returned line is NOT
+ * 0-terminated; it includes the terminating '\n' if one is present (the
+ * last line of a file may lack one).
+ * \param srcbuf    source buffer
+ * \param len       (returned) length of line in bytes
+ * \return Pointer to start of line, or NULL at end of file or on a read
+ *         error.  Only valid until the next call to yasm_srcbuf_get_line()
+ *         or yasm_srcbuf_destroy().
+ */
+YASM_LIB_DECL
+/*@null@*/ /*@dependent@*/ const char *yasm_srcbuf_get_line
+    (yasm_srcbuf *srcbuf, /*@out@*/ size_t *len);
+
+/** Get all the rest of a source buffer at once.  A memory mapped file is
+ * returned in place; otherwise the rest of the file is read into memory.
+ * \param srcbuf    source buffer
+ * \param len       (returned) length of the rest of the file in bytes
+ * \return Pointer to the rest of the file (not 0-terminated).  Only valid
+ *         until the next call to yasm_srcbuf_get_line() or
+ *         yasm_srcbuf_destroy().
+ */
+YASM_LIB_DECL
+/*@dependent@*/ const char *yasm_srcbuf_get_rest
+    (yasm_srcbuf *srcbuf, /*@out@*/ size_t *len);
+
+/** Determine if a read error occurred on a source buffer.
+ * \param srcbuf    source buffer
+ * \return Nonzero if a read error occurred.
+ */
+YASM_LIB_DECL
+int yasm_srcbuf_error(const yasm_srcbuf *srcbuf);
+
 /** Unescape a string with C-style escapes.  Handles b, f, n, r, t, and hex
  * and octal escapes.  String is updated in-place.
  * Edge cases:
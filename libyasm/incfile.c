@@ -0,0 +1,270 @@
+/*
+ * Included binary files
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/* Need fileno() (POSIX) and copy_file_range() (Linux) */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "util.h"
+
+#ifdef YASM_HAVE_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#if defined(HAVE_COPY_FILE_RANGE) && defined(HAVE_UNISTD_H)
+#include <unistd.h>
+#define USE_COPY_FILE_RANGE
+#endif
+
+#include "coretype.h"
+#include "errwarn.h"
+#include "file.h"
+#include "hamt.h"
+#include "incfile.h"
+
+
+#define CHUNK_SIZE      65536   /* size of reads when copying */
+
+struct yasm_incfile {
+    /*@dependent@*/ yasm_incfile_cache *cache;     /* cache it came from */
+    /*@owned@*/ char *key;      /* cache key: from, newline, iname */
+    /*@owned@*/ char *path;     /* pathname it was opened as */
+    /*@owned@*/ FILE *f;
+    unsigned long size;
+#ifdef HAVE_SYS_STAT_H
+    time_t mtime;               /* modification time when opened */
+#endif
+    /*@null@*/ /*@owned@*/ yasm_incfile *next;     /* next opened file */
+};
+
+struct yasm_incfile_cache {
+    /* Most recently opened file for each key */
+    /*@owned@*/ HAMT *files;
+
+    /* Every file opened, including ones since opened again because they
+     * changed (earlier handles may still be in use).
+     */
+    /*@null@*/ /*@owned@*/ yasm_incfile *opened;
+
+#ifdef YASM_HAVE_THREADS
+    pthread_mutex_t mutex;
+#endif
+};
+
+#ifdef YASM_HAVE_THREADS
+#define CACHE_LOCK(c)   pthread_mutex_lock(&(c)->mutex)
+#define CACHE_UNLOCK(c) pthread_mutex_unlock(&(c)->mutex)
+#else
+#define CACHE_LOCK(c)
+#define CACHE_UNLOCK(c)
+#endif
+
+/* The files themselves are deleted from the opened list */
+static void
+incfile_nodelete(/*@unused@*/ void *data)
+{
+}
+
+yasm_incfile_cache *
+yasm_incfile_cache_create(void)
+{
+    yasm_incfile_cache *cache = yasm_xmalloc(sizeof(yasm_incfile_cache));
+
+    cache->files = HAMT_create(0, yasm_internal_error_);
+    cache->opened = NULL;
+#ifdef YASM_HAVE_THREADS
+    pthread_mutex_init(&cache->mutex, NULL);
+#endif
+    return cache;
+}
+
+void
+yasm_incfile_cache_destroy(yasm_incfile_cache *cache)
+{
+    yasm_incfile *file, *next;
+
+    HAMT_destroy(cache->files, incfile_nodelete);
+    for (file = cache->opened; file; file = next) {
+        next = file->next;
+        fclose(file->f);
+        yasm_xfree(file->key);
+        yasm_xfree(file->path);
+        yasm_xfree(file);
+    }
+#ifdef YASM_HAVE_THREADS
+    pthread_mutex_destroy(&cache->mutex);
+#endif
+    yasm_xfree(cache);
+}
+
+/* Has a file changed since it was opened? */
+static int
+incfile_changed(const yasm_incfile *file)
+{
+#ifdef HAVE_SYS_STAT_H
+    struct stat st;
+
+    if (stat(file->path, &st) != 0)
+        return 1;
+    return (unsigned long)st.st_size != file->size
+        || st.st_mtime != file->mtime;
+#else
+    return 0;
+#endif
+}
+
+yasm_incfile *
+yasm_incfile_open(yasm_incfile_cache *cache, const char *iname,
+                  const char *from)
+{
+    /*@null@*/ yasm_incfile *file;
+    char *key, *path;
+    FILE *f;
+    long size;
+    int replace = 1;
+#ifdef HAVE_SYS_STAT_H
+    struct stat st;
+    time_t mtime = 0;
+#endif
+
+    if (!from)
+        from = "";
+    key = yasm_xmalloc(strlen(from)+strlen(iname)+2);
+    sprintf(key, "%s\n%s", from, iname);
+
+    CACHE_LOCK(cache);
+    file = HAMT_search(cache->files, key);
+    if (file && !incfile_changed(file)) {
+        CACHE_UNLOCK(cache);
+        yasm_xfree(key);
+        return file;
+    }
+
+    f = yasm_fopen_include(iname, from, "rb", &path);
+    if (!f) {
+        CACHE_UNLOCK(cache);
+        yasm_xfree(key);
+        return NULL;
+    }
+    size = -1;
+#ifdef HAVE_SYS_STAT_H
+    if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode)) {
+        size = (long)st.st_size;
+        mtime = st.st_mtime;
+    }
+#endif
+    if (size < 0 && fseek(f, 0L, SEEK_END) == 0)
+        size = ftell(f);
+    if (size < 0) {
+        CACHE_UNLOCK(cache);
+        fclose(f);
+        yasm_xfree(path);
+        yasm_xfree(key);
+        return NULL;
+    }
+
+    file = yasm_xmalloc(sizeof(yasm_incfile));
+    file->cache = cache;
+    file->key = key;
+    file->path = path;
+    file->f = f;
+    file->size = (unsigned long)size;
+#ifdef HAVE_SYS_STAT_H
+    file->mtime = mtime;
+#endif
+    file->next = cache->opened;
+    cache->opened = file;
+    HAMT_insert(cache->files, file->key, file, &replace, incfile_nodelete);
+    CACHE_UNLOCK(cache);
+    return file;
+}
+
+unsigned long
+yasm_incfile_size(const yasm_incfile *file)
+{
+    return file->size;
+}
+
+int
+yasm_incfile_read(yasm_incfile *file, unsigned long offset, void *buf,
+                  size_t len)
+{
+    int error;
+
+    /* The file position is shared by all users of the file */
+    CACHE_LOCK(file->cache);
+    error = fseek(file->f, (long)offset, SEEK_SET) < 0
+        || fread(buf, 1, len, file->f) < len;
+    CACHE_UNLOCK(file->cache);
+    return error;
+}
+
+int
+yasm_incfile_copy(yasm_incfile *file, unsigned long offset,
+                  unsigned long len, FILE *f)
+{
+    unsigned char *buf;
+    int error = 0;
+#ifdef USE_COPY_FILE_RANGE
+    long pos;
+
+    /* Let the kernel copy as much as it can.  Both file positions are
+     * passed explicitly, so the included file can be shared.
+     */
+    if (len > 0 && fflush(f) == 0 && (pos = ftell(f)) >= 0) {
+        loff_t inpos = (loff_t)offset, outpos = (loff_t)pos;
+        ssize_t n;
+
+        while (len > 0 && (n = copy_file_range(fileno(file->f), &inpos,
+                                               fileno(f), &outpos, len,
+                                               0)) > 0) {
+            offset += (unsigned long)n;
+            len -= (unsigned long)n;
+        }
+        if (outpos != (loff_t)pos && fseek(f, (long)outpos, SEEK_SET) < 0)
+            return 1;
+    }
+#endif
+
+    /* Copy anything left (if the kernel can't copy between the files) */
+    if (len == 0)
+        return 0;
+    buf = yasm_xmalloc(CHUNK_SIZE);
+    while (len > 0 && !error) {
+        size_t n = len > CHUNK_SIZE ? CHUNK_SIZE : (size_t)len;
+        error = yasm_incfile_read(file, offset, buf, n)
+            || fwrite(buf, 1, n, f) < n;
+        offset += (unsigned long)n;
+        len -= (unsigned long)n;
+    }
+    yasm_xfree(buf);
+    return error;
+}
@@ -0,0 +1,97 @@
+/**
+ * \file libyasm/incfile.h
+ * \brief YASM included binary file interface.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_INCFILE_H
+#define YASM_INCFILE_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/** Create an empty cache of included files.  Each object has its own (see
+ * yasm_object), so files are opened afresh for every assembly.
+ * \return Newly allocated cache.
+ */
+YASM_LIB_DECL
+/*@only@*/ yasm_incfile_cache *yasm_incfile_cache_create(void);
+
+/** Close all files opened through a cache and delete it.  Handles returned
+ * by yasm_incfile_open() for the cache become invalid.
+ * \param cache     cache
+ */
+YASM_LIB_DECL
+void yasm_incfile_cache_destroy(/*@only@*/ yasm_incfile_cache *cache);
+
+/** Open a file whose contents are included verbatim in the output (e.g.
+ * by incbin).  The file is searched for as by yasm_fopen_include().  The
+ * same iname and from return the same handle for as long as the file's
+ * size and modification time are unchanged; if either changes, the file
+ * is opened again (handles returned earlier stay valid).  Files stay open
+ * until the cache is destroyed.  Safe to call from multiple threads.
+ * \param cache     cache
+ * \param iname     file to include
+ * \param from      file doing the including
+ * \return Included file, or NULL if not found.
+ */
+YASM_LIB_DECL
+/*@null@*/ /*@dependent@*/ yasm_incfile *yasm_incfile_open
+    (yasm_incfile_cache *cache, const char *iname, const char *from);
+
+/** Get the size of an included file.
+ * \param file      included file
+ * \return Size in bytes.
+ */
+YASM_LIB_DECL
+unsigned long yasm_incfile_size(const yasm_incfile *file);
+
+/** Read part of an included file into memory.
+ * \param file      included file
+ * \param offset    offset in file to start reading at
+ * \param buf       buffer (output); len bytes
+ * \param len       number of bytes to read
+ * \return Nonzero if the data could not be read.
+ */
+YASM_LIB_DECL
+int yasm_incfile_read(yasm_incfile *file, unsigned long offset,
+                      /*@out@*/ void *buf, size_t len);
+
+/** Copy part of an included file to the current position of an output
+ * file.  The data is copied by the kernel (without passing through user
+ * space) where possible, and otherwise in bounded chunks.
+ * \param file      included file
+ * \param offset    offset in file to start copying at
+ * \param len       number of bytes to copy
+ * \param f         output file
+ * \return Nonzero if an error occurred.
+ */
+YASM_LIB_DECL
+int yasm_incfile_copy(yasm_incfile *file, unsigned long offset,
+                      unsigned long len, FILE *f);
+
+#endif
@@ -30,6 +30,7 @@
 #include <limits.h>
 
 #include "coretype.h"
+#include "arena.h"
 #include "bitvect.h"
 #include "file.h"
 
@@ -40,26 +41,106 @@
 /* "Native" "word" size for intnum calculations. */
 #define BITVECT_NATIVE_SIZE     256
 
+/* Size of a long in bits. */
+#define LONG_BITS               (sizeof(long)*CHAR_BIT)
+
+/* Any value that fits into a long is always stored as one, so most
+ * arithmetic can be done without going through bitvects at all.
+ */
 struct yasm_intnum {
     union val {
-        long l;                 /* integer value (for integers <32 bits) */
-        wordptr bv;             /* bit vector (for integers >=32 bits) */
+        long l;                 /* integer value (if it fits in a long) */
+        wordptr bv;             /* bit vector (for larger integers) */
     } val;
     enum { INTNUM_L, INTNUM_BV } type;
 };
 
+/* Overflow-checked long arithmetic; each returns nonzero on overflow. */
+#if defined(__GNUC__) && __GNUC__ >= 5
+#define long_add_overflow(a, b, r)  __builtin_saddl_overflow(a, b, r)
+#define long_sub_overflow(a, b, r)  __builtin_ssubl_overflow(a, b, r)
+#define long_mul_overflow(a, b, r)  __builtin_smull_overflow(a, b, r)
+#else
+static int
+long_add_overflow(long a, long b, long *r)
+{
+    if ((b > 0 && a > LONG_MAX - b) || (b < 0 && a < LONG_MIN - b))
+        return 1;
+    *r = a + b;
+    return 0;
+}
+
+static int
+long_sub_overflow(long a, long b, long *r)
+{
+    if ((b < 0 && a > LONG_MAX + b) || (b > 0 && a < LONG_MIN + b))
+        return 1;
+    *r = a - b;
+    return 0;
+}
+
+static int
+long_mul_overflow(long a, long b, long *r)
+{
+    unsigned long ua = a < 0 ? 0UL-(unsigned long)a : (unsigned long)a;
+    unsigned long ub = b < 0 ? 0UL-(unsigned long)b : (unsigned long)b;
+    unsigned long p;
+
+    if (ua != 0 && ub > ULONG_MAX / ua)
+        return 1;
+    p = ua * ub;
+    if ((a < 0) != (b < 0)) {
+        if (p > (unsigned long)LONG_MAX + 1)
+            return 1;
+        *r = p > (unsigned long)LONG_MAX ? LONG_MIN : -(long)p;
+    } else {
+        if (p > (unsigned long)LONG_MAX)
+            return 1;
+        *r = (long)p;
+    }
+    return 0;
+}
+#endif
+
+/* Arithmetic (sign-filling) shift right of a long. */
+static long
+long_sar(long v, unsigned long count)
+{
+    if (count >= LONG_BITS)
+        return v < 0 ? -1 : 0;
+    return v < 0 ? ~(~v >> count) : v >> count;
+}
+
+/* Return nonzero if u < 2^bits (Set_Max(u) < bits for a bitvect). */
+static int
+ulong_fits(unsigned long u, long bits)
+{
+    if (bits < 0)
+        return u == 0;
+    if ((unsigned long)bits >= LONG_BITS)
+        return 1;
+    return (u >> bits) == 0;
+}
+
 /* static bitvect used for conversions */
-static /*@only@*/ wordptr conv_bv;
+static YASM_THREAD_LOCAL /*@only@*/ wordptr conv_bv;
 
 /* static bitvects used for computation */
-static /*@only@*/ wordptr result, spare, op1static, op2static;
+static YASM_THREAD_LOCAL /*@only@*/ wordptr result, spare, op1static,
+    op2static;
+
+static YASM_THREAD_LOCAL /*@only@*/ BitVector_from_Dec_static_data
+    *from_dec_data;
 
-static /*@only@*/ BitVector_from_Dec_static_data *from_dec_data;
+/* Number of unmatched yasm_intnum_initialize() calls on this thread */
+static YASM_THREAD_LOCAL unsigned int initialized;
 
 
 void
 yasm_intnum_initialize(void)
 {
+    if (initialized++ > 0)
+        return;
     conv_bv = BitVector_Create(BITVECT_NATIVE_SIZE, FALSE);
     result = BitVector_Create(BITVECT_NATIVE_SIZE, FALSE);
     spare = BitVector_Create(BITVECT_NATIVE_SIZE, FALSE);
@@ -71,6 +152,8 @@ yasm_intnum_initialize(void)
 void
 yasm_intnum_cleanup(void)
 {
+    if (initialized == 0 || --initialized > 0)
+        return;
     BitVector_from_Dec_static_Shutdown(from_dec_data);
     BitVector_Destroy(op2static);
     BitVector_Destroy(op1static);
@@ -86,22 +169,20 @@ yasm_intnum_cleanup(void)
 static void
 intnum_frombv(/*@out@*/ yasm_intnum *intn, wordptr bv)
 {
-    if (Set_Max(bv) < 31) {
+    if (Set_Max(bv) < (long)LONG_BITS-1) {
         intn->type = INTNUM_L;
-        intn->val.l = (long)BitVector_Chunk_Read(bv, 31, 0);
+        intn->val.l = (long)BitVector_Chunk_Read(bv, LONG_BITS, 0);
     } else if (BitVector_msb_(bv)) {
-        /* Negative, negate and see if we'll fit into a long. */
-        unsigned long ul;
-        BitVector_Negate(bv, bv);
-        if (Set_Max(bv) >= 32 ||
-            ((ul = BitVector_Chunk_Read(bv, 32, 0)) & 0x80000000)) {
+        /* Negative, complement (-x-1) and see if we'll fit into a long. */
+        Set_Complement(bv, bv);
+        if (Set_Max(bv) < (long)LONG_BITS-1) {
+            intn->type = INTNUM_L;
+            intn->val.l = ~(long)BitVector_Chunk_Read(bv, LONG_BITS, 0);
+        } else {
             /* too negative */
-            BitVector_Negate(bv, bv);
+            Set_Complement(bv, bv);
             intn->type = INTNUM_BV;
             intn->val.bv = BitVector_Clone(bv);
-        } else {
-            intn->type = INTNUM_L;
-            intn->val.l = -((long)ul);
         }
     } else {
         intn->type = INTNUM_BV;
@@ -119,19 +200,16 @@ intnum_tobv(/*@returned@*/ wordptr bv, const yasm_intnum *intn)
         return intn->val.bv;
 
     BitVector_Empty(bv);
-    if (intn->val.l >= 0)
-        BitVector_Chunk_Store(bv, 32, 0, (unsigned long)intn->val.l);
-    else {
-        BitVector_Chunk_Store(bv, 32, 0, (unsigned long)-intn->val.l);
-        BitVector_Negate(bv, bv);
-    }
+    BitVector_Chunk_Store(bv, LONG_BITS, 0, (unsigned long)intn->val.l);
+    if (intn->val.l < 0)
+        BitVector_Interval_Fill(bv, LONG_BITS, BITVECT_NATIVE_SIZE-1);
     return bv;
 }
 
 yasm_intnum *
 yasm_intnum_create_dec(char *str)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
 
     switch (BitVector_from_Dec_static(from_dec_data, conv_bv,
                                       (unsigned char *)str)) {
@@ -152,7 +230,7 @@ yasm_intnum_create_dec(char *str)
 yasm_intnum *
 yasm_intnum_create_bin(char *str)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
 
     switch (BitVector_from_Bin(conv_bv, (unsigned char *)str)) {
         case ErrCode_Pars:
@@ -172,7 +250,7 @@ yasm_intnum_create_bin(char *str)
 yasm_intnum *
 yasm_intnum_create_oct(char *str)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
 
     switch (BitVector_from_Oct(conv_bv, (unsigned char *)str)) {
         case ErrCode_Pars:
@@ -192,7 +270,7 @@ yasm_intnum_create_oct(char *str)
 yasm_intnum *
 yasm_intnum_create_hex(char *str)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
 
     switch (BitVector_from_Hex(conv_bv, (unsigned char *)str)) {
         case ErrCode_Pars:
@@ -213,18 +291,17 @@ yasm_intnum_create_hex(char *str)
 yasm_intnum *
 yasm_intnum_create_charconst_nasm(const char *str)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
     size_t len = strlen(str);
 
     if(len*8 > BITVECT_NATIVE_SIZE)
         yasm_error_set(YASM_ERROR_OVERFLOW,
                        N_("Character constant too large for internal format"));
 
-    /* be conservative in choosing bitvect in case MSB is set */
-    if (len > 3) {
+    /* build longer constants in a bitvect in case MSB is set */
+    if (len > 3)
         BitVector_Empty(conv_bv);
-        intn->type = INTNUM_BV;
-    } else {
+    else {
         intn->val.l = 0;
         intn->type = INTNUM_L;
     }
@@ -249,7 +326,7 @@ yasm_intnum_create_charconst_nasm(const char *str)
                 BitVector_Chunk_Store(conv_bv, 8, 0,
                                       ((unsigned long)str[--len]) & 0xff);
             }
-            intn->val.bv = BitVector_Clone(conv_bv);
+            intnum_frombv(intn, conv_bv);
     }
 
     return intn;
@@ -258,7 +335,7 @@ yasm_intnum_create_charconst_nasm(const char *str)
 yasm_intnum *
 yasm_intnum_create_charconst_tasm(const char *str)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
     size_t len = strlen(str);
     size_t i;
 
@@ -266,11 +343,10 @@ yasm_intnum_create_charconst_tasm(const char *str)
         yasm_error_set(YASM_ERROR_OVERFLOW,
                        N_("Character constant too large for internal format"));
 
-    /* be conservative in choosing bitvect in case MSB is set */
-    if (len > 3) {
+    /* build longer constants in a bitvect in case MSB is set */
+    if (len > 3)
         BitVector_Empty(conv_bv);
-        intn->type = INTNUM_BV;
-    } else {
+    else {
         intn->val.l = 0;
         intn->type = INTNUM_L;
     }
@@ -297,7 +373,7 @@ yasm_intnum_create_charconst_tasm(const char *str)
                                       ((unsigned long)str[i]) & 0xff);
                 i++;
             }
-            intn->val.bv = BitVector_Clone(conv_bv);
+            intnum_frombv(intn, conv_bv);
     }
 
     return intn;
@@ -307,13 +383,13 @@ yasm_intnum_create_charconst_tasm(const char *str)
 yasm_intnum *
 yasm_intnum_create_uint(unsigned long i)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
 
     if (i > LONG_MAX) {
         /* Too big, store as bitvector */
         intn->val.bv = BitVector_Create(BITVECT_NATIVE_SIZE, TRUE);
         intn->type = INTNUM_BV;
-        BitVector_Chunk_Store(intn->val.bv, 32, 0, i);
+        BitVector_Chunk_Store(intn->val.bv, LONG_BITS, 0, i);
     } else {
         intn->val.l = (long)i;
         intn->type = INTNUM_L;
@@ -325,7 +401,7 @@ yasm_intnum_create_uint(unsigned long i)
 yasm_intnum *
 yasm_intnum_create_int(long i)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
 
     intn->val.l = i;
     intn->type = INTNUM_L;
@@ -337,7 +413,7 @@ yasm_intnum *
 yasm_intnum_create_leb128(const unsigned char *ptr, int sign,
                           unsigned long *size)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
     const unsigned char *ptr_orig = ptr;
     unsigned long i = 0;
 
@@ -366,7 +442,7 @@ yasm_intnum *
 yasm_intnum_create_sized(unsigned char *ptr, int sign, size_t srcsize,
                          int bigendian)
 {
-    yasm_intnum *intn = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *intn = yasm_arena_alloc(sizeof(yasm_intnum));
     unsigned long i = 0;
 
     if (srcsize*8 > BITVECT_NATIVE_SIZE)
@@ -394,7 +470,7 @@ yasm_intnum_create_sized(unsigned char *ptr, int sign, size_t srcsize,
 yasm_intnum *
 yasm_intnum_copy(const yasm_intnum *intn)
 {
-    yasm_intnum *n = yasm_xmalloc(sizeof(yasm_intnum));
+    yasm_intnum *n = yasm_arena_alloc(sizeof(yasm_intnum));
 
     switch (intn->type) {
         case INTNUM_L:
@@ -414,32 +490,160 @@ yasm_intnum_destroy(yasm_intnum *intn)
 {
     if (intn->type == INTNUM_BV)
         BitVector_Destroy(intn->val.bv);
-    yasm_xfree(intn);
+    yasm_arena_free(intn);
+}
+
+/* Signed division of longs, rounding toward zero (as BitVector_Divide()
+ * does).  The remainder has the sign of the dividend.  Returns nonzero if
+ * the quotient overflows.
+ */
+static int
+long_divide(long a, long b, /*@out@*/ long *q, /*@out@*/ long *r)
+{
+    unsigned long ua = a < 0 ? 0UL-(unsigned long)a : (unsigned long)a;
+    unsigned long ub = b < 0 ? 0UL-(unsigned long)b : (unsigned long)b;
+    unsigned long uq = ua / ub, ur = ua % ub;
+
+    if ((a < 0) != (b < 0))
+        *q = uq > (unsigned long)LONG_MAX ? LONG_MIN : -(long)uq;
+    else if (uq > (unsigned long)LONG_MAX)
+        return 1;   /* LONG_MIN / -1 */
+    else
+        *q = (long)uq;
+    /* |r| < |b| <= LONG_MAX+1, and r != LONG_MAX+1 */
+    *r = a < 0 ? -(long)ur : (long)ur;
+    return 0;
 }
 
+/* Calculate with longs if the result fits in a long.  Operations that
+ * can't be done this way (divide by zero, out of range results, and
+ * errors) return 0 and leave *acc untouched.
+ */
+static int
+intnum_calc_long(long *acc, yasm_expr_op op, long b)
+{
+    long a = *acc, r, spare_l;
+
+    switch (op) {
+        case YASM_EXPR_ADD:
+            if (long_add_overflow(a, b, &r))
+                return 0;
+            break;
+        case YASM_EXPR_SUB:
+            if (long_sub_overflow(a, b, &r))
+                return 0;
+            break;
+        case YASM_EXPR_MUL:
+            if (long_mul_overflow(a, b, &r))
+                return 0;
+            break;
+        case YASM_EXPR_DIV:
+        case YASM_EXPR_SIGNDIV:
+            if (b == 0 || long_divide(a, b, &r, &spare_l))
+                return 0;
+            break;
+        case YASM_EXPR_MOD:
+        case YASM_EXPR_SIGNMOD:
+            if (b == 0 || long_divide(a, b, &spare_l, &r))
+                return 0;
+            break;
+        case YASM_EXPR_NEG:
+            if (a == LONG_MIN)
+                return 0;
+            r = -a;
+            break;
+        case YASM_EXPR_NOT:
+            r = ~a;
+            break;
+        case YASM_EXPR_OR:
+            r = a | b;
+            break;
+        case YASM_EXPR_AND:
+            r = a & b;
+            break;
+        case YASM_EXPR_XOR:
+            r = a ^ b;
+            break;
+        case YASM_EXPR_XNOR:
+            r = ~(a ^ b);
+            break;
+        case YASM_EXPR_NOR:
+            r = ~(a | b);
+            break;
+        case YASM_EXPR_SHL:
+            /* the top b+1 bits must all be copies of the sign bit */
+            if (b < 0 || a == 0)
+                r = 0;
+            else if ((unsigned long)b < LONG_BITS-1 &&
+                     long_sar(a, LONG_BITS-1-(unsigned long)b) == -(a < 0))
+                r = (long)((unsigned long)a << b);
+            else
+                return 0;
+            break;
+        case YASM_EXPR_SHR:
+            r = b < 0 ? 0 : long_sar(a, (unsigned long)b);
+            break;
+        case YASM_EXPR_LOR:
+            r = a || b;
+            break;
+        case YASM_EXPR_LAND:
+            r = a && b;
+            break;
+        case YASM_EXPR_LNOT:
+            r = !a;
+            break;
+        case YASM_EXPR_LXOR:
+            r = !a ^ !b;
+            break;
+        case YASM_EXPR_LXNOR:
+            r = !(!a ^ !b);
+            break;
+        case YASM_EXPR_LNOR:
+            r = !(a || b);
+            break;
+        case YASM_EXPR_EQ:
+            r = a == b;
+            break;
+        case YASM_EXPR_LT:
+            r = a < b;
+            break;
+        case YASM_EXPR_GT:
+            r = a > b;
+            break;
+        case YASM_EXPR_LE:
+            r = a <= b;
+            break;
+        case YASM_EXPR_GE:
+            r = a >= b;
+            break;
+        case YASM_EXPR_NE:
+            r = a != b;
+            break;
+        case YASM_EXPR_IDENT:
+            r = a;
+            break;
+        default:
+            return 0;
+    }
+    *acc = r;
+    return 1;
+}
+
+/* Calculate in full bit vectors.
+ * Bit vector results must be calculated through intermediate storage.
+ */
 /*@-nullderef -nullpass -branchstate@*/
-int
-yasm_intnum_calc(yasm_intnum *acc, yasm_expr_op op, yasm_intnum *operand)
+static int
+intnum_calc_bv(yasm_intnum *acc, yasm_expr_op op, yasm_intnum *operand)
 {
     boolean carry = 0;
     wordptr op1, op2 = NULL;
     N_int count;
 
-    /* Always do computations with in full bit vector.
-     * Bit vector results must be calculated through intermediate storage.
-     */
     op1 = intnum_tobv(op1static, acc);
     if (operand)
         op2 = intnum_tobv(op2static, operand);
 
-    if (!operand && op != YASM_EXPR_NEG && op != YASM_EXPR_NOT &&
-        op != YASM_EXPR_LNOT) {
-        yasm_error_set(YASM_ERROR_ARITHMETIC,
-                       N_("operation needs an operand"));
-        BitVector_Empty(result);
-        return 1;
-    }
-
     /* A operation does a bitvector computation if result is allocated. */
     switch (op) {
         case YASM_EXPR_ADD:
@@ -601,7 +805,7 @@ yasm_intnum_calc(yasm_intnum *acc, yasm_expr_op op, yasm_intnum *operand)
             return 1;
     }
 
-    /* Try to fit the result into 32 bits if possible */
+    /* Try to fit the result into a long if possible */
     if (acc->type == INTNUM_BV)
         BitVector_Destroy(acc->val.bv);
     intnum_frombv(acc, result);
@@ -609,6 +813,25 @@ yasm_intnum_calc(yasm_intnum *acc, yasm_expr_op op, yasm_intnum *operand)
 }
 /*@=nullderef =nullpass =branchstate@*/
 
+int
+yasm_intnum_calc(yasm_intnum *acc, yasm_expr_op op, yasm_intnum *operand)
+{
+    if (!operand && op != YASM_EXPR_NEG && op != YASM_EXPR_NOT &&
+        op != YASM_EXPR_LNOT) {
+        yasm_error_set(YASM_ERROR_ARITHMETIC,
+                       N_("operation needs an operand"));
+        BitVector_Empty(result);
+        return 1;
+    }
+
+    /* Most values fit in a long, and so do most results */
+    if (acc->type == INTNUM_L && (!operand || operand->type == INTNUM_L) &&
+        intnum_calc_long(&acc->val.l, op, operand ? operand->val.l : 0))
+        return 0;
+
+    return intnum_calc_bv(acc, op, operand);
+}
+
 int
 yasm_intnum_compare(const yasm_intnum *intn1, const yasm_intnum *intn2)
 {
@@ -667,7 +890,8 @@ yasm_intnum_set_uint(yasm_intnum *intn, unsigned long val)
             intn->val.bv = BitVector_Create(BITVECT_NATIVE_SIZE, TRUE);
             intn->type = INTNUM_BV;
         }
-        BitVector_Chunk_Store(intn->val.bv, 32, 0, val);
+        BitVector_Empty(intn->val.bv);
+        BitVector_Chunk_Store(intn->val.bv, LONG_BITS, 0, val);
     } else {
         if (intn->type == INTNUM_BV) {
             BitVector_Destroy(intn->val.bv);
@@ -729,9 +953,9 @@ yasm_intnum_get_uint(const yasm_intnum *intn)
         case INTNUM_BV:
             if (BitVector_msb_(intn->val.bv))
                 return 0;
-            if (Set_Max(intn->val.bv) > 32)
+            if (Set_Max(intn->val.bv) >= (long)LONG_BITS)
                 return ULONG_MAX;
-            return BitVector_Chunk_Read(intn->val.bv, 32, 0);
+            return BitVector_Chunk_Read(intn->val.bv, LONG_BITS, 0);
         default:
             yasm_internal_error(N_("unknown intnum type"));
             /*@notreached@*/
@@ -746,24 +970,8 @@ yasm_intnum_get_int(const yasm_intnum *intn)
         case INTNUM_L:
             return intn->val.l;
         case INTNUM_BV:
-            if (BitVector_msb_(intn->val.bv)) {
-                /* it's negative: negate the bitvector to get a positive
-                 * number, then negate the positive number.
-                 */
-                unsigned long ul;
-
-                BitVector_Negate(conv_bv, intn->val.bv);
-                if (Set_Max(conv_bv) >= 32) {
-                    /* too negative */
-                    return LONG_MIN;
-                }
-                ul = BitVector_Chunk_Read(conv_bv, 32, 0);
-                /* check for too negative */
-                return (ul & 0x80000000) ? LONG_MIN : -((long)ul);
-            }
-
-            /* it's positive, and since it's a BV, it must be >0x7FFFFFFF */
-            return LONG_MAX;
+            /* it doesn't fit in a long, or it wouldn't be a BV */
+            return BitVector_msb_(intn->val.bv) ? LONG_MIN : LONG_MAX;
         default:
             yasm_internal_error(N_("unknown intnum type"));
             /*@notreached@*/
@@ -795,6 +1003,37 @@ yasm_intnum_get_sized(const yasm_intnum *intn, unsigned char *ptr,
         yasm_warn_set(YASM_WARN_GENERAL,
                       N_("value does not fit in %d bit field"), valsize);
 
+    /* Small values into small destinations don't need bitvects */
+    if (intn->type == INTNUM_L && !bigendian &&
+        destsize <= sizeof(unsigned long)) {
+        unsigned long dest = 0, mask, v;
+        size_t i;
+
+        for (i=0; i<destsize; i++)
+            dest |= (unsigned long)ptr[i] << (i*8);
+
+        /* Check low bits if right shifting and warnings enabled */
+        if (warn && rshift > 0 &&
+            (rshift >= LONG_BITS ? intn->val.l != 0 :
+             ((unsigned long)intn->val.l << (LONG_BITS-rshift)) != 0))
+            yasm_warn_set(YASM_WARN_GENERAL,
+                          N_("misaligned value, truncating to boundary"));
+
+        v = (unsigned long)long_sar(intn->val.l, rshift);
+        if (rshift > 0)
+            shift = 0;
+
+        /* Write the new value into the destination */
+        if ((size_t)shift < LONG_BITS) {
+            mask = valsize >= LONG_BITS ? ULONG_MAX : (1UL<<valsize)-1;
+            dest = (dest & ~(mask << shift)) | ((v & mask) << shift);
+        }
+
+        for (i=0; i<destsize; i++)
+            ptr[i] = (unsigned char)(dest >> (i*8));
+        return;
+    }
+
     /* Read the original data into a bitvect */
     if (bigendian) {
         /* TODO */
@@ -804,6 +1043,11 @@ yasm_intnum_get_sized(const yasm_intnum *intn, unsigned char *ptr,
 
     /* If not already a bitvect, convert value to be written to a bitvect */
     op2 = intnum_tobv(op2static, intn);
+    if (rshift > 0 && op2 != op2static) {
+        /* don't shift the intnum itself */
+        BitVector_Copy(op2static, op2);
+        op2 = op2static;
+    }
 
     /* Check low bits if right shifting and warnings enabled */
     if (warn && rshift > 0) {
@@ -842,7 +1086,22 @@ yasm_intnum_check_size(const yasm_intnum *intn, size_t size, size_t rshift,
 {
     wordptr val;
 
-    /* If not already a bitvect, convert value to a bitvect */
+    if (intn->type == INTNUM_L) {
+        long v = long_sar(intn->val.l, rshift);
+
+        if (size >= BITVECT_NATIVE_SIZE)
+            return 1;
+        if (v < 0) {
+            /* unsigned range never includes negatives */
+            return rangetype > 0 &&
+                ulong_fits((unsigned long)~v, (long)size-1);
+        }
+        if (rangetype == 1)
+            size--;
+        return ulong_fits((unsigned long)v, (long)size);
+    }
+
+    /* Convert value to a bitvect */
     if (intn->type == INTNUM_BV) {
         if (rshift > 0) {
             val = conv_bv;
@@ -882,30 +1141,10 @@ yasm_intnum_check_size(const yasm_intnum *intn, size_t size, size_t rshift,
 int
 yasm_intnum_in_range(const yasm_intnum *intn, long low, long high)
 {
-    wordptr val = intnum_tobv(result, intn);
-    wordptr lval = op1static;
-    wordptr hval = op2static;
-
-    /* Convert high and low to bitvects */
-    BitVector_Empty(lval);
-    if (low >= 0)
-        BitVector_Chunk_Store(lval, 32, 0, (unsigned long)low);
-    else {
-        BitVector_Chunk_Store(lval, 32, 0, (unsigned long)(-low));
-        BitVector_Negate(lval, lval);
-    }
-
-    BitVector_Empty(hval);
-    if (high >= 0)
-        BitVector_Chunk_Store(hval, 32, 0, (unsigned long)high);
-    else {
-        BitVector_Chunk_Store(hval, 32, 0, (unsigned long)(-high));
-        BitVector_Negate(hval, hval);
-    }
-
-    /* Compare! */
-    return (BitVector_Compare(val, lval) >= 0
-            && BitVector_Compare(val, hval) <= 0);
+    /* A BV doesn't fit in a long, so it can't be in range */
+    if (intn->type == INTNUM_BV)
+        return 0;
+    return intn->val.l >= low && intn->val.l <= high;
 }
 
 static unsigned long
@@ -1066,7 +1305,7 @@ yasm_intnum_get_str(const yasm_intnum *intn)
 
     switch (intn->type) {
         case INTNUM_L:
-            s = yasm_xmalloc(16);
+            s = yasm_xmalloc(LONG_BITS/3+3);
             sprintf((char *)s, "%ld", intn->val.l);
             return (char *)s;
             break;
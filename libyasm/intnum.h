@@ -34,11 +34,17 @@
 #define YASM_LIB_DECL
 #endif
 
-/** Initialize intnum internal data structures. */
+/** Initialize intnum internal data structures.  These are per-thread;
+ * yasm_parallel_run() initializes them for its worker threads.  Calls may
+ * be nested; each must be matched by a call to yasm_intnum_cleanup().
+ */
 YASM_LIB_DECL
 void yasm_intnum_initialize(void);
 
-/** Clean up internal intnum allocations. */
+/** Clean up internal intnum allocations (for the calling thread).  The
+ * allocations are released by the call matching the outermost
+ * yasm_intnum_initialize().
+ */
 YASM_LIB_DECL
 void yasm_intnum_cleanup(void);
 
@@ -211,22 +217,23 @@ int yasm_intnum_is_neg1(const yasm_intnum *acc);
 YASM_LIB_DECL
 int yasm_intnum_sign(const yasm_intnum *acc);
 
-/** Convert an intnum to an unsigned 32-bit value.  The value is in "standard"
+/** Convert an intnum to an unsigned long value.  The value is in "standard"
  * C format (eg, of unknown endian).
- * \note Parameter intnum is truncated to fit into 32 bits.  Use
- *       intnum_check_size() to check for overflow.
+ * \note Negative values return 0 and values too large to fit into an
+ *       unsigned long return ULONG_MAX.  Use intnum_check_size() to check
+ *       for overflow.
  * \param intn  intnum
- * \return Unsigned 32-bit value of intn.
+ * \return Unsigned long value of intn.
  */
 YASM_LIB_DECL
 unsigned long yasm_intnum_get_uint(const yasm_intnum *intn);
 
-/** Convert an intnum to a signed 32-bit value.  The value is in "standard" C
+/** Convert an intnum to a signed long value.  The value is in "standard" C
  * format (eg, of unknown endian).
- * \note Parameter intnum is truncated to fit into 32 bits.  Use
- *       intnum_check_size() to check for overflow.
+ * \note Values too large to fit into a long return LONG_MIN or LONG_MAX.
+ *       Use intnum_check_size() to check for overflow.
  * \param intn  intnum
- * \return Signed 32-bit value of intn.
+ * \return Signed long value of intn.
  */
 YASM_LIB_DECL
 long yasm_intnum_get_int(const yasm_intnum *intn);
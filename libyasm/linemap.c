@@ -40,12 +40,19 @@ typedef struct line_mapping {
     /* related info */
     /* "original" source filename */
     /*@null@*/ /*@dependent@*/ const char *filename;
+    /* interned ID of filename */
+    unsigned long filename_id;
     /* "original" source base line number */
     unsigned long file_line;
     /* "original" source line number increment (for following lines) */
     unsigned long line_inc;
 } line_mapping;
 
+typedef struct line_filename {
+    /*@owned@*/ char *filename;
+    unsigned long id;
+} line_filename;
+
 typedef struct line_source_info {
     /* first bytecode on line; NULL if no bytecodes on line */
     /*@null@*/ /*@dependent@*/ yasm_bytecode *bc;
@@ -57,6 +64,7 @@ typedef struct line_source_info {
 struct yasm_linemap {
     /* Shared storage for filenames */
     /*@only@*/ /*@null@*/ HAMT *filenames;
+    unsigned long num_filenames;
 
     /* Current virtual line number. */
     unsigned long current;
@@ -66,6 +74,9 @@ struct yasm_linemap {
     unsigned long map_size;
     unsigned long map_allocated;
 
+    /* Index of last mapping found by lookup (searches start there) */
+    unsigned long map_last;
+
     /* Bytecode and source line information */
     /*@only@*/ line_source_info *source_info;
     size_t source_info_size;
@@ -74,7 +85,9 @@ struct yasm_linemap {
 static void
 filename_delete_one(/*@only@*/ void *d)
 {
-    yasm_xfree(d);
+    line_filename *fn = (line_filename *)d;
+    yasm_xfree(fn->filename);
+    yasm_xfree(fn);
 }
 
 void
@@ -82,7 +95,7 @@ yasm_linemap_set(yasm_linemap *linemap, const char *filename,
                  unsigned long virtual_line, unsigned long file_line,
                  unsigned long line_inc)
 {
-    char *copy;
+    line_filename *fn;
     unsigned long i;
     int replace = 0;
     line_mapping *mapping = NULL;
@@ -117,19 +130,29 @@ yasm_linemap_set(yasm_linemap *linemap, const char *filename,
     /* Fill it */
 
     if (!filename) {
-        if (linemap->map_size >= 2)
+        if (linemap->map_size >= 2) {
             mapping->filename =
                 linemap->map_vector[linemap->map_size-2].filename;
-        else
+            mapping->filename_id =
+                linemap->map_vector[linemap->map_size-2].filename_id;
+        } else
             filename = "unknown";
     }
     if (filename) {
-        /* Copy the filename (via shared storage) */
-        copy = yasm__xstrdup(filename);
+        /* Copy the filename (via shared storage), assigning it the next
+         * ID if it's new.
+         */
+        fn = yasm_xmalloc(sizeof(line_filename));
+        fn->filename = yasm__xstrdup(filename);
+        fn->id = linemap->num_filenames;
         /*@-aliasunique@*/
-        mapping->filename = HAMT_insert(linemap->filenames, copy, copy,
-                                        &replace, filename_delete_one);
+        fn = HAMT_insert(linemap->filenames, fn->filename, fn, &replace,
+                         filename_delete_one);
         /*@=aliasunique@*/
+        if (replace)
+            linemap->num_filenames++;
+        mapping->filename = fn->filename;
+        mapping->filename_id = fn->id;
     }
 
     mapping->line = virtual_line;
@@ -167,6 +190,7 @@ yasm_linemap_create(void)
     yasm_linemap *linemap = yasm_xmalloc(sizeof(yasm_linemap));
 
     linemap->filenames = HAMT_create(0, yasm_internal_error_);
+    linemap->num_filenames = 0;
 
     linemap->current = 1;
 
@@ -174,7 +198,8 @@ yasm_linemap_create(void)
     linemap->map_vector = yasm_xmalloc(8*sizeof(line_mapping));
     linemap->map_size = 0;
     linemap->map_allocated = 8;
-    
+    linemap->map_last = 0;
+
     /* initialize source line information array */
     linemap->source_info_size = 2;
     linemap->source_info = yasm_xmalloc(linemap->source_info_size *
@@ -243,37 +268,84 @@ yasm_linemap_goto_next(yasm_linemap *linemap)
 }
 
 void
-yasm_linemap_lookup(yasm_linemap *linemap, unsigned long line,
-                    const char **filename, unsigned long *file_line)
+yasm_linemap_lookup_id(yasm_linemap *linemap, unsigned long line,
+                       const char **filename, unsigned long *filename_id,
+                       unsigned long *file_line)
 {
     line_mapping *mapping;
     unsigned long vindex, step;
 
     assert(line <= linemap->current);
 
-    /* Binary search through map to find highest line_index <= index */
-    vindex = 0;
-    /* start step as the greatest power of 2 <= size */
-    step = 1;
-    while (step*2<=linemap->map_size)
-        step*=2;
-    while (step>0) {
-        if (vindex+step < linemap->map_size
-                && linemap->map_vector[vindex+step].line <= line)
-            vindex += step;
-        step /= 2;
+    /* Callers generally look up lines in increasing order, so first check
+     * the last mapping found and the one following it.
+     */
+    vindex = linemap->map_last;
+    if (vindex < linemap->map_size
+        && linemap->map_vector[vindex].line <= line
+        && vindex+1 < linemap->map_size
+        && linemap->map_vector[vindex+1].line <= line)
+        vindex++;
+    if (vindex >= linemap->map_size
+        || (vindex > 0 && linemap->map_vector[vindex].line > line)
+        || (vindex+1 < linemap->map_size
+            && linemap->map_vector[vindex+1].line <= line)) {
+        /* Binary search through map to find highest line_index <= index */
+        vindex = 0;
+        /* start step as the greatest power of 2 <= size */
+        step = 1;
+        while (step*2<=linemap->map_size)
+            step*=2;
+        while (step>0) {
+            if (vindex+step < linemap->map_size
+                    && linemap->map_vector[vindex+step].line <= line)
+                vindex += step;
+            step /= 2;
+        }
     }
+    linemap->map_last = vindex;
     mapping = &linemap->map_vector[vindex];
 
     *filename = mapping->filename;
+    *filename_id = mapping->filename_id;
     *file_line = (line ? mapping->file_line + mapping->line_inc*(line-mapping->line) : 0);
 }
 
+void
+yasm_linemap_lookup(yasm_linemap *linemap, unsigned long line,
+                    const char **filename, unsigned long *file_line)
+{
+    unsigned long filename_id;
+    yasm_linemap_lookup_id(linemap, line, filename, &filename_id, file_line);
+}
+
+unsigned long
+yasm_linemap_get_num_filenames(const yasm_linemap *linemap)
+{
+    return linemap->num_filenames;
+}
+
+typedef struct linemap_traverse_info {
+    /*@null@*/ void *d;
+    int (*func) (const char *filename, void *d);
+} linemap_traverse_info;
+
+static int
+linemap_traverse_filename(void *data, void *d)
+{
+    linemap_traverse_info *info = (linemap_traverse_info *)d;
+    return info->func(((line_filename *)data)->filename, info->d);
+}
+
 int
 yasm_linemap_traverse_filenames(yasm_linemap *linemap, /*@null@*/ void *d,
                                 int (*func) (const char *filename, void *d))
 {
-    return HAMT_traverse(linemap->filenames, d, (int (*) (void *, void *))func);
+    linemap_traverse_info info;
+
+    info.d = d;
+    info.func = func;
+    return HAMT_traverse(linemap->filenames, &info, linemap_traverse_filename);
 }
 
 int
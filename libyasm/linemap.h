@@ -125,6 +125,33 @@ void yasm_linemap_lookup(yasm_linemap *linemap, unsigned long line,
                          /*@out@*/ const char **filename,
                          /*@out@*/ unsigned long *file_line);
 
+/** Look up the associated physical file and line for a virtual line, also
+ * returning the interned filename ID.  Filename IDs are small integers
+ * (0 to yasm_linemap_get_num_filenames()-1) assigned in order of first use;
+ * two lookups return the same ID exactly when they return the same
+ * filename, so callers can index per-file tables by ID rather than hashing
+ * or comparing filename strings.  Lookups of nondecreasing virtual lines
+ * (e.g. for consecutive bytecodes) take constant time.
+ * \param linemap       line mapping repository
+ * \param line          virtual line
+ * \param filename      physical file name (output)
+ * \param filename_id   physical file name ID (output)
+ * \param file_line     physical line number (output)
+ */
+YASM_LIB_DECL
+void yasm_linemap_lookup_id(yasm_linemap *linemap, unsigned long line,
+                            /*@out@*/ const char **filename,
+                            /*@out@*/ unsigned long *filename_id,
+                            /*@out@*/ unsigned long *file_line);
+
+/** Get the number of distinct filenames (and thus filename IDs) used in a
+ * linemap.
+ * \param linemap       line mapping repository
+ * \return Number of filenames.
+ */
+YASM_LIB_DECL
+unsigned long yasm_linemap_get_num_filenames(const yasm_linemap *linemap);
+
 /** Traverses all filenames used in a linemap, calling a function on each
  * filename.
  * \param linemap       line mapping repository
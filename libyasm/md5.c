@@ -108,8 +108,7 @@ yasm_md5_update(yasm_md5_context *ctx, unsigned char const *buf,
         /* Process data in 64-byte chunks */
 
         while (len >= 64) {
-                memcpy(ctx->in, buf, 64);
-                yasm_md5_transform (ctx->buf, ctx->in);
+                yasm_md5_transform (ctx->buf, buf);
                 buf += 64;
                 len -= 64;
         }
@@ -91,7 +91,7 @@ struct yasm_objfmt_module {
     /** Module-level implementation of yasm_objfmt_output().
      * Call yasm_objfmt_output() instead of calling this function.
      */
-    void (*output) (yasm_object *o, FILE *f, int all_syms,
+    void (*output) (yasm_object *o, yasm_outsink *sink, int all_syms,
                     yasm_errwarns *errwarns);
 
     /** Module-level implementation of yasm_objfmt_destroy().
@@ -137,14 +137,14 @@ struct yasm_objfmt_module {
  * This function may call yasm_symrec_* functions as necessary (including
  * yasm_symrec_traverse()) to retrieve symbolic information.
  * \param object        object
- * \param f             output object file
+ * \param sink          output sink for the object file
  * \param all_syms      if nonzero, all symbols should be included in
  *                      the object file
  * \param errwarns      error/warning set
  * \note Errors and warnings are stored into errwarns.
  */
-void yasm_objfmt_output(yasm_object *object, FILE *f, int all_syms,
-                        yasm_errwarns *errwarns);
+void yasm_objfmt_output(yasm_object *object, yasm_outsink *sink,
+                        int all_syms, yasm_errwarns *errwarns);
 
 /** Cleans up any allocated object format memory.
  * \param objfmt        object format
@@ -193,9 +193,9 @@ void yasm_objfmt_init_new_section(yasm_object *object, unsigned long line);
 
 #define yasm_objfmt_create(module, object) module->create(object)
 
-#define yasm_objfmt_output(object, f, all_syms, ews) \
+#define yasm_objfmt_output(object, sink, all_syms, ews) \
     ((yasm_objfmt_base *)((object)->objfmt))->module->output \
-        (object, f, all_syms, ews)
+        (object, sink, all_syms, ews)
 #define yasm_objfmt_destroy(objfmt) \
     ((yasm_objfmt_base *)objfmt)->module->destroy(objfmt)
 #define yasm_objfmt_section_switch(object, vpms, oe_vpms, line) \
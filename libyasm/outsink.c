@@ -0,0 +1,420 @@
+/*
+ * Object file output sink
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/* Need fileno() (POSIX) to truncate streamed output */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "util.h"
+
+#if defined(HAVE_FTRUNCATE) && defined(HAVE_UNISTD_H)
+#include <unistd.h>
+#endif
+
+#include "coretype.h"
+#include "incfile.h"
+#include "outsink.h"
+
+
+#define OUTSINK_MINSIZE     4096    /* initial memory segment allocation */
+#define CHUNK_SIZE          65536   /* size of reads from included files */
+
+/* Part of a memory image: either data in memory or a range of an included
+ * file that's only read when the image is written out.  Segments are kept
+ * in order and together cover the whole image.
+ */
+typedef struct outsink_seg {
+    unsigned long pos;      /* position in image */
+    unsigned long len;      /* length in bytes */
+
+    /* Memory contents; NULL if from a file */
+    /*@null@*/ /*@only@*/ unsigned char *buf;
+    unsigned long max;      /* allocated size of buf */
+
+    /* File contents */
+    /*@null@*/ /*@dependent@*/ yasm_incfile *file;
+    unsigned long offset;   /* offset in file */
+} outsink_seg;
+
+struct yasm_outsink {
+    /*@null@*/ /*@dependent@*/ FILE *f;     /* output file; NULL if memory */
+
+    /* Memory image */
+    /*@null@*/ /*@only@*/ outsink_seg *segs;
+    unsigned long nsegs;    /* number of segments */
+    unsigned long maxsegs;  /* allocated size of segs */
+    unsigned long len;      /* length of image */
+    unsigned long pos;      /* current position */
+
+    int error;              /* nonzero if an error occurred */
+};
+
+static yasm_outsink *
+outsink_create(/*@null@*/ FILE *f)
+{
+    yasm_outsink *sink = yasm_xmalloc(sizeof(yasm_outsink));
+
+    sink->f = f;
+    sink->segs = NULL;
+    sink->nsegs = 0;
+    sink->maxsegs = 0;
+    sink->len = 0;
+    sink->pos = 0;
+    sink->error = 0;
+    return sink;
+}
+
+yasm_outsink *
+yasm_outsink_create_mem(void)
+{
+    return outsink_create(NULL);
+}
+
+yasm_outsink *
+yasm_outsink_create_file(FILE *f)
+{
+    return outsink_create(f);
+}
+
+void
+yasm_outsink_destroy(yasm_outsink *sink)
+{
+    unsigned long i;
+
+    for (i=0; i<sink->nsegs; i++) {
+        if (sink->segs[i].buf)
+            yasm_xfree(sink->segs[i].buf);
+    }
+    if (sink->segs)
+        yasm_xfree(sink->segs);
+    yasm_xfree(sink);
+}
+
+/* Add a new (empty) segment at the end of the image. */
+static outsink_seg *
+outsink_add_seg(yasm_outsink *sink)
+{
+    outsink_seg *seg;
+
+    if (sink->nsegs >= sink->maxsegs) {
+        sink->maxsegs = sink->maxsegs ? sink->maxsegs*2 : 4;
+        sink->segs = yasm_xrealloc(sink->segs,
+                                   sink->maxsegs*sizeof(outsink_seg));
+    }
+    seg = &sink->segs[sink->nsegs++];
+    seg->pos = sink->len;
+    seg->len = 0;
+    seg->buf = NULL;
+    seg->max = 0;
+    seg->file = NULL;
+    seg->offset = 0;
+    return seg;
+}
+
+/* Extend the image to end bytes and return the (memory) segment at its
+ * end.  Any gap between the old end and the current position is zeroed;
+ * the caller fills in the rest.
+ */
+static outsink_seg *
+outsink_extend(yasm_outsink *sink, unsigned long end)
+{
+    outsink_seg *seg = NULL;
+
+    if (sink->nsegs > 0 && !sink->segs[sink->nsegs-1].file)
+        seg = &sink->segs[sink->nsegs-1];
+    if (!seg || end - seg->pos > seg->max) {
+        unsigned long max;
+
+        if (!seg)
+            seg = outsink_add_seg(sink);
+        max = seg->max ? seg->max : OUTSINK_MINSIZE;
+        while (end - seg->pos > max)
+            max *= 2;
+        seg->buf = yasm_xrealloc(seg->buf, max);
+        seg->max = max;
+    }
+    if (sink->pos > sink->len)
+        memset(seg->buf + seg->len, 0, sink->pos - sink->len);
+    seg->len = end - seg->pos;
+    sink->len = end;
+    return seg;
+}
+
+/* Find the segment containing a position (which must be in the image). */
+static outsink_seg *
+outsink_find(yasm_outsink *sink, unsigned long pos)
+{
+    unsigned long lo = 0, hi = sink->nsegs-1;
+
+    while (lo < hi) {
+        unsigned long mid = (lo+hi+1)/2;
+        if (sink->segs[mid].pos <= pos)
+            lo = mid;
+        else
+            hi = mid-1;
+    }
+    return &sink->segs[lo];
+}
+
+/* Read the contents of a file segment into memory. */
+static void
+outsink_read_seg(yasm_outsink *sink, outsink_seg *seg)
+{
+    seg->buf = yasm_xmalloc(seg->len > 0 ? seg->len : 1);
+    seg->max = seg->len;
+    if (yasm_incfile_read(seg->file, seg->offset, seg->buf,
+                          (size_t)seg->len) != 0) {
+        memset(seg->buf, 0, seg->len);
+        sink->error = 1;
+    }
+    seg->file = NULL;
+}
+
+size_t
+yasm_outsink_write(yasm_outsink *sink, const void *buf, size_t len)
+{
+    const unsigned char *src = buf;
+    unsigned long end;
+
+    if (sink->f) {
+        size_t n = fwrite(buf, 1, len, sink->f);
+        if (n != len)
+            sink->error = 1;
+        return n;
+    }
+
+    if (len == 0)
+        return 0;
+
+    /* Overwrite whatever is already at pos, then extend the image */
+    end = sink->pos + (unsigned long)len;
+    while (sink->pos < end) {
+        outsink_seg *seg;
+        unsigned long n;
+
+        if (sink->pos >= sink->len)
+            seg = outsink_extend(sink, end);
+        else {
+            seg = outsink_find(sink, sink->pos);
+            if (seg->file)
+                outsink_read_seg(sink, seg);
+        }
+        n = seg->pos + seg->len - sink->pos;
+        if (n > end - sink->pos)
+            n = end - sink->pos;
+        memcpy(seg->buf + (sink->pos - seg->pos), src, n);
+        src += n;
+        sink->pos += n;
+    }
+    return len;
+}
+
+size_t
+yasm_outsink_write_file(yasm_outsink *sink, yasm_incfile *file,
+                        unsigned long offset, unsigned long len)
+{
+    outsink_seg *seg;
+
+    if (sink->f) {
+        if (yasm_incfile_copy(file, offset, len, sink->f) != 0) {
+            sink->error = 1;
+            return 0;
+        }
+        return len;
+    }
+
+    if (len == 0)
+        return 0;
+
+    if (sink->pos < sink->len) {
+        /* Overwriting part of the image; copy the data in */
+        unsigned char *buf = yasm_xmalloc(CHUNK_SIZE);
+        unsigned long left = len;
+
+        while (left > 0) {
+            size_t n = left > CHUNK_SIZE ? CHUNK_SIZE : (size_t)left;
+            if (yasm_incfile_read(file, offset, buf, n) != 0) {
+                sink->error = 1;
+                yasm_xfree(buf);
+                return len - left;
+            }
+            yasm_outsink_write(sink, buf, n);
+            offset += (unsigned long)n;
+            left -= (unsigned long)n;
+        }
+        yasm_xfree(buf);
+        return len;
+    }
+
+    /* Appending; just remember where the data comes from */
+    if (sink->pos > sink->len)
+        outsink_extend(sink, sink->pos);
+    seg = sink->nsegs > 0 ? &sink->segs[sink->nsegs-1] : NULL;
+    if (!seg || seg->file != file || seg->offset + seg->len != offset) {
+        seg = outsink_add_seg(sink);
+        seg->file = file;
+        seg->offset = offset;
+    }
+    seg->len += len;
+    sink->len += len;
+    sink->pos = sink->len;
+    return len;
+}
+
+int
+yasm_outsink_write_sink(yasm_outsink *sink, const yasm_outsink *src)
+{
+    unsigned long i;
+
+    for (i=0; i<src->nsegs; i++) {
+        const outsink_seg *seg = &src->segs[i];
+        if (seg->file)
+            yasm_outsink_write_file(sink, seg->file, seg->offset, seg->len);
+        else
+            yasm_outsink_write(sink, seg->buf, (size_t)seg->len);
+    }
+    return yasm_outsink_error(sink) || src->error;
+}
+
+long
+yasm_outsink_tell(yasm_outsink *sink)
+{
+    if (sink->f)
+        return ftell(sink->f);
+    return (long)sink->pos;
+}
+
+int
+yasm_outsink_seek(yasm_outsink *sink, long pos)
+{
+    if (sink->f)
+        return fseek(sink->f, pos, SEEK_SET);
+    if (pos < 0)
+        return -1;
+    sink->pos = (unsigned long)pos;
+    return 0;
+}
+
+int
+yasm_outsink_truncate(yasm_outsink *sink, unsigned long len)
+{
+    if (sink->f) {
+#if defined(HAVE_FTRUNCATE) && defined(HAVE_UNISTD_H)
+        if (fflush(sink->f) != 0)
+            return -1;
+        return ftruncate(fileno(sink->f), (off_t)len);
+#else
+        return -1;
+#endif
+    }
+    if (len < sink->len) {
+        while (sink->nsegs > 0 && sink->segs[sink->nsegs-1].pos >= len) {
+            outsink_seg *seg = &sink->segs[--sink->nsegs];
+            if (seg->buf)
+                yasm_xfree(seg->buf);
+        }
+        if (sink->nsegs > 0) {
+            outsink_seg *seg = &sink->segs[sink->nsegs-1];
+            seg->len = len - seg->pos;
+        }
+        sink->len = len;
+    }
+    return 0;
+}
+
+int
+yasm_outsink_error(const yasm_outsink *sink)
+{
+    if (sink->f)
+        return sink->error || ferror(sink->f);
+    return sink->error;
+}
+
+FILE *
+yasm_outsink_get_file(yasm_outsink *sink)
+{
+    return sink->f;
+}
+
+const unsigned char *
+yasm_outsink_get_image(yasm_outsink *sink, unsigned long *len)
+{
+    *len = sink->len;
+    if (sink->nsegs == 0)
+        return NULL;
+
+    /* Combine the segments into one */
+    if (sink->nsegs > 1 || sink->segs[0].file) {
+        unsigned char *buf = yasm_xmalloc(sink->len);
+        unsigned long i;
+
+        for (i=0; i<sink->nsegs; i++) {
+            outsink_seg *seg = &sink->segs[i];
+            if (!seg->file)
+                memcpy(buf + seg->pos, seg->buf, seg->len);
+            else if (yasm_incfile_read(seg->file, seg->offset,
+                                       buf + seg->pos,
+                                       (size_t)seg->len) != 0) {
+                memset(buf + seg->pos, 0, seg->len);
+                sink->error = 1;
+            }
+            if (seg->buf)
+                yasm_xfree(seg->buf);
+        }
+        sink->nsegs = 1;
+        sink->segs[0].pos = 0;
+        sink->segs[0].len = sink->len;
+        sink->segs[0].buf = buf;
+        sink->segs[0].max = sink->len;
+        sink->segs[0].file = NULL;
+    }
+    return sink->segs[0].buf;
+}
+
+int
+yasm_outsink_write_to_file(const yasm_outsink *sink, FILE *f)
+{
+    unsigned long i;
+
+    if (sink->f || sink->len == 0)
+        return yasm_outsink_error(sink);
+
+    /* Flush anything already buffered so that the image goes out in large
+     * writes rather than being copied through the stdio buffer.
+     */
+    if (fflush(f) != 0)
+        return 1;
+    for (i=0; i<sink->nsegs; i++) {
+        const outsink_seg *seg = &sink->segs[i];
+        if (seg->file) {
+            if (yasm_incfile_copy(seg->file, seg->offset, seg->len, f) != 0)
+                return 1;
+        } else if (fwrite(seg->buf, 1, seg->len, f) != seg->len)
+            return 1;
+    }
+    return sink->error;
+}
@@ -0,0 +1,158 @@
+/**
+ * \file libyasm/outsink.h
+ * \brief YASM object file output sink interface.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_OUTSINK_H
+#define YASM_OUTSINK_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/** Create an output sink that assembles the output in a growable memory
+ * image.  Seeking is free and writing past the end of the image zero-fills
+ * the gap, just as with a file.  The image can be retrieved with
+ * yasm_outsink_get_image() or written out with
+ * yasm_outsink_write_to_file().
+ * \return Newly allocated output sink.
+ */
+YASM_LIB_DECL
+/*@only@*/ yasm_outsink *yasm_outsink_create_mem(void);
+
+/** Create an output sink that streams directly to a file.  Best suited to
+ * output whose layout is known in advance, as every seek flushes the stdio
+ * buffer.
+ * \param f     output file; not closed by yasm_outsink_destroy()
+ * \return Newly allocated output sink.
+ */
+YASM_LIB_DECL
+/*@only@*/ yasm_outsink *yasm_outsink_create_file(FILE *f);
+
+/** Destroy an output sink, freeing its memory image (if any).
+ * \param sink      output sink
+ */
+YASM_LIB_DECL
+void yasm_outsink_destroy(/*@only@*/ yasm_outsink *sink);
+
+/** Write data at the current position of an output sink.
+ * \param sink      output sink
+ * \param buf       data
+ * \param len       length of data in bytes
+ * \return Number of bytes written (len unless an error occurred).
+ */
+YASM_LIB_DECL
+size_t yasm_outsink_write(yasm_outsink *sink, const void *buf, size_t len);
+
+/** Write part of an included file at the current position of an output
+ * sink.  A streaming output sink copies the data straight away (see
+ * yasm_incfile_copy()).  A memory output sink appending to its image only
+ * records where the data comes from; it is not read until the image is
+ * written out with yasm_outsink_write_to_file().
+ * \param sink      output sink
+ * \param file      included file
+ * \param offset    offset in file of data
+ * \param len       length of data in bytes
+ * \return Number of bytes written (len unless an error occurred).
+ */
+YASM_LIB_DECL
+size_t yasm_outsink_write_file(yasm_outsink *sink, yasm_incfile *file,
+                               unsigned long offset, unsigned long len);
+
+/** Write the image of a memory output sink at the current position of
+ * another output sink.  Included file data is passed on without being read
+ * where possible (see yasm_outsink_write_file()).
+ * \param sink      output sink
+ * \param src       memory output sink
+ * \return 0 on success, nonzero if a write error occurred (either now or
+ *         earlier on either sink).
+ */
+YASM_LIB_DECL
+int yasm_outsink_write_sink(yasm_outsink *sink, const yasm_outsink *src);
+
+/** Get the current position of an output sink.
+ * \param sink      output sink
+ * \return Current position, or -1 on error (just like ftell()).
+ */
+YASM_LIB_DECL
+long yasm_outsink_tell(yasm_outsink *sink);
+
+/** Set the current position of an output sink, relative to the start of
+ * the output.
+ * \param sink      output sink
+ * \param pos       new position
+ * \return 0 on success, -1 on error (just like fseek()).
+ */
+YASM_LIB_DECL
+int yasm_outsink_seek(yasm_outsink *sink, long pos);
+
+/** Truncate the output of an output sink.  The current position is not
+ * changed.  Streaming output sinks can only be truncated if the platform
+ * supports ftruncate().
+ * \param sink      output sink
+ * \param len       new length of output in bytes
+ * \return 0 on success, -1 on error.
+ */
+YASM_LIB_DECL
+int yasm_outsink_truncate(yasm_outsink *sink, unsigned long len);
+
+/** Determine if an error has occurred when writing to an output sink.
+ * \param sink      output sink
+ * \return Nonzero if an error has occurred.
+ */
+YASM_LIB_DECL
+int yasm_outsink_error(const yasm_outsink *sink);
+
+/** Get the file a streaming output sink writes to.
+ * \param sink      output sink
+ * \return File, or NULL if the sink is a memory image.
+ */
+YASM_LIB_DECL
+/*@null@*/ /*@dependent@*/ FILE *yasm_outsink_get_file(yasm_outsink *sink);
+
+/** Get the memory image of a memory output sink.  Any included file data
+ * in the image is read into memory.
+ * \param sink      output sink
+ * \param len       (returned) length of image in bytes
+ * \return Image (NULL if empty or if the sink streams to a file).  Only
+ *         valid until the next write to the sink.
+ */
+YASM_LIB_DECL
+/*@null@*/ /*@dependent@*/ const unsigned char *yasm_outsink_get_image
+    (yasm_outsink *sink, /*@out@*/ unsigned long *len);
+
+/** Write the memory image of a memory output sink to a file, using as few
+ * write calls as possible.  Does nothing for a streaming output sink.
+ * \param sink      output sink
+ * \param f         output file
+ * \return 0 on success, nonzero if a write error occurred (either now or
+ *         earlier on the sink).
+ */
+YASM_LIB_DECL
+int yasm_outsink_write_to_file(const yasm_outsink *sink, FILE *f);
+
+#endif
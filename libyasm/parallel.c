@@ -0,0 +1,162 @@
+/*
+ * Worker threads
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util.h"
+
+#ifdef YASM_HAVE_THREADS
+#include <pthread.h>
+#endif
+
+#include "coretype.h"
+#include "arena.h"
+#include "errwarn.h"
+#include "intnum.h"
+#include "parallel.h"
+
+
+#ifdef YASM_HAVE_THREADS
+typedef struct parallel_data {
+    pthread_mutex_t mutex;
+    unsigned long next_job;
+    unsigned long njobs;
+    void *d;
+    yasm_parallel_func func;
+    unsigned long warn_suppressed;  /* caller's suppressed warnings */
+} parallel_data;
+
+typedef struct parallel_thread_data {
+    parallel_data *pd;
+    /*@null@*/ yasm_arena *arena;   /* child of the caller's arena */
+} parallel_thread_data;
+
+/* Run jobs until there are none left. */
+static void
+parallel_work(parallel_data *pd)
+{
+    for (;;) {
+        unsigned long job;
+
+        pthread_mutex_lock(&pd->mutex);
+        job = pd->next_job;
+        if (job < pd->njobs)
+            pd->next_job++;
+        pthread_mutex_unlock(&pd->mutex);
+
+        if (job >= pd->njobs)
+            break;
+        pd->func(job, pd->d);
+    }
+}
+
+static void *
+parallel_thread(void *arg)
+{
+    parallel_thread_data *ptd = (parallel_thread_data *)arg;
+
+    /* Per-thread libyasm state */
+    yasm_intnum_initialize();
+    yasm_errwarn_thread_initialize();
+    yasm_arena_set_current(ptd->arena);
+    yasm_warn_set_suppressed(ptd->pd->warn_suppressed);
+
+    parallel_work(ptd->pd);
+
+    /* Jobs should have propagated everything, but don't leak if not */
+    yasm_error_clear();
+    yasm_warn_clear();
+    yasm_intnum_cleanup();
+    return NULL;
+}
+#endif
+
+int
+yasm_parallel_supported(void)
+{
+#ifdef YASM_HAVE_THREADS
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void
+yasm_parallel_run(unsigned int nthreads, unsigned long njobs, void *d,
+                  yasm_parallel_func func)
+{
+#ifdef YASM_HAVE_THREADS
+    parallel_data pd;
+    parallel_thread_data *ptd;
+    pthread_t *threads;
+    yasm_arena *arena;
+    unsigned int i, started = 0;
+#endif
+    unsigned long job;
+
+#ifdef YASM_HAVE_THREADS
+    if (nthreads > njobs)
+        nthreads = (unsigned int)njobs;
+    if (nthreads > 1) {
+        pthread_mutex_init(&pd.mutex, NULL);
+        pd.next_job = 0;
+        pd.njobs = njobs;
+        pd.d = d;
+        pd.func = func;
+        pd.warn_suppressed = yasm_warn_get_suppressed();
+
+        /* The calling thread is one of the workers.  The others allocate
+         * from children of its arena, so that they don't need to lock it.
+         */
+        arena = yasm_arena_get_current();
+        threads = yasm_xmalloc((nthreads-1)*sizeof(pthread_t));
+        ptd = yasm_xmalloc((nthreads-1)*sizeof(parallel_thread_data));
+        for (i=0; i<nthreads-1; i++) {
+            ptd[started].pd = &pd;
+            ptd[started].arena =
+                arena ? yasm_arena_create_child(arena) : NULL;
+            if (pthread_create(&threads[started], NULL, parallel_thread,
+                               &ptd[started]) == 0)
+                started++;
+            else if (ptd[started].arena)
+                yasm_arena_merge(ptd[started].arena);
+        }
+
+        parallel_work(&pd);
+
+        for (i=0; i<started; i++) {
+            pthread_join(threads[i], NULL);
+            if (ptd[i].arena)
+                yasm_arena_merge(ptd[i].arena);
+        }
+        yasm_xfree(ptd);
+        yasm_xfree(threads);
+        pthread_mutex_destroy(&pd.mutex);
+        return;
+    }
+#endif
+
+    for (job=0; job<njobs; job++)
+        func(job, d);
+}
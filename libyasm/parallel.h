@@ -0,0 +1,66 @@
+/**
+ * \file libyasm/parallel.h
+ * \brief YASM worker thread interface.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_PARALLEL_H
+#define YASM_PARALLEL_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/** Function run for each job by yasm_parallel_run().
+ * \param job   job number (0 to njobs-1)
+ * \param d     data pointer passed to yasm_parallel_run()
+ */
+typedef void (*yasm_parallel_func) (unsigned long job, /*@null@*/ void *d);
+
+/** Determine if worker threads are supported by this build of libyasm.
+ * \return Nonzero if yasm_parallel_run() can use more than one thread.
+ */
+YASM_LIB_DECL
+int yasm_parallel_supported(void);
+
+/** Run a set of independent jobs on up to nthreads threads (including the
+ * calling thread).  Jobs are handed out in increasing job number order, but
+ * may complete in any order; the function returns when all jobs have
+ * completed.  Each thread has its own error/warning indicators and intnum
+ * scratch space, so jobs must propagate any errors or warnings into a
+ * per-job #yasm_errwarns before returning.
+ * \param nthreads  maximum number of threads to use; if 1 or less, or if
+ *                  threads are not supported, all jobs are run in order in
+ *                  the calling thread
+ * \param njobs     number of jobs
+ * \param d         data pointer passed to func
+ * \param func      function to call for each job
+ */
+YASM_LIB_DECL
+void yasm_parallel_run(unsigned int nthreads, unsigned long njobs,
+                       /*@null@*/ void *d, yasm_parallel_func func);
+
+#endif
@@ -40,6 +40,14 @@ typedef struct yasm_preproc_base {
 } yasm_preproc_base;
 #endif
 
+/** Function called by yasm_preproc_get_stats() for each statistic.
+ * \param name      statistic name
+ * \param value     statistic value
+ * \param d         data pointer passed to yasm_preproc_get_stats()
+ */
+typedef void (*yasm_preproc_stat_func) (const char *name, unsigned long value,
+                                        /*@null@*/ void *d);
+
 /** YASM preprocesor module interface. */
 typedef struct yasm_preproc_module {
     /** One-line description of the preprocessor. */
@@ -106,6 +114,39 @@ typedef struct yasm_preproc_module {
      * Call yasm_preproc_add_standard() instead of calling this function.
      */
     void (*add_standard) (yasm_preproc *preproc, const char **macros);
+
+    /** Module-level implementation of yasm_preproc_get_stats().
+     * Call yasm_preproc_get_stats() instead of calling this function.
+     * May be NULL if the preprocessor keeps no statistics.
+     */
+    void (*get_stats) (yasm_preproc *preproc, yasm_preproc_stat_func func,
+                       /*@null@*/ void *d);
+
+    /** Create preprocessor reading the initial source from memory.
+     * Module-level implementation of yasm_preproc_create_mem().
+     * Call yasm_preproc_create_mem() instead of calling this function.
+     * May be NULL if the preprocessor can only read from files.
+     *
+     * \param in_filename       name of the source, used for line info
+     * \param buf               source text; not copied, so must remain
+     *                          valid until the preprocessor is destroyed
+     * \param len               length of source text in bytes
+     * \param symtab            symbol table (may be NULL if none)
+     * \param lm                line mapping repository
+     * \param errwarns          error/warnning set.
+     * \return New preprocessor.
+     */
+    /*@only@*/ yasm_preproc * (*create_mem) (const char *in_filename,
+                                             const char *buf, size_t len,
+                                             yasm_symtab *symtab,
+                                             yasm_linemap *lm,
+                                             yasm_errwarns *errwarns);
+
+    /** Module-level implementation of yasm_preproc_set_macro_cache().
+     * Call yasm_preproc_set_macro_cache() instead of calling this function.
+     * May be NULL if the preprocessor cannot cache macro definitions.
+     */
+    void (*set_macro_cache) (yasm_preproc *preproc, const char *filename);
 } yasm_preproc_module;
 
 /** Initialize preprocessor.
@@ -123,6 +164,24 @@ typedef struct yasm_preproc_module {
     (yasm_preproc_module *module, const char *in_filename,
      yasm_symtab *symtab, yasm_linemap *lm, yasm_errwarns *errwarns);
 
+/** Initialize preprocessor, reading the initial source from memory.
+ * Only available if the module's create_mem member is non-NULL.
+ * \param module        preprocessor module
+ * \param in_filename   name of the source, used for line info
+ * \param buf           source text (must remain valid until the
+ *                      preprocessor is destroyed)
+ * \param len           length of source text in bytes
+ * \param symtab        symbol table (may be NULL if none)
+ * \param lm            line mapping repository
+ * \param errwarns      error/warning set
+ * \return New preprocessor.
+ * \note Errors/warnings are stored into errwarns.
+ */
+/*@only@*/ yasm_preproc *yasm_preproc_create_mem
+    (yasm_preproc_module *module, const char *in_filename, const char *buf,
+     size_t len, yasm_symtab *symtab, yasm_linemap *lm,
+     yasm_errwarns *errwarns);
+
 /** Cleans up any allocated preproc memory.
  * \param preproc       preprocessor
  */
@@ -178,12 +237,36 @@ void yasm_preproc_define_builtin(yasm_preproc *preproc,
 void yasm_preproc_add_standard(yasm_preproc *preproc,
                                const char **macros);
 
+/** Get internal statistics (table sizes, lookup counts, etc) from a
+ * preprocessor, for debugging and tuning.  Does nothing if the
+ * preprocessor keeps no statistics.
+ * \param preproc       preprocessor
+ * \param func          function to call for each statistic
+ * \param d             data pointer passed to func
+ */
+void yasm_preproc_get_stats(yasm_preproc *preproc,
+                            yasm_preproc_stat_func func, /*@null@*/ void *d);
+
+/** Set a file in which to cache the macros defined by the builtins,
+ * standard macros, predefines and pre-included files, so they need not be
+ * processed again by later runs with the same settings.  The cache is
+ * checked (and used, or rewritten) when the first line is read.  Does
+ * nothing if the preprocessor cannot cache macro definitions.
+ * \param preproc       preprocessor
+ * \param filename      cache file name
+ */
+void yasm_preproc_set_macro_cache(yasm_preproc *preproc,
+                                  const char *filename);
+
 #ifndef YASM_DOXYGEN
 
 /* Inline macro implementations for preproc functions */
 
 #define yasm_preproc_create(module, in_filename, symtab, lm, ews) \
     module->create(in_filename, symtab, lm, ews)
+#define yasm_preproc_create_mem(module, in_filename, buf, len, symtab, lm, \
+                                ews) \
+    module->create_mem(in_filename, buf, len, symtab, lm, ews)
 
 #define yasm_preproc_destroy(preproc) \
     ((yasm_preproc_base *)preproc)->module->destroy(preproc)
@@ -204,6 +287,18 @@ void yasm_preproc_add_standard(yasm_preproc *preproc,
 #define yasm_preproc_add_standard(preproc, macros) \
     ((yasm_preproc_base *)preproc)->module->add_standard(preproc, \
                                                          macros)
+#define yasm_preproc_get_stats(preproc, func, d) \
+    do { \
+        if (((yasm_preproc_base *)preproc)->module->get_stats) \
+            ((yasm_preproc_base *)preproc)->module->get_stats(preproc, \
+                                                              func, d); \
+    } while (0)
+#define yasm_preproc_set_macro_cache(preproc, filename) \
+    do { \
+        if (((yasm_preproc_base *)preproc)->module->set_macro_cache) \
+            ((yasm_preproc_base *)preproc)->module->set_macro_cache( \
+                preproc, filename); \
+    } while (0)
 
 #endif
 
@@ -30,6 +30,7 @@
 
 #include "libyasm-stdint.h"
 #include "coretype.h"
+#include "arena.h"
 #include "hamt.h"
 #include "valparam.h"
 #include "assocdat.h"
@@ -44,6 +45,8 @@
 #include "bytecode.h"
 #include "arch.h"
 #include "section.h"
+#include "parallel.h"
+#include "incfile.h"
 
 #include "dbgfmt.h"
 #include "objfmt.h"
@@ -73,10 +76,19 @@ struct yasm_section {
     /* the bytecodes for the section's contents */
     /*@reldef@*/ STAILQ_HEAD(yasm_bytecodehead, yasm_bytecode) bcs;
 
-    /* the relocations for the section */
-    /*@reldef@*/ STAILQ_HEAD(yasm_relochead, yasm_reloc) relocs;
-
-    void (*destroy_reloc) (/*@only@*/ void *reloc);
+    /* the relocations for the section, stored contiguously; all are
+     * reloc_size bytes (set by the first yasm_section_add_reloc())
+     */
+    /*@null@*/ /*@only@*/ unsigned char *relocs;
+    size_t reloc_size;
+    unsigned long num_relocs, max_relocs;
+    int relocs_sorted;          /* relocs are in order of address? */
+
+    /* First bytecode (lowest bc_index) whose length has changed since the
+     * optimizer last updated offsets in this section; NULL if all offsets
+     * are current.  Only used during yasm_object_optimize().
+     */
+    /*@null@*/ /*@dependent@*/ yasm_bytecode *opt_dirty;
 };
 
 static void yasm_section_destroy(/*@only@*/ yasm_section *sect);
@@ -219,6 +231,10 @@ yasm_object_create(const char *src_filename, const char *obj_filename,
     yasm_object *object = yasm_xmalloc(sizeof(yasm_object));
     int matched, i;
 
+    /* Everything from here on is allocated from the object's arena */
+    object->arena = yasm_arena_create();
+    yasm_arena_set_current(object->arena);
+
     object->src_filename = yasm__xstrdup(src_filename);
     object->obj_filename = yasm__xstrdup(obj_filename);
 
@@ -235,12 +251,25 @@ yasm_object_create(const char *src_filename, const char *obj_filename,
     /* Create directives HAMT */
     object->directives = HAMT_create(1, yasm_internal_error_);
 
+    /* No files included yet */
+    object->incfiles = yasm_incfile_cache_create();
+
     /* Initialize the target architecture */
     object->arch = arch;
 
     /* Initialize things to NULL in case of error */
     object->dbgfmt = NULL;
 
+    /* Default to incremental optimization */
+    object->optimize_full = 0;
+    object->threads = 0;
+    object->strtab_tail_merge = 0;
+    object->sort_relocs = 0;
+    object->optimize_stats.bytecodes = 0;
+    object->optimize_stats.spans = 0;
+    object->optimize_stats.expansions = 0;
+    object->optimize_stats.iterations = 0;
+
     /* Initialize the object format */
     object->objfmt = yasm_objfmt_create(objfmt_module, object);
     if (!object->objfmt) {
@@ -342,12 +371,16 @@ yasm_object_get_general(yasm_object *object, const char *name,
     STAILQ_INSERT_TAIL(&s->bcs, bc, link);
 
     /* Initialize relocs */
-    STAILQ_INIT(&s->relocs);
-    s->destroy_reloc = NULL;
+    s->relocs = NULL;
+    s->reloc_size = 0;
+    s->num_relocs = 0;
+    s->max_relocs = 0;
+    s->relocs_sorted = 1;
 
     s->code = code;
     s->res_only = res_only;
     s->def = 0;
+    s->opt_dirty = NULL;
 
     /* Initialize object format specific data */
     yasm_objfmt_init_new_section(s, line);
@@ -485,10 +518,14 @@ yasm_object_destroy(yasm_object *object)
     /* Delete symbol table */
     yasm_symtab_destroy(object->symtab);
 
+    /* Close included files */
+    yasm_incfile_cache_destroy(object->incfiles);
+
     /* Delete architecture */
     if (object->arch)
         yasm_arch_destroy(object->arch);
 
+    yasm_arena_destroy(object->arena);
     yasm_xfree(object);
 }
 
@@ -562,33 +599,88 @@ yasm_object_find_general(yasm_object *object, const char *name)
 }
 /*@=onlytrans@*/
 
-void
-yasm_section_add_reloc(yasm_section *sect, yasm_reloc *reloc,
-                       void (*destroy_func) (/*@only@*/ void *reloc))
+yasm_reloc *
+yasm_section_add_reloc(yasm_section *sect, const yasm_reloc *reloc,
+                       size_t size)
+{
+    yasm_reloc *copy;
+
+    if (sect->reloc_size == 0) {
+        if (size < sizeof(yasm_reloc))
+            yasm_internal_error(N_("relocation size too small"));
+        sect->reloc_size = size;
+    } else if (size != sect->reloc_size)
+        yasm_internal_error(
+            N_("different relocation size given to add_reloc"));
+
+    if (sect->num_relocs >= sect->max_relocs) {
+        sect->max_relocs = sect->max_relocs ? sect->max_relocs*2 : 16;
+        sect->relocs = yasm_xrealloc(sect->relocs,
+                                     sect->max_relocs*sect->reloc_size);
+    }
+    copy = (yasm_reloc *)(sect->relocs + sect->num_relocs*sect->reloc_size);
+    if (sect->num_relocs > 0 &&
+        reloc->addr < ((yasm_reloc *)(sect->relocs +
+            (sect->num_relocs-1)*sect->reloc_size))->addr)
+        sect->relocs_sorted = 0;
+    memcpy(copy, reloc, size);
+    sect->num_relocs++;
+    return copy;
+}
+
+/*@null@*/ yasm_reloc *
+yasm_section_relocs(yasm_section *sect, unsigned long *nrelocsp)
 {
-    STAILQ_INSERT_TAIL(&sect->relocs, reloc, link);
-    if (!destroy_func)
-        yasm_internal_error(N_("NULL destroy function given to add_reloc"));
-    else if (sect->destroy_reloc && destroy_func != sect->destroy_reloc)
-        yasm_internal_error(N_("different destroy function given to add_reloc"));
-    sect->destroy_reloc = destroy_func;
+    *nrelocsp = sect->num_relocs;
+    if (sect->num_relocs == 0)
+        return NULL;
+    return (yasm_reloc *)sect->relocs;
 }
 
 /*@null@*/ yasm_reloc *
 yasm_section_relocs_first(yasm_section *sect)
 {
-    return STAILQ_FIRST(&sect->relocs);
+    if (sect->num_relocs == 0)
+        return NULL;
+    return (yasm_reloc *)sect->relocs;
 }
 
-#undef yasm_section_reloc_next
 /*@null@*/ yasm_reloc *
-yasm_section_reloc_next(yasm_reloc *reloc)
+yasm_section_reloc_next(yasm_section *sect, yasm_reloc *reloc)
+{
+    unsigned char *next = (unsigned char *)reloc + sect->reloc_size;
+    if (next >= sect->relocs + sect->num_relocs*sect->reloc_size)
+        return NULL;
+    return (yasm_reloc *)next;
+}
+
+static int
+reloc_compare_addr(const void *a, const void *b)
+{
+    unsigned long addr_a = ((const yasm_reloc *)a)->addr;
+    unsigned long addr_b = ((const yasm_reloc *)b)->addr;
+
+    if (addr_a < addr_b)
+        return -1;
+    return addr_a > addr_b;
+}
+
+void
+yasm_section_sort_relocs(yasm_section *sect)
 {
-    return STAILQ_NEXT(reloc, link);
+    if (sect->relocs_sorted)
+        return;
+    /* mergesort is stable, so relocations at the same address (e.g. pairs)
+     * stay in the order they were added.
+     */
+    if (yasm__mergesort(sect->relocs, sect->num_relocs, sect->reloc_size,
+                        reloc_compare_addr) != 0)
+        yasm_internal_error(N_("could not sort relocations"));
+    sect->relocs_sorted = 1;
 }
 
 void
-yasm_reloc_get(yasm_reloc *reloc, yasm_intnum **addrp, yasm_symrec **symp)
+yasm_reloc_get(yasm_reloc *reloc, unsigned long *addrp, yasm_symrec **symp)
 {
     *addrp = reloc->addr;
     *symp = reloc->sym;
@@ -616,7 +708,7 @@ yasm_section_bcs_append(yasm_section *sect, yasm_bytecode *bc)
             STAILQ_INSERT_TAIL(&sect->bcs, bc, link);
             return bc;
         } else
-            yasm_xfree(bc);
+            yasm_arena_free(bc);
     }
     return (yasm_bytecode *)NULL;
 }
@@ -667,7 +759,6 @@ static void
 yasm_section_destroy(yasm_section *sect)
 {
     yasm_bytecode *cur, *next;
-    yasm_reloc *r_cur, *r_next;
 
     if (!sect)
         return;
@@ -684,13 +775,8 @@ yasm_section_destroy(yasm_section *sect)
     }
 
     /* Delete relocations */
-    r_cur = STAILQ_FIRST(&sect->relocs);
-    while (r_cur) {
-        r_next = STAILQ_NEXT(r_cur, link);
-        yasm_intnum_destroy(r_cur->addr);
-        sect->destroy_reloc(r_cur);
-        r_cur = r_next;
-    }
+    if (sect->relocs)
+        yasm_xfree(sect->relocs);
 
     yasm_xfree(sect);
 }
@@ -820,6 +906,21 @@ yasm_section_print(const yasm_section *sect, FILE *f, int indent_level,
  *       If span exceeds long threshold (or is flagged to recalculate on any
  *       change), add it to tail of Q.
  * 3. Final pass over bytecodes to generate final offsets.
+ *
+ * Incremental updates:
+ *
+ * Unless object->optimize_full is set, the offset passes in 1c and 3 only
+ * walk each section from the first bytecode whose length has changed since
+ * offsets were last computed (tracked per section in opt_dirty), and
+ * sections with no changes are skipped entirely.  Similarly, 1d only
+ * recomputes the absolute terms of spans whose term intervals contain a
+ * bytecode that changed length in 1b or 1c (found by binary search of the
+ * sorted list of changed bytecodes).  Spans whose terms were created in 1b
+ * after one of the term endpoints had already changed length (and thus mix
+ * old offsets with new lengths) are also recomputed.  Spans that are not
+ * recomputed keep the values calculated in 1b, which are exactly what a
+ * full recomputation would produce.  Spans with only a relative term are
+ * cheap enough to always recompute.
  */
 
 typedef struct yasm_span yasm_span;
@@ -866,6 +967,9 @@ struct yasm_span {
 
     int active;
 
+    /* Set if span terms need to be recomputed in step 1d */
+    int dirty;
+
     /* NULL-terminated array of spans that led to this span.  Used only for
      * checking for circular references (cycles) with id=0 spans.
      */
@@ -885,13 +989,30 @@ typedef struct optimize_data {
     long len_diff;      /* used only for optimize_term_expand */
     yasm_span *span;    /* used only for check_cycle */
     yasm_offset_setter *os;
+
+    int full;           /* recompute all offsets and spans (no incremental) */
+
+    /* Sections being optimized (for offset updates); NULL for all sections
+     * in the object.
+     */
+    /*@null@*/ /*@only@*/ yasm_section **sects;
+    size_t num_sects;
+
+    /* Bytecodes that changed length during step 1.  Changes made in 1b
+     * are appended in bc_index order; the whole list is sorted before 1d.
+     */
+    /*@only@*/ yasm_bytecode **changed;
+    size_t num_changed, max_changed;
+
+    /* Statistics; added to the object's optimize_stats on cleanup */
+    unsigned long num_bytecodes, num_spans, num_expansions, num_iterations;
 } optimize_data;
 
 static yasm_span *
 create_span(yasm_bytecode *bc, int id, /*@null@*/ const yasm_value *value, 
             long neg_thres, long pos_thres, yasm_offset_setter *os)
 {
-    yasm_span *span = yasm_xmalloc(sizeof(yasm_span));
+    yasm_span *span = yasm_arena_alloc(sizeof(yasm_span));
 
     span->bc = bc;
     if (value)
@@ -908,6 +1029,7 @@ create_span(yasm_bytecode *bc, int id, /*@null@*/ const yasm_value *value,
     span->pos_thres = pos_thres;
     span->id = id;
     span->active = 1;
+    span->dirty = 0;
     span->backtrace = NULL;
     span->backtrace_size = 0;
     span->os = os;
@@ -923,6 +1045,7 @@ optimize_add_span(void *add_span_data, yasm_bytecode *bc, int id,
     yasm_span *span;
     span = create_span(bc, id, value, neg_thres, pos_thres, optd->os);
     TAILQ_INSERT_TAIL(&optd->spans, span, link);
+    optd->num_spans++;
 }
 
 static void
@@ -935,8 +1058,9 @@ add_span_term(unsigned int subst, yasm_bytecode *precbc,
     if (subst >= span->num_terms) {
         /* Linear expansion since total number is essentially always small */
         span->num_terms = subst+1;
-        span->terms = yasm_xrealloc(span->terms,
-                                    span->num_terms*sizeof(yasm_span_term));
+        span->terms =
+            yasm_arena_realloc(span->terms,
+                               span->num_terms*sizeof(yasm_span_term));
     }
     span->terms[subst].precbc = precbc;
     span->terms[subst].precbc2 = precbc2;
@@ -961,7 +1085,8 @@ span_create_terms(yasm_span *span)
         span->num_terms = yasm_expr__bc_dist_subst(&span->depval.abs, span,
                                                    add_span_term);
         if (span->num_terms > 0) {
-            span->items = yasm_xmalloc(span->num_terms*sizeof(yasm_expr__item));
+            span->items =
+                yasm_arena_alloc(span->num_terms*sizeof(yasm_expr__item));
             for (i=0; i<span->num_terms; i++) {
                 /* Create items with dummy value */
                 span->items[i].type = YASM_EXPR_INT;
@@ -993,7 +1118,7 @@ span_create_terms(yasm_span *span)
         if (!span->depval.curpos_rel)
             return;     /* not PC-relative */
 
-        span->rel_term = yasm_xmalloc(sizeof(yasm_span_term));
+        span->rel_term = yasm_arena_alloc(sizeof(yasm_span_term));
         span->rel_term->precbc = NULL;
         span->rel_term->precbc2 = rel_precbc;
         span->rel_term->span = span;
@@ -1050,42 +1175,130 @@ recalc_normal_span(yasm_span *span)
             || span->new_val > span->pos_thres);
 }
 
-/* Updates all bytecode offsets.  For offset-based bytecodes, calls expand
- * to determine new length.
+/* Marks bc as having changed length, so offsets following it need to be
+ * updated.
+ */
+static void
+optimize_mark_dirty(yasm_bytecode *bc)
+{
+    yasm_section *sect = bc->section;
+
+    if (!sect->opt_dirty || bc->bc_index < sect->opt_dirty->bc_index)
+        sect->opt_dirty = bc;
+}
+
+/* Records bc as having changed length during step 1. */
+static void
+optimize_add_changed(optimize_data *optd, yasm_bytecode *bc)
+{
+    if (optd->num_changed >= optd->max_changed) {
+        optd->max_changed = optd->max_changed ? optd->max_changed*2 : 64;
+        optd->changed = yasm_xrealloc(optd->changed,
+            optd->max_changed*sizeof(yasm_bytecode *));
+    }
+    optd->changed[optd->num_changed++] = bc;
+}
+
+/* Determines if any bytecode with bc_index in [low,high] is in the sorted
+ * changed list.
  */
 static int
-update_all_bc_offsets(yasm_object *object, yasm_errwarns *errwarns)
+optimize_changed_in(const optimize_data *optd, unsigned long low,
+                    unsigned long high)
 {
-    yasm_section *sect;
-    int saw_error = 0;
+    size_t lo = 0, hi = optd->num_changed;
 
-    STAILQ_FOREACH(sect, &object->sections, link) {
-        unsigned long offset = 0;
+    /* Find first changed bytecode with bc_index >= low */
+    while (lo < hi) {
+        size_t mid = lo + (hi-lo)/2;
+        if (optd->changed[mid]->bc_index < low)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return (lo < optd->num_changed && optd->changed[lo]->bc_index <= high);
+}
+
+static int
+optimize_changed_compare(const void *a, const void *b)
+{
+    const yasm_bytecode *bca = *(yasm_bytecode * const *)a;
+    const yasm_bytecode *bcb = *(yasm_bytecode * const *)b;
+
+    if (bca->bc_index < bcb->bc_index)
+        return -1;
+    if (bca->bc_index > bcb->bc_index)
+        return 1;
+    return 0;
+}
 
-        yasm_bytecode *bc = STAILQ_FIRST(&sect->bcs);
-        yasm_bytecode *prevbc;
+/* Updates bytecode offsets.  For offset-based bytecodes, calls expand
+ * to determine new length.  Unless doing a full update, only offsets
+ * following the first changed bytecode in each section are updated.
+ * If record is nonzero, offset-based bytecodes that change length are
+ * added to the changed list.
+ */
+static int
+update_sect_offsets(yasm_section *sect, optimize_data *optd,
+                    yasm_errwarns *errwarns, int record)
+{
+    unsigned long offset;
+    yasm_bytecode *bc;
+    int saw_error = 0;
 
+    if (optd->full) {
         /* Skip our locally created empty bytecode first. */
-        prevbc = bc;
+        bc = STAILQ_NEXT(STAILQ_FIRST(&sect->bcs), link);
+        offset = 0;
+    } else {
+        /* Everything before the first changed bytecode is current. */
+        bc = sect->opt_dirty;
+        if (!bc)
+            return 0;
+        offset = bc->offset;
+    }
+    sect->opt_dirty = NULL;
+
+    /* Iterate through the remainder, if any. */
+    while (bc) {
+        if (bc->callback->special == YASM_BC_SPECIAL_OFFSET) {
+            /* Recalculate/adjust len of offset-based bytecodes here */
+            long neg_thres = 0;
+            long pos_thres = (long)yasm_bc_next_offset(bc);
+            unsigned long orig_len = bc->len;
+            int retval = yasm_bc_expand(bc, 1, 0, (long)offset,
+                                        &neg_thres, &pos_thres);
+            optd->num_expansions++;
+            yasm_errwarn_propagate(errwarns, bc->line);
+            if (retval < 0)
+                saw_error = 1;
+            else if (record && bc->len != orig_len)
+                optimize_add_changed(optd, bc);
+        }
+        bc->offset = offset;
+        offset += bc->len*bc->mult_int;
         bc = STAILQ_NEXT(bc, link);
+    }
+    return saw_error;
+}
 
-        /* Iterate through the remainder, if any. */
-        while (bc) {
-            if (bc->callback->special == YASM_BC_SPECIAL_OFFSET) {
-                /* Recalculate/adjust len of offset-based bytecodes here */
-                long neg_thres = 0;
-                long pos_thres = (long)yasm_bc_next_offset(bc);
-                int retval = yasm_bc_expand(bc, 1, 0,
-                                            (long)yasm_bc_next_offset(prevbc),
-                                            &neg_thres, &pos_thres);
-                yasm_errwarn_propagate(errwarns, bc->line);
-                if (retval < 0)
-                    saw_error = 1;
-            }
-            bc->offset = offset;
-            offset += bc->len*bc->mult_int;
-            prevbc = bc;
-            bc = STAILQ_NEXT(bc, link);
+static int
+update_bc_offsets(yasm_object *object, optimize_data *optd,
+                  yasm_errwarns *errwarns, int record)
+{
+    yasm_section *sect;
+    size_t i;
+    int saw_error = 0;
+
+    if (optd->sects) {
+        for (i=0; i<optd->num_sects; i++) {
+            if (update_sect_offsets(optd->sects[i], optd, errwarns, record))
+                saw_error = 1;
+        }
+    } else {
+        STAILQ_FOREACH(sect, &object->sections, link) {
+            if (update_sect_offsets(sect, optd, errwarns, record))
+                saw_error = 1;
         }
     }
     return saw_error;
@@ -1098,17 +1311,26 @@ span_destroy(/*@only@*/ yasm_span *span)
 
     yasm_value_delete(&span->depval);
     if (span->rel_term)
-        yasm_xfree(span->rel_term);
+        yasm_arena_free(span->rel_term);
     if (span->terms)
-        yasm_xfree(span->terms);
+        yasm_arena_free(span->terms);
     if (span->items) {
         for (i=0; i<span->num_terms; i++)
             yasm_intnum_destroy(span->items[i].data.intn);
-        yasm_xfree(span->items);
+        yasm_arena_free(span->items);
     }
     if (span->backtrace)
         yasm_xfree(span->backtrace);
-    yasm_xfree(span);
+    yasm_arena_free(span);
+}
+
+static void
+optimize_add_stats(yasm_object *object, const optimize_data *optd)
+{
+    object->optimize_stats.bytecodes += optd->num_bytecodes;
+    object->optimize_stats.spans += optd->num_spans;
+    object->optimize_stats.expansions += optd->num_expansions;
+    object->optimize_stats.iterations += optd->num_iterations;
 }
 
 static void
@@ -1118,6 +1340,10 @@ optimize_cleanup(optimize_data *optd)
     yasm_offset_setter *os1, *os2;
 
     IT_destroy(optd->itree);
+    if (optd->changed)
+        yasm_xfree(optd->changed);
+    if (optd->sects)
+        yasm_xfree(optd->sects);
 
     s1 = TAILQ_FIRST(&optd->spans);
     while (s1) {
@@ -1134,13 +1360,15 @@ optimize_cleanup(optimize_data *optd)
     }
 }
 
-static void
-optimize_itree_add(IntervalTree *itree, yasm_span *span, yasm_span_term *term)
+/* Gets the range of bytecode indexes whose length affects the term value.
+ * Returns 0 if the term is always 0 (same bytecode).
+ */
+static int
+span_term_range(const yasm_span *span, const yasm_span_term *term,
+                unsigned long *low, unsigned long *high)
 {
     long precbc_index, precbc2_index;
-    unsigned long low, high;
 
-    /* Update term length */
     if (term->precbc)
         precbc_index = term->precbc->bc_index;
     else
@@ -1152,17 +1380,98 @@ optimize_itree_add(IntervalTree *itree, yasm_span *span, yasm_span_term *term)
         precbc2_index = span->bc->bc_index-1;
 
     if (precbc_index < precbc2_index) {
-        low = precbc_index+1;
-        high = precbc2_index;
+        *low = precbc_index+1;
+        *high = precbc2_index;
     } else if (precbc_index > precbc2_index) {
-        low = precbc2_index+1;
-        high = precbc_index;
+        *low = precbc2_index+1;
+        *high = precbc_index;
     } else
+        return 0;
+    return 1;
+}
+
+static void
+optimize_itree_add(IntervalTree *itree, yasm_span *span, yasm_span_term *term)
+{
+    unsigned long low, high;
+
+    if (!span_term_range(span, term, &low, &high))
         return;     /* difference is same bc - always 0! */
 
     IT_insert(itree, (long)low, (long)high, term);
 }
 
+/* Determines if a span term needs to be recomputed given the changed list.
+ * If endpoints_only is nonzero, only checks the term endpoints (used in step
+ * 1b, where terms created after an endpoint changed length mix step 1a
+ * offsets with updated lengths); otherwise checks the entire term range.
+ */
+static int
+span_term_changed(const optimize_data *optd, const yasm_span *span,
+                  const yasm_span_term *term, int endpoints_only)
+{
+    unsigned long low, high;
+
+    if (endpoints_only) {
+        if (term->precbc &&
+            optimize_changed_in(optd, term->precbc->bc_index,
+                                term->precbc->bc_index))
+            return 1;
+        return (term->precbc2 &&
+                optimize_changed_in(optd, term->precbc2->bc_index,
+                                    term->precbc2->bc_index));
+    }
+
+    if (!span_term_range(span, term, &low, &high))
+        return 0;
+    return optimize_changed_in(optd, low, high);
+}
+
+/* Determines if any of the span's terms need to be recomputed. */
+static int
+span_changed(const optimize_data *optd, const yasm_span *span,
+             int endpoints_only)
+{
+    unsigned int i;
+
+    if (optd->num_changed == 0)
+        return 0;
+    for (i=0; i<span->num_terms; i++) {
+        if (span_term_changed(optd, span, &span->terms[i], endpoints_only))
+            return 1;
+    }
+    return (span->rel_term &&
+            span_term_changed(optd, span, span->rel_term, endpoints_only));
+}
+
+/* Update span terms based on current bc offsets */
+static void
+span_update_terms(yasm_span *span)
+{
+    yasm_intnum *intn;
+    unsigned int i;
+
+    for (i=0; i<span->num_terms; i++) {
+        intn = yasm_calc_bc_dist(span->terms[i].precbc,
+                                 span->terms[i].precbc2);
+        if (!intn)
+            yasm_internal_error(N_("could not calculate bc distance"));
+        span->terms[i].cur_val = span->terms[i].new_val;
+        span->terms[i].new_val = yasm_intnum_get_int(intn);
+        yasm_intnum_destroy(intn);
+    }
+    if (span->rel_term) {
+        span->rel_term->cur_val = span->rel_term->new_val;
+        if (span->rel_term->precbc2)
+            span->rel_term->new_val =
+                yasm_bc_next_offset(span->rel_term->precbc2) -
+                span->bc->offset;
+        else
+            span->rel_term->new_val = span->bc->offset -
+                yasm_bc_next_offset(span->rel_term->precbc);
+    }
+}
+
 static void
 check_cycle(IntervalTreeNode *node, void *d)
 {
@@ -1282,103 +1591,122 @@ optimize_term_expand(IntervalTreeNode *node, void *d)
         STAILQ_INSERT_TAIL(&optd->QB, span, linkq);
     span->active = 2;       /* Mark as being in Q */
 }
-
-void
-yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
+/* Create a new placeholder offset setter for following spans to point to;
+ * this will get updated if/when we actually run into one.
+ */
+static void
+optimize_add_offset_setter(optimize_data *optd)
 {
-    yasm_section *sect;
-    unsigned long bc_index = 0;
-    int saw_error = 0;
-    optimize_data optd;
-    yasm_span *span, *span_temp;
-    yasm_offset_setter *os;
-    int retval;
-    unsigned int i;
-
-    TAILQ_INIT(&optd.spans);
-    STAILQ_INIT(&optd.offset_setters);
-    optd.itree = IT_create();
-
-    /* Create an placeholder offset setter for spans to point to; this will
-     * get updated if/when we actually run into one.
-     */
-    os = yasm_xmalloc(sizeof(yasm_offset_setter));
+    yasm_offset_setter *os = yasm_xmalloc(sizeof(yasm_offset_setter));
     os->bc = NULL;
     os->cur_val = 0;
     os->new_val = 0;
     os->thres = 0;
-    STAILQ_INSERT_TAIL(&optd.offset_setters, os, link);
-    optd.os = os;
+    STAILQ_INSERT_TAIL(&optd->offset_setters, os, link);
+    optd->os = os;
+}
 
-    /* Step 1a */
-    STAILQ_FOREACH(sect, &object->sections, link) {
-        unsigned long offset = 0;
+static void
+optimize_init(optimize_data *optd, yasm_object *object)
+{
+    TAILQ_INIT(&optd->spans);
+    STAILQ_INIT(&optd->offset_setters);
+    optd->itree = IT_create();
+    optd->full = object->optimize_full;
+    optd->sects = NULL;
+    optd->num_sects = 0;
+    optd->changed = NULL;
+    optd->num_changed = 0;
+    optd->max_changed = 0;
+    optd->num_bytecodes = 0;
+    optd->num_spans = 0;
+    optd->num_expansions = 0;
+    optd->num_iterations = 0;
+    optimize_add_offset_setter(optd);
+}
 
-        yasm_bytecode *bc = STAILQ_FIRST(&sect->bcs);
-        yasm_bytecode *prevbc;
+/* Step 1a for a single section.  Returns nonzero on error. */
+static int
+optimize_step1a(optimize_data *optd, yasm_section *sect,
+                unsigned long *bc_index, yasm_errwarns *errwarns)
+{
+    unsigned long offset = 0;
+    int saw_error = 0;
+    int retval;
+    yasm_bytecode *bc = STAILQ_FIRST(&sect->bcs);
 
-        bc->bc_index = bc_index++;
+    sect->opt_dirty = NULL;
+    bc->bc_index = (*bc_index)++;
 
-        /* Skip our locally created empty bytecode first. */
-        prevbc = bc;
-        bc = STAILQ_NEXT(bc, link);
+    /* Skip our locally created empty bytecode first. */
+    bc = STAILQ_NEXT(bc, link);
 
-        /* Iterate through the remainder, if any. */
-        while (bc) {
-            bc->bc_index = bc_index++;
-            bc->offset = offset;
+    /* Iterate through the remainder, if any. */
+    while (bc) {
+        bc->bc_index = (*bc_index)++;
+        bc->offset = offset;
+        optd->num_bytecodes++;
+
+        retval = yasm_bc_calc_len(bc, optimize_add_span, optd);
+        yasm_errwarn_propagate(errwarns, bc->line);
+        if (retval)
+            saw_error = 1;
+        else {
+            if (bc->callback->special == YASM_BC_SPECIAL_OFFSET) {
+                /* Remember it as offset setter */
+                optd->os->bc = bc;
+                optd->os->thres = yasm_bc_next_offset(bc);
 
-            retval = yasm_bc_calc_len(bc, optimize_add_span, &optd);
-            yasm_errwarn_propagate(errwarns, bc->line);
-            if (retval)
-                saw_error = 1;
-            else {
-                if (bc->callback->special == YASM_BC_SPECIAL_OFFSET) {
-                    /* Remember it as offset setter */
-                    os->bc = bc;
-                    os->thres = yasm_bc_next_offset(bc);
-
-                    /* Create new placeholder */
-                    os = yasm_xmalloc(sizeof(yasm_offset_setter));
-                    os->bc = NULL;
-                    os->cur_val = 0;
-                    os->new_val = 0;
-                    os->thres = 0;
-                    STAILQ_INSERT_TAIL(&optd.offset_setters, os, link);
-                    optd.os = os;
-
-                    if (bc->multiple) {
-                        yasm_error_set(YASM_ERROR_VALUE,
-                            N_("cannot combine multiples and setting assembly position"));
-                        yasm_errwarn_propagate(errwarns, bc->line);
-                        saw_error = 1;
-                    }
-                }
+                /* Create new placeholder */
+                optimize_add_offset_setter(optd);
 
-                offset += bc->len*bc->mult_int;
+                if (bc->multiple) {
+                    yasm_error_set(YASM_ERROR_VALUE,
+                        N_("cannot combine multiples and setting assembly position"));
+                    yasm_errwarn_propagate(errwarns, bc->line);
+                    saw_error = 1;
+                }
             }
 
-            prevbc = bc;
-            bc = STAILQ_NEXT(bc, link);
+            offset += bc->len*bc->mult_int;
         }
-    }
 
-    if (saw_error) {
-        optimize_cleanup(&optd);
-        return;
+        bc = STAILQ_NEXT(bc, link);
     }
+    return saw_error;
+}
 
-    /* Step 1b */
-    TAILQ_FOREACH_SAFE(span, &optd.spans, link, span_temp) {
+/* Step 1b.  Returns nonzero on error. */
+static int
+optimize_step1b(optimize_data *optd, yasm_errwarns *errwarns)
+{
+    yasm_span *span, *span_temp;
+    int saw_error = 0;
+    int retval;
+
+    TAILQ_FOREACH_SAFE(span, &optd->spans, link, span_temp) {
         span_create_terms(span);
+        if (!optd->full && span->num_terms > 0
+            && span_changed(optd, span, 1))
+            span->dirty = 1;
         if (yasm_error_occurred()) {
             yasm_errwarn_propagate(errwarns, span->bc->line);
             saw_error = 1;
         } else if (recalc_normal_span(span)) {
+            unsigned long orig_len = span->bc->len * span->bc->mult_int;
+
+            optd->num_expansions++;
             retval = yasm_bc_expand(span->bc, span->id, span->cur_val,
                                     span->new_val, &span->neg_thres,
                                     &span->pos_thres);
             yasm_errwarn_propagate(errwarns, span->bc->line);
+            if (!optd->full &&
+                span->bc->len * span->bc->mult_int != orig_len) {
+                optimize_mark_dirty(span->bc);
+                if (optd->num_changed == 0 ||
+                    optd->changed[optd->num_changed-1] != span->bc)
+                    optimize_add_changed(optd, span->bc);
+            }
             if (retval < 0)
                 saw_error = 1;
             else if (retval > 0) {
@@ -1389,66 +1717,76 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
                     saw_error = 1;
                 }
             } else {
-                TAILQ_REMOVE(&optd.spans, span, link);
+                TAILQ_REMOVE(&optd->spans, span, link);
                 span_destroy(span);
                 continue;
             }
         }
         span->cur_val = span->new_val;
     }
+    return saw_error;
+}
 
-    if (saw_error) {
-        optimize_cleanup(&optd);
-        return;
-    }
+/* Steps 1c and 1d.  Returns -1 on error, 0 if no spans exceeded their
+ * thresholds (so optimization is complete), or 1 if step 2 is needed.
+ */
+static int
+optimize_step1cd(yasm_object *object, optimize_data *optd,
+                 yasm_errwarns *errwarns)
+{
+    yasm_span *span;
 
     /* Step 1c */
-    if (update_all_bc_offsets(object, errwarns)) {
-        optimize_cleanup(&optd);
-        return;
-    }
+    if (update_bc_offsets(object, optd, errwarns, !optd->full))
+        return -1;
 
     /* Step 1d */
-    STAILQ_INIT(&optd.QB);
-    TAILQ_FOREACH(span, &optd.spans, link) {
-        yasm_intnum *intn;
-
-        /* Update span terms based on new bc offsets */
-        for (i=0; i<span->num_terms; i++) {
-            intn = yasm_calc_bc_dist(span->terms[i].precbc,
-                                     span->terms[i].precbc2);
-            if (!intn)
-                yasm_internal_error(N_("could not calculate bc distance"));
-            span->terms[i].cur_val = span->terms[i].new_val;
-            span->terms[i].new_val = yasm_intnum_get_int(intn);
-            yasm_intnum_destroy(intn);
-        }
-        if (span->rel_term) {
-            span->rel_term->cur_val = span->rel_term->new_val;
-            if (span->rel_term->precbc2)
-                span->rel_term->new_val =
-                    yasm_bc_next_offset(span->rel_term->precbc2) -
-                    span->bc->offset;
-            else
-                span->rel_term->new_val = span->bc->offset -
-                    yasm_bc_next_offset(span->rel_term->precbc);
+    STAILQ_INIT(&optd->QB);
+    if (optd->num_changed > 1)
+        qsort(optd->changed, optd->num_changed, sizeof(yasm_bytecode *),
+              optimize_changed_compare);
+    TAILQ_FOREACH(span, &optd->spans, link) {
+        int exceeded;
+
+        /* Spans with only a relative term are cheap enough to always
+         * recompute; only avoid recomputing ones with absolute terms.
+         */
+        if (optd->full || span->dirty || span->num_terms == 0
+            || span_changed(optd, span, 0)) {
+            span->dirty = 0;
+            span_update_terms(span);
+            exceeded = recalc_normal_span(span);
+        } else if (span->id <= 0) {
+            /* Terms unchanged since step 1b; just recheck thresholds */
+            exceeded = (span->new_val != span->cur_val);
+        } else {
+            exceeded = (span->new_val < span->neg_thres
+                        || span->new_val > span->pos_thres);
         }
 
-        if (recalc_normal_span(span)) {
+        if (exceeded) {
             /* Exceeded threshold, add span to QB */
-            STAILQ_INSERT_TAIL(&optd.QB, span, linkq);
+            STAILQ_INSERT_TAIL(&optd->QB, span, linkq);
             span->active = 2;
         }
     }
 
-    /* Do we need step 2?  If not, go ahead and exit. */
-    if (STAILQ_EMPTY(&optd.QB)) {
-        optimize_cleanup(&optd);
-        return;
-    }
+    /* Do we need step 2? */
+    return STAILQ_EMPTY(&optd->QB) ? 0 : 1;
+}
+
+/* Step 2 (including its setup).  Returns nonzero on error. */
+static int
+optimize_step2(optimize_data *optd, yasm_errwarns *errwarns)
+{
+    yasm_span *span;
+    yasm_offset_setter *os;
+    int saw_error = 0;
+    int retval;
+    unsigned int i;
 
     /* Update offset-setters values */
-    STAILQ_FOREACH(os, &optd.offset_setters, link) {
+    STAILQ_FOREACH(os, &optd->offset_setters, link) {
         if (!os->bc)
             continue;
         os->thres = yasm_bc_next_offset(os->bc);
@@ -1457,34 +1795,32 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
     }
 
     /* Build up interval tree */
-    TAILQ_FOREACH(span, &optd.spans, link) {
+    TAILQ_FOREACH(span, &optd->spans, link) {
         for (i=0; i<span->num_terms; i++)
-            optimize_itree_add(optd.itree, span, &span->terms[i]);
+            optimize_itree_add(optd->itree, span, &span->terms[i]);
         if (span->rel_term)
-            optimize_itree_add(optd.itree, span, span->rel_term);
+            optimize_itree_add(optd->itree, span, span->rel_term);
     }
 
     /* Look for cycles in times expansion (span.id==0) */
-    TAILQ_FOREACH(span, &optd.spans, link) {
+    TAILQ_FOREACH(span, &optd->spans, link) {
         if (span->id > 0)
             continue;
-        optd.span = span;
-        IT_enumerate(optd.itree, (long)span->bc->bc_index,
-                     (long)span->bc->bc_index, &optd, check_cycle);
+        optd->span = span;
+        IT_enumerate(optd->itree, (long)span->bc->bc_index,
+                     (long)span->bc->bc_index, optd, check_cycle);
         if (yasm_error_occurred()) {
             yasm_errwarn_propagate(errwarns, span->bc->line);
             saw_error = 1;
         }
     }
 
-    if (saw_error) {
-        optimize_cleanup(&optd);
-        return;
-    }
+    if (saw_error)
+        return 1;
 
     /* Step 2 */
-    STAILQ_INIT(&optd.QA);
-    while (!STAILQ_EMPTY(&optd.QA) || !(STAILQ_EMPTY(&optd.QB))) {
+    STAILQ_INIT(&optd->QA);
+    while (!STAILQ_EMPTY(&optd->QA) || !(STAILQ_EMPTY(&optd->QB))) {
         unsigned long orig_len;
         long offset_diff;
 
@@ -1492,14 +1828,15 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
          * This is so that TIMES can absorb increases before we look at
          * expanding non-TIMES BCs.
          */
-        if (!STAILQ_EMPTY(&optd.QA)) {
-            span = STAILQ_FIRST(&optd.QA);
-            STAILQ_REMOVE_HEAD(&optd.QA, linkq);
+        if (!STAILQ_EMPTY(&optd->QA)) {
+            span = STAILQ_FIRST(&optd->QA);
+            STAILQ_REMOVE_HEAD(&optd->QA, linkq);
         } else {
-            span = STAILQ_FIRST(&optd.QB);
-            STAILQ_REMOVE_HEAD(&optd.QB, linkq);
+            span = STAILQ_FIRST(&optd->QB);
+            STAILQ_REMOVE_HEAD(&optd->QB, linkq);
         }
 
+        optd->num_iterations++;
         if (!span->active)
             continue;
         span->active = 1;   /* no longer in Q */
@@ -1513,6 +1850,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
 
         orig_len = span->bc->len * span->bc->mult_int;
 
+        optd->num_expansions++;
         retval = yasm_bc_expand(span->bc, span->id, span->cur_val,
                                 span->new_val, &span->neg_thres,
                                 &span->pos_thres);
@@ -1532,13 +1870,14 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
         } else
             span->active = 0;       /* we're done with this span */
 
-        optd.len_diff = span->bc->len * span->bc->mult_int - orig_len;
-        if (optd.len_diff == 0)
+        optd->len_diff = span->bc->len * span->bc->mult_int - orig_len;
+        if (optd->len_diff == 0)
             continue;   /* didn't increase in size */
+        optimize_mark_dirty(span->bc);
 
         /* Iterate over all spans dependent across the bc just expanded */
-        IT_enumerate(optd.itree, (long)span->bc->bc_index,
-                     (long)span->bc->bc_index, &optd, optimize_term_expand);
+        IT_enumerate(optd->itree, (long)span->bc->bc_index,
+                     (long)span->bc->bc_index, optd, optimize_term_expand);
 
         /* Iterate over offset-setters that follow the bc just expanded.
          * Stop iteration if:
@@ -1546,7 +1885,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
          *  - offset-setter didn't move its following offset
          */
         os = span->os;
-        offset_diff = optd.len_diff;
+        offset_diff = optd->len_diff;
         while (os->bc && os->bc->section == span->bc->section
                && offset_diff != 0) {
             unsigned long old_next_offset = os->cur_val + os->bc->len;
@@ -1557,28 +1896,356 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
             os->new_val += offset_diff;
 
             orig_len = os->bc->len;
+            optd->num_expansions++;
             retval = yasm_bc_expand(os->bc, 1, (long)os->cur_val,
                                     (long)os->new_val, &neg_thres_temp,
                                     (long *)&os->thres);
             yasm_errwarn_propagate(errwarns, os->bc->line);
 
             offset_diff = os->new_val + os->bc->len - old_next_offset;
-            optd.len_diff = os->bc->len - orig_len;
-            if (optd.len_diff != 0)
-                IT_enumerate(optd.itree, (long)os->bc->bc_index,
-                     (long)os->bc->bc_index, &optd, optimize_term_expand);
+            optd->len_diff = os->bc->len - orig_len;
+            if (optd->len_diff != 0)
+                IT_enumerate(optd->itree, (long)os->bc->bc_index,
+                     (long)os->bc->bc_index, optd, optimize_term_expand);
 
             os->cur_val = os->new_val;
             os = STAILQ_NEXT(os, link);
         }
     }
 
-    if (saw_error) {
-        optimize_cleanup(&optd);
+    return saw_error;
+}
+
+/*
+ * Parallel optimization.
+ *
+ * Spans are almost always local to the section containing the spanning
+ * bytecode, and such a section can be optimized without regard to any
+ * other section.  Step 1a is run for each section as an independent job;
+ * it only reads other sections, and bc_index values are assigned from a
+ * precomputed per-section base so they match the serial numbering.  Each
+ * section is then checked for spans that reference (through labels or
+ * bytecode references) another section.  All such sections and the
+ * sections they reference are combined into a single shared group (in
+ * section order) that is optimized exactly as the serial optimizer would;
+ * every other section forms a group on its own.  The remaining steps are
+ * run with each group as a job.
+ *
+ * Each job propagates its errors and warnings into its own errwarns set;
+ * these are merged in section order after each step.  As in the serial
+ * optimizer, if any job reports an error, later steps are not run.
+ */
+typedef struct optimize_sect {
+    /*@dependent@*/ yasm_section *sect;
+    unsigned long bc_index;     /* bc_index of first bytecode in section */
+
+    /* Step 1a data.  Also used for later steps if this is the first section
+     * in a group.
+     */
+    optimize_data optd;
+    /*@only@*/ yasm_errwarns *errwarns;
+    int retval;                 /* result of last step run */
+
+    /* Other sections referenced by spans */
+    /*@only@*/ /*@null@*/ yasm_section **refs;
+    size_t num_refs, max_refs;
+    int refs_unknown;           /* couldn't determine referenced sections */
+    int equ_depth;              /* EQU recursion depth while finding refs */
+
+    int shared;                 /* in the shared group */
+} optimize_sect;
+
+typedef struct optimize_parallel_data {
+    yasm_object *object;
+    /*@only@*/ optimize_sect *osects;
+    size_t num_osects;
+
+    /* First section in each group being processed, in section order */
+    /*@only@*/ optimize_sect **groups;
+    size_t num_groups;
+} optimize_parallel_data;
+
+static int
+optimize_find_refs(const yasm_expr__item *ei, void *d)
+{
+    optimize_sect *osect = d;
+    yasm_bytecode *precbc;
+    const yasm_expr *equ;
+
+    if (ei->type == YASM_EXPR_PRECBC)
+        precbc = ei->data.precbc;
+    else if (ei->type != YASM_EXPR_SYM)
+        return 0;
+    else if ((equ = yasm_symrec_get_equ(ei->data.sym))) {
+        int retval;
+        if (osect->equ_depth >= 32) {
+            osect->refs_unknown = 1;
+            return 1;
+        }
+        osect->equ_depth++;
+        retval = yasm_expr__traverse_leaves_in_const(equ, osect,
+                                                     optimize_find_refs);
+        osect->equ_depth--;
+        return retval;
+    } else if (!yasm_symrec_get_label(ei->data.sym, &precbc))
+        return 0;
+
+    if (precbc->section == osect->sect)
+        return 0;
+    if (osect->num_refs > 0
+        && osect->refs[osect->num_refs-1] == precbc->section)
+        return 0;
+    if (osect->num_refs >= osect->max_refs) {
+        osect->max_refs = osect->max_refs ? osect->max_refs*2 : 4;
+        osect->refs = yasm_xrealloc(osect->refs,
+                                    osect->max_refs*sizeof(yasm_section *));
+    }
+    osect->refs[osect->num_refs++] = precbc->section;
+    return 0;
+}
+
+static void
+optimize_parallel_step1a(unsigned long job, void *d)
+{
+    optimize_parallel_data *opd = d;
+    optimize_sect *osect = &opd->osects[job];
+    unsigned long bc_index = osect->bc_index;
+    yasm_span *span;
+
+    osect->retval = optimize_step1a(&osect->optd, osect->sect, &bc_index,
+                                    osect->errwarns);
+    if (osect->retval)
         return;
+
+    TAILQ_FOREACH(span, &osect->optd.spans, link) {
+        if (span->depval.abs &&
+            yasm_expr__traverse_leaves_in_const(span->depval.abs, osect,
+                                                optimize_find_refs))
+            break;
     }
+}
+
+static void
+optimize_parallel_step1b(unsigned long job, void *d)
+{
+    optimize_parallel_data *opd = d;
+    optimize_sect *group = opd->groups[job];
+
+    group->retval = optimize_step1b(&group->optd, group->errwarns);
+}
+
+static void
+optimize_parallel_step1cd(unsigned long job, void *d)
+{
+    optimize_parallel_data *opd = d;
+    optimize_sect *group = opd->groups[job];
+
+    group->retval = optimize_step1cd(opd->object, &group->optd,
+                                     group->errwarns);
+}
+
+static void
+optimize_parallel_step2(unsigned long job, void *d)
+{
+    optimize_parallel_data *opd = d;
+    optimize_sect *group = opd->groups[job];
+
+    group->retval = optimize_step2(&group->optd, group->errwarns);
+}
+
+static void
+optimize_parallel_step3(unsigned long job, void *d)
+{
+    optimize_parallel_data *opd = d;
+    optimize_sect *group = opd->groups[job];
+
+    group->retval = update_bc_offsets(opd->object, &group->optd,
+                                      group->errwarns, 0);
+}
+
+/* Run a step for each group and merge the results.  Returns nonzero if any
+ * group reported an error.
+ */
+static int
+optimize_parallel_run(optimize_parallel_data *opd, yasm_parallel_func func,
+                      yasm_errwarns *errwarns)
+{
+    size_t i;
+    int saw_error = 0;
+
+    yasm_parallel_run(opd->object->threads, opd->num_groups, opd, func);
+    for (i=0; i<opd->num_groups; i++) {
+        yasm_errwarns_merge(errwarns, opd->groups[i]->errwarns);
+        if (opd->groups[i]->retval < 0 ||
+            (func != optimize_parallel_step1cd && opd->groups[i]->retval))
+            saw_error = 1;
+    }
+    return saw_error;
+}
+
+static optimize_sect *
+optimize_parallel_find(optimize_parallel_data *opd, yasm_section *sect)
+{
+    unsigned long bc_index = STAILQ_FIRST(&sect->bcs)->bc_index;
+    size_t lo = 0, hi = opd->num_osects;
+
+    /* Sections are in bc_index order */
+    while (lo < hi) {
+        size_t mid = (lo+hi)/2;
+        if (opd->osects[mid].bc_index < bc_index)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    if (lo >= opd->num_osects || opd->osects[lo].sect != sect)
+        yasm_internal_error(N_("optimizer section not found"));
+    return &opd->osects[lo];
+}
+
+static void
+optimize_parallel(yasm_object *object, yasm_errwarns *errwarns)
+{
+    optimize_parallel_data opd;
+    optimize_sect *osect, *shared = NULL;
+    yasm_section *sect;
+    yasm_bytecode *bc;
+    unsigned long bc_index = 0;
+    size_t i, j, num_shared = 0;
+    int refs_unknown = 0;
+
+    opd.object = object;
+    opd.num_osects = 0;
+    STAILQ_FOREACH(sect, &object->sections, link)
+        opd.num_osects++;
+    opd.osects = yasm_xmalloc(opd.num_osects*sizeof(optimize_sect));
+    opd.groups = yasm_xmalloc(opd.num_osects*sizeof(optimize_sect *));
+
+    /* Assign each section its base bc_index */
+    i = 0;
+    STAILQ_FOREACH(sect, &object->sections, link) {
+        osect = &opd.osects[i];
+        osect->sect = sect;
+        osect->bc_index = bc_index;
+        optimize_init(&osect->optd, object);
+        osect->errwarns = yasm_errwarns_create();
+        osect->retval = 0;
+        osect->refs = NULL;
+        osect->num_refs = 0;
+        osect->max_refs = 0;
+        osect->refs_unknown = 0;
+        osect->equ_depth = 0;
+        osect->shared = 0;
+        opd.groups[i] = osect;
+        STAILQ_FOREACH(bc, &sect->bcs, link)
+            bc_index++;
+        i++;
+    }
+
+    /* Step 1a */
+    opd.num_groups = opd.num_osects;
+    if (optimize_parallel_run(&opd, optimize_parallel_step1a, errwarns))
+        goto done;
+
+    /* Find the sections with cross-section spans */
+    for (i=0; i<opd.num_osects; i++) {
+        osect = &opd.osects[i];
+        refs_unknown |= osect->refs_unknown;
+        if (osect->num_refs > 0)
+            osect->shared = 1;
+        for (j=0; j<osect->num_refs; j++)
+            optimize_parallel_find(&opd, osect->refs[j])->shared = 1;
+    }
+
+    /* Build groups; the shared group goes in the position of its first
+     * section.
+     */
+    opd.num_groups = 0;
+    for (i=0; i<opd.num_osects; i++) {
+        osect = &opd.osects[i];
+        if (refs_unknown || osect->shared) {
+            if (!shared) {
+                shared = osect;
+                shared->optd.sects =
+                    yasm_xmalloc(opd.num_osects*sizeof(yasm_section *));
+                opd.groups[opd.num_groups++] = osect;
+            } else {
+                TAILQ_CONCAT(&shared->optd.spans, &osect->optd.spans, link);
+                STAILQ_CONCAT(&shared->optd.offset_setters,
+                              &osect->optd.offset_setters);
+            }
+            shared->optd.sects[num_shared++] = osect->sect;
+            shared->optd.num_sects = num_shared;
+        } else {
+            osect->optd.sects = yasm_xmalloc(sizeof(yasm_section *));
+            osect->optd.sects[0] = osect->sect;
+            osect->optd.num_sects = 1;
+            opd.groups[opd.num_groups++] = osect;
+        }
+    }
+
+    /* Step 1b */
+    if (optimize_parallel_run(&opd, optimize_parallel_step1b, errwarns))
+        goto done;
+
+    /* Steps 1c and 1d */
+    if (optimize_parallel_run(&opd, optimize_parallel_step1cd, errwarns))
+        goto done;
+
+    /* Only groups with spans that exceeded thresholds need steps 2 and 3 */
+    j = 0;
+    for (i=0; i<opd.num_groups; i++) {
+        if (opd.groups[i]->retval > 0)
+            opd.groups[j++] = opd.groups[i];
+    }
+    opd.num_groups = j;
+
+    /* Step 2 */
+    if (optimize_parallel_run(&opd, optimize_parallel_step2, errwarns))
+        goto done;
 
     /* Step 3 */
-    update_all_bc_offsets(object, errwarns);
+    optimize_parallel_run(&opd, optimize_parallel_step3, errwarns);
+
+done:
+    for (i=0; i<opd.num_osects; i++) {
+        osect = &opd.osects[i];
+        optimize_add_stats(object, &osect->optd);
+        optimize_cleanup(&osect->optd);
+        yasm_errwarns_destroy(osect->errwarns);
+        if (osect->refs)
+            yasm_xfree(osect->refs);
+    }
+    yasm_xfree(opd.groups);
+    yasm_xfree(opd.osects);
+}
+
+void
+yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
+{
+    yasm_section *sect;
+    unsigned long bc_index = 0;
+    int saw_error = 0;
+    optimize_data optd;
+
+    if (object->threads > 1 && yasm_parallel_supported()) {
+        optimize_parallel(object, errwarns);
+        return;
+    }
+
+    optimize_init(&optd, object);
+
+    /* Step 1a */
+    STAILQ_FOREACH(sect, &object->sections, link) {
+        if (optimize_step1a(&optd, sect, &bc_index, errwarns))
+            saw_error = 1;
+    }
+
+    /* Steps 1b-1d, and 2 and 3 if needed */
+    if (!saw_error && !optimize_step1b(&optd, errwarns)
+        && optimize_step1cd(object, &optd, errwarns) > 0
+        && !optimize_step2(&optd, errwarns))
+        update_bc_offsets(object, &optd, errwarns, 0);
+
+    optimize_add_stats(object, &optd);
     optimize_cleanup(&optd);
 }
@@ -35,13 +35,14 @@
 #endif
 
 /** Basic YASM relocation.  Object formats will need to extend this
- * structure with additional fields for relocation type, etc.
+ * structure with additional fields for relocation type, etc.  Sections
+ * store relocations by value in an array, so the extended structure
+ * must not own any allocated data.
  */
 typedef struct yasm_reloc yasm_reloc;
 
 struct yasm_reloc {
-    /*@reldef@*/ STAILQ_ENTRY(yasm_reloc) link; /**< Link to next reloc */
-    yasm_intnum *addr;          /**< Offset (address) within section */
+    unsigned long addr;         /**< Offset (address) within section */
     /*@dependent@*/ yasm_symrec *sym;       /**< Relocated symbol */
 };
 
@@ -73,11 +74,60 @@ struct yasm_object {
 
     /** Suffix appended to externally-visible symbols (empty string if none) */
     /*@owned@*/ char *global_suffix;
+
+    /** Nonzero to have yasm_object_optimize() recompute every bytecode
+     * offset and span term on each pass rather than only those following
+     * a bytecode that changed length.  Both produce identical results; this
+     * is mainly useful for debugging and benchmarking the optimizer.
+     */
+    int optimize_full;
+
+    /** Maximum number of threads yasm_object_optimize() and object format
+     * output may use to process independent sections concurrently (see
+     * libyasm/parallel.h).  0 or 1 processes all sections serially.  Output
+     * is identical regardless of this setting.
+     */
+    unsigned int threads;
+
+    /** Nonzero to have object formats store a string in their string
+     * tables within the tail of a longer one where possible (see
+     * yasm_strtab_finalize()).  This makes for smaller objects at some cost
+     * in output time.
+     */
+    int strtab_tail_merge;
+
+    /** Nonzero to have object formats that can (ELF and COFF) write each
+     * section's relocations sorted by address (see
+     * yasm_section_sort_relocs()), which some linkers process faster.
+     * Otherwise relocations are written in the order they were made.
+     */
+    int sort_relocs;
+
+    /** Arena that expressions, intnums, bytecodes, and optimizer spans are
+     * allocated from (see arena.h).  Released in bulk by
+     * yasm_object_destroy().
+     */
+    /*@owned@*/ yasm_arena *arena;
+
+    /** Files included verbatim in the output (e.g. by incbin).  Closed by
+     * yasm_object_destroy(), so nothing is kept open or reused from one
+     * object to the next.
+     */
+    /*@owned@*/ yasm_incfile_cache *incfiles;
+
+    /** Optimizer statistics, accumulated by yasm_object_optimize(). */
+    struct {
+        unsigned long bytecodes;    /**< bytecodes laid out */
+        unsigned long spans;        /**< spans created */
+        unsigned long expansions;   /**< calls to yasm_bc_expand() */
+        unsigned long iterations;   /**< span queue entries processed */
+    } optimize_stats;
 };
 
 /** Create a new object.  A default section is created as the first section.
  * An empty symbol table (yasm_symtab) and line mapping (yasm_linemap) are
- * automatically created.
+ * automatically created.  The object's arena is made the current arena of
+ * the calling thread.
  * \param src_filename  source filename (e.g. "file.asm")
  * \param obj_filename  object filename (e.g. "file.o")
  * \param arch          architecture
@@ -128,7 +178,9 @@ int yasm_object_directive(yasm_object *object, const char *name,
                           unsigned long line);
 
 /** Delete (free allocated memory for) an object.  All sections in the
- * object and all bytecodes within those sections are also deleted.
+ * object and all bytecodes within those sections are also deleted, and the
+ * object's arena is released; anything else allocated from it must be
+ * deleted first.
  * \param object        object
  */
 YASM_LIB_DECL
@@ -266,16 +318,29 @@ void yasm_section_add_data(yasm_section *sect,
 
 /** Add a relocation to a section.
  * \param sect          section
- * \param reloc         relocation
- * \param destroy_func  function that can destroy the relocation
- * \note Does not make a copy of reloc.  The same destroy_func must be
- * used for all relocations in a section or an internal error will occur.
- * The section will destroy the relocation address; it is the caller's
- * responsibility to destroy any other allocated data.
+ * \param reloc         relocation (generally an object format structure
+ *                      that starts with a #yasm_reloc)
+ * \param size          size of the relocation structure
+ * \return The section's copy of the relocation.  It may be modified, but
+ *         only until the next relocation is added to the section.
+ * \note A copy of reloc is made.  The same size must be used for all
+ * relocations in a section or an internal error will occur.
  */
 YASM_LIB_DECL
-void yasm_section_add_reloc(yasm_section *sect, yasm_reloc *reloc,
-    void (*destroy_func) (/*@only@*/ void *reloc));
+yasm_reloc *yasm_section_add_reloc(yasm_section *sect,
+                                   const yasm_reloc *reloc, size_t size);
+
+/** Get all relocations for a section as an array.  The relocations are
+ * stored contiguously, each the size given to yasm_section_add_reloc(), in
+ * the order they were added (or in address order after
+ * yasm_section_sort_relocs()).
+ * \param sect          section
+ * \param nrelocsp      number of relocations (returned)
+ * \return First relocation for section.  NULL if no relocations.
+ */
+YASM_LIB_DECL
+/*@null@*/ yasm_reloc *yasm_section_relocs(yasm_section *sect,
+                                         /*@out@*/ unsigned long *nrelocsp);
 
 /** Get the first relocation for a section.
  * \param sect          section
@@ -285,13 +350,21 @@ YASM_LIB_DECL
 /*@null@*/ yasm_reloc *yasm_section_relocs_first(yasm_section *sect);
 
 /** Get the next relocation for a section.
+ * \param sect          section
  * \param reloc         previous relocation
  * \return Next relocation for section.  NULL if no more relocations.
  */
-/*@null@*/ yasm_reloc *yasm_section_reloc_next(yasm_reloc *reloc);
-#ifndef YASM_DOXYGEN
-#define yasm_section_reloc_next(x)      STAILQ_NEXT((x), link)
-#endif
+YASM_LIB_DECL
+/*@null@*/ yasm_reloc *yasm_section_reloc_next(yasm_section *sect,
+                                             yasm_reloc *reloc);
+
+/** Sort the relocations for a section by address.  The sort is stable, so
+ * relocations at the same address keep the order they were added in.
+ * Does nothing if the relocations were added in address order.
+ * \param sect          section
+ */
+YASM_LIB_DECL
+void yasm_section_sort_relocs(yasm_section *sect);
 
 /** Get the basic relocation information for a relocation.
  * \param reloc         relocation
@@ -299,7 +372,7 @@ YASM_LIB_DECL
  * \param symp          relocated symbol (returned)
  */
 YASM_LIB_DECL
-void yasm_reloc_get(yasm_reloc *reloc, yasm_intnum **addrp,
+void yasm_reloc_get(yasm_reloc *reloc, unsigned long *addrp,
                     /*@dependent@*/ yasm_symrec **symp);
 
 /** Get the first bytecode in a section.
@@ -0,0 +1,227 @@
+/*
+ * SHA-256 message digest (FIPS 180-4)
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util.h"
+
+#include <limits.h>
+
+#include "sha256.h"
+
+
+/* Work in a native 32-bit type where there is one, so that the rotates below
+ * compile to single instructions; otherwise mask down to 32 bits.
+ */
+#if UINT_MAX == 0xffffffffUL
+typedef unsigned int sha256_word;
+#define T32(x)          (x)
+#else
+typedef unsigned long sha256_word;
+#define T32(x)          ((x) & 0xffffffffUL)
+#endif
+
+#define ROTR(x, n)      T32(((x) >> (n)) | ((x) << (32-(n))))
+
+#define S0(x)           (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define S1(x)           (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define s0(x)           (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define s1(x)           (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+#define CH(x, y, z)     ((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z)    (((x) & (y)) | ((z) & ((x) | (y))))
+
+#define GET32(p) \
+    (((sha256_word)(p)[0] << 24) | ((sha256_word)(p)[1] << 16) | \
+     ((sha256_word)(p)[2] << 8) | (sha256_word)(p)[3])
+
+#define PUT32(p, v) \
+    do { \
+        (p)[0] = (unsigned char)((v) >> 24); \
+        (p)[1] = (unsigned char)((v) >> 16); \
+        (p)[2] = (unsigned char)((v) >> 8); \
+        (p)[3] = (unsigned char)(v); \
+    } while (0)
+
+static const sha256_word K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* One round.  Rather than shifting the eight working variables each round,
+ * the callers rotate the argument order.
+ */
+#define ROUND(a, b, c, d, e, f, g, h, k, w) \
+    do { \
+        t = T32(h + S1(e) + CH(e, f, g) + (k) + (w)); \
+        d = T32(d + t); \
+        h = T32(t + S0(a) + MAJ(a, b, c)); \
+    } while (0)
+
+/* The message schedule is kept as a rolling window of 16 words. */
+#define SCHEDULE(i) \
+    (W[(i)&15] = T32(s1(W[((i)-2)&15]) + W[((i)-7)&15] + \
+                     s0(W[((i)-15)&15]) + W[(i)&15]))
+
+#define ROUNDS8(i, SCHED) \
+    do { \
+        ROUND(a, b, c, d, e, f, g, h, K[(i)+0], SCHED((i)+0)); \
+        ROUND(h, a, b, c, d, e, f, g, K[(i)+1], SCHED((i)+1)); \
+        ROUND(g, h, a, b, c, d, e, f, K[(i)+2], SCHED((i)+2)); \
+        ROUND(f, g, h, a, b, c, d, e, K[(i)+3], SCHED((i)+3)); \
+        ROUND(e, f, g, h, a, b, c, d, K[(i)+4], SCHED((i)+4)); \
+        ROUND(d, e, f, g, h, a, b, c, K[(i)+5], SCHED((i)+5)); \
+        ROUND(c, d, e, f, g, h, a, b, K[(i)+6], SCHED((i)+6)); \
+        ROUND(b, c, d, e, f, g, h, a, K[(i)+7], SCHED((i)+7)); \
+    } while (0)
+
+#define LOADED(i)   W[i]
+
+/* Hash nblocks consecutive 64-byte blocks. */
+static void
+sha256_blocks(unsigned long state[8], const unsigned char *in,
+              unsigned long nblocks)
+{
+    sha256_word a, b, c, d, e, f, g, h, t;
+    sha256_word W[16];
+    int i;
+
+    while (nblocks-- > 0) {
+        for (i=0; i<16; i++)
+            W[i] = GET32(in + 4*i);
+
+        a = (sha256_word)state[0];
+        b = (sha256_word)state[1];
+        c = (sha256_word)state[2];
+        d = (sha256_word)state[3];
+        e = (sha256_word)state[4];
+        f = (sha256_word)state[5];
+        g = (sha256_word)state[6];
+        h = (sha256_word)state[7];
+
+        ROUNDS8(0, LOADED);
+        ROUNDS8(8, LOADED);
+        for (i=16; i<64; i+=8)
+            ROUNDS8(i, SCHEDULE);
+
+        state[0] = T32(state[0] + a);
+        state[1] = T32(state[1] + b);
+        state[2] = T32(state[2] + c);
+        state[3] = T32(state[3] + d);
+        state[4] = T32(state[4] + e);
+        state[5] = T32(state[5] + f);
+        state[6] = T32(state[6] + g);
+        state[7] = T32(state[7] + h);
+
+        in += 64;
+    }
+}
+
+void
+yasm_sha256_init(yasm_sha256_context *ctx)
+{
+    ctx->state[0] = 0x6a09e667UL;
+    ctx->state[1] = 0xbb67ae85UL;
+    ctx->state[2] = 0x3c6ef372UL;
+    ctx->state[3] = 0xa54ff53aUL;
+    ctx->state[4] = 0x510e527fUL;
+    ctx->state[5] = 0x9b05688cUL;
+    ctx->state[6] = 0x1f83d9abUL;
+    ctx->state[7] = 0x5be0cd19UL;
+    ctx->bits[0] = 0;
+    ctx->bits[1] = 0;
+}
+
+void
+yasm_sha256_update(yasm_sha256_context *ctx, const unsigned char *buf,
+                   unsigned long len)
+{
+    unsigned long t = ctx->bits[0];
+    unsigned long have = (t >> 3) & 0x3f;   /* bytes already in ctx->in */
+
+    /* Update bit count */
+    if ((ctx->bits[0] = (t + ((unsigned long)len << 3)) & 0xffffffffUL) < t)
+        ctx->bits[1]++;     /* carry from low to high */
+    ctx->bits[1] = (ctx->bits[1] + (len >> 29)) & 0xffffffffUL;
+
+    /* Complete a partial block first */
+    if (have) {
+        unsigned long need = 64 - have;
+        if (len < need) {
+            memcpy(ctx->in + have, buf, len);
+            return;
+        }
+        memcpy(ctx->in + have, buf, need);
+        sha256_blocks(ctx->state, ctx->in, 1);
+        buf += need;
+        len -= need;
+    }
+
+    /* Hash whole blocks directly from the input */
+    if (len >= 64) {
+        sha256_blocks(ctx->state, buf, len / 64);
+        buf += len & ~63UL;
+        len &= 63;
+    }
+
+    /* Save any remainder */
+    if (len > 0)
+        memcpy(ctx->in, buf, len);
+}
+
+void
+yasm_sha256_final(unsigned char digest[32], yasm_sha256_context *ctx)
+{
+    unsigned long have = (ctx->bits[0] >> 3) & 0x3f;
+    int i;
+
+    /* Pad with a 1 bit, zeros to 56 mod 64 bytes, then the bit count */
+    ctx->in[have++] = 0x80;
+    if (have > 56) {
+        memset(ctx->in + have, 0, 64 - have);
+        sha256_blocks(ctx->state, ctx->in, 1);
+        have = 0;
+    }
+    memset(ctx->in + have, 0, 56 - have);
+    PUT32(ctx->in + 56, ctx->bits[1]);
+    PUT32(ctx->in + 60, ctx->bits[0]);
+    sha256_blocks(ctx->state, ctx->in, 1);
+
+    for (i=0; i<8; i++)
+        PUT32(digest + 4*i, ctx->state[i]);
+    memset(ctx, 0, sizeof(*ctx));       /* in case it's sensitive */
+}
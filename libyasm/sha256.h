@@ -0,0 +1,69 @@
+/**
+ * \file libyasm/sha256.h
+ * \brief YASM SHA-256 message digest interface.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_SHA256_H
+#define YASM_SHA256_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/** SHA-256 hash state.  Fields are "unsigned long", which is guaranteed to
+ * hold at least 32 bits; only the low 32 bits of each are used.
+ */
+typedef struct yasm_sha256_context {
+    unsigned long state[8];
+    unsigned long bits[2];      /* message length in bits (low, high) */
+    unsigned char in[64];       /* partial input block */
+} yasm_sha256_context;
+
+/** Start a SHA-256 hash.
+ * \param ctx       hash state
+ */
+YASM_LIB_DECL
+void yasm_sha256_init(/*@out@*/ yasm_sha256_context *ctx);
+
+/** Add data to a SHA-256 hash.
+ * \param ctx       hash state
+ * \param buf       data
+ * \param len       length of data, in bytes
+ */
+YASM_LIB_DECL
+void yasm_sha256_update(yasm_sha256_context *ctx, const unsigned char *buf,
+                        unsigned long len);
+
+/** Finish a SHA-256 hash.
+ * \param digest    32-byte message digest (output)
+ * \param ctx       hash state (cleared)
+ */
+YASM_LIB_DECL
+void yasm_sha256_final(/*@out@*/ unsigned char digest[32],
+                       yasm_sha256_context *ctx);
+
+#endif
@@ -0,0 +1,340 @@
+/*
+ * Object file string table builder
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util.h"
+
+#include "coretype.h"
+#include "errwarn.h"
+#include "phash.h"
+#include "strtab.h"
+
+
+typedef struct strtab_str {
+    unsigned long pos;      /* position in pool; in table once finalized */
+    unsigned long len;      /* length of string, excluding NUL */
+    int shared;             /* in hash table (may be returned again)? */
+} strtab_str;
+
+typedef struct strtab_slot {
+    unsigned int hash;      /* low bits of phash of string */
+    unsigned int id;        /* ID of string + 1, or 0 if slot is empty */
+} strtab_slot;
+
+struct yasm_strtab {
+    unsigned long start;    /* bytes reserved at start of table */
+
+    /* String contents, NUL-terminated, in order of addition.  Starts with
+     * the reserved bytes, so unless strings are replaced or merged, this
+     * is the final table.
+     */
+    /*@only@*/ char *pool;
+    unsigned long pool_len, pool_max;
+    int pool_is_table;      /* pool still laid out as the final table? */
+
+    /*@only@*/ strtab_str *strs;
+    unsigned long num_strs, max_strs;
+
+    /* Open-addressed hash table of shared strings.  The size is a power of
+     * 2 and at most half full.
+     */
+    /*@only@*/ strtab_slot *slots;
+    unsigned long num_slots, num_shared;
+
+    /*@only@*/ /*@null@*/ unsigned char *table;     /* once finalized */
+    unsigned long size;
+};
+
+/* String to be laid out by tail merging */
+typedef struct strtab_sortent {
+    const unsigned char *str;
+    unsigned long len;
+    unsigned long id;
+} strtab_sortent;
+
+yasm_strtab *
+yasm_strtab_create(unsigned long start)
+{
+    yasm_strtab *strtab = yasm_xmalloc(sizeof(yasm_strtab));
+
+    strtab->start = start;
+
+    strtab->pool_max = start + 256;
+    strtab->pool = yasm_xmalloc(strtab->pool_max);
+    memset(strtab->pool, 0, start);
+    strtab->pool_len = start;
+    strtab->pool_is_table = 1;
+
+    strtab->max_strs = 64;
+    strtab->strs = yasm_xmalloc(strtab->max_strs*sizeof(strtab_str));
+    strtab->num_strs = 0;
+
+    strtab->num_slots = 128;
+    strtab->slots = yasm_xcalloc(strtab->num_slots, sizeof(strtab_slot));
+    strtab->num_shared = 0;
+
+    strtab->table = NULL;
+    strtab->size = 0;
+    return strtab;
+}
+
+void
+yasm_strtab_destroy(yasm_strtab *strtab)
+{
+    if (strtab->pool)
+        yasm_xfree(strtab->pool);
+    if (strtab->table)
+        yasm_xfree(strtab->table);
+    yasm_xfree(strtab->strs);
+    yasm_xfree(strtab->slots);
+    yasm_xfree(strtab);
+}
+
+/* Copy a string to the end of the pool, returning its position. */
+static unsigned long
+strtab_pool_append(yasm_strtab *strtab, const char *str, unsigned long len)
+{
+    unsigned long pos = strtab->pool_len;
+
+    if (strtab->table)
+        yasm_internal_error(N_("string table already finalized"));
+    if (strtab->pool_max - pos < len+1) {
+        while (strtab->pool_max - pos < len+1)
+            strtab->pool_max *= 2;
+        strtab->pool = yasm_xrealloc(strtab->pool, strtab->pool_max);
+    }
+    memcpy(strtab->pool+pos, str, len+1);
+    strtab->pool_len += len+1;
+    return pos;
+}
+
+static unsigned long
+strtab_new_str(yasm_strtab *strtab, const char *str, unsigned long len,
+               int shared)
+{
+    strtab_str *s;
+
+    if (strtab->num_strs == strtab->max_strs) {
+        strtab->max_strs *= 2;
+        strtab->strs = yasm_xrealloc(strtab->strs,
+                                     strtab->max_strs*sizeof(strtab_str));
+    }
+    s = &strtab->strs[strtab->num_strs];
+    s->pos = strtab_pool_append(strtab, str, len);
+    s->len = len;
+    s->shared = shared;
+    return strtab->num_strs++;
+}
+
+/* Double the size of the hash table.  Slots record their hashes, so
+ * nothing needs to be rehashed.
+ */
+static void
+strtab_grow_slots(yasm_strtab *strtab)
+{
+    strtab_slot *old = strtab->slots;
+    unsigned long old_size = strtab->num_slots;
+    unsigned long mask, i, j;
+
+    strtab->num_slots *= 2;
+    strtab->slots = yasm_xcalloc(strtab->num_slots, sizeof(strtab_slot));
+    mask = strtab->num_slots-1;
+    for (i=0; i<old_size; i++) {
+        if (old[i].id == 0)
+            continue;
+        for (j = old[i].hash & mask; strtab->slots[j].id; j = (j+1) & mask)
+            ;
+        strtab->slots[j] = old[i];
+    }
+    yasm_xfree(old);
+}
+
+unsigned long
+yasm_strtab_add(yasm_strtab *strtab, const char *str)
+{
+    unsigned long len = (unsigned long)strlen(str);
+    unsigned int hash = (unsigned int)phash_lookup(str, len, 0);
+    unsigned long mask, i, id;
+
+    if (strtab->table)
+        yasm_internal_error(N_("string table already finalized"));
+    if (2*(strtab->num_shared+1) > strtab->num_slots)
+        strtab_grow_slots(strtab);
+
+    mask = strtab->num_slots-1;
+    for (i = hash & mask; (id = strtab->slots[i].id) != 0; i = (i+1) & mask) {
+        const strtab_str *s = &strtab->strs[id-1];
+        if (strtab->slots[i].hash == hash && s->len == len &&
+            memcmp(strtab->pool+s->pos, str, len) == 0)
+            return id-1;
+    }
+
+    id = strtab_new_str(strtab, str, len, 1);
+    strtab->slots[i].hash = hash;
+    strtab->slots[i].id = (unsigned int)(id+1);
+    strtab->num_shared++;
+    return id;
+}
+
+unsigned long
+yasm_strtab_add_unique(yasm_strtab *strtab, const char *str)
+{
+    return strtab_new_str(strtab, str, (unsigned long)strlen(str), 0);
+}
+
+void
+yasm_strtab_replace(yasm_strtab *strtab, unsigned long id, const char *str)
+{
+    strtab_str *s;
+    unsigned long len = (unsigned long)strlen(str);
+
+    if (strtab->table)
+        yasm_internal_error(N_("string table already finalized"));
+    if (id >= strtab->num_strs || strtab->strs[id].shared)
+        yasm_internal_error(N_("replacing shared or unknown string"));
+    s = &strtab->strs[id];
+    if (s->len == len && memcmp(strtab->pool+s->pos, str, len) == 0)
+        return;
+
+    /* The old string is left unused in the pool */
+    s->pos = strtab_pool_append(strtab, str, len);
+    s->len = len;
+    strtab->pool_is_table = 0;
+}
+
+/* Order strings by their reversed contents, greatest first.  A string
+ * thus follows all strings it is the tail of, and the nearest of them
+ * immediately precedes it.
+ */
+static int
+strtab_tail_compare(const void *a, const void *b)
+{
+    const strtab_sortent *x = a, *y = b;
+    const unsigned char *p = x->str + x->len, *q = y->str + y->len;
+    unsigned long n = x->len < y->len ? x->len : y->len;
+
+    while (n-- > 0) {
+        --p;
+        --q;
+        if (*p != *q)
+            return *p < *q ? 1 : -1;
+    }
+    if (x->len != y->len)
+        return x->len < y->len ? 1 : -1;
+    /* Identical unique strings; keep the layout deterministic */
+    return x->id < y->id ? -1 : 1;
+}
+
+/* Lay out strings into tails of others, with the rest in reversed order.
+ * Returns the table size.
+ */
+static unsigned long
+strtab_layout_tail_merge(yasm_strtab *strtab, unsigned char *table)
+{
+    strtab_sortent *ents;
+    const strtab_sortent *prev = NULL;
+    unsigned long pos = strtab->start, i;
+
+    if (strtab->num_strs == 0)
+        return pos;
+
+    ents = yasm_xmalloc(strtab->num_strs*sizeof(strtab_sortent));
+    for (i=0; i<strtab->num_strs; i++) {
+        ents[i].str = (unsigned char *)strtab->pool + strtab->strs[i].pos;
+        ents[i].len = strtab->strs[i].len;
+        ents[i].id = i;
+    }
+    qsort(ents, strtab->num_strs, sizeof(strtab_sortent),
+          strtab_tail_compare);
+
+    for (i=0; i<strtab->num_strs; i++) {
+        const strtab_sortent *e = &ents[i];
+        if (prev && prev->len >= e->len &&
+            memcmp(prev->str + prev->len - e->len, e->str, e->len) == 0) {
+            strtab->strs[e->id].pos =
+                strtab->strs[prev->id].pos + prev->len - e->len;
+            continue;
+        }
+        memcpy(table+pos, e->str, e->len+1);
+        strtab->strs[e->id].pos = pos;
+        pos += e->len+1;
+        prev = e;
+    }
+
+    yasm_xfree(ents);
+    return pos;
+}
+
+unsigned char *
+yasm_strtab_finalize(yasm_strtab *strtab, int tail_merge,
+                     unsigned long *size)
+{
+    unsigned long i, pos;
+
+    if (strtab->table) {
+        *size = strtab->size;
+        return strtab->table;
+    }
+
+    if (strtab->pool_is_table && !tail_merge) {
+        /* Already laid out in ID order */
+        strtab->table = (unsigned char *)strtab->pool;
+        strtab->size = strtab->pool_len;
+        strtab->pool = NULL;
+        *size = strtab->size;
+        return strtab->table;
+    }
+
+    /* Allocate enough for every string to be laid out separately */
+    pos = strtab->start;
+    for (i=0; i<strtab->num_strs; i++)
+        pos += strtab->strs[i].len+1;
+    strtab->table = yasm_xmalloc(pos > 0 ? pos : 1);
+    memset(strtab->table, 0, strtab->start);
+
+    if (tail_merge)
+        pos = strtab_layout_tail_merge(strtab, strtab->table);
+    else {
+        pos = strtab->start;
+        for (i=0; i<strtab->num_strs; i++) {
+            strtab_str *s = &strtab->strs[i];
+            memcpy(strtab->table+pos, strtab->pool+s->pos, s->len+1);
+            s->pos = pos;
+            pos += s->len+1;
+        }
+    }
+
+    yasm_xfree(strtab->pool);
+    strtab->pool = NULL;
+    strtab->size = pos;
+    *size = pos;
+    return strtab->table;
+}
+
+unsigned long
+yasm_strtab_offset(const yasm_strtab *strtab, unsigned long id)
+{
+    return strtab->strs[id].pos;
+}
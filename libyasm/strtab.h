@@ -0,0 +1,109 @@
+/**
+ * \file libyasm/strtab.h
+ * \brief YASM object file string table builder interface.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_STRTAB_H
+#define YASM_STRTAB_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/** Create a string table: a block of NUL-terminated strings that object
+ * formats refer to by offset.  Strings are identified by the ID returned
+ * when they are added; IDs count up from 0 in order of addition.  Adding
+ * a string that is already in the table returns the existing ID.
+ * Offsets are assigned by yasm_strtab_finalize().
+ * \param start     number of bytes to reserve at the start of the table
+ *                  (zero-filled); the first string starts here
+ * \return Newly allocated string table.
+ */
+YASM_LIB_DECL
+/*@only@*/ yasm_strtab *yasm_strtab_create(unsigned long start);
+
+/** Destroy a string table, including any finalized contents.
+ * \param strtab    string table
+ */
+YASM_LIB_DECL
+void yasm_strtab_destroy(/*@only@*/ yasm_strtab *strtab);
+
+/** Add a string to a string table, unless it is already present.
+ * \param strtab    string table
+ * \param str       string
+ * \return ID of the string.
+ */
+YASM_LIB_DECL
+unsigned long yasm_strtab_add(yasm_strtab *strtab, const char *str);
+
+/** Add a string to a string table without looking for an existing copy.
+ * Cheaper than yasm_strtab_add() for strings known to be unique, such as
+ * symbol names.  The string gets its own ID, which is never returned for
+ * other strings by yasm_strtab_add(), and it may later be changed with
+ * yasm_strtab_replace().
+ * \param strtab    string table
+ * \param str       string
+ * \return ID of the string.
+ */
+YASM_LIB_DECL
+unsigned long yasm_strtab_add_unique(yasm_strtab *strtab, const char *str);
+
+/** Change a string added with yasm_strtab_add_unique().
+ * \param strtab    string table
+ * \param id        ID of string
+ * \param str       new string
+ */
+YASM_LIB_DECL
+void yasm_strtab_replace(yasm_strtab *strtab, unsigned long id,
+                         const char *str);
+
+/** Lay out a string table and get its contents.  Without tail merging,
+ * strings are laid out in ID order.  With tail merging, a string that is
+ * the tail of another (such as "text" and ".text") is not stored
+ * separately but points into the longer string.  No strings may be added
+ * afterwards.  Subsequent calls return the same contents.
+ * \param strtab        string table
+ * \param tail_merge    nonzero to merge strings into the tails of others
+ * \param size          (returned) size of the table in bytes, including
+ *                      the reserved bytes at the start
+ * \return Contents of the table, owned by the string table.  The reserved
+ *         bytes at the start may be filled in by the caller.
+ */
+YASM_LIB_DECL
+unsigned char *yasm_strtab_finalize(yasm_strtab *strtab, int tail_merge,
+                                    /*@out@*/ unsigned long *size);
+
+/** Get the offset of a string in a finalized string table.
+ * \param strtab    string table
+ * \param id        ID of string
+ * \return Offset of the string from the start of the table.
+ */
+YASM_LIB_DECL
+unsigned long yasm_strtab_offset(const yasm_strtab *strtab,
+                                 unsigned long id);
+
+#endif
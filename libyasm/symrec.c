@@ -71,6 +71,12 @@ struct yasm_symrec {
         /* bytecode immediately preceding a label */
         /*@dependent@*/ yasm_bytecode *precbc;
     } value;
+
+    /* equ value with nested equs expanded and leveled; NULL if not yet
+     * (or not safely) computed.
+     */
+    /*@null@*/ /*@only@*/ yasm_expr *equ_cache;
+
     unsigned int size;          /* 0 if not user-defined */
     const char *segment;        /* for segmented systems like DOS */
 
@@ -153,6 +159,8 @@ symrec_destroy_one(/*@only@*/ void *d)
     yasm_xfree(sym->name);
     if (sym->type == SYM_EQU && (sym->status & YASM_SYM_VALUED))
         yasm_expr_destroy(sym->value.expn);
+    if (sym->equ_cache)
+        yasm_expr_destroy(sym->equ_cache);
     yasm__assoc_data_destroy(sym->assoc_data);
     yasm_xfree(sym);
 }
@@ -176,6 +184,7 @@ symrec_new_common(/*@keep@*/ char *name, int case_sensitive)
     rec->visibility = YASM_SYM_LOCAL;
     rec->size = 0;
     rec->segment = NULL;
+    rec->equ_cache = NULL;
     rec->assoc_data = NULL;
     return rec;
 }
@@ -544,6 +553,20 @@ yasm_symrec_get_equ(const yasm_symrec *sym)
     return (const yasm_expr *)NULL;
 }
 
+const yasm_expr *
+yasm_symrec__get_equ_cache(const yasm_symrec *sym)
+{
+    return sym->equ_cache;
+}
+
+void
+yasm_symrec__set_equ_cache(yasm_symrec *sym, yasm_expr *e)
+{
+    if (sym->equ_cache)
+        yasm_expr_destroy(sym->equ_cache);
+    sym->equ_cache = e;
+}
+
 int
 yasm_symrec_get_label(const yasm_symrec *sym,
                       yasm_symrec_get_label_bytecodep *precbc)
@@ -309,6 +309,22 @@ YASM_LIB_DECL
 /*@observer@*/ /*@null@*/ const yasm_expr *yasm_symrec_get_equ
     (const yasm_symrec *sym);
 
+/** Get the cached expansion of an EQU value of a symbol.  For expr use only.
+ * \param sym       symbol
+ * \return EQU value with all nested EQUs expanded, or NULL if not cached.
+ */
+YASM_LIB_DECL
+/*@observer@*/ /*@null@*/ const yasm_expr *yasm_symrec__get_equ_cache
+    (const yasm_symrec *sym);
+
+/** Set the cached expansion of an EQU value of a symbol.  For expr use only.
+ * \param sym       symbol
+ * \param e         EQU value with all nested EQUs expanded
+ */
+YASM_LIB_DECL
+void yasm_symrec__set_equ_cache(yasm_symrec *sym,
+                                /*@only@*/ yasm_expr *e);
+
 /** Dependent pointer to a bytecode. */
 typedef /*@dependent@*/ yasm_bytecode *yasm_symrec_get_label_bytecodep;
 
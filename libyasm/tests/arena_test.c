@@ -0,0 +1,208 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "libyasm/coretype.h"
+#include "libyasm/arena.h"
+
+typedef struct Test_Entry {
+    /* test name */
+    const char *name;
+
+    /* test function; returns nonzero and sets failmsg on failure */
+    int (*func) (void);
+} Test_Entry;
+
+static char failed[1000];
+static char failmsg[100];
+
+/* Fill a block with a pattern based on its size. */
+static void
+fill(unsigned char *p, size_t size)
+{
+    size_t i;
+    for (i=0; i<size; i++)
+        p[i] = (unsigned char)(i+size);
+}
+
+static int
+check(const unsigned char *p, size_t size)
+{
+    size_t i;
+    for (i=0; i<size; i++) {
+        if (p[i] != (unsigned char)(i+size))
+            return 1;
+    }
+    return 0;
+}
+
+static int
+test_heap(void)
+{
+    unsigned char *p;
+
+    yasm_arena_set_current(NULL);
+    p = yasm_arena_alloc(24);
+    fill(p, 24);
+    p = yasm_arena_realloc(p, 4000);
+    if (check(p, 24)) {
+        strcpy(failmsg, "heap realloc lost contents");
+        return 1;
+    }
+    yasm_arena_free(p);
+    return 0;
+}
+
+static int
+test_reuse(void)
+{
+    yasm_arena *arena = yasm_arena_create();
+    unsigned char *p, *q;
+    int fail = 0;
+
+    yasm_arena_set_current(arena);
+    p = yasm_arena_alloc(40);
+    yasm_arena_free(p);
+    q = yasm_arena_alloc(40);
+    if (p != q) {
+        strcpy(failmsg, "freed block not reused");
+        fail = 1;
+    }
+    yasm_arena_free(q);
+
+    yasm_arena_destroy(arena);
+    if (yasm_arena_get_current() != NULL) {
+        strcpy(failmsg, "destroyed arena still current");
+        fail = 1;
+    }
+    return fail;
+}
+
+static int
+test_sizes(void)
+{
+    yasm_arena *arena = yasm_arena_create();
+    unsigned char *p[64];
+    unsigned long peak, reserved;
+    size_t size;
+    int i, fail = 0;
+
+    yasm_arena_set_current(arena);
+    for (i=0; i<64; i++) {
+        size = (size_t)(i*i*3);       /* up to large (heap) blocks */
+        p[i] = yasm_arena_alloc(size);
+        fill(p[i], size);
+    }
+    for (i=0; i<64; i++) {
+        size = (size_t)(i*i*3);
+        p[i] = yasm_arena_realloc(p[i], size+20);
+        if (check(p[i], size)) {
+            sprintf(failmsg, "realloc of %lu bytes lost contents",
+                    (unsigned long)size);
+            fail = 1;
+        }
+    }
+
+    yasm_arena_get_stats(arena, &peak, &reserved);
+    if (peak < 64*20 || reserved == 0) {
+        strcpy(failmsg, "bad statistics");
+        fail = 1;
+    }
+
+    for (i=0; i<64; i+=2)
+        yasm_arena_free(p[i]);
+    yasm_arena_destroy(arena);
+    return fail;
+}
+
+static int
+test_child(void)
+{
+    yasm_arena *arena = yasm_arena_create();
+    yasm_arena *child = yasm_arena_create_child(arena);
+    unsigned char *p, *q, *r;
+    int fail = 0;
+
+    yasm_arena_set_current(arena);
+    p = yasm_arena_alloc(100);
+
+    /* Allocate from the child and free a parent block into it */
+    yasm_arena_set_current(child);
+    q = yasm_arena_alloc(100);
+    fill(q, 100);
+    yasm_arena_free(p);
+    yasm_arena_set_current(arena);
+    yasm_arena_merge(child);
+
+    /* Child's blocks and free lists now belong to the parent */
+    if (check(q, 100)) {
+        strcpy(failmsg, "child block changed by merge");
+        fail = 1;
+    }
+    r = yasm_arena_alloc(100);
+    if (r != p) {
+        strcpy(failmsg, "child free list not merged");
+        fail = 1;
+    }
+    yasm_arena_free(q);
+    yasm_arena_free(r);
+    yasm_arena_destroy(arena);
+    return fail;
+}
+
+static Test_Entry tests[] = {
+    {"heap", test_heap},
+    {"reuse", test_reuse},
+    {"sizes", test_sizes},
+    {"child", test_child},
+};
+
+int
+main(void)
+{
+    int nf = 0;
+    int numtests = sizeof(tests)/sizeof(Test_Entry);
+    int i;
+
+    failed[0] = '\0';
+    printf("Test arena_test: ");
+    for (i=0; i<numtests; i++) {
+        int fail = tests[i].func();
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s: %s\n", failed, tests[i].name,
+                    failmsg);
+        nf += fail;
+    }
+
+    printf(" +%d-%d/%d %d%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,211 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "libyasm/coretype.h"
+#include "libyasm/bitvect.h"
+#include "libyasm/intnum.h"
+#include "libyasm/floatnum.h"
+#include "libyasm/errwarn.h"
+#include "libyasm/assemble.h"
+
+typedef struct Test_Entry {
+    /* input source */
+    const char *input;
+
+    /* options (NULL for default) */
+    const char *parser;
+    const char *preproc;
+    const char *objfmt;
+    const char *predefine;
+
+    /* correct number of errors */
+    unsigned int num_errors;
+
+    /* correct object image (if no errors) and its length */
+    const char *result;
+    unsigned long result_len;
+
+    /* string that must appear in the messages (NULL for no messages) */
+    const char *message;
+} Test_Entry;
+
+static Test_Entry tests[] = {
+    {"nop\nret\n", NULL, NULL, NULL, NULL, 0, "\x90\xc3", 2, NULL},
+    {"mov ax, 1", NULL, NULL, NULL, NULL, 0, "\xb8\x01\x00", 3, NULL},
+    {"bits 32\nmov eax, 1\n", NULL, NULL, NULL, NULL, 0,
+     "\xb8\x01\x00\x00\x00", 5, NULL},
+    {"db FOO\n", NULL, NULL, NULL, "FOO=5", 0, "\x05", 1, NULL},
+    {"%ifidn __YASM_OBJFMT__, bin\ndb 1\n%endif\n", NULL, NULL, NULL, NULL,
+     0, "\x01", 1, NULL},
+    {"nop\nmov eax,\nnop\n", NULL, NULL, NULL, NULL, 1, NULL, 0,
+     "-:2: error: "},
+    {"db 256\n", NULL, NULL, NULL, NULL, 0, "\x00", 1,
+     "-:1: warning: "},
+    {"nop\n", "gas", NULL, NULL, NULL, 0, "\x90", 1, NULL},
+    {"nop\n", NULL, "raw", NULL, NULL, 0, "\x90", 1, NULL},
+    {"nop\n", "gas", "cpp", NULL, NULL, 1, NULL, 0, "cannot read"},
+    {"nop\n", NULL, "gas", NULL, NULL, 1, NULL, 0, "not a valid"},
+    {"nop\n", NULL, NULL, "nosuch", NULL, 1, NULL, 0, "nosuch"},
+    {"nop\n", NULL, NULL, "elf64", NULL, 0, NULL, 0, NULL},
+    /* state must not leak from the previous unit */
+    {"nop\nret\n", NULL, NULL, NULL, NULL, 0, "\x90\xc3", 2, NULL},
+};
+
+#define INCNAME     "assemble_test.inc"
+
+static char failed[1000];
+static char failmsg[100];
+
+static int
+run_test(Test_Entry *test)
+{
+    yasm_assemble_options opts;
+    yasm_assemble_result result;
+    const char *predefines[2];
+    int ret;
+
+    yasm_assemble_options_init(&opts);
+    opts.parser = test->parser;
+    opts.preproc = test->preproc;
+    opts.objfmt = test->objfmt;
+    if (test->predefine) {
+        predefines[0] = test->predefine;
+        predefines[1] = NULL;
+        opts.predefines = predefines;
+    }
+
+    ret = yasm_assemble(test->input, strlen(test->input), &opts, &result);
+
+    if ((ret != 0) != (test->num_errors != 0) ||
+        result.num_errors != test->num_errors) {
+        sprintf(failmsg, "test %d: expected %u errors, got %u",
+                (int)(test - tests), test->num_errors, result.num_errors);
+        goto fail;
+    }
+    if (test->num_errors == 0 && !result.obj) {
+        sprintf(failmsg, "test %d: no object", (int)(test - tests));
+        goto fail;
+    }
+    if (test->result && (result.obj_len != test->result_len ||
+                         memcmp(result.obj, test->result,
+                                test->result_len) != 0)) {
+        sprintf(failmsg, "test %d: object mismatch (length %lu)",
+                (int)(test - tests), result.obj_len);
+        goto fail;
+    }
+    if (test->message ? strstr(result.messages, test->message) == NULL
+                      : result.messages[0] != '\0') {
+        sprintf(failmsg, "test %d: unexpected messages", (int)(test - tests));
+        goto fail;
+    }
+
+    yasm_assemble_result_delete(&result);
+    return 0;
+
+fail:
+    yasm_assemble_result_delete(&result);
+    return 1;
+}
+
+/* Assemble an incbin of a file with the given contents.  Included files
+ * must not be kept from one unit to the next.
+ */
+static int
+run_incbin_test(const char *data)
+{
+    static const char input[] = "incbin \"" INCNAME "\"\n";
+    yasm_assemble_options opts;
+    yasm_assemble_result result;
+    unsigned long len = (unsigned long)strlen(data);
+    FILE *f;
+
+    f = fopen(INCNAME, "wb");
+    if (!f) {
+        sprintf(failmsg, "incbin: could not create %s", INCNAME);
+        return 1;
+    }
+    fputs(data, f);
+    fclose(f);
+
+    yasm_assemble_options_init(&opts);
+    if (yasm_assemble(input, strlen(input), &opts, &result) != 0 ||
+        result.obj_len != len || memcmp(result.obj, data, len) != 0) {
+        sprintf(failmsg, "incbin: object mismatch (length %lu)",
+                result.obj_len);
+        yasm_assemble_result_delete(&result);
+        return 1;
+    }
+    yasm_assemble_result_delete(&result);
+    return 0;
+}
+
+int
+main(void)
+{
+    int nf = 0;
+    int numtests = sizeof(tests)/sizeof(Test_Entry);
+    int i;
+
+    if (BitVector_Boot() != ErrCode_Ok)
+        return EXIT_FAILURE;
+    yasm_intnum_initialize();
+    yasm_floatnum_initialize();
+    yasm_errwarn_initialize();
+
+    failed[0] = '\0';
+    printf("Test assemble_test: ");
+    for (i=0; i<numtests; i++) {
+        int fail = run_test(&tests[i]);
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+    }
+    for (i=0; i<2; i++) {
+        int fail = run_incbin_test(i == 0 ? "AAAA" : "BBBBBBBB");
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+        numtests++;
+    }
+    remove(INCNAME);
+
+    yasm_floatnum_cleanup();
+    yasm_intnum_cleanup();
+    yasm_errwarn_cleanup();
+    BitVector_Shutdown();
+
+    printf(" +%d-%d/%d %d%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
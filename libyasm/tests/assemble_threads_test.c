@@ -0,0 +1,210 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#ifdef YASM_HAVE_THREADS
+#include <pthread.h>
+#endif
+
+#include "libyasm/coretype.h"
+#include "libyasm/bitvect.h"
+#include "libyasm/intnum.h"
+#include "libyasm/floatnum.h"
+#include "libyasm/errwarn.h"
+#include "libyasm/assemble.h"
+
+#define NUM_THREADS     8
+#define NUM_ROUNDS      4
+
+typedef struct Test_Entry {
+    /* input source */
+    const char *input;
+
+    /* options (NULL for default) */
+    const char *parser;
+    const char *preproc;
+    const char *objfmt;
+    const char *dbgfmt;
+
+    /* result of the serial run, filled in by main() */
+    yasm_assemble_result serial;
+} Test_Entry;
+
+static Test_Entry tests[] = {
+    /* big integer and float arithmetic, macros */
+    {"bits 64\n"
+     "%macro pushall 1-*\n%rep %0\npush %1\n%rotate 1\n%endrep\n%endmacro\n"
+     "%assign i 0\n%rep 64\n"
+     "dq 0x123456789abcdef * i + (1 << 62) / (i + 1)\n"
+     "dq -0x7fffffffffffffff % (i + 3)\n"
+     "%assign i i+1\n%endrep\n"
+     "pushall rax, rbx, rcx, r15\n"
+     "dt 3.14159265358979323846\ndd 1.5e10\ndq -2.5e-300\n",
+     NULL, NULL, NULL, NULL},
+    {"section .text\nglobal f\nextern g\n"
+     "f: call g\nlea rax, [rel data]\nret\n"
+     "section .data\ndata: dq f, g + 0x100000000\n",
+     NULL, NULL, "elf64", "dwarf2"},
+    {"section .text\nglobal f\nf: mov eax, [f]\njmp f\n"
+     "section .data\ndd f\n",
+     NULL, NULL, "rdf", NULL},
+    {"section .text\nglobal _f\n_f: mov rax, 0x1122334455667788\nret\n",
+     NULL, NULL, "macho64", NULL},
+    {".text\nmain: movl $0x12345678, %eax\n"
+     ".rept 10\n.long main+3\n.endr\n"
+     ".data\n.quad 0xfedcba9876543210\n.byte 1, 2\n",
+     "gas", "gas", "elf32", "stabs"},
+    /* the gas parser suppresses unrecognized character warnings while
+     * skipping the rest of an intel syntax line...
+     */
+    {".intel_syntax noprefix\nnop `\nnop\n", "gas", "gas", NULL, NULL},
+    /* ... which other units should still report */
+    {"nop\ndb 1 `\n", NULL, NULL, NULL, NULL},
+    {"bits 32\nadd ecx, [byte ebx*8+06h]\n", NULL, NULL, NULL, NULL},
+    {"nop\njmp nowhere\ndb 300\n", NULL, NULL, NULL, NULL},
+    {"%define X 7\n%if X > 5\ndb 0x1234\n%else\n%error no\n%endif\n",
+     NULL, NULL, NULL, NULL},
+};
+
+#define NUM_TESTS   (sizeof(tests)/sizeof(Test_Entry))
+
+static char failed[1000];
+
+static int
+run_test(Test_Entry *test, yasm_assemble_result *result)
+{
+    yasm_assemble_options opts;
+
+    yasm_assemble_options_init(&opts);
+    opts.parser = test->parser;
+    opts.preproc = test->preproc;
+    opts.objfmt = test->objfmt;
+    opts.dbgfmt = test->dbgfmt;
+    return yasm_assemble(test->input, strlen(test->input), &opts, result);
+}
+
+/* Assemble every test (starting at a different one in each thread, so that
+ * different units overlap) and compare against the serial results.
+ * Returns the number of mismatches.
+ */
+static void *
+run_tests(void *arg)
+{
+    unsigned long start = (unsigned long)(uintptr_t)arg;
+    unsigned long nf = 0;
+    unsigned int round, i;
+
+    for (round=0; round<NUM_ROUNDS; round++) {
+        for (i=0; i<NUM_TESTS; i++) {
+            Test_Entry *test = &tests[(start+round+i) % NUM_TESTS];
+            yasm_assemble_result result;
+
+            run_test(test, &result);
+            if (result.num_errors != test->serial.num_errors ||
+                result.obj_len != test->serial.obj_len ||
+                (result.obj_len > 0 &&
+                 memcmp(result.obj, test->serial.obj, result.obj_len) != 0) ||
+                strcmp(result.messages, test->serial.messages) != 0)
+                nf++;
+            yasm_assemble_result_delete(&result);
+        }
+    }
+    return (void *)(uintptr_t)nf;
+}
+
+int
+main(void)
+{
+    unsigned long nf = 0;
+    int numtests = NUM_THREADS;
+    unsigned int i;
+#ifdef YASM_HAVE_THREADS
+    pthread_t threads[NUM_THREADS];
+#endif
+
+    if (BitVector_Boot() != ErrCode_Ok)
+        return EXIT_FAILURE;
+    yasm_intnum_initialize();
+    yasm_floatnum_initialize();
+    yasm_errwarn_initialize();
+
+    /* Serial reference results */
+    for (i=0; i<NUM_TESTS; i++)
+        run_test(&tests[i], &tests[i].serial);
+
+    failed[0] = '\0';
+    printf("Test assemble_threads_test: ");
+#ifdef YASM_HAVE_THREADS
+    for (i=0; i<NUM_THREADS; i++) {
+        if (pthread_create(&threads[i], NULL, run_tests,
+                           (void *)(uintptr_t)i) != 0) {
+            printf("cannot create thread\n");
+            return EXIT_FAILURE;
+        }
+    }
+    for (i=0; i<NUM_THREADS; i++) {
+        void *ret;
+        unsigned long fail;
+
+        pthread_join(threads[i], &ret);
+        fail = (unsigned long)(uintptr_t)ret;
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: thread %u: %lu mismatches\n", failed,
+                    i, fail);
+        nf += fail > 0;
+    }
+#else
+    /* No threads; at least check that units don't affect each other */
+    for (i=0; i<NUM_THREADS; i++) {
+        unsigned long fail = (unsigned long)(uintptr_t)
+            run_tests((void *)(uintptr_t)i);
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: pass %u: %lu mismatches\n", failed,
+                    i, fail);
+        nf += fail > 0;
+    }
+#endif
+
+    for (i=0; i<NUM_TESTS; i++)
+        yasm_assemble_result_delete(&tests[i].serial);
+
+    yasm_floatnum_cleanup();
+    yasm_intnum_cleanup();
+    yasm_errwarn_cleanup();
+    BitVector_Shutdown();
+
+    printf(" +%lu-%lu/%d %lu%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
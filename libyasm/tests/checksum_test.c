@@ -0,0 +1,203 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libyasm/coretype.h"
+#include "libyasm/md5.h"
+#include "libyasm/sha256.h"
+#include "libyasm/checksum.h"
+
+/* Checks MD5 and SHA-256 against published test vectors, hashing both in
+ * one call and in odd-sized pieces, and through yasm_checksum_file() (which
+ * is also checked to notice a changed file).
+ */
+
+#define TMPNAME     "checksum_test.tmp"
+
+typedef struct Test_Entry {
+    /* checksum type */
+    yasm_checksum_type type;
+
+    /* input, and number of times it's repeated */
+    const char *input;
+    unsigned long repeat;
+
+    /* correct checksum (as hex string) */
+    const char *result;
+} Test_Entry;
+
+static Test_Entry tests[] = {
+    {YASM_CHECKSUM_MD5, "", 1, "d41d8cd98f00b204e9800998ecf8427e"},
+    {YASM_CHECKSUM_MD5, "abc", 1, "900150983cd24fb0d6963f7d28e17f72"},
+    {YASM_CHECKSUM_MD5, "message digest", 1,
+     "f96b697d7cb7938d525a2f31aaf161d0"},
+    {YASM_CHECKSUM_MD5, "a", 1000000, "7707d6ae4e027c70eea2a935c2296f21"},
+    {YASM_CHECKSUM_SHA256, "", 1,
+     "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {YASM_CHECKSUM_SHA256, "abc", 1,
+     "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {YASM_CHECKSUM_SHA256,
+     "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {YASM_CHECKSUM_SHA256,
+     "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+     "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+     "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"},
+    {YASM_CHECKSUM_SHA256, "a", 1000000,
+     "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+};
+
+static char failed[1000];
+static char failmsg[200];
+
+static int
+check_digest(const char *how, Test_Entry *test, const unsigned char *digest)
+{
+    char hex[2*YASM_CHECKSUM_MAX_SIZE+1];
+    size_t i;
+
+    for (i=0; i<yasm_checksum_size(test->type); i++)
+        sprintf(&hex[2*i], "%02x", digest[i]);
+    if (strcmp(hex, test->result) != 0) {
+        sprintf(failmsg, "%s \"%.10s\"x%lu: expected %.16s..., got %.16s...",
+                how, test->input, test->repeat, test->result, hex);
+        return 1;
+    }
+    return 0;
+}
+
+/* Hash in pieces of increasing size, to cross block boundaries at every
+ * offset.
+ */
+static void
+hash_pieces(Test_Entry *test, const unsigned char *buf, size_t len,
+            unsigned char *digest)
+{
+    yasm_md5_context md5;
+    yasm_sha256_context sha256;
+    size_t piece = 1;
+
+    if (test->type == YASM_CHECKSUM_SHA256)
+        yasm_sha256_init(&sha256);
+    else
+        yasm_md5_init(&md5);
+    while (len > 0) {
+        size_t n = piece < len ? piece : len;
+        if (test->type == YASM_CHECKSUM_SHA256)
+            yasm_sha256_update(&sha256, buf, (unsigned long)n);
+        else
+            yasm_md5_update(&md5, buf, (unsigned long)n);
+        buf += n;
+        len -= n;
+        piece = piece % 131 + 1;
+    }
+    if (test->type == YASM_CHECKSUM_SHA256)
+        yasm_sha256_final(digest, &sha256);
+    else
+        yasm_md5_final(digest, &md5);
+}
+
+static int
+run_test(Test_Entry *test)
+{
+    unsigned char digest[YASM_CHECKSUM_MAX_SIZE];
+    size_t inlen = strlen(test->input);
+    size_t len = inlen*test->repeat;
+    unsigned char *buf = malloc(len+1);
+    unsigned long i;
+    FILE *f;
+    int fail = 0;
+
+    for (i=0; i<test->repeat; i++)
+        memcpy(&buf[i*inlen], test->input, inlen);
+
+    yasm_checksum_buf(test->type, buf, len, digest);
+    fail = check_digest("buf", test, digest);
+
+    if (!fail) {
+        hash_pieces(test, buf, len, digest);
+        fail = check_digest("pieces", test, digest);
+    }
+
+    /* Through a file: once to read it, once from the cache */
+    f = fopen(TMPNAME, "wb");
+    if (f) {
+        fwrite(buf, 1, len, f);
+        fclose(f);
+    }
+    for (i=0; i<2 && !fail; i++) {
+        if (yasm_checksum_file(TMPNAME, test->type, digest)) {
+            sprintf(failmsg, "could not checksum %s", TMPNAME);
+            fail = 1;
+        } else
+            fail = check_digest(i == 0 ? "file" : "cached file", test,
+                                digest);
+    }
+
+    /* Change the file (size); the cached result must not be used */
+    f = fopen(TMPNAME, "ab");
+    if (f) {
+        fputc('x', f);
+        fclose(f);
+    }
+    if (!fail && (yasm_checksum_file(TMPNAME, test->type, digest) ||
+                  check_digest("changed file", test, digest) == 0)) {
+        sprintf(failmsg, "changed file \"%.10s\"x%lu: stale checksum",
+                test->input, test->repeat);
+        fail = 1;
+    }
+
+    remove(TMPNAME);
+    free(buf);
+    return fail;
+}
+
+int
+main(void)
+{
+    int nf = 0;
+    int numtests = sizeof(tests)/sizeof(Test_Entry);
+    int i;
+
+    failed[0] = '\0';
+    printf("Test checksum_test: ");
+    for (i=0; i<numtests; i++) {
+        int fail = run_test(&tests[i]);
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+    }
+
+    yasm_checksum_cleanup();
+
+    printf(" +%d-%d/%d %d%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
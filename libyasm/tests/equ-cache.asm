@@ -0,0 +1,14 @@
+; equ values are expanded once and reused on later references
+c0 equ 1
+c1 equ c0*3+1
+c2 equ c1*3+2
+	dd c2, c2 & 0xff, c1-c2
+; forward reference: not cached until y is defined
+x equ y+1
+	times 2 dd x
+y equ 5
+	dd x, x*2
+; label in an equ
+z equ w+2
+w:	dd z, z-w
+	mov ax, [bx+c1]
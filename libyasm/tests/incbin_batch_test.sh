@@ -0,0 +1,60 @@
+#! /bin/sh
+# Assemble a batch of units that each incbin a different file, with fewer
+# file descriptors available than there are files.  Included files must be
+# closed as each unit finishes.
+
+YASM_TEST_SUITE=1
+export YASM_TEST_SUITE
+
+case `echo "testing\c"; echo 1,2,3`,`echo -n testing; echo 1,2,3` in
+  *c*,-n*) ECHO_N= ECHO_C='
+' ECHO_T='      ' ;;
+  *c*,*  ) ECHO_N=-n ECHO_C= ECHO_T= ;;
+  *)       ECHO_N= ECHO_C='\c' ECHO_T= ;;
+esac
+
+units=300
+fdlimit=64
+dir=results/incbin_batch
+
+rm -rf ${dir}
+mkdir -p ${dir} >/dev/null 2>&1
+
+echo $ECHO_N "Test incbin_batch_test: $ECHO_C"
+
+i=0
+: > ${dir}/batch
+while test $i -lt $units; do
+    echo "data $i" > ${dir}/inc$i.bin
+    echo "incbin \"inc$i.bin\"" > ${dir}/unit$i.asm
+    echo "${dir}/unit$i.asm ${dir}/unit$i.o" >> ${dir}/batch
+    i=`expr $i + 1`
+done
+
+# Run within a subshell to limit descriptors and hide signal messages.
+sh -c "ulimit -n ${fdlimit} && ./yasm -f bin --batch=${dir}/batch 2>${dir}/errwarn" >/dev/null 2>/dev/null
+status=$?
+
+failed=
+if test $status -gt 128; then
+    failed="C: yasm crashed!"
+elif test $status -gt 0; then
+    failed="E: yasm returned an error code!"
+else
+    i=0
+    while test $i -lt $units; do
+        if cmp -s ${dir}/inc$i.bin ${dir}/unit$i.o; then :; else
+            failed="O: unit$i did not match included file!"
+            break
+        fi
+        i=`expr $i + 1`
+    done
+fi
+
+if test -z "$failed"; then
+    echo " +1-0/1 100%"
+    exit 0
+fi
+echo " +0-1/1 0%"
+echo " ** $failed"
+exit 1
@@ -0,0 +1,276 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libyasm/intnum.c"
+
+/* Checks the native long fast path of yasm_intnum_calc() against the full
+ * bitvector calculation (intnum_calc_bv()) for every operator, on edge
+ * values and pseudo-random operands of all magnitudes.
+ *
+ * Given an iteration count on the command line, also times a typical
+ * constant fold sequence both ways: intnum_test [iterations]
+ */
+
+typedef struct Test_Entry {
+    /* operator */
+    yasm_expr_op op;
+
+    /* operator name (for failure messages) */
+    const char *name;
+} Test_Entry;
+
+static Test_Entry tests[] = {
+    {YASM_EXPR_ADD, "ADD"},
+    {YASM_EXPR_SUB, "SUB"},
+    {YASM_EXPR_MUL, "MUL"},
+    {YASM_EXPR_DIV, "DIV"},
+    {YASM_EXPR_SIGNDIV, "SIGNDIV"},
+    {YASM_EXPR_MOD, "MOD"},
+    {YASM_EXPR_SIGNMOD, "SIGNMOD"},
+    {YASM_EXPR_NEG, "NEG"},
+    {YASM_EXPR_NOT, "NOT"},
+    {YASM_EXPR_OR, "OR"},
+    {YASM_EXPR_AND, "AND"},
+    {YASM_EXPR_XOR, "XOR"},
+    {YASM_EXPR_XNOR, "XNOR"},
+    {YASM_EXPR_NOR, "NOR"},
+    {YASM_EXPR_SHL, "SHL"},
+    {YASM_EXPR_SHR, "SHR"},
+    {YASM_EXPR_LOR, "LOR"},
+    {YASM_EXPR_LAND, "LAND"},
+    {YASM_EXPR_LNOT, "LNOT"},
+    {YASM_EXPR_LXOR, "LXOR"},
+    {YASM_EXPR_LXNOR, "LXNOR"},
+    {YASM_EXPR_LNOR, "LNOR"},
+    {YASM_EXPR_LT, "LT"},
+    {YASM_EXPR_GT, "GT"},
+    {YASM_EXPR_EQ, "EQ"},
+    {YASM_EXPR_LE, "LE"},
+    {YASM_EXPR_GE, "GE"},
+    {YASM_EXPR_NE, "NE"},
+    {YASM_EXPR_IDENT, "IDENT"},
+};
+
+static const long edge_values[] = {
+    0, 1, -1, 2, -2, 3, -3, 7, -8, 31, 32, 33, 63, 64, 65, 255, 256, -256,
+    0x7FFF, -0x8000, 0x7FFFFFFFL, -0x7FFFFFFFL-1, 0x12345678L, -0x12345678L,
+    LONG_MAX, LONG_MAX-1, LONG_MAX/2, LONG_MAX/2+1, LONG_MIN, LONG_MIN+1,
+    LONG_MIN/2, LONG_MIN/2-1
+};
+
+#define NUM_EDGE    (sizeof(edge_values)/sizeof(long))
+#define NUM_RANDOM  1000
+
+static char failed[1000];
+static char failmsg[100];
+
+static unsigned long rand_state = 1;
+
+/* Simple LCG, so results are repeatable across platforms. */
+static unsigned long
+next_rand(void)
+{
+    rand_state = rand_state * 1103515245UL + 12345UL;
+    return (rand_state >> 16) & 0x7FFF;
+}
+
+/* Random value of random magnitude (and sign). */
+static long
+random_value(void)
+{
+    unsigned long u = 0;
+    unsigned int bits, i;
+
+    for (i=0; i<LONG_BITS; i+=15)
+        u = (u << 15) | next_rand();
+    bits = (unsigned int)(next_rand() % LONG_BITS) + 1;
+    if (bits < LONG_BITS)
+        u &= (1UL << bits) - 1;
+    return (long)u;
+}
+
+/* Returns nonzero if the results differ. */
+static int
+compare_result(const yasm_intnum *a, const yasm_intnum *b)
+{
+    if (a->type != b->type)
+        return 1;
+    if (a->type == INTNUM_L)
+        return a->val.l != b->val.l;
+    return !BitVector_equal(a->val.bv, b->val.bv);
+}
+
+static int
+run_one(Test_Entry *test, long a, long b)
+{
+    yasm_intnum *fast = yasm_intnum_create_int(a);
+    yasm_intnum *slow = yasm_intnum_create_int(a);
+    yasm_intnum *operand = yasm_intnum_create_int(b);
+    int fast_err, slow_err, bad;
+
+    /* the bitvector path shifts one bit at a time */
+    if (test->op == YASM_EXPR_SHR && b > 1000)
+        yasm_intnum_set_int(operand, 1000);
+
+    fast_err = yasm_intnum_calc(fast, test->op, operand);
+    yasm_error_clear();
+    slow_err = intnum_calc_bv(slow, test->op, operand);
+    yasm_error_clear();
+
+    bad = fast_err != slow_err || (!fast_err && compare_result(fast, slow));
+    if (bad)
+        sprintf(failmsg, "%s %ld, %ld: expected %ld, got %ld", test->name,
+                a, b, yasm_intnum_get_int(slow), yasm_intnum_get_int(fast));
+
+    yasm_intnum_destroy(operand);
+    yasm_intnum_destroy(slow);
+    yasm_intnum_destroy(fast);
+    return bad;
+}
+
+static int
+run_test(Test_Entry *test)
+{
+    unsigned int i, j;
+
+    for (i=0; i<NUM_EDGE; i++) {
+        for (j=0; j<NUM_EDGE; j++) {
+            if (run_one(test, edge_values[i], edge_values[j]))
+                return 1;
+        }
+    }
+
+    rand_state = 1;
+    for (i=0; i<NUM_RANDOM; i++) {
+        long a = random_value(), b;
+
+        if (test->op == YASM_EXPR_SHL || test->op == YASM_EXPR_SHR)
+            b = (long)(next_rand() % (LONG_BITS+2));
+        else
+            b = random_value();
+        if (next_rand() & 1)
+            a = -a;
+        if (next_rand() & 1)
+            b = -b;
+        if (run_one(test, a, b))
+            return 1;
+    }
+    return 0;
+}
+
+/* A typical constant expression fold: (((i*3+7)<<2)/5 & 0xFFFF) - i % 13 */
+static long
+fold(int (*calc) (yasm_intnum *, yasm_expr_op, yasm_intnum *),
+     yasm_intnum *acc, yasm_intnum **ops, long i)
+{
+    yasm_intnum_set_int(acc, i);
+    calc(acc, YASM_EXPR_MUL, ops[0]);
+    calc(acc, YASM_EXPR_ADD, ops[1]);
+    calc(acc, YASM_EXPR_SHL, ops[2]);
+    calc(acc, YASM_EXPR_SIGNDIV, ops[3]);
+    calc(acc, YASM_EXPR_AND, ops[4]);
+    yasm_intnum_set_int(ops[6], i);
+    calc(ops[6], YASM_EXPR_SIGNMOD, ops[5]);
+    calc(acc, YASM_EXPR_SUB, ops[6]);
+    return yasm_intnum_get_int(acc);
+}
+
+static double
+run_bench(int (*calc) (yasm_intnum *, yasm_expr_op, yasm_intnum *),
+          long iterations, long *sum)
+{
+    static const long opvals[] = {3, 7, 2, 5, 0xFFFF, 13, 0};
+    yasm_intnum *acc = yasm_intnum_create_int(0);
+    yasm_intnum *ops[sizeof(opvals)/sizeof(long)];
+    clock_t start;
+    long i;
+    double secs;
+
+    for (i=0; i<(long)(sizeof(opvals)/sizeof(long)); i++)
+        ops[i] = yasm_intnum_create_int(opvals[i]);
+
+    *sum = 0;
+    start = clock();
+    for (i=0; i<iterations; i++)
+        *sum += fold(calc, acc, ops, i);
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    for (i=0; i<(long)(sizeof(opvals)/sizeof(long)); i++)
+        yasm_intnum_destroy(ops[i]);
+    yasm_intnum_destroy(acc);
+    return secs;
+}
+
+static void
+bench(long iterations)
+{
+    long fast_sum, slow_sum;
+    double fast = run_bench(yasm_intnum_calc, iterations, &fast_sum);
+    double slow = run_bench(intnum_calc_bv, iterations, &slow_sum);
+    double nops = 7.0 * iterations / 1e6;
+
+    printf("fold x%ld: long %.3fs (%.1f Mops/s), bitvect %.3fs "
+           "(%.1f Mops/s), %.1fx%s\n", iterations,
+           fast, fast > 0 ? nops/fast : 0.0, slow, slow > 0 ? nops/slow : 0.0,
+           fast > 0 ? slow/fast : 0.0,
+           fast_sum != slow_sum ? " (RESULTS DIFFER)" : "");
+}
+
+int
+main(int argc, char *argv[])
+{
+    int nf = 0;
+    int numtests = sizeof(tests)/sizeof(Test_Entry);
+    int i;
+
+    if (BitVector_Boot() != ErrCode_Ok)
+        return EXIT_FAILURE;
+    yasm_intnum_initialize();
+
+    failed[0] = '\0';
+    printf("Test intnum_test: ");
+    for (i=0; i<numtests; i++) {
+        int fail = run_test(&tests[i]);
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+    }
+
+    printf(" +%d-%d/%d %d%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+
+    if (argc > 1)
+        bench(atol(argv[1]));
+
+    yasm_intnum_cleanup();
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,154 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libyasm/coretype.h"
+#include "libyasm/linemap.h"
+
+/* Checks that yasm_linemap_lookup_id() finds the same mapping whatever the
+ * order of lookups (it caches the last mapping found), and that filename
+ * IDs are assigned in order of first use.
+ */
+
+typedef struct Test_Entry {
+    /* virtual line */
+    unsigned long line;
+
+    /* correct filename, filename ID, and file line */
+    const char *filename;
+    unsigned long filename_id;
+    unsigned long file_line;
+} Test_Entry;
+
+static Test_Entry tests[] = {
+    {1, "a.asm", 0, 1},
+    {4, "a.asm", 0, 4},
+    {5, "b.inc", 1, 1},
+    {7, "b.inc", 1, 3},
+    {8, "c.inc", 2, 10},
+    {9, "c.inc", 2, 11},
+    {11, "c.inc", 2, 13},
+    {12, "b.inc", 1, 4},
+    {19, "b.inc", 1, 11},
+    {20, "a.asm", 0, 6},
+    {29, "a.asm", 0, 15},
+    {30, "a.asm", 0, 100},
+    {35, "a.asm", 0, 100},
+};
+
+#define NUM_TESTS   (sizeof(tests)/sizeof(Test_Entry))
+
+static char failed[1000];
+static char failmsg[100];
+
+static yasm_linemap *
+create_linemap(void)
+{
+    yasm_linemap *linemap = yasm_linemap_create();
+
+    while (yasm_linemap_get_current(linemap) < 40)
+        yasm_linemap_goto_next(linemap);
+    yasm_linemap_set(linemap, "a.asm", 1, 1, 1);
+    yasm_linemap_set(linemap, "b.inc", 5, 1, 1);
+    yasm_linemap_set(linemap, "c.inc", 8, 10, 1);
+    yasm_linemap_set(linemap, "b.inc", 12, 4, 1);
+    yasm_linemap_set(linemap, "a.asm", 20, 6, 1);
+    yasm_linemap_set(linemap, NULL, 30, 100, 0);
+    return linemap;
+}
+
+static int
+run_test(yasm_linemap *linemap, Test_Entry *test)
+{
+    const char *filename;
+    unsigned long filename_id, file_line;
+
+    yasm_linemap_lookup_id(linemap, test->line, &filename, &filename_id,
+                           &file_line);
+    if (strcmp(filename, test->filename) != 0
+        || filename_id != test->filename_id
+        || file_line != test->file_line) {
+        sprintf(failmsg, "line %lu: expected %s:%lu (%lu), got %s:%lu (%lu)",
+                test->line, test->filename, test->file_line,
+                test->filename_id, filename, file_line, filename_id);
+        return 1;
+    }
+    return 0;
+}
+
+/* Looks up every entry, in an order that depends on pass: forward,
+ * backward, and strided.
+ */
+static int
+run_pass(int pass)
+{
+    yasm_linemap *linemap = create_linemap();
+    unsigned int i, j;
+    int fail = 0;
+
+    if (yasm_linemap_get_num_filenames(linemap) != 3) {
+        sprintf(failmsg, "expected 3 filenames, got %lu",
+                yasm_linemap_get_num_filenames(linemap));
+        fail = 1;
+    }
+
+    for (i=0; i<NUM_TESTS && !fail; i++) {
+        switch (pass) {
+            case 0: j = i; break;
+            case 1: j = NUM_TESTS-1-i; break;
+            default: j = (i*5) % NUM_TESTS; break;
+        }
+        fail = run_test(linemap, &tests[j]);
+    }
+
+    yasm_linemap_destroy(linemap);
+    return fail;
+}
+
+int
+main(void)
+{
+    int nf = 0;
+    int numtests = 3;
+    int i;
+
+    failed[0] = '\0';
+    printf("Test linemap_test: ");
+    for (i=0; i<numtests; i++) {
+        int fail = run_pass(i);
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+    }
+
+    printf(" +%d-%d/%d %d%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,101 @@
+#! /usr/bin/env python
+# Optimizer benchmark: incremental vs. full offset/span recomputation
+#
+#  Copyright (C) 2026  Yasm developers
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Generates a large, jump-dense source in which only a few jumps need to
+# be expanded, and times yasm with the default (incremental) optimizer
+# against --full-opt.  Also verifies the two produce identical output.
+#
+# Usage: optimize_bench.py [path-to-yasm] [instructions] [runs]
+#
+from __future__ import print_function
+
+import os
+import sys
+import tempfile
+import time
+import subprocess
+
+def generate(f, count):
+    print("bits 64", file=f)
+    for i in range(count):
+        if i % 1000 == 0:
+            # far enough away to need a near jump
+            target = i + 200 if i + 200 < count else 0
+            print("L%d: jmp L%d" % (i, target), file=f)
+        elif i % 3 == 0:
+            target = i + 5 if i + 5 < count else i
+            print("L%d: jnz L%d" % (i, target), file=f)
+        elif i % 3 == 1:
+            # label difference; span with an absolute term
+            target = i + 3 if i + 3 < count else i
+            print("L%d: add eax, L%d - L%d" % (i, target, i), file=f)
+        else:
+            print("L%d: add eax, %d" % (i, i % 100), file=f)
+
+def run(yasm, extra, src, out, runs):
+    best = None
+    for i in range(runs):
+        start = time.time()
+        subprocess.check_call([yasm, "-f", "elf64"] + extra +
+                              ["-o", out, src])
+        elapsed = time.time() - start
+        if best is None or elapsed < best:
+            best = elapsed
+    return best
+
+def main():
+    yasm = len(sys.argv) > 1 and sys.argv[1] or "./yasm"
+    count = len(sys.argv) > 2 and int(sys.argv[2]) or 400000
+    runs = len(sys.argv) > 3 and int(sys.argv[3]) or 3
+
+    tmpdir = tempfile.mkdtemp()
+    src = os.path.join(tmpdir, "bench.asm")
+    out_incr = os.path.join(tmpdir, "incr.o")
+    out_full = os.path.join(tmpdir, "full.o")
+
+    f = open(src, "w")
+    generate(f, count)
+    f.close()
+
+    t_full = run(yasm, ["--full-opt"], src, out_full, runs)
+    t_incr = run(yasm, [], src, out_incr, runs)
+
+    same = open(out_incr, "rb").read() == open(out_full, "rb").read()
+
+    print("instructions:  %d" % count)
+    print("full:          %.3f s" % t_full)
+    print("incremental:   %.3f s" % t_incr)
+    print("speedup:       %.2fx" % (t_full / t_incr))
+    print("output:        %s" % (same and "identical" or "DIFFERENT"))
+
+    for name in (src, out_incr, out_full):
+        os.remove(name)
+    os.rmdir(tmpdir)
+
+    return not same
+
+if __name__ == "__main__":
+    sys.exit(main())
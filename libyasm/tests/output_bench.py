@@ -0,0 +1,139 @@
+#! /usr/bin/env python
+# Object output benchmark: relocation-heavy sources
+#
+#  Copyright (C) 2026  Yasm developers
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Generates two relocation-heavy sources and reports the CPU time of the
+# output phase (from --profile), best of several runs:
+#   data:  "dq ext+N" lines, one relocation each
+#   mixed: calls, RIP-relative loads and data referring to externals,
+#          interleaved with plain instructions
+# Given a second yasm (e.g. a build of the previous revision), times both
+# and verifies they produce identical output.
+#
+# Usage: output_bench.py [path-to-yasm] [lines] [runs] [baseline-yasm]
+#
+from __future__ import print_function
+
+import json
+import os
+import sys
+import tempfile
+import subprocess
+
+# (source, format) pairs to time
+CASES = [("data", "elf64"), ("data", "win64"), ("data", "macho64"),
+         ("mixed", "elf64"), ("mixed32", "elf32")]
+
+def generate_data(f, count):
+    print("BITS 64", file=f)
+    print("extern ext1", file=f)
+    print("section .data", file=f)
+    for i in range(count):
+        print("dq ext1 + %d" % i, file=f)
+
+def generate_mixed(f, count, bits):
+    print("BITS %d" % bits, file=f)
+    print("extern ext1, ext2", file=f)
+    print("section .text", file=f)
+    print("global start", file=f)
+    print("start:", file=f)
+    for i in range(0, count, 4):
+        print("call ext1", file=f)
+        if bits == 64:
+            print("mov rax, [rel ext2 + %d]" % (i + 1), file=f)
+            print("add eax, ebx", file=f)
+            print("dq ext1 + %d" % (i + 3), file=f)
+        else:
+            print("mov eax, [ext2 + %d]" % (i + 1), file=f)
+            print("add eax, ebx", file=f)
+            print("dd ext1 + %d" % (i + 3), file=f)
+
+def find_phase(phases, name):
+    for phase in phases:
+        if phase["name"] == name:
+            return phase
+        found = find_phase(phase.get("phases", []), name)
+        if found:
+            return found
+    return None
+
+def run(yasm, fmt, src, out, profile, runs):
+    best = None
+    for i in range(runs):
+        subprocess.check_call([yasm, "--profile=" + profile, "-f", fmt,
+                               "-o", out, src])
+        f = open(profile)
+        report = json.load(f)
+        f.close()
+        phase = find_phase(report["units"][0]["phases"], "output")
+        if best is None or phase["cpu_us"] < best:
+            best = phase["cpu_us"]
+    return best / 1000.0
+
+def main():
+    yasm = len(sys.argv) > 1 and sys.argv[1] or "./yasm"
+    count = len(sys.argv) > 2 and int(sys.argv[2]) or 1000000
+    runs = len(sys.argv) > 3 and int(sys.argv[3]) or 5
+    base = len(sys.argv) > 4 and sys.argv[4] or None
+
+    # Leave timestamps out of the objects so they can be compared
+    os.environ["YASM_TEST_SUITE"] = "1"
+
+    tmpdir = tempfile.mkdtemp()
+    srcs = {}
+    for kind in ("data", "mixed", "mixed32"):
+        srcs[kind] = os.path.join(tmpdir, kind + ".asm")
+        f = open(srcs[kind], "w")
+        if kind == "data":
+            generate_data(f, count)
+        else:
+            generate_mixed(f, count, kind == "mixed" and 64 or 32)
+        f.close()
+    out = os.path.join(tmpdir, "out.o")
+    out_base = os.path.join(tmpdir, "base.o")
+    profile = os.path.join(tmpdir, "profile.json")
+
+    print("lines:  %d (output phase CPU, best of %d)" % (count, runs))
+    same = True
+    for kind, fmt in CASES:
+        t = run(yasm, fmt, srcs[kind], out, profile, runs)
+        if not base:
+            print("%-8s %-8s %8.1f ms" % (kind, fmt, t))
+            continue
+        t_base = run(base, fmt, srcs[kind], out_base, profile, runs)
+        ident = open(out, "rb").read() == open(out_base, "rb").read()
+        same = same and ident
+        print("%-8s %-8s %8.1f -> %8.1f ms  %+5.1f%%  %s" %
+              (kind, fmt, t_base, t, 100.0 * (t - t_base) / t_base,
+               ident and "identical" or "DIFFERENT"))
+
+    for name in os.listdir(tmpdir):
+        os.remove(os.path.join(tmpdir, name))
+    os.rmdir(tmpdir)
+
+    return not same
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,288 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "libyasm/coretype.h"
+#include "libyasm/incfile.h"
+#include "libyasm/outsink.h"
+
+#define INCNAME     "outsink_test.inc"
+#define INCDATA     "0123456789"
+#define OUTNAME     "outsink_test.tmp"
+
+/* Operations: 'w' writes data, 's' seeks to arg, 't' truncates to arg,
+ * 'i' writes the included file from offset arg (data is what's expected
+ * there, and determines the length).
+ */
+typedef struct Test_Op {
+    char op;
+    long arg;
+    const char *data;
+} Test_Op;
+
+typedef struct Test_Entry {
+    /* operations to perform; terminated by op 0 */
+    Test_Op ops[6];
+
+    /* correct final image and its length */
+    const char *result;
+    unsigned long len;
+} Test_Entry;
+
+static Test_Entry tests[] = {
+    {{{0, 0, NULL}}, "", 0},
+    {{{'w', 0, "abc"}, {0, 0, NULL}}, "abc", 3},
+    {{{'w', 0, "abc"}, {'w', 0, "def"}, {0, 0, NULL}}, "abcdef", 6},
+    {{{'w', 0, "abcdef"}, {'s', 2, NULL}, {'w', 0, "XY"}, {0, 0, NULL}},
+     "abXYef", 6},
+    {{{'s', 4, NULL}, {'w', 0, "ab"}, {0, 0, NULL}}, "\0\0\0\0ab", 6},
+    {{{'w', 0, "ab"}, {'s', 4, NULL}, {'w', 0, "cd"}, {'s', 0, NULL},
+      {'w', 0, "X"}, {0, 0, NULL}}, "Xb\0\0cd", 6},
+    {{{'w', 0, "abcdef"}, {'t', 3, NULL}, {0, 0, NULL}}, "abc", 3},
+    {{{'w', 0, "abcdef"}, {'t', 3, NULL}, {'s', 3, NULL}, {'w', 0, "Z"},
+      {0, 0, NULL}}, "abcZ", 4},
+    {{{'i', 0, "0123"}, {0, 0, NULL}}, "0123", 4},
+    {{{'w', 0, "ab"}, {'i', 2, "234"}, {'w', 0, "cd"}, {0, 0, NULL}},
+     "ab234cd", 7},
+    {{{'i', 0, "0123"}, {'i', 4, "45"}, {0, 0, NULL}}, "012345", 6},
+    {{{'w', 0, "abcdef"}, {'s', 2, NULL}, {'i', 5, "56"}, {0, 0, NULL}},
+     "ab56ef", 6},
+    {{{'i', 0, "01234"}, {'s', 2, NULL}, {'w', 0, "XYZW"}, {0, 0, NULL}},
+     "01XYZW", 6},
+    {{{'i', 0, "0123"}, {'s', 6, NULL}, {'i', 8, "89"}, {0, 0, NULL}},
+     "0123\0\089", 8},
+    {{{'w', 0, "ab"}, {'i', 0, "0123"}, {'w', 0, "cd"}, {'t', 4, NULL},
+      {0, 0, NULL}}, "ab01", 4},
+};
+
+static char failed[1000];
+static char failmsg[100];
+
+static yasm_incfile_cache *incfiles;
+
+static int
+run_test(Test_Entry *test)
+{
+    yasm_outsink *sink, *copy;
+    /*@null@*/ yasm_incfile *file = yasm_incfile_open(incfiles, INCNAME, "");
+    const unsigned char *image;
+    unsigned char buf[64];
+    unsigned long len;
+    const Test_Op *op;
+    size_t oplen;
+    FILE *f;
+
+    if (!file) {
+        sprintf(failmsg, "could not open %s", INCNAME);
+        return 1;
+    }
+
+    sink = yasm_outsink_create_mem();
+    for (op = test->ops; op->op; op++) {
+        switch (op->op) {
+            case 'w':
+                oplen = strlen(op->data);
+                if (yasm_outsink_write(sink, op->data, oplen) != oplen) {
+                    sprintf(failmsg, "test %d: write failed",
+                            (int)(test - tests));
+                    goto fail;
+                }
+                break;
+            case 's':
+                if (yasm_outsink_seek(sink, op->arg) != 0 ||
+                    yasm_outsink_tell(sink) != op->arg) {
+                    sprintf(failmsg, "test %d: seek failed",
+                            (int)(test - tests));
+                    goto fail;
+                }
+                break;
+            case 't':
+                if (yasm_outsink_truncate(sink,
+                                          (unsigned long)op->arg) != 0) {
+                    sprintf(failmsg, "test %d: truncate failed",
+                            (int)(test - tests));
+                    goto fail;
+                }
+                break;
+            case 'i':
+                oplen = strlen(op->data);
+                if (yasm_outsink_write_file(sink, file,
+                                            (unsigned long)op->arg,
+                                            oplen) != oplen) {
+                    sprintf(failmsg, "test %d: file write failed",
+                            (int)(test - tests));
+                    goto fail;
+                }
+                break;
+        }
+    }
+
+    /* Write out to a file (which copies included file data) */
+    f = fopen(OUTNAME, "wb");
+    if (!f || yasm_outsink_write_to_file(sink, f) != 0) {
+        sprintf(failmsg, "test %d: write to file failed",
+                (int)(test - tests));
+        if (f)
+            fclose(f);
+        goto fail;
+    }
+    fclose(f);
+    f = fopen(OUTNAME, "rb");
+    len = f ? (unsigned long)fread(buf, 1, sizeof(buf), f) : 0;
+    if (f)
+        fclose(f);
+    remove(OUTNAME);
+    if (len != test->len || (len > 0 && memcmp(buf, test->result, len))) {
+        sprintf(failmsg, "test %d: file mismatch (length %lu)",
+                (int)(test - tests), len);
+        goto fail;
+    }
+
+    /* Copy to another sink */
+    copy = yasm_outsink_create_mem();
+    yasm_outsink_write_sink(copy, sink);
+    image = yasm_outsink_get_image(copy, &len);
+    if (len != test->len || (len > 0 && memcmp(image, test->result, len))) {
+        sprintf(failmsg, "test %d: copied image mismatch (length %lu)",
+                (int)(test - tests), len);
+        yasm_outsink_destroy(copy);
+        goto fail;
+    }
+    yasm_outsink_destroy(copy);
+
+    if (yasm_outsink_error(sink)) {
+        sprintf(failmsg, "test %d: sink error", (int)(test - tests));
+        goto fail;
+    }
+    if (yasm_outsink_get_file(sink) != NULL) {
+        sprintf(failmsg, "test %d: memory sink has a file",
+                (int)(test - tests));
+        goto fail;
+    }
+    image = yasm_outsink_get_image(sink, &len);
+    if (len != test->len || (len > 0 && memcmp(image, test->result, len))) {
+        sprintf(failmsg, "test %d: image mismatch (length %lu)",
+                (int)(test - tests), len);
+        goto fail;
+    }
+
+    yasm_outsink_destroy(sink);
+    return 0;
+
+fail:
+    yasm_outsink_destroy(sink);
+    return 1;
+}
+
+/* A file that changes after being opened must be opened again */
+static int
+run_changed_test(void)
+{
+    /*@null@*/ yasm_incfile *file, *file2;
+    unsigned char buf[16];
+    FILE *f;
+
+    f = fopen(INCNAME, "wb");
+    if (f) {
+        fputs("AAAA", f);
+        fclose(f);
+    }
+    file = yasm_incfile_open(incfiles, INCNAME, "");
+    if (!file || yasm_incfile_size(file) != 4) {
+        sprintf(failmsg, "changed: could not open %s", INCNAME);
+        return 1;
+    }
+    if (yasm_incfile_open(incfiles, INCNAME, "") != file) {
+        sprintf(failmsg, "changed: unchanged file opened again");
+        return 1;
+    }
+
+    f = fopen(INCNAME, "wb");
+    if (f) {
+        fputs("BBBBBBBB", f);
+        fclose(f);
+    }
+    file2 = yasm_incfile_open(incfiles, INCNAME, "");
+    if (!file2 || file2 == file || yasm_incfile_size(file2) != 8) {
+        sprintf(failmsg, "changed: stale file returned");
+        return 1;
+    }
+    if (yasm_incfile_read(file2, 0, buf, 8) != 0
+        || memcmp(buf, "BBBBBBBB", 8) != 0) {
+        sprintf(failmsg, "changed: stale contents read");
+        return 1;
+    }
+    /* Earlier handle is still usable */
+    if (yasm_incfile_size(file) != 4) {
+        sprintf(failmsg, "changed: earlier handle modified");
+        return 1;
+    }
+    return 0;
+}
+
+int
+main(void)
+{
+    FILE *f;
+    int nf = 0;
+    int numtests = sizeof(tests)/sizeof(Test_Entry);
+    int i;
+
+    failed[0] = '\0';
+    f = fopen(INCNAME, "wb");
+    if (f) {
+        fputs(INCDATA, f);
+        fclose(f);
+    }
+
+    incfiles = yasm_incfile_cache_create();
+    printf("Test outsink_test: ");
+    for (i=0; i<numtests; i++) {
+        int fail = run_test(&tests[i]);
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+    }
+    {
+        int fail = run_changed_test();
+        printf("%c", fail>0 ? 'F':'.');
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+        numtests++;
+    }
+    yasm_incfile_cache_destroy(incfiles);
+    remove(INCNAME);
+
+    printf(" +%d-%d/%d %d%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
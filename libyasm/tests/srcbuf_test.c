@@ -0,0 +1,191 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "libyasm/file.h"
+
+typedef struct Test_Entry {
+    /* input file contents */
+    const char *input;
+
+    /* number of leading bytes to skip before creating the source buffer */
+    long skip;
+
+    /* correct lines, each including its line ending; NULL-terminated */
+    const char *result[5];
+} Test_Entry;
+
+static Test_Entry tests[] = {
+    {"", 0, {NULL}},
+    {"\n", 0, {"\n", NULL}},
+    {"one\ntwo\n", 0, {"one\n", "two\n", NULL}},
+    {"one\ntwo", 0, {"one\n", "two", NULL}},
+    {"one\r\ntwo\r\n", 0, {"one\r\n", "two\r\n", NULL}},
+    {"a\n\n\nb\n", 0, {"a\n", "\n", "\n", "b\n", NULL}},
+    {"cont\\\nline\n", 0, {"cont\\\n", "line\n", NULL}},
+    {"skip\nrest\n", 5, {"rest\n", NULL}},
+    {"skip\nrest", 2, {"ip\n", "rest", NULL}},
+    {"all", 3, {NULL}},
+};
+
+static char failed[1000];
+static char failmsg[100];
+
+/* Check that srcbuf yields exactly the expected lines. */
+static int
+check_lines(Test_Entry *test, yasm_srcbuf *srcbuf, const char *kind)
+{
+    const char *line;
+    size_t len;
+    int i;
+
+    for (i=0; test->result[i]; i++) {
+        line = yasm_srcbuf_get_line(srcbuf, &len);
+        if (!line) {
+            sprintf(failmsg, "test %d (%s): early end of file at line %d",
+                    (int)(test - tests), kind, i);
+            return 1;
+        }
+        if (len != strlen(test->result[i]) ||
+            strncmp(line, test->result[i], len) != 0) {
+            sprintf(failmsg, "test %d (%s): line %d mismatch",
+                    (int)(test - tests), kind, i);
+            return 1;
+        }
+    }
+    if (yasm_srcbuf_get_line(srcbuf, &len) != NULL) {
+        sprintf(failmsg, "test %d (%s): extra line", (int)(test - tests),
+                kind);
+        return 1;
+    }
+    if (yasm_srcbuf_error(srcbuf)) {
+        sprintf(failmsg, "test %d (%s): read error", (int)(test - tests),
+                kind);
+        return 1;
+    }
+    return 0;
+}
+
+/* Check that yasm_srcbuf_get_rest() yields the whole input after the first
+ * line (if any) has been read.
+ */
+static int
+check_rest(Test_Entry *test, yasm_srcbuf *srcbuf, const char *kind)
+{
+    const char *expect = test->input + test->skip;
+    const char *rest;
+    size_t len, explen;
+
+    if (test->result[0]) {
+        yasm_srcbuf_get_line(srcbuf, &len);
+        expect += strlen(test->result[0]);
+    }
+    explen = strlen(expect);
+    rest = yasm_srcbuf_get_rest(srcbuf, &len);
+    if (len != explen || memcmp(rest, expect, len) != 0) {
+        sprintf(failmsg, "test %d (%s): rest mismatch", (int)(test - tests),
+                kind);
+        return 1;
+    }
+    if (yasm_srcbuf_get_line(srcbuf, &len) != NULL) {
+        sprintf(failmsg, "test %d (%s): line after rest",
+                (int)(test - tests), kind);
+        return 1;
+    }
+    return 0;
+}
+
+static int
+run_test(Test_Entry *test)
+{
+    FILE *f;
+    yasm_srcbuf *srcbuf;
+    size_t inlen = strlen(test->input);
+    int fail;
+
+    f = tmpfile();
+    if (!f) {
+        sprintf(failmsg, "could not create temporary file");
+        return 1;
+    }
+    if (fwrite(test->input, 1, inlen, f) != inlen ||
+        fseek(f, test->skip, SEEK_SET) != 0) {
+        sprintf(failmsg, "could not write temporary file");
+        fclose(f);
+        return 1;
+    }
+
+    srcbuf = yasm_srcbuf_create(f);
+    fail = check_lines(test, srcbuf, "file");
+    yasm_srcbuf_destroy(srcbuf);
+    if (!fail && fseek(f, test->skip, SEEK_SET) == 0) {
+        srcbuf = yasm_srcbuf_create(f);
+        fail = check_rest(test, srcbuf, "file");
+        yasm_srcbuf_destroy(srcbuf);
+    }
+    fclose(f);
+    if (fail)
+        return 1;
+
+    srcbuf = yasm_srcbuf_create_mem(test->input + test->skip,
+                                    inlen - (size_t)test->skip);
+    fail = check_lines(test, srcbuf, "memory");
+    yasm_srcbuf_destroy(srcbuf);
+    if (fail)
+        return 1;
+
+    srcbuf = yasm_srcbuf_create_mem(test->input + test->skip,
+                                    inlen - (size_t)test->skip);
+    fail = check_rest(test, srcbuf, "memory");
+    yasm_srcbuf_destroy(srcbuf);
+    return fail;
+}
+
+int
+main(void)
+{
+    int nf = 0;
+    int numtests = sizeof(tests)/sizeof(Test_Entry);
+    int i;
+
+    failed[0] = '\0';
+    printf("Test srcbuf_test: ");
+    for (i=0; i<numtests; i++) {
+        int fail = run_test(&tests[i]);
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+    }
+
+    printf(" +%d-%d/%d %d%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
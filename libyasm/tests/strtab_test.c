@@ -0,0 +1,220 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "libyasm/coretype.h"
+#include "libyasm/strtab.h"
+
+/* Operations: 'a' adds str, 'u' adds str with yasm_strtab_add_unique(),
+ * 'r' replaces the string with ID arg by str.  Each add checks that the
+ * string gets ID arg.
+ */
+typedef struct Test_Op {
+    char op;
+    unsigned long arg;
+    const char *str;
+} Test_Op;
+
+typedef struct Test_Entry {
+    /* reserved bytes and tail merging */
+    unsigned long start;
+    int tail_merge;
+
+    /* operations to perform; terminated by op 0 */
+    Test_Op ops[6];
+
+    /* correct final table and its length */
+    const char *result;
+    unsigned long len;
+} Test_Entry;
+
+static Test_Entry tests[] = {
+    {1, 0, {{0, 0, NULL}}, "\0", 1},
+    {0, 0, {{0, 0, NULL}}, "", 0},
+    {1, 0, {{'a', 0, "a"}, {'a', 1, "b"}, {0, 0, NULL}}, "\0a\0b\0", 5},
+    {1, 0, {{'a', 0, "a"}, {'a', 1, "b"}, {'a', 0, "a"}, {0, 0, NULL}},
+     "\0a\0b\0", 5},
+    {0, 0, {{'a', 0, ".text"}, {'a', 1, ".rela.text"}, {'a', 2, "text"},
+            {0, 0, NULL}}, ".text\0.rela.text\0text\0", 22},
+    {0, 1, {{'a', 0, ".text"}, {'a', 1, ".rela.text"}, {'a', 2, "text"},
+            {0, 0, NULL}}, ".rela.text\0", 11},
+    {4, 1, {{'a', 0, "foo"}, {'a', 1, "bar"}, {'a', 2, "oo"}, {'a', 0, "foo"},
+            {0, 0, NULL}}, "\0\0\0\0bar\0foo\0", 12},
+    {1, 1, {{'a', 0, ""}, {'a', 1, "x"}, {0, 0, NULL}}, "\0x\0", 3},
+    {1, 0, {{'u', 0, "a.asm"}, {'a', 1, "sym"}, {'a', 2, "a.asm"},
+            {'r', 0, "b.asm"}, {0, 0, NULL}}, "\0b.asm\0sym\0a.asm\0", 17},
+    {1, 0, {{'u', 0, "a.asm"}, {'a', 1, "sym"}, {'r', 0, "a.asm"},
+            {0, 0, NULL}}, "\0a.asm\0sym\0", 11},
+    {1, 1, {{'u', 0, "a.asm"}, {'a', 1, "sym"}, {'a', 2, "a.asm"},
+            {'r', 0, "b.asm"}, {0, 0, NULL}}, "\0sym\0b.asm\0a.asm\0", 17},
+    {1, 1, {{'u', 0, "x.s"}, {'a', 1, "x.s"}, {0, 0, NULL}}, "\0x.s\0", 5},
+};
+
+static char failed[1000];
+static char failmsg[100];
+
+static int
+run_test(Test_Entry *test)
+{
+    yasm_strtab *strtab = yasm_strtab_create(test->start);
+    const unsigned char *table, *table2;
+    unsigned long len, len2, id = 0, num_ids = 0, i;
+    const Test_Op *op;
+    /* final string of each ID */
+    const char *strs[6];
+
+    for (op = test->ops; op->op; op++) {
+        switch (op->op) {
+            case 'a':
+                id = yasm_strtab_add(strtab, op->str);
+                break;
+            case 'u':
+                id = yasm_strtab_add_unique(strtab, op->str);
+                break;
+            case 'r':
+                yasm_strtab_replace(strtab, op->arg, op->str);
+                id = op->arg;
+                break;
+        }
+        if (id != op->arg) {
+            sprintf(failmsg, "test %d: got ID %lu, expected %lu",
+                    (int)(test - tests), id, op->arg);
+            goto fail;
+        }
+        strs[id] = op->str;
+        if (id >= num_ids)
+            num_ids = id+1;
+    }
+
+    table = yasm_strtab_finalize(strtab, test->tail_merge, &len);
+    if (len != test->len || (len > 0 && memcmp(table, test->result, len))) {
+        sprintf(failmsg, "test %d: table mismatch (length %lu)",
+                (int)(test - tests), len);
+        goto fail;
+    }
+    for (i=0; i<num_ids; i++) {
+        unsigned long offset = yasm_strtab_offset(strtab, i);
+        if (offset < test->start || offset >= len ||
+            strcmp((const char *)table+offset, strs[i]) != 0) {
+            sprintf(failmsg, "test %d: ID %lu has bad offset %lu",
+                    (int)(test - tests), i, offset);
+            goto fail;
+        }
+    }
+    table2 = yasm_strtab_finalize(strtab, test->tail_merge, &len2);
+    if (table2 != table || len2 != len) {
+        sprintf(failmsg, "test %d: second finalize differs",
+                (int)(test - tests));
+        goto fail;
+    }
+
+    yasm_strtab_destroy(strtab);
+    return 0;
+
+fail:
+    yasm_strtab_destroy(strtab);
+    return 1;
+}
+
+/* Add enough names (each twice) to grow the hash table, and check that
+ * every name maps to its own ID and offset, with and without merging.
+ */
+#define NUM_NAMES   5000
+
+static int
+run_many_test(int tail_merge)
+{
+    yasm_strtab *strtab = yasm_strtab_create(1);
+    const unsigned char *table;
+    unsigned long len, i, id, expected_len = 1;
+    char name[32];
+
+    for (i=0; i<2*NUM_NAMES; i++) {
+        sprintf(name, "%ssym%lu", (i/NUM_NAMES) ? "" : "_", i % NUM_NAMES);
+        id = yasm_strtab_add(strtab, name);
+        /* With merging, each "symN" is the tail of "_symN" */
+        if (!tail_merge || i < NUM_NAMES)
+            expected_len += (unsigned long)strlen(name)+1;
+        if (id != i) {
+            sprintf(failmsg, "many: %s got ID %lu, expected %lu", name, id,
+                    i);
+            goto fail;
+        }
+        if (yasm_strtab_add(strtab, name) != id) {
+            sprintf(failmsg, "many: %s not deduplicated", name);
+            goto fail;
+        }
+    }
+    table = yasm_strtab_finalize(strtab, tail_merge, &len);
+    if (len != expected_len) {
+        sprintf(failmsg, "many: table length %lu, expected %lu", len,
+                expected_len);
+        goto fail;
+    }
+    for (i=0; i<2*NUM_NAMES; i++) {
+        unsigned long offset = yasm_strtab_offset(strtab, i);
+        sprintf(name, "%ssym%lu", (i/NUM_NAMES) ? "" : "_", i % NUM_NAMES);
+        if (offset >= len || strcmp((const char *)table+offset, name) != 0) {
+            sprintf(failmsg, "many: %s has bad offset %lu", name, offset);
+            goto fail;
+        }
+    }
+
+    yasm_strtab_destroy(strtab);
+    return 0;
+
+fail:
+    yasm_strtab_destroy(strtab);
+    return 1;
+}
+
+int
+main(void)
+{
+    int nf = 0;
+    int numtests = sizeof(tests)/sizeof(Test_Entry);
+    int i;
+
+    failed[0] = '\0';
+    printf("Test strtab_test: ");
+    for (i=0; i<numtests+2; i++) {
+        int fail = i < numtests ? run_test(&tests[i]) :
+            run_many_test(i - numtests);
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+    }
+
+    numtests += 2;
+    printf(" +%d-%d/%d %d%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -28,6 +28,7 @@
 
 #include "libyasm-stdint.h"
 #include "coretype.h"
+#include "arena.h"
 #include "bitvect.h"
 
 #include "errwarn.h"
@@ -531,7 +532,7 @@ yasm_value_finalize(yasm_value *value, yasm_bytecode *precbc)
                 while (value->abs->op == YASM_EXPR_IDENT
                        && value->abs->terms[0].type == YASM_EXPR_EXPR) {
                     yasm_expr *sube = value->abs->terms[0].data.expn;
-                    yasm_xfree(value->abs);
+                    yasm_arena_free(value->abs);
                     value->abs = sube;
                 }
                 break;
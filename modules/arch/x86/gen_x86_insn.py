@@ -27,6 +27,7 @@
 # NOTE: operands are arranged in NASM / Intel order (e.g. dest, src)
 
 from sys import stdout, version_info
+from itertools import product
 
 scriptname = "gen_x86_insn.py"
 scriptrev = "HEAD"
@@ -104,6 +105,20 @@ def cpu_lcd(cpu1, cpu2):
 
     return retval
 
+# Coarse operand classes used to index instruction groups by operand
+# signature; must match x86_operand_class in x86id.c.
+(OPC_Imm, OPC_Mem, OPC_SegReg, OPC_Reg8, OPC_Reg16, OPC_Reg32, OPC_Reg64,
+ OPC_FPUReg, OPC_MMXReg, OPC_XMMReg, OPC_YMMReg, OPC_CRReg, OPC_DRReg,
+ OPC_TRReg, OPC_Other) = range(15)
+
+def match_key(classes):
+    """Index key of an operand signature: the number of operands, and the
+    class of each operand, 4 bits each, in Intel order."""
+    key = len(classes) << 20
+    for i, c in enumerate(classes):
+        key |= c << (i*4)
+    return key
+
 class Operand(object):
     def __init__(self, **kwargs):
         self.type = kwargs.pop("type")
@@ -127,6 +142,46 @@ class Operand(object):
                                            and "EA" or self.dest),
                                "OPAP_%s" % self.opt]) + "}"
 
+    def classes(self):
+        """Return the operand classes (see OPC_ above) a parsed operand may
+        have and still match this operand.  May include classes that can't
+        actually match, but never omits one that can."""
+        if self.type in ["Imm", "Imm1", "ImmNotSegOff"]:
+            return [OPC_Imm]
+        if self.type in ["Mem", "MemOffs", "MemrAX", "MemEAX",
+                         "MemXMMIndex", "MemYMMIndex"]:
+            return [OPC_Mem]
+        if self.type in ["SegReg", "CS", "DS", "ES", "FS", "GS", "SS"]:
+            return [OPC_SegReg]
+        if self.type in ["CRReg", "CR4"]:
+            return [OPC_CRReg]
+        if self.type == "DRReg":
+            return [OPC_DRReg]
+        if self.type == "TRReg":
+            return [OPC_TRReg]
+        if self.type == "ST0":
+            return [OPC_FPUReg]
+        if self.type == "XMM0":
+            return [OPC_XMMReg]
+        if self.type in ["Reg", "RM", "Areg", "Creg", "Dreg"]:
+            # Register size must exactly match
+            classes = {8: [OPC_Reg8], 16: [OPC_Reg16], 32: [OPC_Reg32],
+                       64: [OPC_Reg64], 80: [OPC_FPUReg],
+                       "BITS": [OPC_Reg16, OPC_Reg32, OPC_Reg64]}.get(
+                self.size, [OPC_Reg8, OPC_Reg16, OPC_Reg32, OPC_Reg64,
+                            OPC_FPUReg])
+            if self.type == "RM":
+                classes = [OPC_Mem] + classes
+            return classes
+        if self.type in ["SIMDReg", "SIMDRM"]:
+            classes = {64: [OPC_MMXReg], 128: [OPC_XMMReg],
+                       256: [OPC_YMMReg]}.get(
+                self.size, [OPC_MMXReg, OPC_XMMReg, OPC_YMMReg])
+            if self.type == "SIMDRM":
+                classes = [OPC_Mem] + classes
+            return classes
+        raise ValueError("unknown operand type %s" % self.type)
+
     def __eq__(self, other):
         return (self.type == other.type and
                 self.size == other.size and
@@ -354,9 +409,7 @@ class GroupForm(object):
         # Build instruction info structure initializer
         return "{ "+ ", ".join([gas_flags or "0",
                                 "|".join(self.misc_flags) or "0",
-                                cpus_str[0],
-                                cpus_str[1],
-                                cpus_str[2],
+                                "CPU_FLAGS(%s)" % ", ".join(cpus_str[0:3]),
                                 mod_str,
                                 "%d" % (self.opersize or 0),
                                 "%d" % (self.def_opersize_64 or 0),
@@ -379,6 +432,7 @@ class Insn(object):
                  cpu=None, misc_flags=None, only64=False, not64=False,
                  avx=False):
         self.groupname = groupname
+        self.index_parser = None
         if suffix is None:
             self.suffix = None
         else:
@@ -485,7 +539,10 @@ class Insn(object):
         # Ensure modifiers is at least 3 long
         mods_str.extend(["0", "0", "0"])
 
+        keys = "%s_insn_%s_keys" % (self.groupname, self.index_parser)
         return ",\t".join(["%s_insn" % self.groupname,
+                           keys,
+                           "NELEMS(%s)" % keys,
                            "%d" % len(groups[self.groupname]),
                            suffix_str,
                            mods_str[0],
@@ -509,6 +566,8 @@ class Prefix(object):
 
     def __str__(self):
         return ",\t".join(["NULL",
+                           "NULL",
+                           "0",
                            "X86_%s>>8" % self.groupname,
                            "0x%02X" % self.value,
                            "0",
@@ -563,6 +622,7 @@ def finalize_insns():
                     newinsn = insn.copy()
                     if insn.suffix is None:
                         newinsn.suffix = suffix
+                    newinsn.index_parser = "gas"
                     newinsn.auto_cpu("gas")
                     newinsn.auto_misc_flags("gas")
                     gas_insns[keyword] = newinsn
@@ -572,6 +632,7 @@ def finalize_insns():
                 if keyword in nasm_insns:
                     raise ValueError("duplicate nasm instruction %s" % keyword)
                 newinsn = insn.copy()
+                newinsn.index_parser = "nasm"
                 newinsn.auto_cpu("nasm")
                 newinsn.auto_misc_flags("nasm")
                 nasm_insns[keyword] = newinsn
@@ -641,6 +702,53 @@ def output_groups(f):
         lprint(",\n    ".join(str(x) for x in groups[name]), f)
         lprint("};\n", f)
 
+    # Output operand signature index of each group, for each parser it's
+    # used with.  Each key lists, in group order, the forms an instruction
+    # with that signature may match, so finding a match only needs to
+    # look at those.  Forms see GAS operands reversed unless GAS_NO_REV.
+    cands = []
+    cands_offset = {}
+    if version_info[0] == 2:
+        ii = gas_insns.itervalues()
+        ni = nasm_insns.itervalues()
+    else:
+        ii = gas_insns.values()
+        ni = nasm_insns.values()
+    indexes = set((insn.groupname, insn.index_parser)
+                  for insn in list(ii) + list(ni) if isinstance(insn, Insn))
+    for name, parser in sorted(indexes):
+        index = {}
+        for i, form in enumerate(groups[name]):
+            if parser not in form.parsers:
+                continue
+            classes = [op.classes() for op in form.operands]
+            if parser == "gas" and not form.gas_no_rev:
+                classes.reverse()
+            for sig in product(*classes):
+                index.setdefault(match_key(sig), []).append(i)
+        keys = []
+        for key in sorted(index):
+            forms = tuple(index[key])
+            if forms not in cands_offset:
+                cands_offset[forms] = len(cands)
+                cands.extend(forms)
+            if cands_offset[forms] > 65535 or len(forms) > 255:
+                raise ValueError("index of group %s too large" % name)
+            keys.append("{0x%06X, %d, %d}" % (key, cands_offset[forms],
+                                                len(forms)))
+        if len(keys) > 255:
+            raise ValueError("too many index keys in group %s" % name)
+        lprint("static const x86_insn_key %s_insn_%s_keys[] = {" %
+               (name, parser), f)
+        lprint("   ", f, '')
+        lprint(",\n    ".join(keys), f)
+        lprint("};\n", f)
+
+    lprint("static const unsigned char insn_index_cands[] = {", f)
+    for i in range(0, len(cands), 16):
+        lprint("    " + ", ".join("%d" % x for x in cands[i:i+16]) + ",", f)
+    lprint("};\n", f)
+
 #####################################################################
 # General instruction groupings
 #####################################################################
@@ -33,8 +33,19 @@
 #include "modules/arch/x86/x86arch.h"
 
 
-static const char *cpu_find_reverse(unsigned int cpu0, unsigned int cpu1,
-                                    unsigned int cpu2);
+static const char *cpu_find_reverse(const unsigned long *cpu);
+
+/* CPU feature sets as plain integer bitmasks: CPU feature c is bit c%32 of
+ * word c/32.  CPU_FLAGS() initializes the mask of up to three features.
+ */
+#define CPU_WORD(c, w)          ((c)/32 == (w) ? 1UL<<((c)%32) : 0UL)
+#define CPU_MASK(c0, c1, c2, w) \
+    (CPU_WORD(c0, w) | CPU_WORD(c1, w) | CPU_WORD(c2, w))
+#define CPU_FLAGS(c0, c1, c2)   {CPU_MASK(c0, c1, c2, 0), \
+                                 CPU_MASK(c0, c1, c2, 1)}
+/* Are all of the features in mask cpu enabled? */
+#define CPU_ENABLED(enabled, cpu) \
+    (((cpu)[0] & ~(enabled)[0]) == 0 && ((cpu)[1] & ~(enabled)[1]) == 0)
 
 /* Opcode modifiers. */
 #define MOD_Gap     0   /* Eats a parameter / does nothing */
@@ -134,6 +145,29 @@ enum x86_operand_size {
     OPS_BITS = 8
 };
 
+/* Coarse classes of parsed operands.  Each instruction group has an index
+ * (generated by gen_x86_insn.py, which must agree with these values) from
+ * the operand count and the class of each operand to the forms that may
+ * match, so that matching only needs to look at a few forms.
+ */
+enum x86_operand_class {
+    OPC_Imm = 0,
+    OPC_Mem = 1,
+    OPC_SegReg = 2,
+    OPC_Reg8 = 3,       /* including REX versions */
+    OPC_Reg16 = 4,
+    OPC_Reg32 = 5,
+    OPC_Reg64 = 6,
+    OPC_FPUReg = 7,
+    OPC_MMXReg = 8,
+    OPC_XMMReg = 9,
+    OPC_YMMReg = 10,
+    OPC_CRReg = 11,
+    OPC_DRReg = 12,
+    OPC_TRReg = 13,
+    OPC_Other = 14      /* doesn't match any form */
+};
+
 enum x86_operand_targetmod {
     OPTM_None = 0,  /* no target mod acceptable */
     OPTM_Near = 1,  /* NEAR */
@@ -238,14 +272,11 @@ typedef struct x86_insn_info {
     /* Tests against BITS==64, AVX, and XOP */
     unsigned int misc_flags:5;
 
-    /* The CPU feature flags needed to execute this instruction.  This is OR'ed
-     * with arch-specific data[2].  This combined value is compared with
-     * cpu_enabled to see if all bits set here are set in cpu_enabled--if so,
+    /* The CPU feature flags needed to execute this instruction, as a
+     * bitmask (see CPU_FLAGS).  If all bits set here are set in cpu_enabled,
      * the instruction is available on this CPU.
      */
-    unsigned int cpu0:6;
-    unsigned int cpu1:6;
-    unsigned int cpu2:6;
+    unsigned long cpu[2];
 
     /* Opcode modifiers for variations of instruction.  As each modifier reads
      * its parameter in LSB->MSB order from the arch-specific data[1] from the
@@ -299,14 +330,31 @@ typedef struct x86_insn_info {
     unsigned int operands_index:12;
 } x86_insn_info;
 
+/* Entry of an instruction group index */
+typedef struct x86_insn_key {
+    /* Number of operands (bits 20 and up) and the x86_operand_class of each
+     * operand (4 bits each, first operand in the low bits).
+     */
+    unsigned long key;
+
+    /* The forms that may match, as indexes into the group in group order:
+     * insn_index_cands[cands] to insn_index_cands[cands+num_cands-1].
+     */
+    unsigned short cands;
+    unsigned char num_cands;
+} x86_insn_key;
+
 typedef struct x86_id_insn {
     yasm_insn insn;     /* base structure */
 
     /* instruction parse group - NULL if empty instruction (just prefixes) */
     /*@null@*/ const x86_insn_info *group;
 
+    /* Index of the group, sorted by key; NULL if none */
+    /*@null@*/ const x86_insn_key *keys;
+
     /* CPU feature flags enabled at the time of parsing the instruction */
-    wordptr cpu_enabled;
+    unsigned long cpu_enabled[2];
 
     /* Modifier data */
     unsigned char mod_data[3];
@@ -314,6 +362,9 @@ typedef struct x86_id_insn {
     /* Number of elements in the instruction parse group */
     unsigned int num_info:8;
 
+    /* Number of entries in the group index */
+    unsigned int num_keys:8;
+
     /* BITS setting active at the time of parsing the instruction */
     unsigned int mode_bits:8;
 
@@ -564,9 +615,7 @@ x86_finalize_jmp(yasm_bytecode *bc, yasm_bytecode *prev_bc,
         if (mode_bits == 64 && (info->misc_flags & NOT_64))
             continue;
 
-        if (!BitVector_bit_test(id_insn->cpu_enabled, info->cpu0) ||
-            !BitVector_bit_test(id_insn->cpu_enabled, info->cpu1) ||
-            !BitVector_bit_test(id_insn->cpu_enabled, info->cpu2))
+        if (!CPU_ENABLED(id_insn->cpu_enabled, info->cpu))
             continue;
 
         if (info->num_operands == 0)
@@ -621,40 +670,142 @@ x86_finalize_jmp(yasm_bytecode *bc, yasm_bytecode *prev_bc,
     yasm_x86__bc_transform_jmp(bc, jmp);
 }
 
+/* Look up the forms of the instruction group the operands may match in the
+ * group index.  The operands are always in Intel order (the index accounts
+ * for GAS operand reversal).  Returns 0 if the index can't be used for these
+ * operands.
+ */
+static int
+x86_find_cands(const x86_id_insn *id_insn, yasm_insn_operand **ops,
+               /*@out@*/ const unsigned char **cands,
+               /*@out@*/ unsigned int *num_cands)
+{
+    unsigned long key = (unsigned long)id_insn->insn.num_operands << 20;
+    unsigned int i, lo, hi;
+
+    for (i = 0; i < id_insn->insn.num_operands; i++) {
+        unsigned long opc = OPC_Other;
+
+        switch (ops[i]->type) {
+            case YASM_INSN__OPERAND_IMM:
+                opc = OPC_Imm;
+                break;
+            case YASM_INSN__OPERAND_MEMORY:
+                opc = OPC_Mem;
+                break;
+            case YASM_INSN__OPERAND_SEGREG:
+                opc = OPC_SegReg;
+                break;
+            case YASM_INSN__OPERAND_REG:
+                /* Explicitly sized registers aren't size matched */
+                if (ops[i]->size != 0)
+                    return 0;
+                switch ((x86_expritem_reg_size)(ops[i]->data.reg&~0xFUL)) {
+                    case X86_REG8:
+                    case X86_REG8X:
+                        opc = OPC_Reg8;
+                        break;
+                    case X86_REG16:
+                        opc = OPC_Reg16;
+                        break;
+                    case X86_REG32:
+                        opc = OPC_Reg32;
+                        break;
+                    case X86_REG64:
+                        opc = OPC_Reg64;
+                        break;
+                    case X86_FPUREG:
+                        opc = OPC_FPUReg;
+                        break;
+                    case X86_MMXREG:
+                        opc = OPC_MMXReg;
+                        break;
+                    case X86_XMMREG:
+                        opc = OPC_XMMReg;
+                        break;
+                    case X86_YMMREG:
+                        opc = OPC_YMMReg;
+                        break;
+                    case X86_CRREG:
+                        opc = OPC_CRReg;
+                        break;
+                    case X86_DRREG:
+                        opc = OPC_DRReg;
+                        break;
+                    case X86_TRREG:
+                        opc = OPC_TRReg;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+        }
+        key |= opc << (i*4);
+    }
+
+    /* Binary search the sorted keys */
+    *cands = NULL;
+    *num_cands = 0;
+    lo = 0;
+    hi = id_insn->num_keys;
+    while (lo < hi) {
+        unsigned int mid = (lo+hi)/2;
+        const x86_insn_key *k = &id_insn->keys[mid];
+        if (k->key < key)
+            lo = mid+1;
+        else if (k->key > key)
+            hi = mid;
+        else {
+            *cands = &insn_index_cands[k->cands];
+            *num_cands = k->num_cands;
+            break;
+        }
+    }
+    return 1;
+}
+
 static const x86_insn_info *
 x86_find_match(x86_id_insn *id_insn, yasm_insn_operand **ops,
                yasm_insn_operand **rev_ops, const unsigned int *size_lookup,
                int bypass)
 {
-    const x86_insn_info *info = id_insn->group;
+    const x86_insn_info *info = NULL;
+    /*@null@*/ const unsigned char *cands = NULL;
     unsigned int num_info = id_insn->num_info;
     unsigned int suffix = id_insn->suffix;
     unsigned int mode_bits = id_insn->mode_bits;
+    unsigned int n;
     int found = 0;
 
-    /* Just do a simple linear search through the info array for a match.
-     * First match wins.
+    /* Only look at the forms the group index says may match, if possible.
+     * The relaxed checks done when diagnosing a mismatch (bypass) always
+     * look at all the forms.
      */
-    for (; num_info>0 && !found; num_info--, info++) {
+    if (id_insn->keys && bypass == 0 &&
+        x86_find_cands(id_insn, ops, &cands, &num_info) && num_info == 0)
+        return NULL;
+
+    /* Search through the candidates in group order.  First match wins. */
+    for (n = 0; n < num_info; n++) {
         yasm_insn_operand *op, **use_ops;
-        const x86_info_operand *info_ops =
-            &insn_operands[info->operands_index];
-        unsigned int gas_flags = info->gas_flags;
-        unsigned int misc_flags = info->misc_flags;
+        const x86_info_operand *info_ops;
+        unsigned int gas_flags, misc_flags;
         unsigned int size;
         int mismatch = 0;
         unsigned int i;
 
+        info = &id_insn->group[cands ? cands[n] : n];
+        info_ops = &insn_operands[info->operands_index];
+        gas_flags = info->gas_flags;
+        misc_flags = info->misc_flags;
+
         /* Match CPU */
         if (mode_bits != 64 && (misc_flags & ONLY_64))
             continue;
         if (mode_bits == 64 && (misc_flags & NOT_64))
             continue;
 
-        if (bypass != 8 &&
-            (!BitVector_bit_test(id_insn->cpu_enabled, info->cpu0) ||
-             !BitVector_bit_test(id_insn->cpu_enabled, info->cpu1) ||
-             !BitVector_bit_test(id_insn->cpu_enabled, info->cpu2)))
+        if (bypass != 8 && !CPU_ENABLED(id_insn->cpu_enabled, info->cpu))
             continue;
 
         /* Match # of operands */
@@ -1046,13 +1197,10 @@ x86_match_error(x86_id_insn *id_insn, yasm_insn_operand **ops,
                 N_("one of source operand 1 or 3 must match dest operand"));
             break;
         case 8:
-        {
-            unsigned int cpu0 = i->cpu0, cpu1 = i->cpu1, cpu2 = i->cpu2;
             yasm_error_set(YASM_ERROR_TYPE,
                           N_("requires CPU%s"),
-                          cpu_find_reverse(cpu0, cpu1, cpu2));
+                          cpu_find_reverse(i->cpu));
             break;
-        }
         default:
             yasm_error_set(YASM_ERROR_TYPE,
                            N_("invalid combination of opcode and operands"));
@@ -1676,6 +1824,10 @@ typedef struct insnprefix_parse_data {
     /* instruction parse group - NULL if prefix */
     /*@null@*/ const x86_insn_info *group;
 
+    /* Index of the group for this parser, and its number of entries */
+    /*@null@*/ const x86_insn_key *keys;
+    unsigned int num_keys;
+
     /* For instruction, number of elements in group.
      * For prefix, prefix type shifted right by 8.
      */
@@ -1705,17 +1857,14 @@ typedef struct insnprefix_parse_data {
 #include "x86insn_gas.c"
 
 static const char *
-cpu_find_reverse(unsigned int cpu0, unsigned int cpu1, unsigned int cpu2)
+cpu_find_reverse(const unsigned long *cpu_mask)
 {
-    static char cpuname[200];
+    static YASM_THREAD_LOCAL char cpuname[200];
     wordptr cpu = BitVector_Create(128, TRUE);
 
-    if (cpu0 != CPU_Any)
-        BitVector_Bit_On(cpu, cpu0);
-    if (cpu1 != CPU_Any)
-        BitVector_Bit_On(cpu, cpu1);
-    if (cpu2 != CPU_Any)
-        BitVector_Bit_On(cpu, cpu2);
+    BitVector_Chunk_Store(cpu, 32, 0, cpu_mask[0]);
+    BitVector_Chunk_Store(cpu, 32, 32, cpu_mask[1]);
+    BitVector_Bit_Off(cpu, CPU_Any);
 
     cpuname[0] = '\0';
 
@@ -1788,6 +1937,16 @@ cpu_find_reverse(unsigned int cpu0, unsigned int cpu1, unsigned int cpu2)
     return cpuname;
 }
 
+/* Get the CPU features enabled by the active CPU setting as a bitmask */
+static void
+x86_cpu_enabled(const yasm_arch_x86 *arch_x86,
+                /*@out@*/ unsigned long *cpu_enabled)
+{
+    wordptr cpu = arch_x86->cpu_enables[arch_x86->active_cpu];
+    cpu_enabled[0] = BitVector_Chunk_Read(cpu, 32, 0);
+    cpu_enabled[1] = BitVector_Chunk_Read(cpu, 32, 32);
+}
+
 yasm_arch_insnprefix
 yasm_x86__parse_check_insnprefix(yasm_arch *arch, const char *id,
                                  size_t id_len, unsigned long line,
@@ -1796,7 +1955,7 @@ yasm_x86__parse_check_insnprefix(yasm_arch *arch, const char *id,
     yasm_arch_x86 *arch_x86 = (yasm_arch_x86 *)arch;
     /*@null@*/ const insnprefix_parse_data *pdata;
     size_t i;
-    static char lcaseid[17];
+    static YASM_THREAD_LOCAL char lcaseid[17];
 
     *bc = (yasm_bytecode *)NULL;
     *prefix = 0;
@@ -1825,8 +1984,9 @@ yasm_x86__parse_check_insnprefix(yasm_arch *arch, const char *id,
 
     if (pdata->group) {
         x86_id_insn *id_insn;
-        wordptr cpu_enabled = arch_x86->cpu_enables[arch_x86->active_cpu];
-        unsigned int cpu0, cpu1, cpu2;
+        unsigned long cpu_enabled[2], cpu[2];
+
+        x86_cpu_enabled(arch_x86, cpu_enabled);
 
         if (arch_x86->mode_bits != 64 && (pdata->misc_flags & ONLY_64)) {
             yasm_warn_set(YASM_WARN_GENERAL,
@@ -1839,11 +1999,14 @@ yasm_x86__parse_check_insnprefix(yasm_arch *arch, const char *id,
             id_insn = yasm_xmalloc(sizeof(x86_id_insn));
             yasm_insn_initialize(&id_insn->insn);
             id_insn->group = not64_insn;
-            id_insn->cpu_enabled = cpu_enabled;
+            id_insn->keys = NULL;
+            id_insn->cpu_enabled[0] = cpu_enabled[0];
+            id_insn->cpu_enabled[1] = cpu_enabled[1];
             id_insn->mod_data[0] = 0;
             id_insn->mod_data[1] = 0;
             id_insn->mod_data[2] = 0;
             id_insn->num_info = NELEMS(not64_insn);
+            id_insn->num_keys = 0;
             id_insn->mode_bits = arch_x86->mode_bits;
             id_insn->suffix = 0;
             id_insn->misc_flags = 0;
@@ -1855,27 +2018,27 @@ yasm_x86__parse_check_insnprefix(yasm_arch *arch, const char *id,
             return YASM_ARCH_INSN;
         }
 
-        cpu0 = pdata->cpu0;
-        cpu1 = pdata->cpu1;
-        cpu2 = pdata->cpu2;
+        cpu[0] = CPU_MASK(pdata->cpu0, pdata->cpu1, pdata->cpu2, 0);
+        cpu[1] = CPU_MASK(pdata->cpu0, pdata->cpu1, pdata->cpu2, 1);
 
-        if (!BitVector_bit_test(cpu_enabled, cpu0) ||
-            !BitVector_bit_test(cpu_enabled, cpu1) ||
-            !BitVector_bit_test(cpu_enabled, cpu2)) {
+        if (!CPU_ENABLED(cpu_enabled, cpu)) {
             yasm_warn_set(YASM_WARN_GENERAL,
                           N_("`%s' is an instruction in CPU%s"), id,
-                          cpu_find_reverse(cpu0, cpu1, cpu2));
+                          cpu_find_reverse(cpu));
             return YASM_ARCH_NOTINSNPREFIX;
         }
 
         id_insn = yasm_xmalloc(sizeof(x86_id_insn));
         yasm_insn_initialize(&id_insn->insn);
         id_insn->group = pdata->group;
-        id_insn->cpu_enabled = cpu_enabled;
+        id_insn->keys = pdata->keys;
+        id_insn->cpu_enabled[0] = cpu_enabled[0];
+        id_insn->cpu_enabled[1] = cpu_enabled[1];
         id_insn->mod_data[0] = pdata->mod_data0;
         id_insn->mod_data[1] = pdata->mod_data1;
         id_insn->mod_data[2] = pdata->mod_data2;
         id_insn->num_info = pdata->num_info;
+        id_insn->num_keys = pdata->num_keys;
         id_insn->mode_bits = arch_x86->mode_bits;
         id_insn->suffix = pdata->flags;
         id_insn->misc_flags = pdata->misc_flags;
@@ -1934,11 +2097,13 @@ yasm_x86__create_empty_insn(yasm_arch *arch, unsigned long line)
 
     yasm_insn_initialize(&id_insn->insn);
     id_insn->group = empty_insn;
-    id_insn->cpu_enabled = arch_x86->cpu_enables[arch_x86->active_cpu];
+    id_insn->keys = NULL;
+    x86_cpu_enabled(arch_x86, id_insn->cpu_enabled);
     id_insn->mod_data[0] = 0;
     id_insn->mod_data[1] = 0;
     id_insn->mod_data[2] = 0;
     id_insn->num_info = NELEMS(empty_insn);
+    id_insn->num_keys = 0;
     id_insn->mode_bits = arch_x86->mode_bits;
     id_insn->suffix = (PARSER(arch_x86) == X86_PARSER_GAS) ? SUF_Z : 0;
     id_insn->misc_flags = 0;
@@ -52,6 +52,11 @@ cv_dbgfmt_create(yasm_object *object, yasm_dbgfmt_module *module, int version)
         dbgfmt_cv->filenames[i].info_off = 0;
     }
 
+    dbgfmt_cv->filenames_index = NULL;
+    dbgfmt_cv->filenames_hole = 0;
+
+    dbgfmt_cv->checksum = YASM_CHECKSUM_MD5;
+
     dbgfmt_cv->version = version;
 
     return (yasm_dbgfmt *)dbgfmt_cv;
@@ -68,6 +73,7 @@ cv_dbgfmt_destroy(/*@only@*/ yasm_dbgfmt *dbgfmt)
 {
     yasm_dbgfmt_cv *dbgfmt_cv = (yasm_dbgfmt_cv *)dbgfmt;
     size_t i;
+    yasm_cv__delete_file_index(dbgfmt_cv);
     for (i=0; i<dbgfmt_cv->filenames_size; i++) {
         if (dbgfmt_cv->filenames[i].pathname)
             yasm_xfree(dbgfmt_cv->filenames[i].pathname);
@@ -96,11 +102,33 @@ cv_dbgfmt_generate(yasm_object *object, yasm_linemap *linemap,
     yasm_cv__generate_type(object);
 }
 
+static void
+dir_checksum(yasm_object *object, yasm_valparamhead *valparams,
+             yasm_valparamhead *objext_valparams, unsigned long line)
+{
+    yasm_dbgfmt_cv *dbgfmt_cv = (yasm_dbgfmt_cv *)object->dbgfmt;
+    const char *type = yasm_vp_id(yasm_vps_first(valparams));
+
+    if (yasm__strcasecmp(type, "md5") == 0)
+        dbgfmt_cv->checksum = YASM_CHECKSUM_MD5;
+    else if (yasm__strcasecmp(type, "sha256") == 0)
+        dbgfmt_cv->checksum = YASM_CHECKSUM_SHA256;
+    else
+        yasm_error_set(YASM_ERROR_VALUE,
+                       N_("unrecognized checksum type `%s'"), type);
+}
+
+static const yasm_directive cv_directives[] = {
+    { ".cv_checksum",   "gas",  dir_checksum,   YASM_DIR_ID_REQUIRED },
+    { "cv_checksum",    "nasm", dir_checksum,   YASM_DIR_ID_REQUIRED },
+    { NULL, NULL, NULL, 0 }
+};
+
 /* Define dbgfmt structure -- see dbgfmt.h for details */
 yasm_dbgfmt_module yasm_cv8_LTX_dbgfmt = {
     "CodeView debugging format for VC8",
     "cv8",
-    NULL,   /* no directives */
+    cv_directives,
     cv8_dbgfmt_create,
     cv_dbgfmt_destroy,
     cv_dbgfmt_generate
@@ -32,7 +32,7 @@ typedef struct {
     char *filename;             /* filename as yasm knows it internally */
     unsigned long str_off;      /* offset into pathname string table */
     unsigned long info_off;     /* offset into source info table */
-    unsigned char digest[16];   /* MD5 digest of source file */
+    unsigned char digest[YASM_CHECKSUM_MAX_SIZE];   /* checksum of source */
 } cv_filename;
 
 /* Global data */
@@ -43,6 +43,12 @@ typedef struct yasm_dbgfmt_cv {
     size_t filenames_size;
     size_t filenames_allocated;
 
+    /* Hashed index into filenames (built on demand) */
+    /*@null@*/ /*@only@*/ HAMT *filenames_index;
+    size_t filenames_hole;          /* first unused entry in filenames */
+
+    yasm_checksum_type checksum;    /* source file checksum type */
+
     int version;
 } yasm_dbgfmt_cv;
 
@@ -51,6 +57,7 @@ yasm_bytecode *yasm_cv__append_bc(yasm_section *sect, yasm_bytecode *bc);
 /* Symbol/Line number functions */
 yasm_section *yasm_cv__generate_symline
     (yasm_object *object, yasm_linemap *linemap, yasm_errwarns *errwarns);
+void yasm_cv__delete_file_index(yasm_dbgfmt_cv *dbgfmt_cv);
 
 /* Type functions */
 yasm_section *yasm_cv__generate_type(yasm_object *object);
@@ -40,6 +40,13 @@ enum cv8_symheadtype {
     CV8_FILE_INFO       = 0xF4  /* source file info */
 };
 
+enum cv8_checksumtype {
+    CV8_CHECKSUM_NONE   = 0,
+    CV8_CHECKSUM_MD5    = 1,
+    CV8_CHECKSUM_SHA1   = 2,
+    CV8_CHECKSUM_SHA256 = 3
+};
+
 enum cv_symtype {
     /* Non-modal Symbols */
     CV_S_COMPILE        = 0x0001,       /* Compile Flag */
@@ -334,27 +341,94 @@ cv8_add_sym_data(yasm_section *sect, unsigned long type, yasm_symrec *sym,
     return cvs;
 }
 
+/* Hashed index entry: maps a filename to its index in the filename table */
+typedef struct cv_file_index {
+    /*@owned@*/ char *filename;
+    size_t index;
+} cv_file_index;
+
+static void
+cv_file_index_delete(/*@only@*/ void *data)
+{
+    cv_file_index *fi = (cv_file_index *)data;
+    yasm_xfree(fi->filename);
+    yasm_xfree(fi);
+}
+
+/* Associates filename with index.  Only replaces an existing association if
+ * replace is nonzero.
+ */
+static void
+cv_file_index_insert(HAMT *hamt, const char *filename, size_t index,
+                     int replace)
+{
+    cv_file_index *fi = yasm_xmalloc(sizeof(cv_file_index));
+    fi->filename = yasm__xstrdup(filename);
+    fi->index = index;
+    HAMT_insert(hamt, fi->filename, fi, &replace, cv_file_index_delete);
+}
+
+void
+yasm_cv__delete_file_index(yasm_dbgfmt_cv *dbgfmt_cv)
+{
+    if (dbgfmt_cv->filenames_index) {
+        HAMT_destroy(dbgfmt_cv->filenames_index, cv_file_index_delete);
+        dbgfmt_cv->filenames_index = NULL;
+    }
+}
+
+/* Find the first entry in the filename table for filename.  Returns its
+ * index, or filenames_size if not found.
+ */
+static size_t
+cv_dbgfmt_find_file(yasm_dbgfmt_cv *dbgfmt_cv, const char *filename)
+{
+    /*@null@*/ cv_file_index *fi;
+    size_t i;
+
+    if (!dbgfmt_cv->filenames_index) {
+        /* (Re)build index; as entries are inserted in order, the first
+         * entry for each filename is the one kept.
+         */
+        dbgfmt_cv->filenames_index = HAMT_create(0, yasm_internal_error_);
+        dbgfmt_cv->filenames_hole = dbgfmt_cv->filenames_size;
+        for (i=0; i<dbgfmt_cv->filenames_size; i++) {
+            if (!dbgfmt_cv->filenames[i].filename) {
+                if (i < dbgfmt_cv->filenames_hole)
+                    dbgfmt_cv->filenames_hole = i;
+                continue;
+            }
+            cv_file_index_insert(dbgfmt_cv->filenames_index,
+                                 dbgfmt_cv->filenames[i].filename, i, 0);
+        }
+    }
+
+    fi = HAMT_search(dbgfmt_cv->filenames_index, filename);
+    return fi ? fi->index : dbgfmt_cv->filenames_size;
+}
+
 static size_t
 cv_dbgfmt_add_file(yasm_dbgfmt_cv *dbgfmt_cv, size_t filenum,
                    const char *filename)
 {
     char *pathname;
     size_t i;
-    yasm_md5_context context;
-    FILE *f;
-    unsigned char *buf;
-    size_t len;
 
     /* Put the filename into the filename table */
     if (filenum == 0) {
-        /* Look to see if we already have that filename in the table */
-        for (; filenum<dbgfmt_cv->filenames_size; filenum++) {
-            if (!dbgfmt_cv->filenames[filenum].filename ||
-                strcmp(dbgfmt_cv->filenames[filenum].filename, filename) == 0)
-                break;
-        }
-    } else
+        /* Look to see if we already have that filename in the table;
+         * if not, fill the first unused entry.
+         */
+        filenum = cv_dbgfmt_find_file(dbgfmt_cv, filename);
+        if (filenum > dbgfmt_cv->filenames_hole)
+            filenum = dbgfmt_cv->filenames_hole;
+    } else {
         filenum--;      /* array index is 0-based */
+        /* Entries may be replaced or skipped; rebuild index when next
+         * needed.
+         */
+        yasm_cv__delete_file_index(dbgfmt_cv);
+    }
 
     /* Realloc table if necessary */
     if (filenum >= dbgfmt_cv->filenames_allocated) {
@@ -370,18 +444,6 @@ cv_dbgfmt_add_file(yasm_dbgfmt_cv *dbgfmt_cv, size_t filenum,
         }
     }
 
-    /* Calculate MD5 checksum of file */
-    buf = yasm_xmalloc(1024);
-    yasm_md5_init(&context);
-    f = fopen(filename, "rb");
-    if (!f)
-        yasm__fatal(N_("codeview: could not open source file"));
-    while ((len = fread(buf, 1, 1024, f)) > 0)
-        yasm_md5_update(&context, buf, (unsigned long)len);
-    yasm_md5_final(dbgfmt_cv->filenames[filenum].digest, &context);
-    fclose(f);
-    yasm_xfree(buf);
-
     /* Actually save in table */
     if (dbgfmt_cv->filenames[filenum].pathname)
         yasm_xfree(dbgfmt_cv->filenames[filenum].pathname);
@@ -396,6 +458,18 @@ cv_dbgfmt_add_file(yasm_dbgfmt_cv *dbgfmt_cv, size_t filenum,
     if (filenum >= dbgfmt_cv->filenames_size)
         dbgfmt_cv->filenames_size = filenum + 1;
 
+    /* Update index (if not waiting to be rebuilt) */
+    if (dbgfmt_cv->filenames_index) {
+        /* Nothing before this entry matched, so it's now the first */
+        cv_file_index_insert(dbgfmt_cv->filenames_index, filename, filenum,
+                             1);
+        for (i=dbgfmt_cv->filenames_hole; i<dbgfmt_cv->filenames_size; i++) {
+            if (!dbgfmt_cv->filenames[i].filename)
+                break;
+        }
+        dbgfmt_cv->filenames_hole = i;
+    }
+
     return filenum;
 }
 
@@ -424,6 +498,10 @@ typedef struct cv_line_info {
     STAILQ_HEAD(cv8_lineinfo_head, cv8_lineinfo) cv8_lineinfos;
     /*@null@*/ cv8_lineinfo *cv8_cur_li;
     /*@null@*/ cv8_lineset *cv8_cur_ls;
+    /* filename table index plus 1 (0 if not yet looked up) of each
+     * linemap filename ID
+     */
+    size_t *file_ids;
 } cv_line_info;
 
 static int
@@ -433,30 +511,31 @@ cv_generate_line_bc(yasm_bytecode *bc, /*@null@*/ void *d)
     yasm_dbgfmt_cv *dbgfmt_cv = info->dbgfmt_cv;
     size_t i;
     const char *filename;
-    unsigned long line;
+    unsigned long id, line;
     /*@null@*/ yasm_bytecode *nextbc = yasm_bc__next(bc);
     yasm_section *sect = yasm_bc_get_section(bc);
 
     if (nextbc && bc->offset == nextbc->offset)
         return 0;
 
-    yasm_linemap_lookup(info->linemap, bc->line, &filename, &line);
+    yasm_linemap_lookup_id(info->linemap, bc->line, &filename, &id, &line);
+
+    /* Find file; only look it up once per linemap filename */
+    if (info->file_ids[id] == 0) {
+        i = cv_dbgfmt_find_file(dbgfmt_cv, filename);
+        if (i >= dbgfmt_cv->filenames_size)
+            yasm_internal_error(N_("could not find filename in table"));
+        info->file_ids[id] = i+1;
+    }
+    i = info->file_ids[id]-1;
 
     if (!info->cv8_cur_li
-        || strcmp(filename, info->cv8_cur_li->fn->filename) != 0) {
+        || info->cv8_cur_li->fn != &dbgfmt_cv->filenames[i]) {
         yasm_bytecode *sectbc;
         char symname[8];
         int first_in_sect = !info->cv8_cur_li;
 
-        /* Find file */
-        for (i=0; i<dbgfmt_cv->filenames_size; i++) {
-            if (strcmp(filename, dbgfmt_cv->filenames[i].filename) == 0)
-                break;
-        }
-        if (i >= dbgfmt_cv->filenames_size)
-            yasm_internal_error(N_("could not find filename in table"));
-
-        /* and create new lineinfo structure */
+        /* Create new lineinfo structure */
         info->cv8_cur_li = yasm_xmalloc(sizeof(cv8_lineinfo));
         info->cv8_cur_li->fn = &dbgfmt_cv->filenames[i];
         info->cv8_cur_li->sect = sect;
@@ -516,6 +595,41 @@ cv_generate_filename(const char *filename, void *d)
     return 0;
 }
 
+typedef struct cv_checksum_info {
+    yasm_dbgfmt_cv *dbgfmt_cv;
+    int *failed;        /* per file: nonzero if it couldn't be read */
+} cv_checksum_info;
+
+static void
+cv_checksum_file(unsigned long job, void *d)
+{
+    cv_checksum_info *info = (cv_checksum_info *)d;
+    cv_filename *fn = &info->dbgfmt_cv->filenames[job];
+
+    if (fn->filename)
+        info->failed[job] = yasm_checksum_file(fn->filename,
+                                               info->dbgfmt_cv->checksum,
+                                               fn->digest);
+}
+
+/* Checksum all source files, in parallel if allowed */
+static void
+cv_checksum_files(yasm_object *object, yasm_dbgfmt_cv *dbgfmt_cv)
+{
+    cv_checksum_info info;
+    size_t i;
+
+    info.dbgfmt_cv = dbgfmt_cv;
+    info.failed = yasm_xcalloc(dbgfmt_cv->filenames_size+1, sizeof(int));
+    yasm_parallel_run(object->threads, dbgfmt_cv->filenames_size, &info,
+                      cv_checksum_file);
+    for (i=0; i<dbgfmt_cv->filenames_size; i++) {
+        if (info.failed[i])
+            yasm__fatal(N_("codeview: could not open source file"));
+    }
+    yasm_xfree(info.failed);
+}
+
 static int
 cv_generate_sym(yasm_symrec *sym, void *d)
 {
@@ -555,6 +669,7 @@ yasm_cv__generate_symline(yasm_object *object, yasm_linemap *linemap,
     /* Generate filenames based on linemap */
     yasm_linemap_traverse_filenames(linemap, dbgfmt_cv,
                                     cv_generate_filename);
+    cv_checksum_files(object, dbgfmt_cv);
 
     info.object = object;
     info.dbgfmt_cv = dbgfmt_cv;
@@ -566,6 +681,8 @@ yasm_cv__generate_symline(yasm_object *object, yasm_linemap *linemap,
     STAILQ_INIT(&info.cv8_lineinfos);
     info.cv8_cur_li = NULL;
     info.cv8_cur_ls = NULL;
+    info.file_ids = yasm_xcalloc(yasm_linemap_get_num_filenames(linemap)+1,
+                                 sizeof(size_t));
 
     /* source filenames string table */
     head = cv8_add_symhead(info.debug_symline, CV8_FILE_STRTAB, 1);
@@ -609,6 +726,7 @@ yasm_cv__generate_symline(yasm_object *object, yasm_linemap *linemap,
     /* Generate line numbers for sections */
     yasm_object_sections_traverse(object, (void *)&info,
                                   cv_generate_line_section);
+    yasm_xfree(info.file_ids);
 
     /* Output line numbers for sections */
     head = NULL;
@@ -760,6 +878,8 @@ cv8_symhead_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
 static yasm_bytecode *
 cv8_add_fileinfo(yasm_section *sect, const cv_filename *fn)
 {
+    yasm_dbgfmt_cv *dbgfmt_cv =
+        (yasm_dbgfmt_cv *)yasm_section_get_object(sect)->dbgfmt;
     cv8_fileinfo *fi;
     yasm_bytecode *bc;
 
@@ -767,7 +887,9 @@ cv8_add_fileinfo(yasm_section *sect, const cv_filename *fn)
     fi->fn = fn;
 
     bc = yasm_bc_create_common(&cv8_fileinfo_bc_callback, fi, 0);
-    bc->len = 24;
+    /* offset, checksum type/length and checksum, padded to 4 bytes */
+    bc->len = 6 + (unsigned long)yasm_checksum_size(dbgfmt_cv->checksum);
+    bc->len = (bc->len + 3) & ~3UL;
 
     yasm_cv__append_bc(sect, bc);
     return bc;
@@ -801,10 +923,11 @@ cv8_fileinfo_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
                         yasm_output_reloc_func output_reloc)
 {
     yasm_object *object = yasm_section_get_object(bc->section);
+    yasm_dbgfmt_cv *dbgfmt_cv = (yasm_dbgfmt_cv *)object->dbgfmt;
     cv8_fileinfo *fi = (cv8_fileinfo *)bc->contents;
     unsigned char *buf = *bufp;
     yasm_intnum *cval;
-    int i;
+    size_t i, size = yasm_checksum_size(dbgfmt_cv->checksum);
 
     /* Offset in filename string table */
     cval = yasm_intnum_create_uint(fi->fn->str_off);
@@ -812,17 +935,17 @@ cv8_fileinfo_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
     buf += 4;
 
     /* Checksum type/length */
-    yasm_intnum_set_uint(cval, 0x0110);
-    yasm_arch_intnum_tobytes(object->arch, cval, buf, 2, 16, 0, bc, 0);
-    buf += 2;
+    YASM_WRITE_8(buf, size);
+    YASM_WRITE_8(buf, dbgfmt_cv->checksum == YASM_CHECKSUM_SHA256 ?
+                 CV8_CHECKSUM_SHA256 : CV8_CHECKSUM_MD5);
 
     /* Checksum */
-    for (i=0; i<16; i++)
+    for (i=0; i<size; i++)
         YASM_WRITE_8(buf, fi->fn->digest[i]);
 
     /* Pad */
-    YASM_WRITE_8(buf, 0);
-    YASM_WRITE_8(buf, 0);
+    for (i=6+size; i<bc->len; i++)
+        YASM_WRITE_8(buf, 0);
 
     *bufp = buf;
 
@@ -98,6 +98,10 @@ dwarf2_dbgfmt_create(yasm_object *object)
         dbgfmt_dwarf2->filenames[i].dir = 0;
     }
 
+    dbgfmt_dwarf2->dirs_index = NULL;
+    dbgfmt_dwarf2->filenames_index = NULL;
+    dbgfmt_dwarf2->filenames_hole = 0;
+
     dbgfmt_dwarf2->format = DWARF2_FORMAT_32BIT;    /* TODO: flexible? */
 
     dbgfmt_dwarf2->sizeof_address = yasm_arch_get_address_size(object->arch)/8;
@@ -119,6 +123,7 @@ dwarf2_dbgfmt_destroy(/*@only@*/ yasm_dbgfmt *dbgfmt)
 {
     yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2 = (yasm_dbgfmt_dwarf2 *)dbgfmt;
     size_t i;
+    yasm_dwarf2__delete_file_index(dbgfmt_dwarf2);
     for (i=0; i<dbgfmt_dwarf2->dirs_size; i++)
         if (dbgfmt_dwarf2->dirs[i])
             yasm_xfree(dbgfmt_dwarf2->dirs[i]);
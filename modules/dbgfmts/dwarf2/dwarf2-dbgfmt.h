@@ -48,6 +48,11 @@ typedef struct yasm_dbgfmt_dwarf2 {
     unsigned long filenames_size;
     unsigned long filenames_allocated;
 
+    /* Hashed indexes into dirs and filenames (built on demand) */
+    /*@null@*/ /*@only@*/ HAMT *dirs_index;
+    /*@null@*/ /*@only@*/ HAMT *filenames_index;
+    unsigned long filenames_hole;   /* first unused entry in filenames */
+
     enum {
         DWARF2_FORMAT_32BIT,
         DWARF2_FORMAT_64BIT
@@ -108,6 +113,7 @@ yasm_section *yasm_dwarf2__generate_line
     (yasm_object *object, yasm_linemap *linemap, yasm_errwarns *errwarns,
      int asm_source, /*@out@*/ yasm_section **main_code,
      /*@out@*/ size_t *num_line_sections);
+void yasm_dwarf2__delete_file_index(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2);
 void yasm_dwarf2__dir_loc(yasm_object *object, yasm_valparamhead *valparams,
                           yasm_valparamhead *objext_valparams,
                           unsigned long line);
@@ -113,16 +113,29 @@ typedef struct dwarf2_spp {
     yasm_bytecode *line_end_prevbc;
 } dwarf2_spp;
 
-typedef struct dwarf2_line_op {
-    dwarf_line_number_op opcode;
-    /*@owned@*/ /*@null@*/ yasm_intnum *operand;
+/* Address operand (of DW_LNE_set_address) in a line number program */
+typedef struct dwarf2_line_addr {
+    unsigned long offset;       /* offset of operand in program */
+    /*@dependent@*/ yasm_symrec *sym;
+} dwarf2_line_addr;
+
+/* The line number program for all sections, encoded directly into a byte
+ * buffer (it is generated after optimization, so all address advances are
+ * already known).  Only the DW_LNE_set_address operands are left to be
+ * output as values (as they generally need relocations).
+ */
+typedef struct dwarf2_line_prog {
+    /*@owned@*/ unsigned char *buf;
+    unsigned long len, max;
+
+    /*@owned@*/ dwarf2_line_addr *addrs;
+    unsigned long num_addrs, max_addrs;
+} dwarf2_line_prog;
 
-    /* extended opcode */
-    dwarf_line_number_ext_op ext_opcode;
-    /*@null@*/ /*@dependent@*/ yasm_symrec *ext_operand;  /* unsigned */
-    /*@null@*/ /*@dependent@*/ yasm_intnum *ext_operand_int; /* unsigned */
-    unsigned long ext_operandsize;
-} dwarf2_line_op;
+/* Maximum size of a line number opcode and its operands, other than the
+ * DW_LNE_set_address operand.
+ */
+#define DWARF2_LINE_OP_MAXLEN   (3+2*(sizeof(unsigned long)*8+6)/7)
 
 /* Bytecode callback function prototypes */
 static void dwarf2_spp_bc_destroy(void *contents);
@@ -135,12 +148,12 @@ static int dwarf2_spp_bc_tobytes
      yasm_output_value_func output_value,
      /*@null@*/ yasm_output_reloc_func output_reloc);
 
-static void dwarf2_line_op_bc_destroy(void *contents);
-static void dwarf2_line_op_bc_print(const void *contents, FILE *f,
-                                    int indent_level);
-static int dwarf2_line_op_bc_calc_len
+static void dwarf2_line_prog_bc_destroy(void *contents);
+static void dwarf2_line_prog_bc_print(const void *contents, FILE *f,
+                                      int indent_level);
+static int dwarf2_line_prog_bc_calc_len
     (yasm_bytecode *bc, yasm_bc_add_span_func add_span, void *add_span_data);
-static int dwarf2_line_op_bc_tobytes
+static int dwarf2_line_prog_bc_tobytes
     (yasm_bytecode *bc, unsigned char **bufp, unsigned char *bufstart, void *d,
      yasm_output_value_func output_value,
      /*@null@*/ yasm_output_reloc_func output_reloc);
@@ -157,18 +170,134 @@ static const yasm_bytecode_callback dwarf2_spp_bc_callback = {
     0
 };
 
-static const yasm_bytecode_callback dwarf2_line_op_bc_callback = {
-    dwarf2_line_op_bc_destroy,
-    dwarf2_line_op_bc_print,
+static const yasm_bytecode_callback dwarf2_line_prog_bc_callback = {
+    dwarf2_line_prog_bc_destroy,
+    dwarf2_line_prog_bc_print,
     yasm_bc_finalize_common,
     NULL,
-    dwarf2_line_op_bc_calc_len,
+    dwarf2_line_prog_bc_calc_len,
     yasm_bc_expand_common,
-    dwarf2_line_op_bc_tobytes,
+    dwarf2_line_prog_bc_tobytes,
     0
 };
 
 
+/* Hashed index entry: maps a directory name or filename key to its 0-based
+ * index in the dirs or filenames table.
+ */
+typedef struct dwarf2_file_index {
+    /*@owned@*/ char *key;
+    unsigned long index;
+} dwarf2_file_index;
+
+static void
+dwarf2_file_index_delete(/*@only@*/ void *data)
+{
+    dwarf2_file_index *fi = (dwarf2_file_index *)data;
+    yasm_xfree(fi->key);
+    yasm_xfree(fi);
+}
+
+/* Associates key (which is taken over) with index.  Only replaces an
+ * existing association if replace is nonzero.
+ */
+static void
+dwarf2_file_index_insert(HAMT *hamt, /*@only@*/ char *key,
+                         unsigned long index, int replace)
+{
+    dwarf2_file_index *fi = yasm_xmalloc(sizeof(dwarf2_file_index));
+    fi->key = key;
+    fi->index = index;
+    HAMT_insert(hamt, key, fi, &replace, dwarf2_file_index_delete);
+}
+
+/* Filename index key: directory index and filename (which can't contain
+ * path separators).
+ */
+static /*@only@*/ char *
+dwarf2_filename_key(unsigned long dir, const char *filename)
+{
+    char *key = yasm_xmalloc(strlen(filename)+24);
+    sprintf(key, "%lu/%s", dir, filename);
+    return key;
+}
+
+void
+yasm_dwarf2__delete_file_index(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2)
+{
+    if (dbgfmt_dwarf2->dirs_index) {
+        HAMT_destroy(dbgfmt_dwarf2->dirs_index, dwarf2_file_index_delete);
+        dbgfmt_dwarf2->dirs_index = NULL;
+    }
+    if (dbgfmt_dwarf2->filenames_index) {
+        HAMT_destroy(dbgfmt_dwarf2->filenames_index,
+                     dwarf2_file_index_delete);
+        dbgfmt_dwarf2->filenames_index = NULL;
+    }
+}
+
+/* Find the directory of pathname in the directory table.  Returns its
+ * 1-based index, or 0 if not found.
+ */
+static unsigned long
+dwarf2_dbgfmt_find_dir(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2,
+                       const char *pathname, size_t dirlen)
+{
+    /*@null@*/ dwarf2_file_index *fi;
+    char *dirname;
+    unsigned long dir;
+
+    if (!dbgfmt_dwarf2->dirs_index) {
+        dbgfmt_dwarf2->dirs_index = HAMT_create(0, yasm_internal_error_);
+        for (dir=0; dir<dbgfmt_dwarf2->dirs_size; dir++)
+            dwarf2_file_index_insert(dbgfmt_dwarf2->dirs_index,
+                                     yasm__xstrdup(dbgfmt_dwarf2->dirs[dir]),
+                                     dir, 0);
+    }
+
+    dirname = yasm__xstrndup(pathname, dirlen);
+    fi = HAMT_search(dbgfmt_dwarf2->dirs_index, dirname);
+    yasm_xfree(dirname);
+    return fi ? fi->index+1 : 0;
+}
+
+/* Find the first entry in the filename table for filename in directory dir.
+ * Returns its 0-based index, or filenames_size if not found.
+ */
+static unsigned long
+dwarf2_dbgfmt_find_filename(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2,
+                            unsigned long dir, const char *filename)
+{
+    /*@null@*/ dwarf2_file_index *fi;
+    char *key;
+    unsigned long i;
+
+    if (!dbgfmt_dwarf2->filenames_index) {
+        /* (Re)build index; as entries are inserted in order, the first
+         * entry for each filename is the one kept.
+         */
+        dbgfmt_dwarf2->filenames_index = HAMT_create(0, yasm_internal_error_);
+        dbgfmt_dwarf2->filenames_hole = dbgfmt_dwarf2->filenames_size;
+        for (i=0; i<dbgfmt_dwarf2->filenames_size; i++) {
+            dwarf2_filename *fn = &dbgfmt_dwarf2->filenames[i];
+            if (!fn->filename) {
+                if (i < dbgfmt_dwarf2->filenames_hole)
+                    dbgfmt_dwarf2->filenames_hole = i;
+                continue;
+            }
+            dwarf2_file_index_insert(dbgfmt_dwarf2->filenames_index,
+                                     dwarf2_filename_key(fn->dir,
+                                                         fn->filename),
+                                     i, 0);
+        }
+    }
+
+    key = dwarf2_filename_key(dir, filename);
+    fi = HAMT_search(dbgfmt_dwarf2->filenames_index, key);
+    yasm_xfree(key);
+    return fi ? fi->index : dbgfmt_dwarf2->filenames_size;
+}
+
 static size_t
 dwarf2_dbgfmt_add_file(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2, unsigned long filenum,
                        const char *pathname)
@@ -182,13 +311,10 @@ dwarf2_dbgfmt_add_file(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2, unsigned long filenum,
     dirlen = yasm__splitpath(pathname, &filename);
     if (dirlen > 0) {
         /* Look to see if we already have that dir in the table */
-        for (dir=1; dir<dbgfmt_dwarf2->dirs_size+1; dir++) {
-            if (strncmp(dbgfmt_dwarf2->dirs[dir-1], pathname, dirlen) == 0
-                && dbgfmt_dwarf2->dirs[dir-1][dirlen] == '\0')
-                break;
-        }
-        if (dir >= dbgfmt_dwarf2->dirs_size+1) {
+        dir = dwarf2_dbgfmt_find_dir(dbgfmt_dwarf2, pathname, dirlen);
+        if (dir == 0) {
             /* Not found in table, add to end, reallocing if necessary */
+            dir = dbgfmt_dwarf2->dirs_size+1;
             if (dir >= dbgfmt_dwarf2->dirs_allocated+1) {
                 dbgfmt_dwarf2->dirs_allocated = dir+32;
                 dbgfmt_dwarf2->dirs = yasm_xrealloc(dbgfmt_dwarf2->dirs,
@@ -196,21 +322,31 @@ dwarf2_dbgfmt_add_file(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2, unsigned long filenum,
             }
             dbgfmt_dwarf2->dirs[dir-1] = yasm__xstrndup(pathname, dirlen);
             dbgfmt_dwarf2->dirs_size = dir;
+            dwarf2_file_index_insert(dbgfmt_dwarf2->dirs_index,
+                                     yasm__xstrndup(pathname, dirlen),
+                                     dir-1, 0);
         }
     }
 
     /* Put the filename into the filename table */
     if (filenum == 0) {
-        /* Look to see if we already have that filename in the table */
-        for (; filenum<dbgfmt_dwarf2->filenames_size; filenum++) {
-            if (!dbgfmt_dwarf2->filenames[filenum].filename ||
-                (dbgfmt_dwarf2->filenames[filenum].dir == dir
-                 && strcmp(dbgfmt_dwarf2->filenames[filenum].filename,
-                           filename) == 0))
-                break;
-        }
-    } else
+        /* Look to see if we already have that filename in the table;
+         * if not, fill the first unused entry.
+         */
+        filenum = dwarf2_dbgfmt_find_filename(dbgfmt_dwarf2, dir, filename);
+        if (filenum > dbgfmt_dwarf2->filenames_hole)
+            filenum = dbgfmt_dwarf2->filenames_hole;
+    } else {
         filenum--;      /* array index is 0-based */
+        /* Entries may be replaced or skipped; rebuild index when next
+         * needed.
+         */
+        if (dbgfmt_dwarf2->filenames_index) {
+            HAMT_destroy(dbgfmt_dwarf2->filenames_index,
+                         dwarf2_file_index_delete);
+            dbgfmt_dwarf2->filenames_index = NULL;
+        }
+    }
 
     /* Realloc table if necessary */
     if (filenum >= dbgfmt_dwarf2->filenames_allocated) {
@@ -238,85 +374,116 @@ dwarf2_dbgfmt_add_file(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2, unsigned long filenum,
     if (filenum >= dbgfmt_dwarf2->filenames_size)
         dbgfmt_dwarf2->filenames_size = filenum + 1;
 
+    /* Update index (if not waiting to be rebuilt) */
+    if (dbgfmt_dwarf2->filenames_index) {
+        /* Nothing before this entry matched, so it's now the first */
+        dwarf2_file_index_insert(dbgfmt_dwarf2->filenames_index,
+                                 dwarf2_filename_key(dir, filename),
+                                 filenum, 1);
+        for (i=dbgfmt_dwarf2->filenames_hole;
+             i<dbgfmt_dwarf2->filenames_size; i++) {
+            if (!dbgfmt_dwarf2->filenames[i].filename)
+                break;
+        }
+        dbgfmt_dwarf2->filenames_hole = i;
+    }
+
     return filenum;
 }
 
-/* Create and add a new line opcode to a section, updating offset on insertion;
- * no optimization necessary.
+/* Make room for at least size more bytes in a line number program. */
+static unsigned char *
+dwarf2_line_prog_reserve(dwarf2_line_prog *prog, unsigned long size)
+{
+    if (prog->len+size > prog->max) {
+        prog->max = prog->max*2 > prog->len+size ? prog->max*2 :
+            prog->len+size;
+        prog->buf = yasm_xrealloc(prog->buf, prog->max);
+    }
+    return &prog->buf[prog->len];
+}
+
+/* Add a new line opcode (with no operand) to a line number program. */
+static void
+dwarf2_dbgfmt_append_line_op(dwarf2_line_prog *prog, int opcode)
+{
+    unsigned char *buf = dwarf2_line_prog_reserve(prog, 1);
+    YASM_WRITE_8(buf, opcode);
+    prog->len++;
+}
+
+/* Add a new line opcode with an unsigned operand to a line number
+ * program.
  */
-static yasm_bytecode *
-dwarf2_dbgfmt_append_line_op(yasm_section *sect, dwarf_line_number_op opcode,
-                             /*@only@*/ /*@null@*/ yasm_intnum *operand)
+static void
+dwarf2_dbgfmt_append_line_op_uint(dwarf2_line_prog *prog,
+                                  dwarf_line_number_op opcode,
+                                  unsigned long operand)
+{
+    unsigned char *buf = dwarf2_line_prog_reserve(prog, DWARF2_LINE_OP_MAXLEN);
+    YASM_WRITE_8(buf, opcode);
+    prog->len += 1 + yasm_get_uleb128(operand, buf);
+}
+
+/* Add a new line opcode with a signed operand to a line number program. */
+static void
+dwarf2_dbgfmt_append_line_op_int(dwarf2_line_prog *prog,
+                                 dwarf_line_number_op opcode, long operand)
 {
-    dwarf2_line_op *line_op = yasm_xmalloc(sizeof(dwarf2_line_op));
-    yasm_bytecode *bc;
-
-    line_op->opcode = opcode;
-    line_op->operand = operand;
-    line_op->ext_opcode = 0;
-    line_op->ext_operand = NULL;
-    line_op->ext_operand_int = NULL;
-    line_op->ext_operandsize = 0;
-
-    bc = yasm_bc_create_common(&dwarf2_line_op_bc_callback, line_op, 0);
-    bc->len = 1;
-    if (operand)
-        bc->len += yasm_intnum_size_leb128(operand,
-                                           opcode == DW_LNS_advance_line);
-
-    yasm_dwarf2__append_bc(sect, bc);
-    return bc;
+    unsigned char *buf = dwarf2_line_prog_reserve(prog, DWARF2_LINE_OP_MAXLEN);
+    YASM_WRITE_8(buf, opcode);
+    prog->len += 1 + yasm_get_sleb128(operand, buf);
 }
 
-/* Create and add a new extended line opcode to a section, updating offset on
- * insertion; no optimization necessary.
+/* Add a new extended line opcode to a line number program.  The operand
+ * (if any) is an address, output when the program is output.
  */
-static yasm_bytecode *
-dwarf2_dbgfmt_append_line_ext_op(yasm_section *sect,
+static void
+dwarf2_dbgfmt_append_line_ext_op(dwarf2_line_prog *prog,
                                  dwarf_line_number_ext_op ext_opcode,
                                  unsigned long ext_operandsize,
                                  /*@null@*/ yasm_symrec *ext_operand)
 {
-    dwarf2_line_op *line_op = yasm_xmalloc(sizeof(dwarf2_line_op));
-    yasm_bytecode *bc;
-
-    line_op->opcode = DW_LNS_extended_op;
-    line_op->operand = yasm_intnum_create_uint(ext_operandsize+1);
-    line_op->ext_opcode = ext_opcode;
-    line_op->ext_operand = ext_operand;
-    line_op->ext_operand_int = NULL;
-    line_op->ext_operandsize = ext_operandsize;
-
-    bc = yasm_bc_create_common(&dwarf2_line_op_bc_callback, line_op, 0);
-    bc->len = 2 + yasm_intnum_size_leb128(line_op->operand, 0) +
-        ext_operandsize;
-
-    yasm_dwarf2__append_bc(sect, bc);
-    return bc;
+    unsigned char *buf = dwarf2_line_prog_reserve(prog,
+        DWARF2_LINE_OP_MAXLEN+ext_operandsize);
+    unsigned char *start = buf;
+
+    YASM_WRITE_8(buf, DW_LNS_extended_op);
+    buf += yasm_get_uleb128(ext_operandsize+1, buf);
+    YASM_WRITE_8(buf, ext_opcode);
+    if (ext_operand) {
+        dwarf2_line_addr *addr;
+
+        if (prog->num_addrs >= prog->max_addrs) {
+            prog->max_addrs = prog->max_addrs ? prog->max_addrs*2 : 8;
+            prog->addrs = yasm_xrealloc(prog->addrs,
+                sizeof(dwarf2_line_addr)*prog->max_addrs);
+        }
+        addr = &prog->addrs[prog->num_addrs++];
+        addr->offset = prog->len + (unsigned long)(buf-start);
+        addr->sym = ext_operand;
+    }
+    memset(buf, 0, ext_operandsize);
+    buf += ext_operandsize;
+    prog->len += (unsigned long)(buf-start);
 }
 
-static yasm_bytecode *
-dwarf2_dbgfmt_append_line_ext_op_int(yasm_section *sect,
-                                     dwarf_line_number_ext_op ext_opcode,
-                                     /*@only@*/ yasm_intnum *ext_operand)
+/* Add a new extended line opcode with an unsigned operand to a line number
+ * program.
+ */
+static void
+dwarf2_dbgfmt_append_line_ext_op_uint(dwarf2_line_prog *prog,
+                                      dwarf_line_number_ext_op ext_opcode,
+                                      unsigned long ext_operand)
 {
-    dwarf2_line_op *line_op = yasm_xmalloc(sizeof(dwarf2_line_op));
-    unsigned long ext_operandsize = yasm_intnum_size_leb128(ext_operand, 0);
-    yasm_bytecode *bc;
-
-    line_op->opcode = DW_LNS_extended_op;
-    line_op->operand = yasm_intnum_create_uint(ext_operandsize+1);
-    line_op->ext_opcode = ext_opcode;
-    line_op->ext_operand = NULL;
-    line_op->ext_operand_int = ext_operand;
-    line_op->ext_operandsize = ext_operandsize;
-
-    bc = yasm_bc_create_common(&dwarf2_line_op_bc_callback, line_op, 0);
-    bc->len = 2 + yasm_intnum_size_leb128(line_op->operand, 0) +
-        ext_operandsize;
-
-    yasm_dwarf2__append_bc(sect, bc);
-    return bc;
+    unsigned char *buf = dwarf2_line_prog_reserve(prog, DWARF2_LINE_OP_MAXLEN);
+    unsigned char *start = buf;
+
+    YASM_WRITE_8(buf, DW_LNS_extended_op);
+    buf += yasm_get_uleb128(yasm_size_uleb128(ext_operand)+1, buf);
+    YASM_WRITE_8(buf, ext_opcode);
+    buf += yasm_get_uleb128(ext_operand, buf);
+    prog->len += (unsigned long)(buf-start);
 }
 
 static void
@@ -352,7 +519,7 @@ dwarf2_dbgfmt_finalize_locs(yasm_section *sect, dwarf2_section_data *dsd)
 }
 
 static int
-dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
+dwarf2_dbgfmt_gen_line_op(dwarf2_line_prog *prog, dwarf2_line_state *state,
                           const dwarf2_loc *loc,
                           /*@null@*/ const dwarf2_loc *nextloc)
 {
@@ -363,43 +530,39 @@ dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
 
     if (state->file != loc->file) {
         state->file = loc->file;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_file,
-                                     yasm_intnum_create_uint(state->file));
+        dwarf2_dbgfmt_append_line_op_uint(prog, DW_LNS_set_file, state->file);
     }
     if (state->column != loc->column) {
         state->column = loc->column;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_column,
-                                     yasm_intnum_create_uint(state->column));
+        dwarf2_dbgfmt_append_line_op_uint(prog, DW_LNS_set_column,
+                                          state->column);
     }
     if (loc->discriminator != 0) {
-        dwarf2_dbgfmt_append_line_ext_op_int(debug_line,
-            DW_LNE_set_discriminator,
-            yasm_intnum_create_uint(loc->discriminator));
+        dwarf2_dbgfmt_append_line_ext_op_uint(prog, DW_LNE_set_discriminator,
+                                              loc->discriminator);
     }
 #ifdef WITH_DWARF3
     if (loc->isa_change) {
         state->isa = loc->isa;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_isa,
-                                     yasm_intnum_create_uint(state->isa));
+        dwarf2_dbgfmt_append_line_op_uint(prog, DW_LNS_set_isa, state->isa);
     }
 #endif
     if (state->is_stmt == 0 && loc->is_stmt == IS_STMT_SET) {
         state->is_stmt = 1;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_negate_stmt, NULL);
+        dwarf2_dbgfmt_append_line_op(prog, DW_LNS_negate_stmt);
     } else if (state->is_stmt == 1 && loc->is_stmt == IS_STMT_CLEAR) {
         state->is_stmt = 0;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_negate_stmt, NULL);
+        dwarf2_dbgfmt_append_line_op(prog, DW_LNS_negate_stmt);
     }
     if (loc->basic_block) {
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_basic_block, NULL);
+        dwarf2_dbgfmt_append_line_op(prog, DW_LNS_set_basic_block);
     }
 #ifdef WITH_DWARF3
     if (loc->prologue_end) {
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_prologue_end, NULL);
+        dwarf2_dbgfmt_append_line_op(prog, DW_LNS_set_prologue_end);
     }
     if (loc->epilogue_begin) {
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_epilogue_begin,
-                                     NULL);
+        dwarf2_dbgfmt_append_line_op(prog, DW_LNS_set_epilogue_begin);
     }
 #endif
 
@@ -415,7 +578,7 @@ dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
                            N_("could not find label prior to loc"));
             return 1;
         }
-        dwarf2_dbgfmt_append_line_ext_op(debug_line, DW_LNE_set_address,
+        dwarf2_dbgfmt_append_line_ext_op(prog, DW_LNE_set_address,
             dbgfmt_dwarf2->sizeof_address, loc->sym);
         addr_delta = 0;
     } else if (loc->bc) {
@@ -435,8 +598,8 @@ dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
     if (line_delta < DWARF2_LINE_BASE
         || line_delta >= DWARF2_LINE_BASE+DWARF2_LINE_RANGE) {
         /* Won't fit in special opcode, use (signed) line advance */
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_advance_line,
-                                     yasm_intnum_create_int(line_delta));
+        dwarf2_dbgfmt_append_line_op_int(prog, DW_LNS_advance_line,
+                                         line_delta);
         line_delta = 0;
     }
 
@@ -448,26 +611,25 @@ dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
                              dbgfmt_dwarf2->min_insn_len);
     if (line_delta == 0 && addr_delta == 0) {
         /* Both line and addr deltas are 0: do DW_LNS_copy */
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_copy, NULL);
+        dwarf2_dbgfmt_append_line_op(prog, DW_LNS_copy);
     } else if (addr_delta <= DWARF2_MAX_SPECIAL_ADDR_DELTA && opcode1 <= 255) {
         /* Addr delta in range of special opcode */
-        dwarf2_dbgfmt_append_line_op(debug_line, opcode1, NULL);
+        dwarf2_dbgfmt_append_line_op(prog, opcode1);
     } else if (addr_delta <= 2*DWARF2_MAX_SPECIAL_ADDR_DELTA
                && opcode2 <= 255) {
         /* Addr delta in range of const_add_pc + special */
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_const_add_pc, NULL);
-        dwarf2_dbgfmt_append_line_op(debug_line, opcode2, NULL);
+        dwarf2_dbgfmt_append_line_op(prog, DW_LNS_const_add_pc);
+        dwarf2_dbgfmt_append_line_op(prog, opcode2);
     } else {
         /* Need advance_pc */
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_advance_pc,
-                                     yasm_intnum_create_uint(addr_delta));
+        dwarf2_dbgfmt_append_line_op_uint(prog, DW_LNS_advance_pc, addr_delta);
         /* Take care of any remaining line_delta and add entry to matrix */
         if (line_delta == 0)
-            dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_copy, NULL);
+            dwarf2_dbgfmt_append_line_op(prog, DW_LNS_copy);
         else {
             unsigned int opcode;
             opcode = DWARF2_LINE_OPCODE_BASE + line_delta - DWARF2_LINE_BASE;
-            dwarf2_dbgfmt_append_line_op(debug_line, opcode, NULL);
+            dwarf2_dbgfmt_append_line_op(prog, opcode);
         }
     }
     state->precbc = loc->bc;
@@ -475,42 +637,24 @@ dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
 }
 
 typedef struct dwarf2_line_bc_info {
-    yasm_section *debug_line;
+    dwarf2_line_prog *prog;
     yasm_object *object;
     yasm_linemap *linemap;
     yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2;
     dwarf2_line_state *state;
     dwarf2_loc loc;
-    unsigned long lastfile;
+    /* file index (1-based, 0 if not yet looked up) of each linemap
+     * filename ID
+     */
+    unsigned long *file_ids;
 } dwarf2_line_bc_info;
 
-static int
-dwarf2_filename_equals(const dwarf2_filename *fn,
-                       char **dirs,
-                       const char *pathname,
-                       unsigned long dirlen,
-                       const char *filename)
-{
-    /* check directory */
-    if (fn->dir == 0) {
-        if (dirlen != 0)
-            return 0;
-    } else {
-        if (strncmp(dirs[fn->dir-1], pathname, dirlen) != 0 ||
-            dirs[fn->dir-1][dirlen] != '\0')
-            return 0;
-    }
-
-    /* check filename */
-    return strcmp(fn->filename, filename) == 0;
-}
-
 static int
 dwarf2_generate_line_bc(yasm_bytecode *bc, /*@null@*/ void *d)
 {
     dwarf2_line_bc_info *info = (dwarf2_line_bc_info *)d;
     yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2 = info->dbgfmt_dwarf2;
-    unsigned long i;
+    unsigned long i, dir, id;
     size_t dirlen;
     const char *pathname, *filename;
     /*@null@*/ yasm_bytecode *nextbc = yasm_bc__next(bc);
@@ -530,28 +674,25 @@ dwarf2_generate_line_bc(yasm_bytecode *bc, /*@null@*/ void *d)
         }
     }
 
-    yasm_linemap_lookup(info->linemap, bc->line, &pathname, &info->loc.line);
-    dirlen = yasm__splitpath(pathname, &filename);
-
-    /* Find file index; just linear search it unless it was the last used */
-    if (info->lastfile > 0
-        && dwarf2_filename_equals(&dbgfmt_dwarf2->filenames[info->lastfile-1],
-                                  dbgfmt_dwarf2->dirs, pathname, dirlen,
-                                  filename))
-        info->loc.file = info->lastfile;
-    else {
-        for (i=0; i<dbgfmt_dwarf2->filenames_size; i++) {
-            if (dwarf2_filename_equals(&dbgfmt_dwarf2->filenames[i],
-                                       dbgfmt_dwarf2->dirs, pathname, dirlen,
-                                       filename))
-                break;
+    yasm_linemap_lookup_id(info->linemap, bc->line, &pathname, &id,
+                           &info->loc.line);
+
+    /* Find file index; only look it up once per linemap filename */
+    if (info->file_ids[id] == 0) {
+        dir = 0;
+        dirlen = yasm__splitpath(pathname, &filename);
+        if (dirlen > 0) {
+            dir = dwarf2_dbgfmt_find_dir(dbgfmt_dwarf2, pathname, dirlen);
+            if (dir == 0)
+                yasm_internal_error(N_("could not find filename in table"));
         }
+        i = dwarf2_dbgfmt_find_filename(dbgfmt_dwarf2, dir, filename);
         if (i >= dbgfmt_dwarf2->filenames_size)
             yasm_internal_error(N_("could not find filename in table"));
-        info->loc.file = i+1;
-        info->lastfile = i+1;
+        info->file_ids[id] = i+1;
     }
-    if (dwarf2_dbgfmt_gen_line_op(info->debug_line, info->state, &info->loc,
+    info->loc.file = info->file_ids[id];
+    if (dwarf2_dbgfmt_gen_line_op(info->prog, info->state, &info->loc,
                                   NULL))
         return 1;
     return 0;
@@ -559,6 +700,8 @@ dwarf2_generate_line_bc(yasm_bytecode *bc, /*@null@*/ void *d)
 
 typedef struct dwarf2_line_info {
     yasm_section *debug_line;   /* section to which line number info goes */
+    dwarf2_line_prog *prog;     /* line number program */
+    /*@null@*/ unsigned long *file_ids;     /* see dwarf2_line_bc_info */
     yasm_object *object;
     yasm_linemap *linemap;
     yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2;
@@ -612,12 +755,12 @@ dwarf2_generate_line_section(yasm_section *sect, /*@null@*/ void *d)
     if (info->asm_source) {
         dwarf2_line_bc_info bcinfo;
 
-        bcinfo.debug_line = info->debug_line;
+        bcinfo.prog = info->prog;
         bcinfo.object = info->object;
         bcinfo.linemap = info->linemap;
         bcinfo.dbgfmt_dwarf2 = dbgfmt_dwarf2;
         bcinfo.state = &state;
-        bcinfo.lastfile = 0;
+        bcinfo.file_ids = info->file_ids;
         bcinfo.loc.isa_change = 0;
         bcinfo.loc.column = 0;
         bcinfo.loc.discriminator = 0;
@@ -647,7 +790,7 @@ dwarf2_generate_line_section(yasm_section *sect, /*@null@*/ void *d)
         dwarf2_dbgfmt_finalize_locs(sect, dsd);
 
         STAILQ_FOREACH(loc, &dsd->locs, link) {
-            if (dwarf2_dbgfmt_gen_line_op(info->debug_line, &state, loc,
+            if (dwarf2_dbgfmt_gen_line_op(info->prog, &state, loc,
                                           STAILQ_NEXT(loc, link)))
                 return 1;
         }
@@ -662,12 +805,11 @@ dwarf2_generate_line_section(yasm_section *sect, /*@null@*/ void *d)
     bc = yasm_section_bcs_last(sect);
     addr_delta = yasm_bc_next_offset(bc) - state.precbc->offset;
     if (addr_delta == DWARF2_MAX_SPECIAL_ADDR_DELTA)
-        dwarf2_dbgfmt_append_line_op(info->debug_line, DW_LNS_const_add_pc,
-                                     NULL);
+        dwarf2_dbgfmt_append_line_op(info->prog, DW_LNS_const_add_pc);
     else if (addr_delta > 0)
-        dwarf2_dbgfmt_append_line_op(info->debug_line, DW_LNS_advance_pc,
-                                     yasm_intnum_create_uint(addr_delta));
-    dwarf2_dbgfmt_append_line_ext_op(info->debug_line, DW_LNE_end_sequence, 0,
+        dwarf2_dbgfmt_append_line_op_uint(info->prog, DW_LNS_advance_pc,
+                                          addr_delta);
+    dwarf2_dbgfmt_append_line_ext_op(info->prog, DW_LNE_end_sequence, 0,
                                      NULL);
 
     return 0;
@@ -691,14 +833,19 @@ yasm_dwarf2__generate_line(yasm_object *object, yasm_linemap *linemap,
     dwarf2_line_info info;
     int new;
     size_t i;
-    yasm_bytecode *last, *sppbc;
+    yasm_bytecode *last, *sppbc, *progbc;
     dwarf2_spp *spp;
+    dwarf2_line_prog *prog;
     dwarf2_head *head;
 
+    info.file_ids = NULL;
     if (asm_source) {
         /* Generate dirs and filenames based on linemap */
         yasm_linemap_traverse_filenames(linemap, dbgfmt_dwarf2,
                                         dwarf2_generate_filename);
+        info.file_ids =
+            yasm_xcalloc(yasm_linemap_get_num_filenames(linemap)+1,
+                         sizeof(unsigned long));
     }
 
     info.num_sections = 0;
@@ -741,8 +888,21 @@ yasm_dwarf2__generate_line(yasm_object *object, yasm_linemap *linemap,
     yasm_dwarf2__append_bc(info.debug_line, sppbc);
 
     /* statement program */
+    prog = yasm_xmalloc(sizeof(dwarf2_line_prog));
+    prog->buf = NULL;
+    prog->len = 0;
+    prog->max = 0;
+    prog->addrs = NULL;
+    prog->num_addrs = 0;
+    prog->max_addrs = 0;
+    info.prog = prog;
     yasm_object_sections_traverse(object, (void *)&info,
                                   dwarf2_generate_line_section);
+    if (info.file_ids)
+        yasm_xfree(info.file_ids);
+    progbc = yasm_bc_create_common(&dwarf2_line_prog_bc_callback, prog, 0);
+    progbc->len = prog->len;
+    yasm_dwarf2__append_bc(info.debug_line, progbc);
 
     /* mark end of line information */
     yasm_dwarf2__set_head_end(head, yasm_section_bcs_last(info.debug_line));
@@ -836,60 +996,62 @@ dwarf2_spp_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
 }
 
 static void
-dwarf2_line_op_bc_destroy(void *contents)
+dwarf2_line_prog_bc_destroy(void *contents)
 {
-    dwarf2_line_op *line_op = (dwarf2_line_op *)contents;
-    if (line_op->operand)
-        yasm_intnum_destroy(line_op->operand);
-    if (line_op->ext_operand_int)
-        yasm_intnum_destroy(line_op->ext_operand_int);
+    dwarf2_line_prog *prog = (dwarf2_line_prog *)contents;
+    if (prog->buf)
+        yasm_xfree(prog->buf);
+    if (prog->addrs)
+        yasm_xfree(prog->addrs);
     yasm_xfree(contents);
 }
 
 static void
-dwarf2_line_op_bc_print(const void *contents, FILE *f, int indent_level)
+dwarf2_line_prog_bc_print(const void *contents, FILE *f, int indent_level)
 {
-    /* TODO */
+    const dwarf2_line_prog *prog = (const dwarf2_line_prog *)contents;
+    fprintf(f, "%*s_DWARF2 Line Number Program_\n", indent_level, "");
+    fprintf(f, "%*sLength=%lu\n", indent_level+1, "", prog->len);
+    fprintf(f, "%*sAddresses=%lu\n", indent_level+1, "", prog->num_addrs);
 }
 
 static int
-dwarf2_line_op_bc_calc_len(yasm_bytecode *bc, yasm_bc_add_span_func add_span,
-                           void *add_span_data)
+dwarf2_line_prog_bc_calc_len(yasm_bytecode *bc,
+                             yasm_bc_add_span_func add_span,
+                             void *add_span_data)
 {
-    yasm_internal_error(N_("tried to calc_len a dwarf2 line_op bytecode"));
+    yasm_internal_error(N_("tried to calc_len a dwarf2 line program"));
     /*@notreached@*/
     return 0;
 }
 
 static int
-dwarf2_line_op_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
-                          unsigned char *bufstart, void *d,
-                          yasm_output_value_func output_value,
-                          yasm_output_reloc_func output_reloc)
+dwarf2_line_prog_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
+                            unsigned char *bufstart, void *d,
+                            yasm_output_value_func output_value,
+                            yasm_output_reloc_func output_reloc)
 {
-    dwarf2_line_op *line_op = (dwarf2_line_op *)bc->contents;
+    yasm_object *object = yasm_section_get_object(bc->section);
+    yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2 = (yasm_dbgfmt_dwarf2 *)object->dbgfmt;
+    dwarf2_line_prog *prog = (dwarf2_line_prog *)bc->contents;
     unsigned char *buf = *bufp;
+    unsigned long i;
 
-    YASM_WRITE_8(buf, line_op->opcode);
-    if (line_op->operand)
-        buf += yasm_intnum_get_leb128(line_op->operand, buf,
-                                      line_op->opcode == DW_LNS_advance_line);
-    if (line_op->ext_opcode > 0) {
-        YASM_WRITE_8(buf, line_op->ext_opcode);
-        if (line_op->ext_operand) {
-            yasm_value value;
-            yasm_value_init_sym(&value, line_op->ext_operand,
-                                line_op->ext_operandsize*8);
-            output_value(&value, buf, line_op->ext_operandsize,
-                         (unsigned long)(buf-bufstart), bc, 0, d);
-            buf += line_op->ext_operandsize;
-        }
-        if (line_op->ext_operand_int) {
-            buf += yasm_intnum_get_leb128(line_op->ext_operand_int, buf, 0);
-        }
+    if (prog->len > 0)
+        memcpy(buf, prog->buf, prog->len);
+
+    /* Fill in the addresses */
+    for (i=0; i<prog->num_addrs; i++) {
+        unsigned char *abuf = buf + prog->addrs[i].offset;
+        yasm_value value;
+
+        yasm_value_init_sym(&value, prog->addrs[i].sym,
+                            dbgfmt_dwarf2->sizeof_address*8);
+        output_value(&value, abuf, dbgfmt_dwarf2->sizeof_address,
+                     (unsigned long)(abuf-bufstart), bc, 0, d);
     }
 
-    *bufp = buf;
+    *bufp = buf + prog->len;
     return 0;
 }
 
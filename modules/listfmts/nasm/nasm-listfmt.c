@@ -108,12 +108,11 @@ nasm_listfmt_output_value(yasm_value *value, unsigned char *buf,
         STAILQ_INSERT_TAIL(&info->bcrelocs, reloc, link);
 
         /* Get next reloc's info */
-        info->next_reloc = yasm_section_reloc_next(info->next_reloc);
+        info->next_reloc = yasm_section_reloc_next(yasm_bc_get_section(bc),
+                                                   info->next_reloc);
         if (info->next_reloc) {
-            yasm_intnum *addr;
             yasm_symrec *sym;
-            yasm_reloc_get(info->next_reloc, &addr, &sym);
-            info->next_reloc_addr = yasm_intnum_get_uint(addr);
+            yasm_reloc_get(info->next_reloc, &info->next_reloc_addr, &sym);
         }
     }
 
@@ -184,11 +183,9 @@ nasm_listfmt_output(yasm_listfmt *listfmt, FILE *f, yasm_linemap *linemap,
                     last_hist->next_reloc = yasm_section_relocs_first(sect);
 
                     if (last_hist->next_reloc) {
-                        yasm_intnum *addr;
                         yasm_symrec *sym;
-                        yasm_reloc_get(last_hist->next_reloc, &addr, &sym);
-                        last_hist->next_reloc_addr =
-                            yasm_intnum_get_uint(addr);
+                        yasm_reloc_get(last_hist->next_reloc,
+                                       &last_hist->next_reloc_addr, &sym);
                     }
 
                     SLIST_INSERT_HEAD(&reloc_hist, last_hist, link);
@@ -187,7 +187,7 @@ bin_group_destroy(/*@only@*/ bin_group *group)
 typedef struct bin_objfmt_output_info {
     yasm_object *object;
     yasm_errwarns *errwarns;
-    /*@dependent@*/ FILE *f;
+    /*@dependent@*/ yasm_outsink *sink;
     /*@only@*/ unsigned char *buf;
     /*@observer@*/ const yasm_section *sect;
     unsigned long start;        /* what normal variables go against */
@@ -978,9 +978,18 @@ bin_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
     /*@null@*/ /*@only@*/ unsigned char *bigbuf;
     unsigned long size = REGULAR_OUTBUF_SIZE;
     int gap;
+    /*@null@*/ /*@dependent@*/ yasm_incfile *incfile;
+    unsigned long offset;
 
     assert(info != NULL);
 
+    /* Copy included binary files straight from the file */
+    incfile = yasm_bc_get_incbin(bc, &offset);
+    if (incfile && bc->len > 0) {
+        yasm_outsink_write_file(info->sink, incfile, offset, bc->len);
+        return 0;
+    }
+
     bigbuf = yasm_bc_tobytes(bc, info->buf, &size, &gap, info,
                              bin_objfmt_output_value, NULL);
 
@@ -1000,13 +1009,14 @@ bin_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
         memset(info->buf, 0, REGULAR_OUTBUF_SIZE);
         left = size;
         while (left > REGULAR_OUTBUF_SIZE) {
-            fwrite(info->buf, REGULAR_OUTBUF_SIZE, 1, info->f);
+            yasm_outsink_write(info->sink, info->buf, REGULAR_OUTBUF_SIZE);
             left -= REGULAR_OUTBUF_SIZE;
         }
-        fwrite(info->buf, left, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, left);
     } else {
         /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : info->buf, (size_t)size, 1, info->f);
+        yasm_outsink_write(info->sink, bigbuf ? bigbuf : info->buf,
+                           (size_t)size);
     }
 
     /* If bigbuf was allocated, free it */
@@ -1076,8 +1086,8 @@ bin_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
             yasm_errwarn_propagate(info->errwarns, 0);
             return 0;
         }
-        if (fseek(info->f, yasm_intnum_get_int(info->tmp_intn) + info->start,
-                  SEEK_SET) < 0)
+        if (yasm_outsink_seek(info->sink,
+                yasm_intnum_get_int(info->tmp_intn) + info->start) < 0)
             yasm__fatal(N_("could not seek on output file"));
         yasm_section_bcs_traverse(sect, info->errwarns,
                                   info, bin_objfmt_output_bytecode);
@@ -1103,7 +1113,8 @@ bin_objfmt_cleanup(bin_objfmt_output_info *info)
 }
 
 static void
-bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
+bin_objfmt_output(yasm_object *object, yasm_outsink *sink,
+                  /*@unused@*/ int all_syms,
                   yasm_errwarns *errwarns)
 {
     yasm_objfmt_bin *objfmt_bin = (yasm_objfmt_bin *)object->objfmt;
@@ -1112,7 +1123,7 @@ bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
     yasm_intnum *start, *last, *vdelta;
     bin_groups unsorted_groups, bss_groups;
 
-    info.start = ftell(f);
+    info.start = yasm_outsink_tell(sink);
 
     /* Set ORG to 0 unless otherwise specified */
     if (objfmt_bin->org) {
@@ -1134,7 +1145,7 @@ bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
 
     info.object = object;
     info.errwarns = errwarns;
-    info.f = f;
+    info.sink = sink;
     info.buf = yasm_xmalloc(REGULAR_OUTBUF_SIZE);
     info.tmp_intn = yasm_intnum_create_uint(0);
     TAILQ_INIT(&info.lma_groups);
@@ -1843,18 +1854,18 @@ get_sym(yasm_object *object, const char *name) {
 }
 
 static void
-dosexe_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
-                  yasm_errwarns *errwarns)
+dosexe_objfmt_output(yasm_object *object, yasm_outsink *sink,
+                     /*@unused@*/ int all_syms, yasm_errwarns *errwarns)
 {
     unsigned long tot_size, size, bss_size;
     unsigned long start, bss;
     unsigned char c;
 
-    fseek(f, EXE_HEADER_SIZE, SEEK_SET);
+    yasm_outsink_seek(sink, EXE_HEADER_SIZE);
 
-    bin_objfmt_output(object, f, all_syms, errwarns);
+    bin_objfmt_output(object, sink, all_syms, errwarns);
 
-    tot_size = ftell(f);
+    tot_size = yasm_outsink_tell(sink);
 
     /* if there is a __bss_start symbol, data after it is 0, no need to write
      * it.  */
@@ -1864,62 +1875,60 @@ dosexe_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
     else
         size = tot_size;
     bss_size = tot_size - size;
-#ifdef HAVE_FTRUNCATE
     if (size != tot_size)
-        ftruncate(fileno(f), EXE_HEADER_SIZE + size);
-#endif
-    fseek(f, 0, SEEK_SET);
+        yasm_outsink_truncate(sink, EXE_HEADER_SIZE + size);
+    yasm_outsink_seek(sink, 0);
 
     /* magic */
-    fwrite("MZ", 1, 2, f);
+    yasm_outsink_write(sink, "MZ", 2);
 
     /* file size */
     c = size & 0xff;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
     c = !!(size & 0x100);
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
     c = ((size + 511) >> 9) & 0xff;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
     c = ((size + 511) >> 17) & 0xff;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
 
     /* relocation # */
     c = 0;
-    fwrite(&c, 1, 1, f);
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
+    yasm_outsink_write(sink, &c, 1);
 
     /* header size */
     c = EXE_HEADER_SIZE / 16;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
     c = 0;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
 
     /* minimum paragraph # */
     bss_size = (bss_size + 15) >> 4;
     c = bss_size & 0xff;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
     c = (bss_size >> 8) & 0xff;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
 
     /* maximum paragraph # */
     c = 0xFF;
-    fwrite(&c, 1, 1, f);
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
+    yasm_outsink_write(sink, &c, 1);
 
     /* relative value of stack segment */
     c = 0;
-    fwrite(&c, 1, 1, f);
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
+    yasm_outsink_write(sink, &c, 1);
 
     /* SP at start */
     c = 0;
-    fwrite(&c, 1, 1, f);
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
+    yasm_outsink_write(sink, &c, 1);
 
     /* header checksum */
     c = 0;
-    fwrite(&c, 1, 1, f);
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
+    yasm_outsink_write(sink, &c, 1);
 
     /* IP at start */
     start = get_sym(object, "start");
@@ -1929,25 +1938,25 @@ dosexe_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
         return;
     }
     c = start & 0xff;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
     c = (start >> 8) & 0xff;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
 
     /* CS start */
     c = 0;
-    fwrite(&c, 1, 1, f);
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
+    yasm_outsink_write(sink, &c, 1);
 
     /* reloc start */
     c = 0x22;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
     c = 0;
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
 
     /* Overlay number */
     c = 0;
-    fwrite(&c, 1, 1, f);
-    fwrite(&c, 1, 1, f);
+    yasm_outsink_write(sink, &c, 1);
+    yasm_outsink_write(sink, &c, 1);
 }
 
 
@@ -113,7 +113,7 @@ typedef struct coff_section_data {
     unsigned long relptr;   /* file ptr to relocation */
     unsigned long nreloc;   /* number of relocation entries >64k -> error */
     unsigned long flags2;   /* internal flags (see COFF_FLAG_* above) */
-    unsigned long strtab_name;  /* strtab offset of name if name > 8 chars */
+    unsigned long strtab_name;  /* strtab ID of name if name > 8 chars */
     int isdebug;            /* is a debug section? */
 } coff_section_data;
 
@@ -166,6 +166,9 @@ typedef struct coff_symrec_data {
     unsigned int type;                  /* type */
     coff_symrec_sclass sclass;          /* storage class */
 
+    unsigned long strtab_name;  /* strtab ID of name if name > 8 chars */
+    unsigned long strtab_fname; /* strtab ID of aux filename if > 14 chars */
+
     int numaux;                 /* number of auxiliary entries */
     coff_symtab_auxtype auxtype;    /* type of aux entries */
     coff_symtab_auxent aux[1];  /* actually may be any size (including 0) */
@@ -193,19 +196,32 @@ typedef struct yasm_objfmt_coff {
     yasm_symrec *ssym_imagebase;            /* ..imagebase symbol for win64 */
 } yasm_objfmt_coff;
 
+/* Section contents encoded ahead of output by a worker thread */
+typedef struct coff_objfmt_sect_bytes {
+    /*@only@*/ yasm_outsink *sink;      /* memory image */
+    /*@only@*/ yasm_errwarns *errwarns;
+} coff_objfmt_sect_bytes;
+
 typedef struct coff_objfmt_output_info {
     yasm_object *object;
     yasm_objfmt_coff *objfmt_coff;
     yasm_errwarns *errwarns;
-    /*@dependent@*/ FILE *f;
+    /*@dependent@*/ yasm_outsink *sink;
     /*@only@*/ unsigned char *buf;
+    /*@only@*/ yasm_intnum *intn;       /* scratch for output values */
     yasm_section *sect;
     /*@dependent@*/ coff_section_data *csd;
     unsigned long addr;                 /* start of next section */
 
     unsigned long indx;                 /* current symbol index */
     int all_syms;                       /* outputting all symbols? */
-    unsigned long strtab_offset;        /* current string table offset */
+    /*@only@*/ yasm_strtab *strtab;     /* string table */
+
+    /* Contents of each section in section order, if encoded ahead of
+     * output; NULL if sections are encoded as they are output.
+     */
+    /*@only@*/ /*@null@*/ coff_objfmt_sect_bytes *encoded;
+    unsigned long encoded_num;          /* index of next section to output */
 } coff_objfmt_output_info;
 
 static void coff_section_data_destroy(/*@only@*/ void *d);
@@ -264,6 +280,8 @@ coff_objfmt_sym_set_data(yasm_symrec *sym, coff_symrec_sclass sclass,
     sym_data->index = 0;
     sym_data->type = 0;
     sym_data->sclass = sclass;
+    sym_data->strtab_name = 0;
+    sym_data->strtab_fname = 0;
     sym_data->numaux = numaux;
     sym_data->auxtype = auxtype;
 
@@ -295,6 +313,7 @@ coff_common_create(yasm_object *object)
     /* Filename is set in coff_objfmt_output */
     objfmt_coff->filesym_data->aux[0].fname = NULL;
 
+    objfmt_coff->def_sym = NULL;
     objfmt_coff->proc_frame = 0;
     objfmt_coff->done_prolog = 0;
     objfmt_coff->unwind = NULL;
@@ -455,7 +474,6 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
     /*@only@*/ /*@null@*/ yasm_intnum *dist = NULL;
     /*@dependent@*/ /*@null@*/ yasm_intnum *intn;
     unsigned long intn_val, intn_minus;
-    int retval;
     unsigned int valsize = value->size;
 
     assert(info != NULL);
@@ -493,7 +511,7 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
         yasm_sym_vis vis = yasm_symrec_get_visibility(value->rel);
         /*@dependent@*/ /*@null@*/ yasm_symrec *sym = value->rel;
         unsigned long addr;
-        coff_reloc *reloc;
+        coff_reloc reloc;
         int nobase = info->csd->flags2 & COFF_FLAG_NOBASE;
 
         /* Sometimes we want the relocation to be generated against one
@@ -587,17 +605,16 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
         }
 
         /* Generate reloc */
-        reloc = yasm_xmalloc(sizeof(coff_reloc));
         addr = bc->offset + offset;
         if (COFF_SET_VMA)
             addr += info->addr;
-        reloc->reloc.addr = yasm_intnum_create_uint(addr);
-        reloc->reloc.sym = sym;
+        reloc.reloc.addr = addr;
+        reloc.reloc.sym = sym;
 
         if (value->curpos_rel) {
             if (objfmt_coff->machine == COFF_MACHINE_I386) {
                 if (valsize == 32)
-                    reloc->type = COFF_RELOC_I386_REL32;
+                    reloc.type = COFF_RELOC_I386_REL32;
                 else {
                     yasm_error_set(YASM_ERROR_TYPE,
                                    N_("coff: invalid relocation size"));
@@ -610,25 +627,25 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
                     return 1;
                 }
                 if (!value->ip_rel)
-                    reloc->type = COFF_RELOC_AMD64_REL32;
+                    reloc.type = COFF_RELOC_AMD64_REL32;
                 else switch (bc->len*bc->mult_int - (offset+destsize)) {
                     case 0:
-                        reloc->type = COFF_RELOC_AMD64_REL32;
+                        reloc.type = COFF_RELOC_AMD64_REL32;
                         break;
                     case 1:
-                        reloc->type = COFF_RELOC_AMD64_REL32_1;
+                        reloc.type = COFF_RELOC_AMD64_REL32_1;
                         break;
                     case 2:
-                        reloc->type = COFF_RELOC_AMD64_REL32_2;
+                        reloc.type = COFF_RELOC_AMD64_REL32_2;
                         break;
                     case 3:
-                        reloc->type = COFF_RELOC_AMD64_REL32_3;
+                        reloc.type = COFF_RELOC_AMD64_REL32_3;
                         break;
                     case 4:
-                        reloc->type = COFF_RELOC_AMD64_REL32_4;
+                        reloc.type = COFF_RELOC_AMD64_REL32_4;
                         break;
                     case 5:
-                        reloc->type = COFF_RELOC_AMD64_REL32_5;
+                        reloc.type = COFF_RELOC_AMD64_REL32_5;
                         break;
                     default:
                         yasm_error_set(YASM_ERROR_TYPE,
@@ -639,32 +656,32 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
                 yasm_internal_error(N_("coff objfmt: unrecognized machine"));
         } else if (value->seg_of) {
             if (objfmt_coff->machine == COFF_MACHINE_I386)
-                reloc->type = COFF_RELOC_I386_SECTION;
+                reloc.type = COFF_RELOC_I386_SECTION;
             else if (objfmt_coff->machine == COFF_MACHINE_AMD64)
-                reloc->type = COFF_RELOC_AMD64_SECTION;
+                reloc.type = COFF_RELOC_AMD64_SECTION;
             else
                 yasm_internal_error(N_("coff objfmt: unrecognized machine"));
         } else if (value->section_rel) {
             if (objfmt_coff->machine == COFF_MACHINE_I386)
-                reloc->type = COFF_RELOC_I386_SECREL;
+                reloc.type = COFF_RELOC_I386_SECREL;
             else if (objfmt_coff->machine == COFF_MACHINE_AMD64)
-                reloc->type = COFF_RELOC_AMD64_SECREL;
+                reloc.type = COFF_RELOC_AMD64_SECREL;
             else
                 yasm_internal_error(N_("coff objfmt: unrecognized machine"));
         } else {
             if (objfmt_coff->machine == COFF_MACHINE_I386) {
                 if (nobase)
-                    reloc->type = COFF_RELOC_I386_ADDR32NB;
+                    reloc.type = COFF_RELOC_I386_ADDR32NB;
                 else
-                    reloc->type = COFF_RELOC_I386_ADDR32;
+                    reloc.type = COFF_RELOC_I386_ADDR32;
             } else if (objfmt_coff->machine == COFF_MACHINE_AMD64) {
                 if (valsize == 32) {
                     if (nobase)
-                        reloc->type = COFF_RELOC_AMD64_ADDR32NB;
+                        reloc.type = COFF_RELOC_AMD64_ADDR32NB;
                     else
-                        reloc->type = COFF_RELOC_AMD64_ADDR32;
+                        reloc.type = COFF_RELOC_AMD64_ADDR32;
                 } else if (valsize == 64)
-                    reloc->type = COFF_RELOC_AMD64_ADDR64;
+                    reloc.type = COFF_RELOC_AMD64_ADDR64;
                 else {
                     yasm_error_set(YASM_ERROR_TYPE,
                                    N_("coff: invalid relocation size"));
@@ -674,17 +691,18 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
                 yasm_internal_error(N_("coff objfmt: unrecognized machine"));
         }
         info->csd->nreloc++;
-        yasm_section_add_reloc(info->sect, (yasm_reloc *)reloc, yasm_xfree);
+        yasm_section_add_reloc(info->sect, &reloc.reloc, sizeof(coff_reloc));
     }
 
     /* Build up final integer output from intn_val, intn_minus, value->abs,
      * and dist.  We do all this at the end to avoid creating temporary
      * intnums above (except for dist).
      */
+    intn = info->intn;
     if (intn_minus <= intn_val)
-        intn = yasm_intnum_create_uint(intn_val-intn_minus);
+        yasm_intnum_set_uint(intn, intn_val-intn_minus);
     else {
-        intn = yasm_intnum_create_uint(intn_minus-intn_val);
+        yasm_intnum_set_uint(intn, intn_minus-intn_val);
         yasm_intnum_calc(intn, YASM_EXPR_NEG, NULL);
     }
 
@@ -693,7 +711,6 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
         if (!intn2) {
             yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                            N_("coff: relocation too complex"));
-            yasm_intnum_destroy(intn);
             if (dist)
                 yasm_intnum_destroy(dist);
             return 1;
@@ -706,10 +723,8 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
         yasm_intnum_destroy(dist);
     }
 
-    retval = yasm_arch_intnum_tobytes(info->object->arch, intn, buf, destsize,
-                                      valsize, 0, bc, warn);
-    yasm_intnum_destroy(intn);
-    return retval;
+    return yasm_arch_intnum_tobytes(info->object->arch, intn, buf, destsize,
+                                    valsize, 0, bc, warn);
 }
 
 static int
@@ -719,9 +734,19 @@ coff_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
     /*@null@*/ /*@only@*/ unsigned char *bigbuf;
     unsigned long size = REGULAR_OUTBUF_SIZE;
     int gap;
+    /*@null@*/ /*@dependent@*/ yasm_incfile *incfile;
+    unsigned long offset;
 
     assert(info != NULL);
 
+    /* Copy included binary files straight from the file */
+    incfile = yasm_bc_get_incbin(bc, &offset);
+    if (incfile && bc->len > 0) {
+        info->csd->size += bc->len;
+        yasm_outsink_write_file(info->sink, incfile, offset, bc->len);
+        return 0;
+    }
+
     bigbuf = yasm_bc_tobytes(bc, info->buf, &size, &gap, info,
                              coff_objfmt_output_value, NULL);
 
@@ -743,13 +768,13 @@ coff_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
         memset(info->buf, 0, REGULAR_OUTBUF_SIZE);
         left = size;
         while (left > REGULAR_OUTBUF_SIZE) {
-            fwrite(info->buf, REGULAR_OUTBUF_SIZE, 1, info->f);
+            yasm_outsink_write(info->sink, info->buf, REGULAR_OUTBUF_SIZE);
             left -= REGULAR_OUTBUF_SIZE;
         }
-        fwrite(info->buf, left, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, left);
     } else {
         /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : info->buf, (size_t)size, 1, info->f);
+        yasm_outsink_write(info->sink, bigbuf ? bigbuf : info->buf, size);
     }
 
     /* If bigbuf was allocated, free it */
@@ -764,22 +789,17 @@ coff_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ coff_objfmt_output_info *info = (coff_objfmt_output_info *)d;
     /*@dependent@*/ /*@null@*/ coff_section_data *csd;
+    /*@dependent@*/ /*@null@*/ coff_objfmt_sect_bytes *encoded = NULL;
     long pos;
-    coff_reloc *reloc;
-    unsigned char *localbuf;
+    coff_reloc *relocs;
+    unsigned long nreloc, i;
+    unsigned char *relbuf, *localbuf;
 
     assert(info != NULL);
     csd = yasm_section_get_data(sect, &coff_section_data_cb);
     assert(csd != NULL);
-
-    /* Add to strtab if in win32 format and name > 8 chars */
-    if (info->objfmt_coff->win32) {
-        size_t namelen = strlen(yasm_section_get_name(sect));
-        if (namelen > 8) {
-            csd->strtab_name = info->strtab_offset;
-            info->strtab_offset += (unsigned long)(namelen + 1);
-        }
-    }
+    if (info->encoded)
+        encoded = &info->encoded[info->encoded_num++];
 
     if (!csd->isdebug)
         csd->addr = info->addr;
@@ -791,7 +811,7 @@ coff_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
         pos = 0;    /* position = 0 because it's not in the file */
         csd->size = yasm_bc_next_offset(yasm_section_bcs_last(sect));
     } else {
-        pos = ftell(info->f);
+        pos = yasm_outsink_tell(info->sink);
         if (pos == -1) {
             yasm__fatal(N_("could not get file position on output file"));
             /*@notreached@*/
@@ -800,8 +820,12 @@ coff_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 
         info->sect = sect;
         info->csd = csd;
-        yasm_section_bcs_traverse(sect, info->errwarns, info,
-                                  coff_objfmt_output_bytecode);
+        if (encoded) {
+            yasm_outsink_write_sink(info->sink, encoded->sink);
+            yasm_errwarns_merge(info->errwarns, encoded->errwarns);
+        } else
+            yasm_section_bcs_traverse(sect, info->errwarns, info,
+                                      coff_objfmt_output_bytecode);
 
         /* Sanity check final section size */
         if (yasm_errwarns_num_errors(info->errwarns, 0) == 0 &&
@@ -822,7 +846,7 @@ coff_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     if (csd->nreloc == 0)
         return 0;
 
-    pos = ftell(info->f);
+    pos = yasm_outsink_tell(info->sink);
     if (pos == -1) {
         yasm__fatal(N_("could not get file position on output file"));
         /*@notreached@*/
@@ -838,46 +862,126 @@ coff_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
         YASM_WRITE_32_L(localbuf, csd->nreloc+1);   /* address of relocation */
         YASM_WRITE_32_L(localbuf, 0);           /* relocated symbol */
         YASM_WRITE_16_L(localbuf, 0);           /* type of relocation */
-        fwrite(info->buf, 10, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, 10);
     }
 
-    reloc = (coff_reloc *)yasm_section_relocs_first(sect);
-    while (reloc) {
+    /* Encode all the relocations, then write them at once */
+    if (info->object->sort_relocs)
+        yasm_section_sort_relocs(sect);
+    relocs = (coff_reloc *)yasm_section_relocs(sect, &nreloc);
+    relbuf = yasm_xmalloc(nreloc*10);
+    localbuf = relbuf;
+    for (i=0; i<nreloc; i++) {
+        coff_reloc *reloc = &relocs[i];
         /*@null@*/ coff_symrec_data *csymd;
-        localbuf = info->buf;
 
         csymd = yasm_symrec_get_data(reloc->reloc.sym, &coff_symrec_data_cb);
         if (!csymd)
             yasm_internal_error(
                 N_("coff: no symbol data for relocated symbol"));
 
-        yasm_intnum_get_sized(reloc->reloc.addr, localbuf, 4, 32, 0, 0, 0);
-        localbuf += 4;                          /* address of relocation */
+        /* address of relocation */
+        YASM_WRITE_32_L(localbuf, reloc->reloc.addr);
         YASM_WRITE_32_L(localbuf, csymd->index);    /* relocated symbol */
         YASM_WRITE_16_L(localbuf, reloc->type);     /* type of relocation */
-        fwrite(info->buf, 10, 1, info->f);
-
-        reloc = (coff_reloc *)yasm_section_reloc_next((yasm_reloc *)reloc);
     }
+    yasm_outsink_write(info->sink, relbuf, nreloc*10);
+    yasm_xfree(relbuf);
+
+    return 0;
+}
 
+typedef struct coff_objfmt_encode_data {
+    /*@dependent@*/ const coff_objfmt_output_info *info;
+    /*@only@*/ yasm_section **sects;
+    unsigned long num, max;
+} coff_objfmt_encode_data;
+
+static int
+coff_objfmt_collect_section(yasm_section *sect, /*@null@*/ void *d)
+{
+    coff_objfmt_encode_data *ed = (coff_objfmt_encode_data *)d;
+
+    if (ed->num >= ed->max) {
+        ed->max = ed->max ? ed->max*2 : 16;
+        ed->sects = yasm_xrealloc(ed->sects, ed->max*sizeof(yasm_section *));
+    }
+    ed->sects[ed->num++] = sect;
     return 0;
 }
 
+static void
+coff_objfmt_encode_section(unsigned long job, /*@null@*/ void *d)
+{
+    coff_objfmt_encode_data *ed = (coff_objfmt_encode_data *)d;
+    coff_objfmt_output_info info = *ed->info;   /* structure copy */
+    yasm_section *sect = ed->sects[job];
+
+    info.csd = yasm_section_get_data(sect, &coff_section_data_cb);
+    assert(info.csd != NULL);
+
+    /* BSS sections aren't output */
+    if ((info.csd->flags & COFF_STYP_STD_MASK) == COFF_STYP_BSS)
+        return;
+
+    info.sect = sect;
+    info.sink = info.encoded[job].sink;
+    info.errwarns = info.encoded[job].errwarns;
+    info.buf = yasm_xmalloc(REGULAR_OUTBUF_SIZE);
+    info.intn = yasm_intnum_create_uint(0);
+    yasm_section_bcs_traverse(sect, info.errwarns, &info,
+                              coff_objfmt_output_bytecode);
+    yasm_intnum_destroy(info.intn);
+    yasm_xfree(info.buf);
+}
+
+/* Encode the contents of all sections into memory using worker threads, so
+ * that coff_objfmt_output_section() only needs to write them out in order.
+ * Only used for Win32/Win64, where section contents don't depend on the
+ * addresses of other sections (see COFF_SET_VMA).
+ */
+static unsigned long
+coff_objfmt_encode_sections(yasm_object *object, coff_objfmt_output_info *info)
+{
+    coff_objfmt_encode_data ed;
+    unsigned long i;
+
+    ed.info = info;
+    ed.sects = NULL;
+    ed.num = 0;
+    ed.max = 0;
+    yasm_object_sections_traverse(object, &ed, coff_objfmt_collect_section);
+
+    info->encoded = yasm_xmalloc(ed.num*sizeof(coff_objfmt_sect_bytes));
+    info->encoded_num = 0;
+    for (i=0; i<ed.num; i++) {
+        info->encoded[i].sink = yasm_outsink_create_mem();
+        info->encoded[i].errwarns = yasm_errwarns_create();
+    }
+
+    yasm_parallel_run(object->threads, ed.num, &ed,
+                      coff_objfmt_encode_section);
+    if (ed.sects)
+        yasm_xfree(ed.sects);
+    return ed.num;
+}
+
 static int
-coff_objfmt_output_sectstr(yasm_section *sect, /*@null@*/ void *d)
+coff_objfmt_add_sectstr(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ coff_objfmt_output_info *info = (coff_objfmt_output_info *)d;
+    /*@dependent@*/ /*@null@*/ coff_section_data *csd;
     const char *name;
-    size_t len;
 
     /* Add to strtab if in win32 format and name > 8 chars */
     if (!info->objfmt_coff->win32)
        return 0;
-    
+
+    csd = yasm_section_get_data(sect, &coff_section_data_cb);
+    assert(csd != NULL);
     name = yasm_section_get_name(sect);
-    len = strlen(name);
-    if (len > 8)
-        fwrite(name, len+1, 1, info->f);
+    if (strlen(name) > 8)
+        csd->strtab_name = yasm_strtab_add(info->strtab, name);
     return 0;
 }
 
@@ -910,7 +1014,8 @@ coff_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
     localbuf = info->buf;
     if (strlen(yasm_section_get_name(sect)) > 8) {
         char namenum[30];
-        sprintf(namenum, "/%ld", csd->strtab_name);
+        sprintf(namenum, "/%ld", !objfmt_coff->win32 ? 0L :
+                (long)yasm_strtab_offset(info->strtab, csd->strtab_name));
         strncpy((char *)localbuf, namenum, 8);
     } else
         strncpy((char *)localbuf, yasm_section_get_name(sect), 8);
@@ -944,7 +1049,7 @@ coff_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
         YASM_WRITE_16_L(localbuf, csd->nreloc); /* num of relocation entries */
     YASM_WRITE_16_L(localbuf, 0);               /* num of line number entries */
     YASM_WRITE_32_L(localbuf, csd->flags);      /* flags */
-    fwrite(info->buf, 40, 1, info->f);
+    yasm_outsink_write(info->sink, info->buf, 40);
 
     return 0;
 }
@@ -977,6 +1082,20 @@ coff_objfmt_count_sym(yasm_symrec *sym, /*@null@*/ void *d)
         sym_data->index = info->indx;
 
         info->indx += sym_data->numaux + 1;
+
+        /* Add long names to strtab */
+        if (!yasm_symrec_is_abs(sym)) {
+            /*@only@*/ char *name =
+                yasm_symrec_get_global_name(sym, info->object);
+            if (strlen(name) > 8)
+                sym_data->strtab_name = yasm_strtab_add(info->strtab, name);
+            yasm_xfree(name);
+        }
+        if (sym_data->numaux > 0 &&
+            sym_data->auxtype == COFF_SYMTAB_AUX_FILE &&
+            strlen(sym_data->aux[0].fname) > 14)
+            sym_data->strtab_fname =
+                yasm_strtab_add(info->strtab, sym_data->aux[0].fname);
     }
     return 0;
 }
@@ -1089,8 +1208,8 @@ coff_objfmt_output_sym(yasm_symrec *sym, /*@null@*/ void *d)
         localbuf = info->buf;
         if (len > 8) {
             YASM_WRITE_32_L(localbuf, 0);       /* "zeros" field */
-            YASM_WRITE_32_L(localbuf, info->strtab_offset); /* strtab offset */
-            info->strtab_offset += (unsigned long)(len+1);
+            YASM_WRITE_32_L(localbuf,                   /* strtab offset */
+                yasm_strtab_offset(info->strtab, csymd->strtab_name));
         } else {
             /* <8 chars, so no string table entry needed */
             strncpy((char *)localbuf, name, 8);
@@ -1101,7 +1220,7 @@ coff_objfmt_output_sym(yasm_symrec *sym, /*@null@*/ void *d)
         YASM_WRITE_16_L(localbuf, csymd->type); /* type */
         YASM_WRITE_8(localbuf, csymd->sclass);  /* storage class */
         YASM_WRITE_8(localbuf, csymd->numaux);  /* number of aux entries */
-        fwrite(info->buf, 18, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, 18);
         for (aux=0; aux<csymd->numaux; aux++) {
             localbuf = info->buf;
             memset(localbuf, 0, 18);
@@ -1117,8 +1236,9 @@ coff_objfmt_output_sym(yasm_symrec *sym, /*@null@*/ void *d)
                     len = strlen(csymd->aux[0].fname);
                     if (len > 14) {
                         YASM_WRITE_32_L(localbuf, 0);
-                        YASM_WRITE_32_L(localbuf, info->strtab_offset);
-                        info->strtab_offset += (unsigned long)(len+1);
+                        YASM_WRITE_32_L(localbuf,
+                            yasm_strtab_offset(info->strtab,
+                                               csymd->strtab_fname));
                     } else
                         strncpy((char *)localbuf, csymd->aux[0].fname, 14);
                     break;
@@ -1126,45 +1246,7 @@ coff_objfmt_output_sym(yasm_symrec *sym, /*@null@*/ void *d)
                     yasm_internal_error(
                         N_("coff: unrecognized aux symtab type"));
             }
-            fwrite(info->buf, 18, 1, info->f);
-        }
-        yasm_xfree(name);
-    }
-    return 0;
-}
-
-static int
-coff_objfmt_output_str(yasm_symrec *sym, /*@null@*/ void *d)
-{
-    /*@null@*/ coff_objfmt_output_info *info = (coff_objfmt_output_info *)d;
-    yasm_sym_vis vis = yasm_symrec_get_visibility(sym);
-    /*@dependent@*/ /*@null@*/ coff_symrec_data *csymd;
-    csymd = yasm_symrec_get_data(sym, &coff_symrec_data_cb);
-
-    assert(info != NULL);
-
-    /* Don't output local syms unless outputting all syms */
-    if (info->all_syms || vis != YASM_SYM_LOCAL ||
-        (csymd && csymd->forcevis)) {
-        /*@only@*/ char *name = yasm_symrec_get_global_name(sym, info->object);
-        size_t len = strlen(name);
-        int aux;
-
-        if (!csymd)
-            yasm_internal_error(N_("coff: expected sym data to be present"));
-
-        if (len > 8)
-            fwrite(name, len+1, 1, info->f);
-        for (aux=0; aux<csymd->numaux; aux++) {
-            switch (csymd->auxtype) {
-                case COFF_SYMTAB_AUX_FILE:
-                    len = strlen(csymd->aux[0].fname);
-                    if (len > 14)
-                        fwrite(csymd->aux[0].fname, len+1, 1, info->f);
-                    break;
-                default:
-                    break;
-            }
+            yasm_outsink_write(info->sink, info->buf, 18);
         }
         yasm_xfree(name);
     }
@@ -1172,17 +1254,20 @@ coff_objfmt_output_str(yasm_symrec *sym, /*@null@*/ void *d)
 }
 
 static void
-coff_objfmt_output(yasm_object *object, FILE *f, int all_syms,
+coff_objfmt_output(yasm_object *object, yasm_outsink *sink, int all_syms,
                    yasm_errwarns *errwarns)
 {
     yasm_objfmt_coff *objfmt_coff = (yasm_objfmt_coff *)object->objfmt;
     coff_objfmt_output_info info;
-    unsigned char *localbuf;
+    unsigned char *localbuf, *strtab;
     long pos;
     unsigned long symtab_pos;
     unsigned long symtab_count;
+    unsigned long strtab_size;
     unsigned int flags;
     unsigned long ts;
+    unsigned long num_encoded = 0;
+    int retval;
 
     if (objfmt_coff->proc_frame) {
         yasm_error_set_xref(objfmt_coff->proc_frame,
@@ -1204,25 +1289,33 @@ coff_objfmt_output(yasm_object *object, FILE *f, int all_syms,
      */
     all_syms |= objfmt_coff->win64;
 
-    info.strtab_offset = 4;
+    /* String table starts with its total length */
+    info.strtab = yasm_strtab_create(4);
     info.object = object;
     info.objfmt_coff = objfmt_coff;
     info.errwarns = errwarns;
-    info.f = f;
+    info.sink = sink;
     info.buf = yasm_xmalloc(REGULAR_OUTBUF_SIZE);
+    info.encoded = NULL;
 
     /* Allocate space for headers by seeking forward */
-    if (fseek(f, (long)(20+40*(objfmt_coff->parse_scnum-1)), SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, (long)(20+40*(objfmt_coff->parse_scnum-1)))
+        < 0) {
         yasm__fatal(N_("could not seek on output file"));
         /*@notreached@*/
         return;
     }
 
-    /* Finalize symbol table (assign index to each symbol) */
+    /* Finalize symbol table (assign index to each symbol) and lay out
+     * string table
+     */
+    yasm_object_sections_traverse(object, &info, coff_objfmt_add_sectstr);
     info.indx = 0;
     info.all_syms = all_syms;
     yasm_symtab_traverse(object->symtab, &info, coff_objfmt_count_sym);
     symtab_count = info.indx;
+    strtab = yasm_strtab_finalize(info.strtab, object->strtab_tail_merge,
+                                  &strtab_size);
 
     /* Section data/relocs */
     if (COFF_SET_VMA) {
@@ -1236,13 +1329,27 @@ coff_objfmt_output(yasm_object *object, FILE *f, int all_syms,
                                           coff_objfmt_set_section_addr))
             return;
     }
+    if (!COFF_SET_VMA && object->threads > 1 && yasm_parallel_supported())
+        num_encoded = coff_objfmt_encode_sections(object, &info);
     info.addr = 0;
-    if (yasm_object_sections_traverse(object, &info,
-                                      coff_objfmt_output_section))
+    info.intn = yasm_intnum_create_uint(0);
+    retval = yasm_object_sections_traverse(object, &info,
+                                           coff_objfmt_output_section);
+    yasm_intnum_destroy(info.intn);
+    if (info.encoded) {
+        unsigned long i;
+        for (i=0; i<num_encoded; i++) {
+            yasm_outsink_destroy(info.encoded[i].sink);
+            yasm_errwarns_destroy(info.encoded[i].errwarns);
+        }
+        yasm_xfree(info.encoded);
+        info.encoded = NULL;
+    }
+    if (retval)
         return;
 
     /* Symbol table */
-    pos = ftell(f);
+    pos = yasm_outsink_tell(sink);
     if (pos == -1) {
         yasm__fatal(N_("could not get file position on output file"));
         /*@notreached@*/
@@ -1252,12 +1359,12 @@ coff_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     yasm_symtab_traverse(object->symtab, &info, coff_objfmt_output_sym);
 
     /* String table */
-    yasm_fwrite_32_l(info.strtab_offset, f); /* total length */
-    yasm_object_sections_traverse(object, &info, coff_objfmt_output_sectstr);
-    yasm_symtab_traverse(object->symtab, &info, coff_objfmt_output_str);
+    localbuf = strtab;
+    YASM_WRITE_32_L(localbuf, strtab_size);             /* total length */
+    yasm_outsink_write(sink, strtab, strtab_size);
 
     /* Write headers */
-    if (fseek(f, 0, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, 0) < 0) {
         yasm__fatal(N_("could not seek on output file"));
         /*@notreached@*/
         return;
@@ -1283,10 +1390,11 @@ coff_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     if (objfmt_coff->machine != COFF_MACHINE_AMD64)
         flags |= COFF_F_AR32WR;
     YASM_WRITE_16_L(localbuf, flags);
-    fwrite(info.buf, 20, 1, f);
+    yasm_outsink_write(sink, info.buf, 20);
 
     yasm_object_sections_traverse(object, &info, coff_objfmt_output_secthead);
 
+    yasm_strtab_destroy(info.strtab);
     yasm_xfree(info.buf);
 }
 
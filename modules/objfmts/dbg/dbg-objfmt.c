@@ -33,6 +33,7 @@ typedef struct yasm_objfmt_dbg {
     yasm_objfmt_base objfmt;        /* base structure */
 
     FILE *dbgfile;
+    int owns_dbgfile;           /* dbgfile is our temp file */
 } yasm_objfmt_dbg;
 
 yasm_objfmt_module yasm_dbg_LTX_objfmt;
@@ -46,6 +47,7 @@ dbg_objfmt_create(yasm_object *object)
     objfmt_dbg->objfmt.module = &yasm_dbg_LTX_objfmt;
 
     objfmt_dbg->dbgfile = tmpfile();
+    objfmt_dbg->owns_dbgfile = 1;
     if (!objfmt_dbg->dbgfile) {
         fprintf(stderr, N_("could not open temporary file"));
         return 0;
@@ -54,30 +56,45 @@ dbg_objfmt_create(yasm_object *object)
     return (yasm_objfmt *)objfmt_dbg;
 }
 
+/* Copy the temp file to the real output */
 static void
-dbg_objfmt_output(yasm_object *object, FILE *f, int all_syms,
-                  yasm_errwarns *errwarns)
+dbg_objfmt_copy_dbgfile(yasm_objfmt_dbg *objfmt_dbg, yasm_outsink *sink)
 {
-    yasm_objfmt_dbg *objfmt_dbg = (yasm_objfmt_dbg *)object->objfmt;
     char buf[1024];
     size_t i;
 
-    /* Copy temp file to real output file */
     rewind(objfmt_dbg->dbgfile);
     while ((i = fread(buf, 1, 1024, objfmt_dbg->dbgfile))) {
-        if (fwrite(buf, 1, i, f) != i)
+        if (yasm_outsink_write(sink, buf, i) != i)
             break;
     }
+}
 
-    /* Reassign objfmt debug file to output file */
-    fclose(objfmt_dbg->dbgfile);
-    objfmt_dbg->dbgfile = f;
+static void
+dbg_objfmt_output(yasm_object *object, yasm_outsink *sink, int all_syms,
+                  yasm_errwarns *errwarns)
+{
+    yasm_objfmt_dbg *objfmt_dbg = (yasm_objfmt_dbg *)object->objfmt;
+    /*@null@*/ FILE *f = yasm_outsink_get_file(sink);
+
+    /* Reassign objfmt debug file to output file (if there is one; for a
+     * memory image, keep printing to the temp file and copy it at the end).
+     */
+    if (f) {
+        dbg_objfmt_copy_dbgfile(objfmt_dbg, sink);
+        fclose(objfmt_dbg->dbgfile);
+        objfmt_dbg->dbgfile = f;
+        objfmt_dbg->owns_dbgfile = 0;
+    }
 
     fprintf(objfmt_dbg->dbgfile, "output(f, object->\n");
     yasm_object_print(object, objfmt_dbg->dbgfile, 1);
     fprintf(objfmt_dbg->dbgfile, "%d)\n", all_syms);
     fprintf(objfmt_dbg->dbgfile, " Symbol Table:\n");
     yasm_symtab_print(object->symtab, objfmt_dbg->dbgfile, 1);
+
+    if (!f)
+        dbg_objfmt_copy_dbgfile(objfmt_dbg, sink);
 }
 
 static void
@@ -85,6 +102,8 @@ dbg_objfmt_destroy(yasm_objfmt *objfmt)
 {
     yasm_objfmt_dbg *objfmt_dbg = (yasm_objfmt_dbg *)objfmt;
     fprintf(objfmt_dbg->dbgfile, "destroy()\n");
+    if (objfmt_dbg->owns_dbgfile)
+        fclose(objfmt_dbg->dbgfile);
     yasm_xfree(objfmt);
 }
 
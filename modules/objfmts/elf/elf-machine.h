@@ -44,6 +44,10 @@
 
 #define YASM_WRITE_64Z_L(p, i)          YASM_WRITE_64C_L(p, 0, i)
 
+/* Write all of an unsigned long (which may be 32 or 64 bits) as 64 bits. */
+#define YASM_WRITE_64UL_L(p, i) \
+    YASM_WRITE_64C_L(p, ((i) >> 16) >> 16, (i) & 0xFFFFFFFFUL)
+
 typedef int(*func_accepts_reloc)(size_t val, yasm_symrec *wrt);
 typedef void(*func_write_symtab_entry)(unsigned char *bufp,
                                        elf_symtab_entry *entry,
@@ -51,6 +51,9 @@
 typedef struct yasm_objfmt_elf {
     yasm_objfmt_base objfmt;            /* base structure */
 
+    const elf_machine_handler *elf_march;   /* machine handler */
+    /*@only@*/ yasm_symrec **elf_ssyms;     /* "special" syms */
+
     elf_symtab_head* elf_symtab;        /* symbol table of indexed syms */
     elf_strtab_head* shstrtab;          /* section name strtab */
     elf_strtab_head* strtab;            /* strtab entries */
@@ -59,15 +62,28 @@ typedef struct yasm_objfmt_elf {
     yasm_symrec *dotdotsym;             /* ..sym symbol */
 } yasm_objfmt_elf;
 
+/* Section contents encoded ahead of output by a worker thread */
+typedef struct elf_objfmt_sect_bytes {
+    /*@only@*/ yasm_outsink *sink;      /* memory image */
+    /*@only@*/ yasm_errwarns *errwarns;
+} elf_objfmt_sect_bytes;
+
 typedef struct {
     yasm_objfmt_elf *objfmt_elf;
     yasm_errwarns *errwarns;
-    FILE *f;
+    yasm_outsink *sink;
     elf_secthead *shead;
     yasm_section *sect;
     yasm_object *object;
     unsigned long sindex;
     yasm_symrec *GOT_sym;
+    /*@only@*/ yasm_intnum *intn;       /* scratch for output values */
+
+    /* Contents of each section in section order, if encoded ahead of
+     * output; NULL if sections are encoded as they are output.
+     */
+    /*@only@*/ /*@null@*/ elf_objfmt_sect_bytes *encoded;
+    unsigned long encoded_num;      /* index of next section to output */
 } elf_objfmt_output_info;
 
 typedef struct {
@@ -95,7 +111,7 @@ elf_objfmt_symtab_append(yasm_objfmt_elf *objfmt_elf, yasm_symrec *sym,
     if (!entry) {
         /*@only@*/ char *symname = yasm_symrec_get_global_name(sym, object);
         elf_strtab_entry *name =
-            elf_strtab_append_str(objfmt_elf->strtab, symname);
+            elf_strtab_append_unique_str(objfmt_elf->strtab, symname);
         yasm_xfree(symname);
         entry = elf_symtab_entry_create(name, sym);
         yasm_symrec_add_data(sym, &elf_symrec_data, entry);
@@ -322,7 +338,8 @@ elf_objfmt_build_symtab(yasm_symrec *sym, /*@null@*/ void *d)
             /*@only@*/ char *symname =
                 yasm_symrec_get_global_name(sym, info->object);
             elf_strtab_entry *name = !info->local_names || is_sect ? NULL :
-                elf_strtab_append_str(info->objfmt_elf->strtab, symname);
+                elf_strtab_append_unique_str(info->objfmt_elf->strtab,
+                                             symname);
             yasm_xfree(symname);
             entry = elf_symtab_entry_create(name, sym);
             yasm_symrec_add_data(sym, &elf_symrec_data, entry);
@@ -356,11 +373,13 @@ elf_objfmt_create_common(yasm_object *object, yasm_objfmt_module *module,
     const elf_machine_handler *elf_march;
 
     objfmt_elf->objfmt.module = module;
-    elf_march = elf_set_arch(object->arch, object->symtab, bits_pref);
+    elf_march = elf_set_arch(object->arch, object->symtab, bits_pref,
+                             &objfmt_elf->elf_ssyms);
     if (!elf_march) {
         yasm_xfree(objfmt_elf);
         return NULL;
     }
+    objfmt_elf->elf_march = elf_march;
     if (elf_march_out)
         *elf_march_out = elf_march;
 
@@ -372,7 +391,8 @@ elf_objfmt_create_common(yasm_object *object, yasm_objfmt_module *module,
     filesym = yasm_symtab_define_label(object->symtab, ".file", NULL, 0, 0);
     /* Put in current input filename; we'll replace it in output() */
     objfmt_elf->file_strtab_entry =
-        elf_strtab_append_str(objfmt_elf->strtab, object->src_filename);
+        elf_strtab_append_unique_str(objfmt_elf->strtab,
+                                     object->src_filename);
     entry = elf_symtab_entry_create(objfmt_elf->file_strtab_entry, filesym);
     yasm_symrec_add_data(filesym, &elf_symrec_data, entry);
     elf_symtab_set_nonzero(entry, NULL, SHN_ABS, STB_LOCAL, STT_FILE, NULL,
@@ -427,14 +447,14 @@ elfx32_objfmt_create(yasm_object *object)
 }
 
 static long
-elf_objfmt_output_align(FILE *f, unsigned int align)
+elf_objfmt_output_align(yasm_outsink *sink, unsigned int align)
 {
     long pos;
     unsigned long delta;
     if (!is_exp2(align))
         yasm_internal_error("requested alignment not a power of two");
 
-    pos = ftell(f);
+    pos = yasm_outsink_tell(sink);
     if (pos == -1) {
         yasm_error_set(YASM_ERROR_IO,
                        N_("could not get file position on output file"));
@@ -443,7 +463,7 @@ elf_objfmt_output_align(FILE *f, unsigned int align)
     delta = align - (pos & (align-1)); 
     if (delta != align) {
         pos += delta;
-        if (fseek(f, pos, SEEK_SET) < 0) {
+        if (yasm_outsink_seek(sink, pos) < 0) {
             yasm_error_set(YASM_ERROR_IO,
                            N_("could not set file position on output file"));
             return -1;
@@ -459,24 +479,21 @@ elf_objfmt_output_reloc(yasm_symrec *sym, yasm_bytecode *bc,
 {
     elf_reloc_entry *reloc;
     elf_objfmt_output_info *info = d;
-    yasm_intnum *zero;
-    int retval;
 
-    reloc = elf_reloc_entry_create(sym, NULL,
-        yasm_intnum_create_uint(bc->offset), 0, valsize, 0);
+    /* allocate .rel[a] sections on a need-basis */
+    reloc = elf_secthead_append_reloc(info->objfmt_elf->elf_march,
+                                      info->sect, info->shead, sym, NULL,
+                                      bc->offset, 0, valsize, 0);
     if (reloc == NULL) {
         yasm_error_set(YASM_ERROR_TYPE, N_("elf: invalid relocation size"));
         return 1;
     }
-    /* allocate .rel[a] sections on a need-basis */
-    elf_secthead_append_reloc(info->sect, info->shead, reloc);
 
-    zero = yasm_intnum_create_uint(0);
-    elf_handle_reloc_addend(zero, reloc, 0);
-    retval = yasm_arch_intnum_tobytes(info->object->arch, zero, buf, destsize,
-                                      valsize, 0, bc, warn);
-    yasm_intnum_destroy(zero);
-    return retval;
+    yasm_intnum_set_uint(info->intn, 0);
+    elf_handle_reloc_addend(info->objfmt_elf->elf_march, info->intn, reloc,
+                            0);
+    return yasm_arch_intnum_tobytes(info->object->arch, info->intn, buf,
+                                    destsize, valsize, 0, bc, warn);
 }
 
 static int
@@ -488,7 +505,6 @@ elf_objfmt_output_value(yasm_value *value, unsigned char *buf,
     /*@dependent@*/ /*@null@*/ yasm_intnum *intn;
     unsigned long intn_val;
     /*@null@*/ elf_reloc_entry *reloc = NULL;
-    int retval;
     unsigned int valsize = value->size;
 
     if (info == NULL)
@@ -555,38 +571,39 @@ elf_objfmt_output_value(yasm_value *value, unsigned char *buf,
         if (value->curpos_rel)
             intn_val += offset;
 
-        /* Check for _GLOBAL_OFFSET_TABLE_ symbol reference */
-        reloc = elf_reloc_entry_create(sym, wrt,
-            yasm_intnum_create_uint(bc->offset + offset), value->curpos_rel,
-            valsize, sym == info->GOT_sym);
+        /* allocate .rel[a] sections on a need-basis; check for
+         * _GLOBAL_OFFSET_TABLE_ symbol reference
+         */
+        reloc = elf_secthead_append_reloc(info->objfmt_elf->elf_march,
+                                          info->sect, info->shead, sym, wrt,
+                                          bc->offset + offset,
+                                          value->curpos_rel, valsize,
+                                          sym == info->GOT_sym);
         if (reloc == NULL) {
             yasm_error_set(YASM_ERROR_TYPE,
                            N_("elf: invalid relocation (WRT or size)"));
             return 1;
         }
-        /* allocate .rel[a] sections on a need-basis */
-        elf_secthead_append_reloc(info->sect, info->shead, reloc);
     }
 
-    intn = yasm_intnum_create_uint(intn_val);
+    intn = info->intn;
+    yasm_intnum_set_uint(intn, intn_val);
 
     if (value->abs) {
         yasm_intnum *intn2 = yasm_expr_get_intnum(&value->abs, 0);
         if (!intn2) {
             yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                            N_("elf: relocation too complex"));
-            yasm_intnum_destroy(intn);
             return 1;
         }
         yasm_intnum_calc(intn, YASM_EXPR_ADD, intn2);
     }
 
     if (reloc)
-        elf_handle_reloc_addend(intn, reloc, offset);
-    retval = yasm_arch_intnum_tobytes(info->object->arch, intn, buf, destsize,
-                                      valsize, 0, bc, warn);
-    yasm_intnum_destroy(intn);
-    return retval;
+        elf_handle_reloc_addend(info->objfmt_elf->elf_march, intn, reloc,
+                                offset);
+    return yasm_arch_intnum_tobytes(info->object->arch, intn, buf, destsize,
+                                    valsize, 0, bc, warn);
 }
 
 static int
@@ -597,10 +614,20 @@ elf_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
     /*@null@*/ /*@only@*/ unsigned char *bigbuf;
     unsigned long size = 256;
     int gap;
+    /*@null@*/ /*@dependent@*/ yasm_incfile *incfile;
+    unsigned long offset;
 
     if (info == NULL)
         yasm_internal_error("null info struct");
 
+    /* Copy included binary files straight from the file */
+    incfile = yasm_bc_get_incbin(bc, &offset);
+    if (incfile && bc->len > 0) {
+        elf_secthead_add_size(info->shead, bc->len);
+        yasm_outsink_write_file(info->sink, incfile, offset, bc->len);
+        return 0;
+    }
+
     bigbuf = yasm_bc_tobytes(bc, buf, &size, &gap, info,
                              elf_objfmt_output_value, elf_objfmt_output_reloc);
 
@@ -610,11 +637,8 @@ elf_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
             yasm_xfree(bigbuf);
         return 0;
     }
-    else {
-        yasm_intnum *bcsize = yasm_intnum_create_uint(size);
-        elf_secthead_add_size(info->shead, bcsize);
-        yasm_intnum_destroy(bcsize);
-    }
+    else
+        elf_secthead_add_size(info->shead, size);
 
     /* Warn that gaps are converted to 0 and write out the 0's. */
     if (gap) {
@@ -625,13 +649,13 @@ elf_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
         memset(buf, 0, 256);
         left = size;
         while (left > 256) {
-            fwrite(buf, 256, 1, info->f);
+            yasm_outsink_write(info->sink, buf, 256);
             left -= 256;
         }
-        fwrite(buf, left, 1, info->f);
+        yasm_outsink_write(info->sink, buf, left);
     } else {
         /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : buf, (size_t)size, 1, info->f);
+        yasm_outsink_write(info->sink, bigbuf ? bigbuf : buf, (size_t)size);
     }
 
     /* If bigbuf was allocated, free it */
@@ -646,6 +670,7 @@ elf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ elf_objfmt_output_info *info = (elf_objfmt_output_info *)d;
     /*@dependent@*/ /*@null@*/ elf_secthead *shead;
+    /*@dependent@*/ /*@null@*/ elf_objfmt_sect_bytes *encoded = NULL;
     long pos;
     char *relname;
     const char *sectname;
@@ -655,6 +680,8 @@ elf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     shead = yasm_section_get_data(sect, &elf_section_data);
     if (shead == NULL)
         yasm_internal_error("no associated data");
+    if (info->encoded)
+        encoded = &info->encoded[info->encoded_num++];
 
     if (elf_secthead_get_align(shead) == 0)
         elf_secthead_set_align(shead, yasm_section_get_align(sect));
@@ -663,43 +690,45 @@ elf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     if ((elf_secthead_get_type(shead) & SHT_NOBITS) == SHT_NOBITS)
     {
         yasm_bytecode *last = yasm_section_bcs_last(sect);
-        if (last) {
-            yasm_intnum *sectsize;
-            sectsize = yasm_intnum_create_uint(yasm_bc_next_offset(last));
-            elf_secthead_add_size(shead, sectsize);
-            yasm_intnum_destroy(sectsize);
-        }
+        if (last)
+            elf_secthead_add_size(shead, yasm_bc_next_offset(last));
         elf_secthead_set_index(shead, ++info->sindex);
         return 0;
     }
 
-    if ((pos = ftell(info->f)) == -1) {
+    if ((pos = yasm_outsink_tell(info->sink)) == -1) {
         yasm_error_set(YASM_ERROR_IO,
                        N_("couldn't read position on output stream"));
         yasm_errwarn_propagate(info->errwarns, 0);
     }
     pos = elf_secthead_set_file_offset(shead, pos);
-    if (fseek(info->f, pos, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(info->sink, pos) < 0) {
         yasm_error_set(YASM_ERROR_IO, N_("couldn't seek on output stream"));
         yasm_errwarn_propagate(info->errwarns, 0);
     }
 
     info->sect = sect;
     info->shead = shead;
-    yasm_section_bcs_traverse(sect, info->errwarns, info,
-                              elf_objfmt_output_bytecode);
+    if (encoded) {
+        yasm_outsink_write_sink(info->sink, encoded->sink);
+        yasm_errwarns_merge(info->errwarns, encoded->errwarns);
+    } else
+        yasm_section_bcs_traverse(sect, info->errwarns, info,
+                                  elf_objfmt_output_bytecode);
 
     elf_secthead_set_index(shead, ++info->sindex);
 
     /* No relocations to output?  Go on to next section */
-    if (elf_secthead_write_relocs_to_file(info->f, sect, shead,
+    if (elf_secthead_write_relocs_to_file(info->objfmt_elf->elf_march,
+                                          info->sink, sect, shead,
                                           info->errwarns) == 0)
         return 0;
     elf_secthead_set_rel_index(shead, ++info->sindex);
 
     /* name the relocation section .rel[a].foo */
     sectname = yasm_section_get_name(sect);
-    relname = elf_secthead_name_reloc_section(sectname);
+    relname = elf_secthead_name_reloc_section(info->objfmt_elf->elf_march,
+                                              sectname);
     elf_secthead_set_rel_name(shead,
         elf_strtab_append_str(info->objfmt_elf->shstrtab, relname));
     yasm_xfree(relname);
@@ -707,6 +736,79 @@ elf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     return 0;
 }
 
+typedef struct elf_objfmt_encode_data {
+    /*@dependent@*/ const elf_objfmt_output_info *info;
+    /*@only@*/ yasm_section **sects;
+    unsigned long num, max;
+} elf_objfmt_encode_data;
+
+static int
+elf_objfmt_collect_section(yasm_section *sect, /*@null@*/ void *d)
+{
+    elf_objfmt_encode_data *ed = (elf_objfmt_encode_data *)d;
+
+    if (ed->num >= ed->max) {
+        ed->max = ed->max ? ed->max*2 : 16;
+        ed->sects = yasm_xrealloc(ed->sects, ed->max*sizeof(yasm_section *));
+    }
+    ed->sects[ed->num++] = sect;
+    return 0;
+}
+
+static void
+elf_objfmt_encode_section(unsigned long job, /*@null@*/ void *d)
+{
+    elf_objfmt_encode_data *ed = (elf_objfmt_encode_data *)d;
+    elf_objfmt_output_info info = *ed->info;    /* structure copy */
+    yasm_section *sect = ed->sects[job];
+
+    info.shead = yasm_section_get_data(sect, &elf_section_data);
+    if (info.shead == NULL)
+        yasm_internal_error("no associated data");
+
+    /* don't output header-only sections */
+    if ((elf_secthead_get_type(info.shead) & SHT_NOBITS) == SHT_NOBITS)
+        return;
+
+    info.sect = sect;
+    info.sink = info.encoded[job].sink;
+    info.errwarns = info.encoded[job].errwarns;
+    info.intn = yasm_intnum_create_uint(0);
+    yasm_section_bcs_traverse(sect, info.errwarns, &info,
+                              elf_objfmt_output_bytecode);
+    yasm_intnum_destroy(info.intn);
+}
+
+/* Encode the contents of all sections into memory using worker threads, so
+ * that elf_objfmt_output_section() only needs to write them out in order.
+ * Only section-local state (section size and relocations) is updated.
+ */
+static unsigned long
+elf_objfmt_encode_sections(yasm_object *object, elf_objfmt_output_info *info)
+{
+    elf_objfmt_encode_data ed;
+    unsigned long i;
+
+    ed.info = info;
+    ed.sects = NULL;
+    ed.num = 0;
+    ed.max = 0;
+    yasm_object_sections_traverse(object, &ed, elf_objfmt_collect_section);
+
+    info->encoded = yasm_xmalloc(ed.num*sizeof(elf_objfmt_sect_bytes));
+    info->encoded_num = 0;
+    for (i=0; i<ed.num; i++) {
+        info->encoded[i].sink = yasm_outsink_create_mem();
+        info->encoded[i].errwarns = yasm_errwarns_create();
+    }
+
+    yasm_parallel_run(object->threads, ed.num, &ed,
+                      elf_objfmt_encode_section);
+    if (ed.sects)
+        yasm_xfree(ed.sects);
+    return ed.num;
+}
+
 static int
 elf_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
 {
@@ -719,13 +821,15 @@ elf_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
     if (shead == NULL)
         yasm_internal_error("no section header attached to section");
 
-    if(elf_secthead_write_to_file(info->f, shead, info->sindex+1))
+    if(elf_secthead_write_to_file(info->objfmt_elf->elf_march, info->sink,
+                                  shead, info->sindex+1))
         info->sindex++;
 
     /* output strtab headers here? */
 
     /* relocation entries for .foo are stored in section .rel[a].foo */
-    if(elf_secthead_write_rel_to_file(info->f, 3, sect, shead,
+    if(elf_secthead_write_rel_to_file(info->objfmt_elf->elf_march,
+                                      info->sink, 3, sect, shead,
                                       info->sindex+1))
         info->sindex++;
 
@@ -733,10 +837,11 @@ elf_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
 }
 
 static void
-elf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
+elf_objfmt_output(yasm_object *object, yasm_outsink *sink, int all_syms,
                   yasm_errwarns *errwarns)
 {
     yasm_objfmt_elf *objfmt_elf = (yasm_objfmt_elf *)object->objfmt;
+    const elf_machine_handler *elf_march = objfmt_elf->elf_march;
     elf_objfmt_output_info info;
     build_symtab_info buildsym_info;
     long pos;
@@ -746,19 +851,24 @@ elf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     unsigned long elf_strtab_size, elf_shstrtab_size, elf_symtab_size;
     elf_strtab_entry *elf_strtab_name, *elf_shstrtab_name, *elf_symtab_name;
     unsigned long elf_symtab_nlocal;
+    unsigned long num_encoded = 0;
+    int retval;
 
     info.object = object;
     info.objfmt_elf = objfmt_elf;
     info.errwarns = errwarns;
-    info.f = f;
+    info.sink = sink;
     info.GOT_sym = yasm_symtab_get(object->symtab, "_GLOBAL_OFFSET_TABLE_");
+    info.encoded = NULL;
 
     /* Update filename strtab */
-    elf_strtab_entry_set_str(objfmt_elf->file_strtab_entry,
+    elf_strtab_entry_set_str(objfmt_elf->strtab,
+                             objfmt_elf->file_strtab_entry,
                              object->src_filename);
 
     /* Allocate space for Ehdr by seeking forward */
-    if (fseek(f, (long)(elf_proghead_get_size()), SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, (long)(elf_proghead_get_size(elf_march)))
+        < 0) {
         yasm_error_set(YASM_ERROR_IO, N_("could not seek on output file"));
         yasm_errwarn_propagate(errwarns, 0);
         return;
@@ -776,9 +886,23 @@ elf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
 
     /* output known sections - includes reloc sections which aren't in yasm's
      * list.  Assign indices as we go. */
+    if (object->threads > 1 && yasm_parallel_supported())
+        num_encoded = elf_objfmt_encode_sections(object, &info);
     info.sindex = 3;
-    if (yasm_object_sections_traverse(object, &info,
-                                      elf_objfmt_output_section))
+    info.intn = yasm_intnum_create_uint(0);
+    retval = yasm_object_sections_traverse(object, &info,
+                                           elf_objfmt_output_section);
+    yasm_intnum_destroy(info.intn);
+    if (info.encoded) {
+        unsigned long i;
+        for (i=0; i<num_encoded; i++) {
+            yasm_outsink_destroy(info.encoded[i].sink);
+            yasm_errwarns_destroy(info.encoded[i].errwarns);
+        }
+        yasm_xfree(info.encoded);
+        info.encoded = NULL;
+    }
+    if (retval)
         return;
 
     /* add final sections to the shstrtab */
@@ -788,32 +912,35 @@ elf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
                                               ".shstrtab");
 
     /* output .shstrtab */
-    if ((pos = elf_objfmt_output_align(f, 4)) == -1) {
+    if ((pos = elf_objfmt_output_align(sink, 4)) == -1) {
         yasm_errwarn_propagate(errwarns, 0);
         return;
     }
     elf_shstrtab_offset = (unsigned long) pos;
-    elf_shstrtab_size = elf_strtab_output_to_file(f, objfmt_elf->shstrtab);
+    elf_shstrtab_size = elf_strtab_output_to_file(sink, objfmt_elf->shstrtab,
+                                                  object->strtab_tail_merge);
 
     /* output .strtab */
-    if ((pos = elf_objfmt_output_align(f, 4)) == -1) {
+    if ((pos = elf_objfmt_output_align(sink, 4)) == -1) {
         yasm_errwarn_propagate(errwarns, 0);
         return;
     }
     elf_strtab_offset = (unsigned long) pos;
-    elf_strtab_size = elf_strtab_output_to_file(f, objfmt_elf->strtab);
+    elf_strtab_size = elf_strtab_output_to_file(sink, objfmt_elf->strtab,
+                                                object->strtab_tail_merge);
 
     /* output .symtab - last section so all others have indexes */
-    if ((pos = elf_objfmt_output_align(f, 4)) == -1) {
+    if ((pos = elf_objfmt_output_align(sink, 4)) == -1) {
         yasm_errwarn_propagate(errwarns, 0);
         return;
     }
     elf_symtab_offset = (unsigned long) pos;
-    elf_symtab_size = elf_symtab_write_to_file(f, objfmt_elf->elf_symtab,
+    elf_symtab_size = elf_symtab_write_to_file(elf_march, sink,
+                                               objfmt_elf->elf_symtab,
                                                errwarns);
 
     /* output section header table */
-    if ((pos = elf_objfmt_output_align(f, 16)) == -1) {
+    if ((pos = elf_objfmt_output_align(sink, 16)) == -1) {
         yasm_errwarn_propagate(errwarns, 0);
         return;
     }
@@ -840,29 +967,29 @@ elf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     /* output dummy section header - 0 */
     info.sindex = 0;
 
-    esdn = elf_secthead_create(NULL, SHT_NULL, 0, 0, 0);
+    esdn = elf_secthead_create(elf_march, NULL, SHT_NULL, 0, 0, 0);
     elf_secthead_set_index(esdn, 0);
-    elf_secthead_write_to_file(f, esdn, 0);
+    elf_secthead_write_to_file(elf_march, sink, esdn, 0);
     elf_secthead_destroy(esdn);
 
-    esdn = elf_secthead_create(elf_shstrtab_name, SHT_STRTAB, 0,
+    esdn = elf_secthead_create(elf_march, elf_shstrtab_name, SHT_STRTAB, 0,
                                elf_shstrtab_offset, elf_shstrtab_size);
     elf_secthead_set_index(esdn, 1);
-    elf_secthead_write_to_file(f, esdn, 1);
+    elf_secthead_write_to_file(elf_march, sink, esdn, 1);
     elf_secthead_destroy(esdn);
 
-    esdn = elf_secthead_create(elf_strtab_name, SHT_STRTAB, 0,
+    esdn = elf_secthead_create(elf_march, elf_strtab_name, SHT_STRTAB, 0,
                                elf_strtab_offset, elf_strtab_size);
     elf_secthead_set_index(esdn, 2);
-    elf_secthead_write_to_file(f, esdn, 2);
+    elf_secthead_write_to_file(elf_march, sink, esdn, 2);
     elf_secthead_destroy(esdn);
 
-    esdn = elf_secthead_create(elf_symtab_name, SHT_SYMTAB, 0,
+    esdn = elf_secthead_create(elf_march, elf_symtab_name, SHT_SYMTAB, 0,
                                elf_symtab_offset, elf_symtab_size);
     elf_secthead_set_index(esdn, 3);
     elf_secthead_set_info(esdn, elf_symtab_nlocal);
     elf_secthead_set_link(esdn, 2);     /* for .strtab, which is index 2 */
-    elf_secthead_write_to_file(f, esdn, 3);
+    elf_secthead_write_to_file(elf_march, sink, esdn, 3);
     elf_secthead_destroy(esdn);
 
     info.sindex = 3;
@@ -870,13 +997,14 @@ elf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     yasm_object_sections_traverse(object, &info, elf_objfmt_output_secthead);
 
     /* output Ehdr */
-    if (fseek(f, 0, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, 0) < 0) {
         yasm_error_set(YASM_ERROR_IO, N_("could not seek on output file"));
         yasm_errwarn_propagate(errwarns, 0);
         return;
     }
 
-    elf_proghead_write_to_file(f, elf_shead_addr, info.sindex+1, 1);
+    elf_proghead_write_to_file(elf_march, sink, elf_shead_addr,
+                               info.sindex+1, 1);
 }
 
 static void
@@ -886,6 +1014,8 @@ elf_objfmt_destroy(yasm_objfmt *objfmt)
     elf_symtab_destroy(objfmt_elf->elf_symtab);
     elf_strtab_destroy(objfmt_elf->shstrtab);
     elf_strtab_destroy(objfmt_elf->strtab);
+    if (objfmt_elf->elf_ssyms)
+        yasm_xfree(objfmt_elf->elf_ssyms);
     yasm_xfree(objfmt);
 }
 
@@ -909,7 +1039,7 @@ elf_objfmt_init_new_section(yasm_section *sect, unsigned long line)
         type = SHT_STRTAB;
     }
 
-    esd = elf_secthead_create(name, type, 0, 0, 0);
+    esd = elf_secthead_create(objfmt_elf->elf_march, name, type, 0, 0, 0);
     elf_secthead_set_entsize(esd, entsize);
     yasm_section_add_data(sect, &elf_section_data, esd);
     sym = yasm_symtab_define_label(object->symtab, sectname,
@@ -1140,11 +1270,11 @@ static /*@observer@*/ /*@null@*/ yasm_symrec *
 elf_objfmt_get_special_sym(yasm_object *object, const char *name,
                            const char *parser)
 {
-    if (yasm__strcasecmp(name, "sym") == 0) {
-        yasm_objfmt_elf *objfmt_elf = (yasm_objfmt_elf *)object->objfmt;
+    yasm_objfmt_elf *objfmt_elf = (yasm_objfmt_elf *)object->objfmt;
+    if (yasm__strcasecmp(name, "sym") == 0)
         return objfmt_elf->dotdotsym;
-    }
-    return elf_get_special_sym(name, parser);
+    return elf_get_special_sym(objfmt_elf->elf_march, objfmt_elf->elf_ssyms,
+                               name, parser);
 }
 
 static void
@@ -1162,7 +1292,7 @@ dir_type(yasm_object *object, yasm_valparamhead *valparams,
     /* Create entry if necessary */
     if (!entry) {
         entry = elf_symtab_entry_create(
-            elf_strtab_append_str(objfmt_elf->strtab, symname), sym);
+            elf_strtab_append_unique_str(objfmt_elf->strtab, symname), sym);
         yasm_symrec_add_data(sym, &elf_symrec_data, entry);
     }
 
@@ -1199,7 +1329,7 @@ dir_size(yasm_object *object, yasm_valparamhead *valparams,
     /* Create entry if necessary */
     if (!entry) {
         entry = elf_symtab_entry_create(
-            elf_strtab_append_str(objfmt_elf->strtab, symname), sym);
+            elf_strtab_append_unique_str(objfmt_elf->strtab, symname), sym);
         yasm_symrec_add_data(sym, &elf_symrec_data, entry);
     }
 
@@ -98,7 +98,7 @@ elf_x86_amd64_write_secthead(unsigned char *bufp, elf_secthead *shead)
     YASM_WRITE_64Z_L(bufp, shead->flags);
     YASM_WRITE_64Z_L(bufp, 0);          /* vmem address */
     YASM_WRITE_64Z_L(bufp, shead->offset);
-    YASM_WRITE_64I_L(bufp, shead->size);
+    YASM_WRITE_64UL_L(bufp, shead->size);
 
     YASM_WRITE_32_L(bufp, shead->link);
     YASM_WRITE_32_L(bufp, shead->info);
@@ -113,21 +113,13 @@ elf_x86_amd64_write_secthead_rel(unsigned char *bufp,
                                  elf_section_index symtab_idx,
                                  elf_section_index sindex)
 {
-    yasm_intnum *nreloc;
-    yasm_intnum *relocsize;
-
     YASM_WRITE_32_L(bufp, shead->rel_name ? shead->rel_name->index : 0);
     YASM_WRITE_32_L(bufp, SHT_RELA);
     YASM_WRITE_64Z_L(bufp, 0);
     YASM_WRITE_64Z_L(bufp, 0);
     YASM_WRITE_64Z_L(bufp, shead->rel_offset);
 
-    nreloc = yasm_intnum_create_uint(shead->nreloc);
-    relocsize = yasm_intnum_create_uint(RELOC64A_SIZE);
-    yasm_intnum_calc(relocsize, YASM_EXPR_MUL, nreloc);
-    YASM_WRITE_64I_L(bufp, relocsize);          /* size */
-    yasm_intnum_destroy(nreloc);
-    yasm_intnum_destroy(relocsize);
+    YASM_WRITE_64UL_L(bufp, shead->nreloc * RELOC64A_SIZE); /* size */
 
     YASM_WRITE_32_L(bufp, symtab_idx);          /* link: symtab index */
     YASM_WRITE_32_L(bufp, shead->index);        /* info: relocated's index */
@@ -141,7 +133,7 @@ elf_x86_amd64_handle_reloc_addend(yasm_intnum *intn,
                                   unsigned long offset)
 {
     /* .rela: copy value out as addend, replace original with 0 */
-    reloc->addend = yasm_intnum_copy(intn);
+    yasm_intnum_get_sized(intn, reloc->addend, 8, 64, 0, 0, 0);
     yasm_intnum_zero(intn);
 }
 
@@ -194,15 +186,10 @@ static void
 elf_x86_amd64_write_reloc(unsigned char *bufp, elf_reloc_entry *reloc,
                           unsigned int r_type, unsigned int r_sym)
 {
-    YASM_WRITE_64I_L(bufp, reloc->reloc.addr);
+    YASM_WRITE_64UL_L(bufp, reloc->reloc.addr);
     /*YASM_WRITE_64_L(bufp, ELF64_R_INFO(r_sym, r_type));*/
     YASM_WRITE_64C_L(bufp, r_sym, r_type);
-    if (reloc->addend)
-        YASM_WRITE_64I_L(bufp, reloc->addend);
-    else {
-        YASM_WRITE_32_L(bufp, 0);
-        YASM_WRITE_32_L(bufp, 0);
-    }
+    memcpy(bufp, reloc->addend, 8);
 }
 
 static void
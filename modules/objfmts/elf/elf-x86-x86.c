@@ -105,7 +105,7 @@ elf_x86_x86_write_secthead(unsigned char *bufp, elf_secthead *shead)
     YASM_WRITE_32_L(bufp, 0); /* vmem address */
 
     YASM_WRITE_32_L(bufp, shead->offset);
-    YASM_WRITE_32I_L(bufp, shead->size);
+    YASM_WRITE_32_L(bufp, shead->size);
     YASM_WRITE_32_L(bufp, shead->link);
     YASM_WRITE_32_L(bufp, shead->info);
 
@@ -190,7 +190,7 @@ static void
 elf_x86_x86_write_reloc(unsigned char *bufp, elf_reloc_entry *reloc,
                         unsigned int r_type, unsigned int r_sym)
 {
-    YASM_WRITE_32I_L(bufp, reloc->reloc.addr);
+    YASM_WRITE_32_L(bufp, reloc->reloc.addr);
     YASM_WRITE_32_L(bufp, ELF32_R_INFO((unsigned long)r_sym, (unsigned char)r_type));
 }
 
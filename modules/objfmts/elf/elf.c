@@ -66,16 +66,13 @@ static const elf_machine_handler *elf_machine_handlers[] =
     &elf_machine_handler_x86_x32,
     NULL
 };
-static const elf_machine_handler elf_null_machine = {0, 0, 0, 0, 0, 0, 0, 0,
-                                                     0, 0, 0, 0, 0, 0, 0, 0,
-                                                     0, 0, 0};
-static elf_machine_handler const *elf_march = &elf_null_machine;
-static yasm_symrec **elf_ssyms;
 
 const elf_machine_handler *
-elf_set_arch(yasm_arch *arch, yasm_symtab *symtab, int bits_pref)
+elf_set_arch(yasm_arch *arch, yasm_symtab *symtab, int bits_pref,
+             yasm_symrec ***elf_ssyms)
 {
     const char *machine = yasm_arch_get_machine(arch);
+    const elf_machine_handler *elf_march;
     int i;
 
     for (i=0, elf_march = elf_machine_handlers[0];
@@ -92,18 +89,19 @@ elf_set_arch(yasm_arch *arch, yasm_symtab *symtab, int bits_pref)
                 break;
     }
 
+    *elf_ssyms = NULL;
     if (elf_march && elf_march->num_ssyms > 0)
     {
         /* Allocate "special" syms */
-        elf_ssyms =
+        *elf_ssyms =
             yasm_xmalloc(elf_march->num_ssyms * sizeof(yasm_symrec *));
         for (i=0; (unsigned int)i<elf_march->num_ssyms; i++)
         {
             /* FIXME: misuse of NULL bytecode */
-            elf_ssyms[i] = yasm_symtab_define_label(symtab,
-                                                    elf_march->ssyms[i].name,
-                                                    NULL, 0, 0);
-            yasm_symrec_add_data(elf_ssyms[i], &elf_ssym_symrec_data,
+            (*elf_ssyms)[i] =
+                yasm_symtab_define_label(symtab, elf_march->ssyms[i].name,
+                                         NULL, 0, 0);
+            yasm_symrec_add_data((*elf_ssyms)[i], &elf_ssym_symrec_data,
                                  (void*)&elf_march->ssyms[i]);
         }
     }
@@ -112,7 +110,9 @@ elf_set_arch(yasm_arch *arch, yasm_symtab *symtab, int bits_pref)
 }
 
 yasm_symrec *
-elf_get_special_sym(const char *name, const char *parser)
+elf_get_special_sym(const elf_machine_handler *elf_march,
+                    yasm_symrec **elf_ssyms, const char *name,
+                    const char *parser)
 {
     int i;
     for (i=0; (unsigned int)i<elf_march->num_ssyms; i++) {
@@ -140,154 +140,112 @@ elf_is_wrt_pos_adjusted(yasm_symrec *wrt)
 int
 elf_ssym_has_flag(yasm_symrec *wrt, int flag)
 {
-    int i;
-    for (i=0; (unsigned int)i<elf_march->num_ssyms; i++) {
-        if (elf_ssyms[i] == wrt)
-            return (elf_march->ssyms[i].sym_rel & flag) != 0;
-    }
-    return 0;
+    const elf_machine_ssym *ssym =
+        yasm_symrec_get_data(wrt, &elf_ssym_symrec_data);
+    return ssym && (ssym->sym_rel & flag) != 0;
 }
 
-/* takes ownership of addr */
-elf_reloc_entry *
-elf_reloc_entry_create(yasm_symrec *sym,
-                       yasm_symrec *wrt,
-                       yasm_intnum *addr,
-                       int rel,
-                       size_t valsize,
-                       int is_GOT_sym)
+/* strtab functions */
+elf_strtab_head *
+elf_strtab_create(void)
 {
-    elf_reloc_entry *entry;
-
-    if (!elf_march->accepts_reloc)
-        yasm_internal_error(N_("Unsupported machine for ELF output"));
-
-    if (!elf_march->accepts_reloc(valsize, wrt))
-    {
-        if (addr)
-            yasm_intnum_destroy(addr);
-        return NULL;
-    }
-
-    if (sym == NULL)
-        yasm_internal_error("sym is null");
-
-    entry = yasm_xmalloc(sizeof(elf_reloc_entry));
-    entry->reloc.sym = sym;
-    entry->reloc.addr = addr;
-    entry->rtype_rel = rel;
-    entry->valsize = valsize;
-    entry->addend = NULL;
-    entry->wrt = wrt;
-    entry->is_GOT_sym = is_GOT_sym;
-
-    return entry;
-}
+    elf_strtab_head *strtab = yasm_xmalloc(sizeof(elf_strtab_head));
 
-void
-elf_reloc_entry_destroy(void *entry)
-{
-    if (((elf_reloc_entry*)entry)->addend)
-        yasm_intnum_destroy(((elf_reloc_entry*)entry)->addend);
-    yasm_xfree(entry);
+    /* Index 0 is the empty string */
+    strtab->strtab = yasm_strtab_create(1);
+    strtab->max_blocks = 16;
+    strtab->blocks =
+        yasm_xmalloc(strtab->max_blocks*sizeof(elf_strtab_entry *));
+    strtab->num_blocks = 0;
+    strtab->num_entries = 0;
+    return strtab;
 }
 
-/* strtab functions */
-elf_strtab_entry *
-elf_strtab_entry_create(const char *str)
+/* Get the entry for a string ID, creating it if it's new. */
+static elf_strtab_entry *
+elf_strtab_get_entry(elf_strtab_head *strtab, unsigned long id)
 {
-    elf_strtab_entry *entry = yasm_xmalloc(sizeof(elf_strtab_entry));
-    entry->str = yasm__xstrdup(str);
-    entry->index = 0;
-    return entry;
-}
+    unsigned long block = id / ELF_STRTAB_BLOCK_SIZE;
+    elf_strtab_entry *entry;
 
-void
-elf_strtab_entry_set_str(elf_strtab_entry *entry, const char *str)
-{
-    elf_strtab_entry *last;
-    if (entry->str)
-        yasm_xfree(entry->str);
-    entry->str = yasm__xstrdup(str);
-
-    /* Update all following indices since string length probably changes */
-    last = entry;
-    entry = STAILQ_NEXT(last, qlink);
-    while (entry) {
-        entry->index = last->index + (unsigned long)strlen(last->str) + 1;
-        last = entry;
-        entry = STAILQ_NEXT(last, qlink);
+    if (block == strtab->num_blocks) {
+        if (strtab->num_blocks == strtab->max_blocks) {
+            strtab->max_blocks *= 2;
+            strtab->blocks = yasm_xrealloc(strtab->blocks,
+                strtab->max_blocks*sizeof(elf_strtab_entry *));
+        }
+        strtab->blocks[strtab->num_blocks++] =
+            yasm_xmalloc(ELF_STRTAB_BLOCK_SIZE*sizeof(elf_strtab_entry));
+    }
+    entry = &strtab->blocks[block][id % ELF_STRTAB_BLOCK_SIZE];
+    if (id == strtab->num_entries) {
+        entry->id = id;
+        entry->index = 0;
+        strtab->num_entries++;
     }
+    return entry;
 }
 
-elf_strtab_head *
-elf_strtab_create()
+elf_strtab_entry *
+elf_strtab_append_str(elf_strtab_head *strtab, const char *str)
 {
-    elf_strtab_head *strtab = yasm_xmalloc(sizeof(elf_strtab_head));
-    elf_strtab_entry *entry = yasm_xmalloc(sizeof(elf_strtab_entry));
-
-    STAILQ_INIT(strtab);
-    entry->index = 0;
-    entry->str = yasm__xstrdup("");
-
-    STAILQ_INSERT_TAIL(strtab, entry, qlink);
-    return strtab;
+    if (strtab == NULL)
+        yasm_internal_error("strtab is null");
+    return elf_strtab_get_entry(strtab,
+                                yasm_strtab_add(strtab->strtab, str));
 }
 
 elf_strtab_entry *
-elf_strtab_append_str(elf_strtab_head *strtab, const char *str)
+elf_strtab_append_unique_str(elf_strtab_head *strtab, const char *str)
 {
-    elf_strtab_entry *last, *entry;
-
     if (strtab == NULL)
         yasm_internal_error("strtab is null");
-    if (STAILQ_EMPTY(strtab))
-        yasm_internal_error("strtab is missing initial dummy entry");
-
-    last = STAILQ_LAST(strtab, elf_strtab_entry, qlink);
-
-    entry = elf_strtab_entry_create(str);
-    entry->index = last->index + (unsigned long)strlen(last->str) + 1;
+    return elf_strtab_get_entry(strtab,
+                                yasm_strtab_add_unique(strtab->strtab, str));
+}
 
-    STAILQ_INSERT_TAIL(strtab, entry, qlink);
-    return entry;
+void
+elf_strtab_entry_set_str(elf_strtab_head *strtab, elf_strtab_entry *entry,
+                         const char *str)
+{
+    yasm_strtab_replace(strtab->strtab, entry->id, str);
 }
 
 void
 elf_strtab_destroy(elf_strtab_head *strtab)
 {
-    elf_strtab_entry *s1, *s2;
+    unsigned long i;
 
     if (strtab == NULL)
         yasm_internal_error("strtab is null");
-    if (STAILQ_EMPTY(strtab))
-        yasm_internal_error("strtab is missing initial dummy entry");
 
-    s1 = STAILQ_FIRST(strtab);
-    while (s1 != NULL) {
-        s2 = STAILQ_NEXT(s1, qlink);
-        yasm_xfree(s1->str);
-        yasm_xfree(s1);
-        s1 = s2;
-    }
+    for (i=0; i<strtab->num_blocks; i++)
+        yasm_xfree(strtab->blocks[i]);
+    yasm_xfree(strtab->blocks);
+    yasm_strtab_destroy(strtab->strtab);
     yasm_xfree(strtab);
 }
 
 unsigned long
-elf_strtab_output_to_file(FILE *f, elf_strtab_head *strtab)
+elf_strtab_output_to_file(yasm_outsink *sink, elf_strtab_head *strtab,
+                          int tail_merge)
 {
-    unsigned long size = 0;
-    elf_strtab_entry *entry;
+    unsigned long size, id;
+    unsigned char *buf;
 
     if (strtab == NULL)
         yasm_internal_error("strtab is null");
 
-    /* consider optimizing tables here */
-    STAILQ_FOREACH(entry, strtab, qlink) {
-        size_t len = 1 + strlen(entry->str);
-        fwrite(entry->str, len, 1, f);
-        size += (unsigned long)len;
+    buf = yasm_strtab_finalize(strtab->strtab, tail_merge, &size);
+
+    /* Now that strings have been laid out, set each entry's index */
+    for (id=0; id<strtab->num_entries; id++) {
+        elf_strtab_entry *entry =
+            &strtab->blocks[id / ELF_STRTAB_BLOCK_SIZE]
+                           [id % ELF_STRTAB_BLOCK_SIZE];
+        entry->index = yasm_strtab_offset(strtab->strtab, id);
     }
+    yasm_outsink_write(sink, buf, size);
     return size;
 }
 
@@ -464,7 +422,8 @@ elf_symtab_assign_indices(elf_symtab_head *symtab)
 }
 
 unsigned long
-elf_symtab_write_to_file(FILE *f, elf_symtab_head *symtab,
+elf_symtab_write_to_file(const elf_machine_handler *elf_march,
+                         yasm_outsink *sink, elf_symtab_head *symtab,
                          yasm_errwarns *errwarns)
 {
     unsigned char buf[SYMTAB_MAXSIZE], *bufp;
@@ -532,7 +491,7 @@ elf_symtab_write_to_file(FILE *f, elf_symtab_head *symtab,
         if (!elf_march->write_symtab_entry || !elf_march->symtab_entry_size)
             yasm_internal_error(N_("Unsupported machine for ELF output"));
         elf_march->write_symtab_entry(bufp, entry, value_intn, size_intn);
-        fwrite(buf, elf_march->symtab_entry_size, 1, f);
+        yasm_outsink_write(sink, buf, elf_march->symtab_entry_size);
         size += elf_march->symtab_entry_size;
 
         yasm_intnum_destroy(size_intn);
@@ -591,7 +550,8 @@ elf_sym_in_table(elf_symtab_entry *entry)
 }
 
 elf_secthead *
-elf_secthead_create(elf_strtab_entry    *name,
+elf_secthead_create(const elf_machine_handler *elf_march,
+                    elf_strtab_entry    *name,
                     elf_section_type     type,
                     elf_section_flags    flags,
                     elf_address          offset,
@@ -602,7 +562,7 @@ elf_secthead_create(elf_strtab_entry    *name,
     esd->type = type;
     esd->flags = flags;
     esd->offset = offset;
-    esd->size = yasm_intnum_create_uint(size);
+    esd->size = size;
     esd->link = 0;
     esd->info = 0;
     esd->align = 0;
@@ -617,7 +577,7 @@ elf_secthead_create(elf_strtab_entry    *name,
     esd->rel_offset = 0;
     esd->nreloc = 0;
 
-    if (name && (strcmp(name->str, ".symtab") == 0)) {
+    if (type == SHT_SYMTAB) {
         if (!elf_march->symtab_entry_size || !elf_march->symtab_entry_align)
             yasm_internal_error(N_("unsupported ELF format"));
         esd->entsize = elf_march->symtab_entry_size;
@@ -633,8 +593,6 @@ elf_secthead_destroy(elf_secthead *shead)
     if (shead == NULL)
         yasm_internal_error(N_("shead is null"));
 
-    yasm_intnum_destroy(shead->size);
-
     yasm_xfree(shead);
 }
 
@@ -648,8 +606,8 @@ static void
 elf_secthead_print(void *data, FILE *f, int indent_level)
 {
     elf_secthead *sect = data;
-    fprintf(f, "%*sname=%s\n", indent_level, "",
-            sect->name ? sect->name->str : "<undef>");
+    fprintf(f, "%*sname_index=0x%lx\n", indent_level, "",
+            sect->name ? sect->name->index : 0);
     fprintf(f, "%*ssym=\n", indent_level, "");
     yasm_symrec_print(sect->sym, f, indent_level+1);
     fprintf(f, "%*sindex=0x%x\n", indent_level, "", sect->index);
@@ -663,15 +621,15 @@ elf_secthead_print(void *data, FILE *f, int indent_level)
     /*if (sect->flags & SHF_MASKPROC)
         fprintf(f, "PROC-SPECIFIC"); */
     fprintf(f, "%*soffset=0x%lx\n", indent_level, "", sect->offset);
-    fprintf(f, "%*ssize=0x%lx\n", indent_level, "",
-            yasm_intnum_get_uint(sect->size));
+    fprintf(f, "%*ssize=0x%lx\n", indent_level, "", sect->size);
     fprintf(f, "%*slink=0x%x\n", indent_level, "", sect->link);
     fprintf(f, "%*salign=%lu\n", indent_level, "", sect->align);
     fprintf(f, "%*snreloc=%ld\n", indent_level, "", sect->nreloc);
 }
 
 unsigned long
-elf_secthead_write_to_file(FILE *f, elf_secthead *shead,
+elf_secthead_write_to_file(const elf_machine_handler *elf_march,
+                           yasm_outsink *sink, elf_secthead *shead,
                            elf_section_index sindex)
 {
     unsigned char buf[SHDR_MAXSIZE], *bufp = buf;
@@ -683,29 +641,54 @@ elf_secthead_write_to_file(FILE *f, elf_secthead *shead,
     if (!elf_march->write_secthead || !elf_march->secthead_size)
         yasm_internal_error(N_("Unsupported machine for ELF output"));
     elf_march->write_secthead(bufp, shead);
-    if (fwrite(buf, elf_march->secthead_size, 1, f))
+    if (yasm_outsink_write(sink, buf, elf_march->secthead_size) ==
+        elf_march->secthead_size)
         return elf_march->secthead_size;
     yasm_internal_error(N_("Failed to write an elf section header"));
     return 0;
 }
 
-void
-elf_secthead_append_reloc(yasm_section *sect, elf_secthead *shead,
-                          elf_reloc_entry *reloc)
+elf_reloc_entry *
+elf_secthead_append_reloc(const elf_machine_handler *elf_march,
+                          yasm_section *sect, elf_secthead *shead,
+                          yasm_symrec *sym,
+                          yasm_symrec *wrt,
+                          elf_address addr,
+                          int rel,
+                          size_t valsize,
+                          int is_GOT_sym)
 {
+    elf_reloc_entry entry;
+
     if (sect == NULL)
         yasm_internal_error("sect is null");
     if (shead == NULL)
         yasm_internal_error("shead is null");
-    if (reloc == NULL)
-        yasm_internal_error("reloc is null");
+    if (sym == NULL)
+        yasm_internal_error("sym is null");
+
+    if (!elf_march->accepts_reloc)
+        yasm_internal_error(N_("Unsupported machine for ELF output"));
+
+    if (!elf_march->accepts_reloc(valsize, wrt))
+        return NULL;
+
+    entry.reloc.sym = sym;
+    entry.reloc.addr = addr;
+    entry.rtype_rel = rel;
+    entry.valsize = valsize;
+    memset(entry.addend, 0, sizeof(entry.addend));
+    entry.wrt = wrt;
+    entry.is_GOT_sym = is_GOT_sym;
 
     shead->nreloc++;
-    yasm_section_add_reloc(sect, (yasm_reloc *)reloc, elf_reloc_entry_destroy);
+    return (elf_reloc_entry *)yasm_section_add_reloc(sect, &entry.reloc,
+                                                     sizeof(elf_reloc_entry));
 }
 
 char *
-elf_secthead_name_reloc_section(const char *basesect)
+elf_secthead_name_reloc_section(const elf_machine_handler *elf_march,
+                                const char *basesect)
 {
     if (!elf_march->reloc_section_prefix)
     {
@@ -723,7 +706,8 @@ elf_secthead_name_reloc_section(const char *basesect)
 }
 
 void
-elf_handle_reloc_addend(yasm_intnum *intn,
+elf_handle_reloc_addend(const elf_machine_handler *elf_march,
+                        yasm_intnum *intn,
                         elf_reloc_entry *reloc,
                         unsigned long offset)
 {
@@ -733,7 +717,9 @@ elf_handle_reloc_addend(yasm_intnum *intn,
 }
 
 unsigned long
-elf_secthead_write_rel_to_file(FILE *f, elf_section_index symtab_idx,
+elf_secthead_write_rel_to_file(const elf_machine_handler *elf_march,
+                               yasm_outsink *sink,
+                               elf_section_index symtab_idx,
                                yasm_section *sect, elf_secthead *shead,
                                elf_section_index sindex)
 {
@@ -750,46 +736,59 @@ elf_secthead_write_rel_to_file(FILE *f, elf_section_index symtab_idx,
     if (!elf_march->write_secthead_rel || !elf_march->secthead_size)
         yasm_internal_error(N_("Unsupported machine for ELF output"));
     elf_march->write_secthead_rel(bufp, shead, symtab_idx, sindex);
-    if (fwrite(buf, elf_march->secthead_size, 1, f))
+    if (yasm_outsink_write(sink, buf, elf_march->secthead_size) ==
+        elf_march->secthead_size)
         return elf_march->secthead_size;
     yasm_internal_error(N_("Failed to write an elf section header"));
     return 0;
 }
 
 unsigned long
-elf_secthead_write_relocs_to_file(FILE *f, yasm_section *sect,
+elf_secthead_write_relocs_to_file(const elf_machine_handler *elf_march,
+                                  yasm_outsink *sink, yasm_section *sect,
                                   elf_secthead *shead, yasm_errwarns *errwarns)
 {
-    elf_reloc_entry *reloc;
-    unsigned char buf[RELOC_MAXSIZE], *bufp;
-    unsigned long size = 0;
+    elf_reloc_entry *relocs;
+    unsigned long nreloc, i;
+    unsigned char *buf, *bufp;
+    unsigned long size;
     long pos;
 
     if (shead == NULL)
         yasm_internal_error("shead is null");
 
-    reloc = (elf_reloc_entry *)yasm_section_relocs_first(sect);
-    if (!reloc)
+    if (yasm_section_get_object(sect)->sort_relocs)
+        yasm_section_sort_relocs(sect);
+    relocs = (elf_reloc_entry *)yasm_section_relocs(sect, &nreloc);
+    if (!relocs)
         return 0;
 
     /* first align section to multiple of 4 */
-    pos = ftell(f);
+    pos = yasm_outsink_tell(sink);
     if (pos == -1) {
         yasm_error_set(YASM_ERROR_IO,
                        N_("couldn't read position on output stream"));
         yasm_errwarn_propagate(errwarns, 0);
     }
     pos = (pos + 3) & ~3;
-    if (fseek(f, pos, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, pos) < 0) {
         yasm_error_set(YASM_ERROR_IO, N_("couldn't seek on output stream"));
         yasm_errwarn_propagate(errwarns, 0);
     }
     shead->rel_offset = (unsigned long)pos;
 
-
-    while (reloc) {
-        yasm_sym_vis vis;
-        unsigned int r_type=0, r_sym;
+    if (!elf_march->map_reloc_info_to_type)
+        yasm_internal_error(N_("Unsupported arch/machine for elf output"));
+    if (!elf_march->write_reloc || !elf_march->reloc_entry_size)
+        yasm_internal_error(N_("Unsupported arch/machine for elf output"));
+
+    /* encode all the entries, then write them at once */
+    size = nreloc*elf_march->reloc_entry_size;
+    buf = yasm_xmalloc(size);
+    bufp = buf;
+    for (i=0; i<nreloc; i++) {
+        elf_reloc_entry *reloc = &relocs[i];
+        unsigned int r_type, r_sym;
         elf_symtab_entry *esym;
 
         esym = yasm_symrec_get_data(reloc->reloc.sym, &elf_symrec_data);
@@ -798,21 +797,12 @@ elf_secthead_write_relocs_to_file(FILE *f, yasm_section *sect,
         else
             r_sym = STN_UNDEF;
 
-        vis = yasm_symrec_get_visibility(reloc->reloc.sym);
-        if (!elf_march->map_reloc_info_to_type)
-            yasm_internal_error(N_("Unsupported arch/machine for elf output"));
         r_type = elf_march->map_reloc_info_to_type(reloc);
-
-        bufp = buf;
-        if (!elf_march->write_reloc || !elf_march->reloc_entry_size)
-            yasm_internal_error(N_("Unsupported arch/machine for elf output"));
         elf_march->write_reloc(bufp, reloc, r_type, r_sym);
-        fwrite(buf, elf_march->reloc_entry_size, 1, f);
-        size += elf_march->reloc_entry_size;
-
-        reloc = (elf_reloc_entry *)
-            yasm_section_reloc_next((yasm_reloc *)reloc);
+        bufp += elf_march->reloc_entry_size;
     }
+    yasm_outsink_write(sink, buf, size);
+    yasm_xfree(buf);
     return size;
 }
 
@@ -833,7 +823,7 @@ elf_secthead_set_typeflags(elf_secthead *shead, elf_section_type type,
 int
 elf_secthead_is_empty(elf_secthead *shead)
 {
-    return yasm_intnum_is_zero(shead->size);
+    return shead->size == 0;
 }
 
 yasm_symrec *
@@ -903,11 +893,9 @@ elf_secthead_set_sym(elf_secthead *shead, yasm_symrec *sym)
 }
 
 void
-elf_secthead_add_size(elf_secthead *shead, yasm_intnum *size)
+elf_secthead_add_size(elf_secthead *shead, elf_size size)
 {
-    if (size) {
-        yasm_intnum_calc(shead->size, YASM_EXPR_ADD, size);
-    }
+    shead->size += size;
 }
 
 long
@@ -929,7 +917,7 @@ elf_secthead_set_file_offset(elf_secthead *shead, long pos)
 }
 
 unsigned long
-elf_proghead_get_size(void)
+elf_proghead_get_size(const elf_machine_handler *elf_march)
 {
     if (!elf_march->proghead_size)
         yasm_internal_error(N_("Unsupported ELF format for output"));
@@ -937,7 +925,8 @@ elf_proghead_get_size(void)
 }
 
 unsigned long
-elf_proghead_write_to_file(FILE *f,
+elf_proghead_write_to_file(const elf_machine_handler *elf_march,
+                           yasm_outsink *sink,
                            elf_offset secthead_addr,
                            unsigned long secthead_count,
                            elf_section_index shstrtab_index)
@@ -956,7 +945,8 @@ elf_proghead_write_to_file(FILE *f,
     if (((unsigned)(bufp - buf)) != elf_march->proghead_size)
         yasm_internal_error(N_("ELF program header is not proper length"));
 
-    if (fwrite(buf, elf_march->proghead_size, 1, f))
+    if (yasm_outsink_write(sink, buf, elf_march->proghead_size) ==
+        elf_march->proghead_size)
         return elf_march->proghead_size;
 
     yasm_internal_error(N_("Failed to write ELF program header"));
@@ -351,7 +351,7 @@ struct elf_secthead {
     elf_section_type     type;
     elf_section_flags    flags;
     elf_address          offset;
-    yasm_intnum         *size;
+    elf_size             size;
     elf_section_index    link;
     elf_section_info     info;      /* see note ESD1 */
     unsigned long        align;
@@ -389,16 +389,24 @@ struct elf_reloc_entry {
     yasm_reloc           reloc;
     int                  rtype_rel;
     size_t               valsize;
-    yasm_intnum         *addend;
+    unsigned char        addend[8];     /* .rela addend, little endian */
     /*@null@*/ yasm_symrec *wrt;
     int                  is_GOT_sym;
 };
 
-STAILQ_HEAD(elf_strtab_head, elf_strtab_entry);
+/* Each ID in the string table has one entry, allocated in blocks so that
+ * entries don't move as the table grows.
+ */
+#define ELF_STRTAB_BLOCK_SIZE   256
+struct elf_strtab_head {
+    /*@only@*/ yasm_strtab *strtab;
+    /*@only@*/ elf_strtab_entry **blocks;
+    unsigned long        num_blocks, max_blocks;
+    unsigned long        num_entries;
+};
 struct elf_strtab_entry {
-    STAILQ_ENTRY(elf_strtab_entry) qlink;
-    unsigned long        index;
-    char                *str;
+    unsigned long        id;        /* ID in strtab */
+    unsigned long        index;     /* offset, set when output */
 };
 
 STAILQ_HEAD(elf_symtab_head, elf_symtab_entry);
@@ -427,28 +435,28 @@ extern const yasm_assoc_data_callback elf_ssym_symrec_data;
 
 const elf_machine_handler *elf_set_arch(struct yasm_arch *arch,
                                         yasm_symtab *symtab,
-                                        int bits_pref);
+                                        int bits_pref,
+                                        /*@out@*/ yasm_symrec ***elf_ssyms);
 
-yasm_symrec *elf_get_special_sym(const char *name, const char *parser);
+yasm_symrec *elf_get_special_sym(const elf_machine_handler *elf_march,
+                                 yasm_symrec **elf_ssyms, const char *name,
+                                 const char *parser);
 
 /* reloc functions */
 int elf_is_wrt_sym_relative(yasm_symrec *wrt);
 int elf_is_wrt_pos_adjusted(yasm_symrec *wrt);
-elf_reloc_entry *elf_reloc_entry_create(yasm_symrec *sym,
-                                        /*@null@*/ yasm_symrec *wrt,
-                                        yasm_intnum *addr,
-                                        int rel,
-                                        size_t valsize,
-                                        int is_GOT_sym);
-void elf_reloc_entry_destroy(void *entry);
 
 /* strtab functions */
-elf_strtab_entry *elf_strtab_entry_create(const char *str);
-void elf_strtab_entry_set_str(elf_strtab_entry *entry, const char *str);
 elf_strtab_head *elf_strtab_create(void);
 elf_strtab_entry *elf_strtab_append_str(elf_strtab_head *head, const char *str);
+elf_strtab_entry *elf_strtab_append_unique_str(elf_strtab_head *head,
+                                               const char *str);
+void elf_strtab_entry_set_str(elf_strtab_head *head, elf_strtab_entry *entry,
+                              const char *str);
 void elf_strtab_destroy(elf_strtab_head *head);
-unsigned long elf_strtab_output_to_file(FILE *f, elf_strtab_head *head);
+unsigned long elf_strtab_output_to_file(yasm_outsink *sink,
+                                        elf_strtab_head *head,
+                                        int tail_merge);
 
 /* symtab functions */
 elf_symtab_entry *elf_symtab_entry_create(elf_strtab_entry *name,
@@ -459,7 +467,9 @@ void elf_symtab_insert_local_sym(elf_symtab_head *symtab,
                                  elf_symtab_entry *entry);
 void elf_symtab_destroy(elf_symtab_head *head);
 unsigned long elf_symtab_assign_indices(elf_symtab_head *symtab);
-unsigned long elf_symtab_write_to_file(FILE *f, elf_symtab_head *symtab,
+unsigned long elf_symtab_write_to_file(const elf_machine_handler *elf_march,
+                                       yasm_outsink *sink,
+                                       elf_symtab_head *symtab,
                                        yasm_errwarns *errwarns);
 void elf_symtab_set_nonzero(elf_symtab_entry    *entry,
                             struct yasm_section *sect,
@@ -475,16 +485,24 @@ void elf_sym_set_size(elf_symtab_entry *entry, struct yasm_expr *size);
 int elf_sym_in_table(elf_symtab_entry *entry);
 
 /* section header functions */
-elf_secthead *elf_secthead_create(elf_strtab_entry      *name,
+elf_secthead *elf_secthead_create(const elf_machine_handler *elf_march,
+                                  elf_strtab_entry      *name,
                                   elf_section_type      type,
                                   elf_section_flags     flags,
                                   elf_address           offset,
                                   elf_size              size);
 void elf_secthead_destroy(elf_secthead *esd);
-unsigned long elf_secthead_write_to_file(FILE *f, elf_secthead *esd,
+unsigned long elf_secthead_write_to_file(const elf_machine_handler *elf_march,
+                                         yasm_outsink *sink,
+                                         elf_secthead *esd,
                                          elf_section_index sindex);
-void elf_secthead_append_reloc(yasm_section *sect, elf_secthead *shead,
-                               elf_reloc_entry *reloc);
+/* returns the section's copy of the relocation (valid until the next one
+ * is appended), or NULL if the machine doesn't accept it
+ */
+/*@null@*/ elf_reloc_entry *elf_secthead_append_reloc
+    (const elf_machine_handler *elf_march, yasm_section *sect,
+     elf_secthead *shead, yasm_symrec *sym, /*@null@*/ yasm_symrec *wrt,
+     elf_address addr, int rel, size_t valsize, int is_GOT_sym);
 elf_section_type elf_secthead_get_type(elf_secthead *shead);
 void elf_secthead_set_typeflags(elf_secthead *shead, elf_section_type type,
                                 elf_section_flags flags);
@@ -506,25 +524,28 @@ elf_strtab_entry *elf_secthead_set_rel_name(elf_secthead *shead,
 elf_size elf_secthead_set_entsize(elf_secthead *shead, elf_size size);
 struct yasm_symrec *elf_secthead_set_sym(elf_secthead *shead,
                                          struct yasm_symrec *sym);
-void elf_secthead_add_size(elf_secthead *shead, yasm_intnum *size);
-char *elf_secthead_name_reloc_section(const char *basesect);
-void elf_handle_reloc_addend(yasm_intnum *intn,
+void elf_secthead_add_size(elf_secthead *shead, elf_size size);
+char *elf_secthead_name_reloc_section(const elf_machine_handler *elf_march,
+                                      const char *basesect);
+void elf_handle_reloc_addend(const elf_machine_handler *elf_march,
+                             yasm_intnum *intn,
                              elf_reloc_entry *reloc,
                              unsigned long offset);
-unsigned long elf_secthead_write_rel_to_file(FILE *f, elf_section_index symtab,
-                                             yasm_section *sect,
-                                             elf_secthead *esd,
-                                             elf_section_index sindex);
-unsigned long elf_secthead_write_relocs_to_file(FILE *f, yasm_section *sect,
-                                                elf_secthead *shead,
-                                                yasm_errwarns *errwarns);
+unsigned long elf_secthead_write_rel_to_file
+    (const elf_machine_handler *elf_march, yasm_outsink *sink,
+     elf_section_index symtab, yasm_section *sect, elf_secthead *esd,
+     elf_section_index sindex);
+unsigned long elf_secthead_write_relocs_to_file
+    (const elf_machine_handler *elf_march, yasm_outsink *sink,
+     yasm_section *sect, elf_secthead *shead, yasm_errwarns *errwarns);
 long elf_secthead_set_file_offset(elf_secthead *shead, long pos);
 
 /* program header function */
 unsigned long
-elf_proghead_get_size(void);
+elf_proghead_get_size(const elf_machine_handler *elf_march);
 unsigned long
-elf_proghead_write_to_file(FILE *f,
+elf_proghead_write_to_file(const elf_machine_handler *elf_march,
+                           yasm_outsink *sink,
                            elf_offset secthead_addr,
                            unsigned long secthead_count,
                            elf_section_index shstrtab_index);
@@ -0,0 +1,42 @@
+; Sections optimized and output independently, with a shared group of
+; sections linked by cross-section label differences.
+bits 64
+extern ext
+
+section .text
+top:
+	jmp	short_fwd
+	times 10 nop
+short_fwd:
+	jz	far_fwd
+	times 200 nop
+far_fwd:
+	call	ext
+	lea	rax, [rel data1]
+	mov	eax, tbl_end - tbl
+	jmp	top
+
+section .text.a exec
+a_start:
+	jnz	a_end
+	times 100 db 0x90
+	loop	a_start
+a_end:
+	ret
+
+section .text.b exec
+b_start:
+	times (a_end - a_start) & 7 nop
+	jmp	b_start
+b_len equ $ - b_start
+	dd	b_len
+
+section .data
+data1:	dq	top, a_start, b_start
+tbl:	dd	1, 2, 3
+	align	16
+tbl_end:
+	dd	a_end - a_start
+
+section .bss
+	resb	64
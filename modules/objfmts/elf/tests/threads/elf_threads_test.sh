@@ -0,0 +1,3 @@
+#! /bin/sh
+${srcdir}/out_test.sh elf_threads_test modules/objfmts/elf/tests/threads "elf-amd64 objfmt with threads" "-f elf64 --threads=4" ".o"
+exit $?
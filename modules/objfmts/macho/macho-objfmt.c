@@ -276,7 +276,7 @@ typedef struct macho_section_data {
 typedef struct macho_symrec_data {
     unsigned long index;        /* index in output order */
     yasm_intnum *value;         /* valid after writing symtable to file */
-    unsigned long length;       /* length + 1 (plus auto underscore) */
+    unsigned long strtab_name;  /* string table ID of name */
 } macho_symrec_data;
 
 
@@ -294,8 +294,9 @@ typedef struct macho_objfmt_output_info {
     yasm_object *object;
     yasm_objfmt_macho *objfmt_macho;
     yasm_errwarns *errwarns;
-    /*@dependent@ */ FILE *f;
+    /*@dependent@ */ yasm_outsink *sink;
     /*@only@ */ unsigned char *buf;
+    /*@only@ */ yasm_intnum *intn;      /* scratch for output values */
     yasm_section *sect;
     /*@dependent@ */ macho_section_data *msd;
 
@@ -310,10 +311,10 @@ typedef struct macho_objfmt_output_info {
     unsigned long rel_base;     /* first relocation in file */
     unsigned long s_reloff;     /* in-file offset to relocations */
 
-    unsigned long indx;         /* current symbol size in bytes (name length+1) */
+    unsigned long indx;         /* number of symbols */
     unsigned long symindex;     /* current symbol index in output order */
     int all_syms;               /* outputting all symbols? */
-    unsigned long strlength;    /* length of all strings */
+    /*@only@*/ yasm_strtab *strtab;     /* string table */
 } macho_objfmt_output_info;
 
 
@@ -411,9 +412,8 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
     yasm_objfmt_macho *objfmt_macho;
     /*@dependent@*/ /*@null@*/ yasm_intnum *intn;
     unsigned long intn_minus = 0, intn_plus = 0;
-    int retval;
     unsigned int valsize = value->size;
-    macho_reloc *reloc = NULL;
+    macho_reloc reloc;
 
     assert(info != NULL);
     objfmt_macho = info->objfmt_macho;
@@ -444,60 +444,56 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
     if (value->rel) {
         yasm_sym_vis vis = yasm_symrec_get_visibility(value->rel);
 
-        reloc = yasm_xcalloc(sizeof(macho_reloc), 1);
-        reloc->reloc.addr = yasm_intnum_create_uint(bc->offset + offset);
-        reloc->reloc.sym = value->rel;
+        memset(&reloc, 0, sizeof(macho_reloc));
+        reloc.reloc.addr = bc->offset + offset;
+        reloc.reloc.sym = value->rel;
         switch (valsize) {
             case 64:
-                reloc->length = 3;
+                reloc.length = 3;
                 break;
             case 32:
-                reloc->length = 2;
+                reloc.length = 2;
                 break;
             case 16:
-                reloc->length = 1;
+                reloc.length = 1;
                 break;
             case 8:
-                reloc->length = 0;
+                reloc.length = 0;
                 break;
             default:
                 yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                                N_("macho: relocation size unsupported"));
-                yasm_xfree(reloc);
                 return 1;
         }
-        reloc->pcrel = 0;
-        reloc->ext = 0;
-        reloc->type = GENERIC_RELOC_VANILLA;
+        reloc.pcrel = 0;
+        reloc.ext = 0;
+        reloc.type = GENERIC_RELOC_VANILLA;
         /* R_ABS */
 
         if (value->rshift > 0) {
             yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                            N_("macho: shifted relocations not supported"));
-            yasm_xfree(reloc);
             return 1;
         }
 
         if (value->seg_of) {
             yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                            N_("macho: SEG not supported"));
-            yasm_xfree(reloc);
             return 1;
         }
 
         if (value->curpos_rel && objfmt_macho->gotpcrel_sym &&
             value->wrt == objfmt_macho->gotpcrel_sym) {
-            reloc->type = X86_64_RELOC_GOT;
+            reloc.type = X86_64_RELOC_GOT;
             value->wrt = NULL;
         } else if (value->wrt) {
             yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                            N_("macho: invalid WRT"));
-            yasm_xfree(reloc);
             return 1;
         }
 
         if (value->curpos_rel) {
-            reloc->pcrel = 1;
+            reloc.pcrel = 1;
             if (!info->is_64) {
                 /* Adjust to start of section, so subtract out the bytecode
                  * offset.
@@ -506,14 +502,14 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
             } else {
                 /* Add in the offset plus value size to end up with 0. */
                 intn_plus = offset+destsize;
-                if (reloc->type == X86_64_RELOC_GOT) {
+                if (reloc.type == X86_64_RELOC_GOT) {
                     /* XXX: This is a hack */
                     if (offset >= 2 && buf[-2] == 0x8B)
-                        reloc->type = X86_64_RELOC_GOT_LOAD;
+                        reloc.type = X86_64_RELOC_GOT_LOAD;
                 } else if (value->jump_target)
-                    reloc->type = X86_64_RELOC_BRANCH;
+                    reloc.type = X86_64_RELOC_BRANCH;
                 else
-                    reloc->type = X86_64_RELOC_SIGNED;
+                    reloc.type = X86_64_RELOC_SIGNED;
             }
         } else if (info->is_64) {
             if (valsize == 32) {
@@ -521,15 +517,15 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
                     N_("macho: sorry, cannot apply 32 bit absolute relocations in 64 bit mode, consider \"[_symbol wrt rip]\" for mem access, \"qword\" and \"dq _foo\" for pointers."));
                 return 1;
             }
-            reloc->type = X86_64_RELOC_UNSIGNED;
+            reloc.type = X86_64_RELOC_UNSIGNED;
         }
 
         /* It seems that x86-64 objects need to have all extern relocs? */
         if (info->is_64)
-            reloc->ext = 1;
+            reloc.ext = 1;
 
         if ((vis & YASM_SYM_EXTERN) || (vis & YASM_SYM_COMMON)) {
-            reloc->ext = 1;
+            reloc.ext = 1;
             info->msd->extreloc = 1;    /* section has external relocations */
         } else if (!info->is_64) {
             /*@dependent@*/ /*@null@*/ yasm_bytecode *sym_precbc;
@@ -545,14 +541,15 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
         }
 
         info->msd->nreloc++;
-        /*printf("reloc %s type %d ",yasm_symrec_get_name(reloc->reloc.sym),reloc->type);*/
-        yasm_section_add_reloc(info->sect, (yasm_reloc *)reloc, yasm_xfree);
+        /*printf("reloc %s type %d ",yasm_symrec_get_name(reloc.reloc.sym),reloc.type);*/
+        yasm_section_add_reloc(info->sect, &reloc.reloc, sizeof(macho_reloc));
     }
 
+    intn = info->intn;
     if (intn_minus <= intn_plus)
-        intn = yasm_intnum_create_uint(intn_plus-intn_minus);
+        yasm_intnum_set_uint(intn, intn_plus-intn_minus);
     else {
-        intn = yasm_intnum_create_uint(intn_minus-intn_plus);
+        yasm_intnum_set_uint(intn, intn_minus-intn_plus);
         yasm_intnum_calc(intn, YASM_EXPR_NEG, NULL);
     }
 
@@ -562,17 +559,14 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
         if (!intn2) {
             yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                            N_("macho: relocation too complex"));
-            yasm_intnum_destroy(intn);
             return 1;
         }
         yasm_intnum_calc(intn, YASM_EXPR_ADD, intn2);
     }
 
-    retval = yasm_arch_intnum_tobytes(info->object->arch, intn, buf, destsize,
-                                      valsize, 0, bc, warn);
     /*printf("val %ld\n",yasm_intnum_get_int(intn));*/
-    yasm_intnum_destroy(intn);
-    return retval;
+    return yasm_arch_intnum_tobytes(info->object->arch, intn, buf, destsize,
+                                    valsize, 0, bc, warn);
 }
 
 static int
@@ -582,9 +576,18 @@ macho_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
     /*@null@*/ /*@only@*/ unsigned char *bigbuf;
     unsigned long size = REGULAR_OUTBUF_SIZE;
     int gap;
+    /*@null@*/ /*@dependent@*/ yasm_incfile *incfile;
+    unsigned long offset;
 
     assert(info != NULL);
 
+    /* Copy included binary files straight from the file */
+    incfile = yasm_bc_get_incbin(bc, &offset);
+    if (incfile && bc->len > 0) {
+        yasm_outsink_write_file(info->sink, incfile, offset, bc->len);
+        return 0;
+    }
+
     bigbuf = yasm_bc_tobytes(bc, info->buf, &size, &gap, info,
                              macho_objfmt_output_value, NULL);
 
@@ -605,13 +608,14 @@ macho_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
         memset(info->buf, 0, REGULAR_OUTBUF_SIZE);
         left = size;
         while (left > REGULAR_OUTBUF_SIZE) {
-            fwrite(info->buf, REGULAR_OUTBUF_SIZE, 1, info->f);
+            yasm_outsink_write(info->sink, info->buf, REGULAR_OUTBUF_SIZE);
             left -= REGULAR_OUTBUF_SIZE;
         }
-        fwrite(info->buf, left, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, left);
     } else {
         /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : info->buf, (size_t) size, 1, info->f);
+        yasm_outsink_write(info->sink, bigbuf ? bigbuf : info->buf,
+                           (size_t) size);
     }
 
     /* If bigbuf was allocated, free it */
@@ -647,17 +651,25 @@ macho_objfmt_output_relocs(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ macho_objfmt_output_info *info = (macho_objfmt_output_info *)d;
     /*@dependent@*/ /*@null@*/ macho_section_data *msd;
-    macho_reloc *reloc;
+    macho_reloc *relocs;
+    unsigned long nreloc, i;
+    unsigned char *relbuf, *localbuf;
 
-    reloc = (macho_reloc *)yasm_section_relocs_first(sect);
-    while (reloc) {
-        unsigned char *localbuf = info->buf;
+    relocs = (macho_reloc *)yasm_section_relocs(sect, &nreloc);
+    if (!relocs)
+        return 0;
+
+    /* Encode all the relocations, then write them at once */
+    relbuf = yasm_xmalloc(nreloc*8);
+    localbuf = relbuf;
+    for (i=0; i<nreloc; i++) {
+        macho_reloc *reloc = &relocs[i];
         /*@null@*/ macho_symrec_data *xsymd;
         unsigned long symnum;
 
         xsymd = yasm_symrec_get_data(reloc->reloc.sym, &macho_symrec_data_cb);
-        yasm_intnum_get_sized(reloc->reloc.addr, localbuf, 4, 32, 0, 0, 0);
-        localbuf += 4;          /* address of relocation */
+        /* address of relocation */
+        YASM_WRITE_32_L(localbuf, reloc->reloc.addr);
 
         if (reloc->ext)
             symnum = xsymd->index;
@@ -677,9 +689,9 @@ macho_objfmt_output_relocs(yasm_section *sect, /*@null@*/ void *d)
                         (((unsigned long)reloc->length & 3) << 25) |
                         (((unsigned long)reloc->ext & 1) << 27) |
                         (((unsigned long)reloc->type & 0xf) << 28));
-        fwrite(info->buf, 8, 1, info->f);
-        reloc = (macho_reloc *)yasm_section_reloc_next((yasm_reloc *)reloc);
     }
+    yasm_outsink_write(info->sink, relbuf, nreloc*8);
+    yasm_xfree(relbuf);
 
     return 0;
 }
@@ -784,9 +796,9 @@ macho_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
     YASM_WRITE_32_L(localbuf, 0);       /* reserved 2 */
 
     if (info->is_64)
-        fwrite(info->buf, MACHO_SECTCMD64_SIZE, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, MACHO_SECTCMD64_SIZE);
     else
-        fwrite(info->buf, MACHO_SECTCMD_SIZE, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, MACHO_SECTCMD_SIZE);
 
     return 0;
 }
@@ -815,9 +827,7 @@ macho_objfmt_count_sym(yasm_symrec *sym, /*@null@*/ void *d)
 
             name = yasm_symrec_get_global_name(sym, info->object);
             /*printf("%s\n",name); */
-            /* name length + delimiter */
-            sym_data->length = (unsigned long)strlen(name) + 1;
-            info->strlength += sym_data->length;
+            sym_data->strtab_name = yasm_strtab_add(info->strtab, name);
             info->indx++;
             yasm_xfree(name);
         }
@@ -944,7 +954,9 @@ macho_objfmt_output_symtable(yasm_symrec *sym, /*@null@*/ void *d)
         }
 
         localbuf = info->buf;
-        YASM_WRITE_32_L(localbuf, info->indx);  /* offset in string table */
+        /* offset in string table */
+        YASM_WRITE_32_L(localbuf,
+                        yasm_strtab_offset(info->strtab, symd->strtab_name));
         YASM_WRITE_8(localbuf, n_type); /* type of symbol entry */
         n_sect = (scnum >= 0) ? scnum + 1 : NO_SECT;
         YASM_WRITE_8(localbuf, n_sect); /* referring section where symbol is found */
@@ -956,40 +968,13 @@ macho_objfmt_output_symtable(yasm_symrec *sym, /*@null@*/ void *d)
         else
             yasm_intnum_destroy(val);
 
-        info->indx += symd->length;
-
-        fwrite(info->buf, 8 + long_int_bytes, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, 8 + long_int_bytes);
     }
 
     return 0;
 }
 
 
-static int
-macho_objfmt_output_str(yasm_symrec *sym, /*@null@*/ void *d)
-{
-    /*@null@*/ macho_objfmt_output_info *info = (macho_objfmt_output_info *)d;
-    yasm_sym_vis vis = yasm_symrec_get_visibility(sym);
-    /*@null@*/ macho_symrec_data *xsymd;
-
-
-    assert(info != NULL);
-
-    if (info->all_syms ||
-        vis & (YASM_SYM_GLOBAL | YASM_SYM_COMMON | YASM_SYM_EXTERN)) {
-        if (0 == macho_objfmt_is_section_label(sym)) {
-            /*@only@*/ char *name =
-                yasm_symrec_get_global_name(sym, info->object);
-            size_t len = strlen(name);
-
-            xsymd = yasm_symrec_get_data(sym, &macho_symrec_data_cb);
-            fwrite(name, len + 1, 1, info->f);
-            yasm_xfree(name);
-        }
-    }
-    return 0;
-}
-
 static int
 macho_objfmt_calc_sectsize(yasm_section *sect, /*@null@ */ void *d)
 {
@@ -1028,13 +1013,14 @@ macho_objfmt_calc_sectsize(yasm_section *sect, /*@null@ */ void *d)
 
 /* write object */
 static void
-macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
+macho_objfmt_output(yasm_object *object, yasm_outsink *sink, int all_syms,
                     yasm_errwarns *errwarns)
 {
     yasm_objfmt_macho *objfmt_macho = (yasm_objfmt_macho *)object->objfmt;
     macho_objfmt_output_info info;
-    unsigned char *localbuf;
+    unsigned char *localbuf, *strtab;
     unsigned long symtab_count = 0;
+    unsigned long strtab_size;
     unsigned long headsize;
     unsigned int macho_segcmdsize, macho_sectcmdsize, macho_nlistsize;
     unsigned int macho_relinfosize, macho_segcmd;
@@ -1047,7 +1033,7 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     info.object = object;
     info.objfmt_macho = objfmt_macho;
     info.errwarns = errwarns;
-    info.f = f;
+    info.sink = sink;
     info.buf = yasm_xmalloc(REGULAR_OUTBUF_SIZE);
 
     if (objfmt_macho->parse_scnum == 0) {
@@ -1090,14 +1076,17 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     /* Get number of symbols */
     info.symindex = 0;
     info.indx = 0;
-    info.strlength = 1;         /* string table starts with a zero byte */
+    /* string table starts with a zero byte */
+    info.strtab = yasm_strtab_create(1);
     info.all_syms = all_syms || info.is_64;
     /*info.all_syms = 1;                * force all syms into symbol table */
     yasm_symtab_traverse(object->symtab, &info, macho_objfmt_count_sym);
     symtab_count = info.indx;
+    strtab = yasm_strtab_finalize(info.strtab, object->strtab_tail_merge,
+                                  &strtab_size);
 
     /* write raw section data first */
-    if (fseek(f, (long)headsize, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, (long)headsize) < 0) {
         yasm__fatal(N_("could not seek on output file"));
         /*@notreached@ */
         return;
@@ -1112,12 +1101,14 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     yasm_object_sections_traverse(object, &info, macho_objfmt_calc_sectsize);
 
     /* output sections to file */
+    info.intn = yasm_intnum_create_uint(0);
     yasm_object_sections_traverse(object, &info, macho_objfmt_output_section);
+    yasm_intnum_destroy(info.intn);
 
-    fileoff_sections = ftell(f);
+    fileoff_sections = yasm_outsink_tell(sink);
 
     /* Write headers */
-    if (fseek(f, 0, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, 0) < 0) {
         yasm__fatal(N_("could not seek on output file"));
         /*@notreached@*/
         return;
@@ -1202,7 +1193,7 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     YASM_WRITE_32_L(localbuf, 0);       /* no flags */
 
     /* write MACH-O header and segment command to outfile */
-    fwrite(info.buf, (size_t) (localbuf - info.buf), 1, f);
+    yasm_outsink_write(sink, info.buf, (size_t) (localbuf - info.buf));
 
     /* next: section headers */
     /* offset to relocs for first section */
@@ -1220,15 +1211,15 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
 
     YASM_WRITE_32_L(localbuf, macho_nlistsize * symtab_count + info.rel_base +
                     info.s_reloff);     /* string table offset */
-    YASM_WRITE_32_L(localbuf, info.strlength);  /* string table size */
+    YASM_WRITE_32_L(localbuf, strtab_size);     /* string table size */
     /* write symbol command */
-    fwrite(info.buf, (size_t)(localbuf - info.buf), 1, f);
+    yasm_outsink_write(sink, info.buf, (size_t)(localbuf - info.buf));
 
     /*printf("num symbols %d, vmsize %d, filesize %d\n",symtab_count,
       info.vmsize, info.filesize ); */
 
     /* get back to end of raw section data */
-    if (fseek(f, (long)fileoff_sections, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, (long)fileoff_sections) < 0) {
         yasm__fatal(N_("could not seek on output file"));
         /*@notreached@*/
         return;
@@ -1236,20 +1227,19 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
 
     /* padding to long boundary */
     if ((info.rel_base - fileoff_sections) > 0) {
-        fwrite(pad_data, info.rel_base - fileoff_sections, 1, f);
+        yasm_outsink_write(sink, pad_data, info.rel_base - fileoff_sections);
     }
 
     /* relocation data */
     yasm_object_sections_traverse(object, &info, macho_objfmt_output_relocs);
 
     /* symbol table (NLIST) */
-    info.indx = 1;              /* restart symbol table indices */
     yasm_symtab_traverse(object->symtab, &info, macho_objfmt_output_symtable);
 
     /* symbol strings */
-    fwrite(pad_data, 1, 1, f);
-    yasm_symtab_traverse(object->symtab, &info, macho_objfmt_output_str);
+    yasm_outsink_write(sink, strtab, strtab_size);
 
+    yasm_strtab_destroy(info.strtab);
     yasm_intnum_destroy(val);
     yasm_xfree(info.buf);
 }
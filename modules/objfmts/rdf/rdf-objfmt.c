@@ -118,7 +118,7 @@ typedef struct rdf_objfmt_output_info {
     yasm_object *object;
     yasm_objfmt_rdf *objfmt_rdf;
     yasm_errwarns *errwarns;
-    /*@dependent@*/ FILE *f;
+    /*@dependent@*/ yasm_outsink *sink;
     /*@only@*/ unsigned char *buf;
     yasm_section *sect;
     /*@dependent@*/ rdf_section_data *rsd;
@@ -225,25 +225,24 @@ rdf_objfmt_output_value(yasm_value *value, unsigned char *buf,
     intn_minus = 0;
     intn_plus = 0;
     if (value->rel) {
-        rdf_reloc *reloc;
+        rdf_reloc reloc;
         /*@null@*/ rdf_symrec_data *rsymd;
         /*@dependent@*/ yasm_bytecode *precbc;
 
-        reloc = yasm_xmalloc(sizeof(rdf_reloc));
-        reloc->reloc.addr = yasm_intnum_create_uint(bc->offset + offset);
-        reloc->reloc.sym = value->rel;
-        reloc->size = valsize/8;
+        reloc.reloc.addr = bc->offset + offset;
+        reloc.reloc.sym = value->rel;
+        reloc.size = valsize/8;
 
         if (value->seg_of)
-            reloc->type = RDF_RELOC_SEG;
+            reloc.type = RDF_RELOC_SEG;
         else if (value->curpos_rel) {
-            reloc->type = RDF_RELOC_REL;
+            reloc.type = RDF_RELOC_REL;
             /* Adjust to start of section, so subtract out the bytecode
              * offset.
              */
             intn_minus = bc->offset;
         } else
-            reloc->type = RDF_RELOC_NORM;
+            reloc.type = RDF_RELOC_NORM;
 
         if (yasm_symrec_get_label(value->rel, &precbc)) {
             /* local, set the value to be the offset, and the refseg to the
@@ -256,19 +255,19 @@ rdf_objfmt_output_value(yasm_value *value, unsigned char *buf,
             csectd = yasm_section_get_data(sect, &rdf_section_data_cb);
             if (!csectd)
                 yasm_internal_error(N_("didn't understand section"));
-            reloc->refseg = csectd->scnum;
+            reloc.refseg = csectd->scnum;
             intn_plus = yasm_bc_next_offset(precbc);
         } else {
             /* must be common/external */
-            rsymd = yasm_symrec_get_data(reloc->reloc.sym,
+            rsymd = yasm_symrec_get_data(reloc.reloc.sym,
                                          &rdf_symrec_data_cb);
             if (!rsymd)
                 yasm_internal_error(
                     N_("rdf: no symbol data for relocated symbol"));
-            reloc->refseg = rsymd->segment;
+            reloc.refseg = rsymd->segment;
         }
 
-        yasm_section_add_reloc(info->sect, (yasm_reloc *)reloc, yasm_xfree);
+        yasm_section_add_reloc(info->sect, &reloc.reloc, sizeof(rdf_reloc));
     }
 
     if (intn_minus > 0) {
@@ -382,7 +381,9 @@ rdf_objfmt_output_section_reloc(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ rdf_objfmt_output_info *info = (rdf_objfmt_output_info *)d;
     /*@dependent@*/ /*@null@*/ rdf_section_data *rsd;
-    rdf_reloc *reloc;
+    rdf_reloc *relocs;
+    unsigned long nreloc, i;
+    unsigned char *relbuf, *localbuf;
 
     assert(info != NULL);
     rsd = yasm_section_get_data(sect, &rdf_section_data_cb);
@@ -397,9 +398,15 @@ rdf_objfmt_output_section_reloc(yasm_section *sect, /*@null@*/ void *d)
     if (rsd->size == 0)
         return 0;
 
-    reloc = (rdf_reloc *)yasm_section_relocs_first(sect);
-    while (reloc) {
-        unsigned char *localbuf = info->buf;
+    relocs = (rdf_reloc *)yasm_section_relocs(sect, &nreloc);
+    if (!relocs)
+        return 0;
+
+    /* Encode all the relocation records, then write them at once */
+    relbuf = yasm_xmalloc(nreloc*10);
+    localbuf = relbuf;
+    for (i=0; i<nreloc; i++) {
+        rdf_reloc *reloc = &relocs[i];
 
         if (reloc->type == RDF_RELOC_SEG)
             YASM_WRITE_8(localbuf, RDFREC_SEGRELOC);
@@ -409,14 +416,13 @@ rdf_objfmt_output_section_reloc(yasm_section *sect, /*@null@*/ void *d)
         /* Section number, +0x40 if relative reloc */
         YASM_WRITE_8(localbuf, rsd->scnum +
                      (reloc->type == RDF_RELOC_REL ? 0x40 : 0));
-        yasm_intnum_get_sized(reloc->reloc.addr, localbuf, 4, 32, 0, 0, 0);
-        localbuf += 4;                          /* offset of relocation */
+        /* offset of relocation */
+        YASM_WRITE_32_L(localbuf, reloc->reloc.addr);
         YASM_WRITE_8(localbuf, reloc->size);        /* size of relocation */
         YASM_WRITE_16_L(localbuf, reloc->refseg);   /* relocated symbol */
-        fwrite(info->buf, 10, 1, info->f);
-
-        reloc = (rdf_reloc *)yasm_section_reloc_next((yasm_reloc *)reloc);
     }
+    yasm_outsink_write(info->sink, relbuf, nreloc*10);
+    yasm_xfree(relbuf);
 
     return 0;
 }
@@ -447,10 +453,10 @@ rdf_objfmt_output_section_file(yasm_section *sect, /*@null@*/ void *d)
     YASM_WRITE_16_L(localbuf, rsd->scnum);      /* number */
     YASM_WRITE_16_L(localbuf, rsd->reserved);   /* reserved */
     YASM_WRITE_32_L(localbuf, rsd->size);       /* length */
-    fwrite(info->buf, 10, 1, info->f);
+    yasm_outsink_write(info->sink, info->buf, 10);
 
     /* Section data */
-    fwrite(rsd->raw_data, rsd->size, 1, info->f);
+    yasm_outsink_write(info->sink, rsd->raw_data, rsd->size);
 
     /* Free section data */
     yasm_xfree(rsd->raw_data);
@@ -656,14 +662,14 @@ rdf_objfmt_output_sym(yasm_symrec *sym, /*@null@*/ void *d)
     YASM_WRITE_8(localbuf, 0);          /* 0-terminated name */
     yasm_xfree(name);
 
-    fwrite(info->buf, (unsigned long)(localbuf-info->buf), 1, info->f);
+    yasm_outsink_write(info->sink, info->buf, (size_t)(localbuf-info->buf));
 
     yasm_errwarn_propagate(info->errwarns, yasm_symrec_get_decl_line(sym));
     return 0;
 }
 
 static void
-rdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
+rdf_objfmt_output(yasm_object *object, yasm_outsink *sink, int all_syms,
                   yasm_errwarns *errwarns)
 {
     yasm_objfmt_rdf *objfmt_rdf = (yasm_objfmt_rdf *)object->objfmt;
@@ -676,12 +682,12 @@ rdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     info.object = object;
     info.objfmt_rdf = objfmt_rdf;
     info.errwarns = errwarns;
-    info.f = f;
+    info.sink = sink;
     info.buf = yasm_xmalloc(REGULAR_OUTBUF_SIZE);
     info.bss_size = 0;
 
     /* Allocate space for file header by seeking forward */
-    if (fseek(f, (long)strlen(RDF_MAGIC)+8, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, (long)strlen(RDF_MAGIC)+8) < 0) {
         yasm__fatal(N_("could not seek on output file"));
         /*@notreached@*/
         return;
@@ -694,8 +700,8 @@ rdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
         localbuf = info.buf;
         YASM_WRITE_8(localbuf, RDFREC_MODNAME);         /* record type */
         YASM_WRITE_8(localbuf, len);                    /* record length */
-        fwrite(info.buf, 2, 1, f);
-        fwrite(cur->str, len, 1, f);
+        yasm_outsink_write(sink, info.buf, 2);
+        yasm_outsink_write(sink, cur->str, len);
         cur = STAILQ_NEXT(cur, link);
     }
 
@@ -705,8 +711,8 @@ rdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
         localbuf = info.buf;
         YASM_WRITE_8(localbuf, RDFREC_DLL);             /* record type */
         YASM_WRITE_8(localbuf, len);                    /* record length */
-        fwrite(info.buf, 2, 1, f);
-        fwrite(cur->str, len, 1, f);
+        yasm_outsink_write(sink, info.buf, 2);
+        yasm_outsink_write(sink, cur->str, len);
         cur = STAILQ_NEXT(cur, link);
     }
 
@@ -741,11 +747,11 @@ rdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
         YASM_WRITE_8(localbuf, RDFREC_BSS);             /* record type */
         YASM_WRITE_8(localbuf, 4);                      /* record length */
         YASM_WRITE_32_L(localbuf, info.bss_size);       /* total BSS size */
-        fwrite(info.buf, 6, 1, f);
+        yasm_outsink_write(sink, info.buf, 6);
     }
 
     /* Determine header length */
-    headerlen = ftell(f);
+    headerlen = yasm_outsink_tell(sink);
     if (headerlen == -1) {
         yasm__fatal(N_("could not get file position on output file"));
         /*@notreached@*/
@@ -759,10 +765,10 @@ rdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
 
     /* NULL section to end file */
     memset(info.buf, 0, 10);
-    fwrite(info.buf, 10, 1, f);
+    yasm_outsink_write(sink, info.buf, 10);
 
     /* Determine object length */
-    filelen = ftell(f);
+    filelen = yasm_outsink_tell(sink);
     if (filelen == -1) {
         yasm__fatal(N_("could not get file position on output file"));
         /*@notreached@*/
@@ -770,17 +776,17 @@ rdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     }
 
     /* Write file header */
-    if (fseek(f, 0, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, 0) < 0) {
         yasm__fatal(N_("could not seek on output file"));
         /*@notreached@*/
         return;
     }
 
-    fwrite(RDF_MAGIC, strlen(RDF_MAGIC), 1, f);
+    yasm_outsink_write(sink, RDF_MAGIC, strlen(RDF_MAGIC));
     localbuf = info.buf;
     YASM_WRITE_32_L(localbuf, filelen-10);              /* object size */
     YASM_WRITE_32_L(localbuf, headerlen-14);            /* header size */
-    fwrite(info.buf, 8, 1, f);
+    yasm_outsink_write(sink, info.buf, 8);
 
     yasm_xfree(info.buf);
 }
@@ -89,7 +89,7 @@ typedef struct xdf_objfmt_output_info {
     yasm_object *object;
     yasm_objfmt_xdf *objfmt_xdf;
     yasm_errwarns *errwarns;
-    /*@dependent@*/ FILE *f;
+    /*@dependent@*/ yasm_outsink *sink;
     /*@only@*/ unsigned char *buf;
     yasm_section *sect;
     /*@dependent@*/ xdf_section_data *xsd;
@@ -183,30 +183,29 @@ xdf_objfmt_output_value(yasm_value *value, unsigned char *buf,
 
     intn_minus = 0;
     if (value->rel) {
-        xdf_reloc *reloc;
+        xdf_reloc reloc;
 
-        reloc = yasm_xmalloc(sizeof(xdf_reloc));
-        reloc->reloc.addr = yasm_intnum_create_uint(bc->offset + offset);
-        reloc->reloc.sym = value->rel;
-        reloc->base = NULL;
-        reloc->size = valsize/8;
-        reloc->shift = value->rshift;
+        reloc.reloc.addr = bc->offset + offset;
+        reloc.reloc.sym = value->rel;
+        reloc.base = NULL;
+        reloc.size = valsize/8;
+        reloc.shift = value->rshift;
 
         if (value->seg_of)
-            reloc->type = XDF_RELOC_SEG;
+            reloc.type = XDF_RELOC_SEG;
         else if (value->wrt) {
-            reloc->base = value->wrt;
-            reloc->type = XDF_RELOC_WRT;
+            reloc.base = value->wrt;
+            reloc.type = XDF_RELOC_WRT;
         } else if (value->curpos_rel) {
-            reloc->type = XDF_RELOC_RIP;
+            reloc.type = XDF_RELOC_RIP;
             /* Adjust to start of section, so subtract out the bytecode
              * offset.
              */
             intn_minus = bc->offset;
         } else
-            reloc->type = XDF_RELOC_REL;
+            reloc.type = XDF_RELOC_REL;
         info->xsd->nreloc++;
-        yasm_section_add_reloc(info->sect, (yasm_reloc *)reloc, yasm_xfree);
+        yasm_section_add_reloc(info->sect, &reloc.reloc, sizeof(xdf_reloc));
     }
 
     if (intn_minus > 0) {
@@ -239,9 +238,19 @@ xdf_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
     /*@null@*/ /*@only@*/ unsigned char *bigbuf;
     unsigned long size = REGULAR_OUTBUF_SIZE;
     int gap;
+    /*@null@*/ /*@dependent@*/ yasm_incfile *incfile;
+    unsigned long offset;
 
     assert(info != NULL);
 
+    /* Copy included binary files straight from the file */
+    incfile = yasm_bc_get_incbin(bc, &offset);
+    if (incfile && bc->len > 0) {
+        info->xsd->size += bc->len;
+        yasm_outsink_write_file(info->sink, incfile, offset, bc->len);
+        return 0;
+    }
+
     bigbuf = yasm_bc_tobytes(bc, info->buf, &size, &gap, info,
                              xdf_objfmt_output_value, NULL);
 
@@ -263,13 +272,14 @@ xdf_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
         memset(info->buf, 0, REGULAR_OUTBUF_SIZE);
         left = size;
         while (left > REGULAR_OUTBUF_SIZE) {
-            fwrite(info->buf, REGULAR_OUTBUF_SIZE, 1, info->f);
+            yasm_outsink_write(info->sink, info->buf, REGULAR_OUTBUF_SIZE);
             left -= REGULAR_OUTBUF_SIZE;
         }
-        fwrite(info->buf, left, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, left);
     } else {
         /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : info->buf, (size_t)size, 1, info->f);
+        yasm_outsink_write(info->sink, bigbuf ? bigbuf : info->buf,
+                           (size_t)size);
     }
 
     /* If bigbuf was allocated, free it */
@@ -285,7 +295,9 @@ xdf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     /*@null@*/ xdf_objfmt_output_info *info = (xdf_objfmt_output_info *)d;
     /*@dependent@*/ /*@null@*/ xdf_section_data *xsd;
     long pos;
-    xdf_reloc *reloc;
+    xdf_reloc *relocs;
+    unsigned long nreloc, i;
+    unsigned char *relbuf, *localbuf;
 
     assert(info != NULL);
     xsd = yasm_section_get_data(sect, &xdf_section_data_cb);
@@ -298,7 +310,7 @@ xdf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
         pos = 0;    /* position = 0 because it's not in the file */
         xsd->size = yasm_bc_next_offset(yasm_section_bcs_last(sect));
     } else {
-        pos = ftell(info->f);
+        pos = yasm_outsink_tell(info->sink);
         if (pos == -1) {
             yasm__fatal(N_("could not get file position on output file"));
             /*@notreached@*/
@@ -326,7 +338,7 @@ xdf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     if (xsd->nreloc == 0)
         return 0;
 
-    pos = ftell(info->f);
+    pos = yasm_outsink_tell(info->sink);
     if (pos == -1) {
         yasm__fatal(N_("could not get file position on output file"));
         /*@notreached@*/
@@ -334,9 +346,12 @@ xdf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     }
     xsd->relptr = (unsigned long)pos;
 
-    reloc = (xdf_reloc *)yasm_section_relocs_first(sect);
-    while (reloc) {
-        unsigned char *localbuf = info->buf;
+    /* Encode all the relocations, then write them at once */
+    relocs = (xdf_reloc *)yasm_section_relocs(sect, &nreloc);
+    relbuf = yasm_xmalloc(nreloc*16);
+    localbuf = relbuf;
+    for (i=0; i<nreloc; i++) {
+        xdf_reloc *reloc = &relocs[i];
         /*@null@*/ xdf_symrec_data *xsymd;
 
         xsymd = yasm_symrec_get_data(reloc->reloc.sym, &xdf_symrec_data_cb);
@@ -344,8 +359,8 @@ xdf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
             yasm_internal_error(
                 N_("xdf: no symbol data for relocated symbol"));
 
-        yasm_intnum_get_sized(reloc->reloc.addr, localbuf, 4, 32, 0, 0, 0);
-        localbuf += 4;                          /* address of relocation */
+        /* address of relocation */
+        YASM_WRITE_32_L(localbuf, reloc->reloc.addr);
         YASM_WRITE_32_L(localbuf, xsymd->index);    /* relocated symbol */
         if (reloc->base) {
             xsymd = yasm_symrec_get_data(reloc->base, &xdf_symrec_data_cb);
@@ -363,10 +378,9 @@ xdf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
         YASM_WRITE_8(localbuf, reloc->size);        /* size of relocation */
         YASM_WRITE_8(localbuf, reloc->shift);       /* relocation shift */
         YASM_WRITE_8(localbuf, 0);                  /* flags */
-        fwrite(info->buf, 16, 1, info->f);
-
-        reloc = (xdf_reloc *)yasm_section_reloc_next((yasm_reloc *)reloc);
     }
+    yasm_outsink_write(info->sink, relbuf, nreloc*16);
+    yasm_xfree(relbuf);
 
     return 0;
 }
@@ -413,7 +427,7 @@ xdf_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
     YASM_WRITE_32_L(localbuf, xsd->size);       /* section size */
     YASM_WRITE_32_L(localbuf, xsd->relptr);     /* file ptr to relocs */
     YASM_WRITE_32_L(localbuf, xsd->nreloc); /* num of relocation entries */
-    fwrite(info->buf, 40, 1, info->f);
+    yasm_outsink_write(info->sink, info->buf, 40);
 
     return 0;
 }
@@ -512,7 +526,7 @@ xdf_objfmt_output_sym(yasm_symrec *sym, /*@null@*/ void *d)
         YASM_WRITE_32_L(localbuf, info->strtab_offset);
         info->strtab_offset += (unsigned long)(len+1);
         YASM_WRITE_32_L(localbuf, flags);       /* flags */
-        fwrite(info->buf, 16, 1, info->f);
+        yasm_outsink_write(info->sink, info->buf, 16);
         yasm_xfree(name);
     }
     return 0;
@@ -529,14 +543,14 @@ xdf_objfmt_output_str(yasm_symrec *sym, /*@null@*/ void *d)
     if (info->all_syms || vis != YASM_SYM_LOCAL) {
         /*@only@*/ char *name = yasm_symrec_get_global_name(sym, info->object);
         size_t len = strlen(name);
-        fwrite(name, len+1, 1, info->f);
+        yasm_outsink_write(info->sink, name, len+1);
         yasm_xfree(name);
     }
     return 0;
 }
 
 static void
-xdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
+xdf_objfmt_output(yasm_object *object, yasm_outsink *sink, int all_syms,
                   yasm_errwarns *errwarns)
 {
     yasm_objfmt_xdf *objfmt_xdf = (yasm_objfmt_xdf *)object->objfmt;
@@ -547,11 +561,11 @@ xdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     info.object = object;
     info.objfmt_xdf = objfmt_xdf;
     info.errwarns = errwarns;
-    info.f = f;
+    info.sink = sink;
     info.buf = yasm_xmalloc(REGULAR_OUTBUF_SIZE);
 
     /* Allocate space for headers by seeking forward */
-    if (fseek(f, (long)(16+40*(objfmt_xdf->parse_scnum)), SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, (long)(16+40*(objfmt_xdf->parse_scnum))) < 0) {
         yasm__fatal(N_("could not seek on output file"));
         /*@notreached@*/
         return;
@@ -578,7 +592,7 @@ xdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
         return;
 
     /* Write headers */
-    if (fseek(f, 0, SEEK_SET) < 0) {
+    if (yasm_outsink_seek(sink, 0) < 0) {
         yasm__fatal(N_("could not seek on output file"));
         /*@notreached@*/
         return;
@@ -590,7 +604,7 @@ xdf_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     YASM_WRITE_32_L(localbuf, symtab_count);            /* number of symtabs */
     /* size of sect headers + symbol table + strings */
     YASM_WRITE_32_L(localbuf, info.strtab_offset-16);
-    fwrite(info.buf, 16, 1, f);
+    yasm_outsink_write(sink, info.buf, 16);
 
     yasm_object_sections_traverse(object, &info, xdf_objfmt_output_secthead);
 
@@ -48,7 +48,8 @@ static void cpp_line_marker(yasm_parser_gas *parser_gas);
 static void nasm_line_marker(yasm_parser_gas *parser_gas);
 static yasm_bytecode *parse_instr(yasm_parser_gas *parser_gas);
 static int parse_dirvals(yasm_parser_gas *parser_gas, yasm_valparamhead *vps);
-static int parse_datavals(yasm_parser_gas *parser_gas, yasm_datavalhead *dvs);
+static int parse_datavals(yasm_parser_gas *parser_gas, yasm_datavalhead *dvs,
+                          unsigned int size);
 static int parse_strvals(yasm_parser_gas *parser_gas, yasm_datavalhead *dvs);
 static yasm_effaddr *parse_memaddr(yasm_parser_gas *parser_gas);
 static yasm_insn_operand *parse_operand(yasm_parser_gas *parser_gas);
@@ -622,7 +623,7 @@ static yasm_bytecode *
 dir_data(yasm_parser_gas *parser_gas, unsigned int size)
 {
     yasm_datavalhead dvs;
-    if (!parse_datavals(parser_gas, &dvs))
+    if (!parse_datavals(parser_gas, &dvs, size))
         return NULL;
     return yasm_bc_create_data(&dvs, size, 0, p_object->arch, cur_line);
 }
@@ -631,7 +632,7 @@ static yasm_bytecode *
 dir_leb128(yasm_parser_gas *parser_gas, unsigned int sign)
 {
     yasm_datavalhead dvs;
-    if (!parse_datavals(parser_gas, &dvs))
+    if (!parse_datavals(parser_gas, &dvs, 0))
         return NULL;
     return yasm_bc_create_leb128(&dvs, (int)sign, cur_line);
 }
@@ -910,12 +911,12 @@ parse_instr(yasm_parser_gas *parser_gas)
     if (parser_gas->intel_syntax) {
         bc = parse_instr_intel(parser_gas);
         if (bc) {
-            yasm_warn_disable(YASM_WARN_UNREC_CHAR);
+            yasm_warn_suppress(YASM_WARN_UNREC_CHAR);
              do {
                 destroy_curtok();
                 get_next_token();
             } while (!is_eol());
-            yasm_warn_enable(YASM_WARN_UNREC_CHAR);
+            yasm_warn_unsuppress(YASM_WARN_UNREC_CHAR);
         }
         return bc;
     }
@@ -1057,8 +1058,12 @@ parse_dirvals(yasm_parser_gas *parser_gas, yasm_valparamhead *vps)
     return num;
 }
 
+/* Parse a list of data values.  If size is nonzero, plain numbers are
+ * converted directly to size-byte values (see yasm_dvs_append_intnum()).
+ */
 static int
-parse_datavals(yasm_parser_gas *parser_gas, yasm_datavalhead *dvs)
+parse_datavals(yasm_parser_gas *parser_gas, yasm_datavalhead *dvs,
+               unsigned int size)
 {
     yasm_expr *e;
     yasm_dataval *dv;
@@ -1067,6 +1072,21 @@ parse_datavals(yasm_parser_gas *parser_gas, yasm_datavalhead *dvs)
     yasm_dvs_initialize(dvs);
 
     for (;;) {
+        if (size > 0 && curtok == INTNUM) {
+            get_peek_token(parser_gas);
+            if (parser_gas->peek_token == ','
+                || is_eol_tok(parser_gas->peek_token)) {
+                yasm_dvs_append_intnum(dvs, INTNUM_val, size,
+                                       p_object->arch);
+                yasm_intnum_destroy(INTNUM_val);
+                get_next_token(); /* INTNUM */
+                num++;
+                if (curtok != ',')
+                    break;
+                get_next_token(); /* ',' */
+                continue;
+            }
+        }
         e = parse_expr(parser_gas);
         if (!e) {
             yasm_dvs_delete(dvs);
@@ -1749,9 +1769,16 @@ gas_parser_parse(yasm_parser_gas *parser_gas)
 
         yasm_errwarn_propagate(parser_gas->errwarns, cur_line);
 
-        temp_bc = yasm_section_bcs_append(cursect, bc);
-        if (temp_bc)
-            parser_gas->prev_bc = temp_bc;
+        if (bc && parser_gas->data_bc &&
+            yasm_bc_data_merge(parser_gas->data_bc, bc))
+            temp_bc = parser_gas->data_bc;
+        else {
+            temp_bc = yasm_section_bcs_append(cursect, bc);
+            if (temp_bc)
+                parser_gas->prev_bc = temp_bc;
+        }
+        if (parser_gas->merge_data)
+            parser_gas->data_bc = temp_bc;
         if (curtok == ';')
             continue;       /* don't advance line number until \n */
         if (parser_gas->save_input)
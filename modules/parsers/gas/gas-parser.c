@@ -61,6 +61,14 @@ gas_parser_do_parse(yasm_object *object, yasm_preproc *pp,
     parser_gas.save_input = save_input;
     parser_gas.save_last = 0;
 
+    /* Lines of constant data can share a bytecode unless their line
+     * numbers are needed for a listing or debug information.
+     */
+    parser_gas.data_bc = NULL;
+    parser_gas.merge_data = !save_input &&
+        yasm__strcasecmp(((yasm_dbgfmt_base *)object->dbgfmt)->module->keyword,
+                         "null") == 0;
+
     parser_gas.peek_token = NONE;
 
     parser_gas.line = NULL;
@@ -94,6 +94,11 @@ typedef struct yasm_parser_gas {
     /*@null@*/ yasm_bytecode *prev_bc;
     yasm_bytecode *temp_bc;
 
+    /* Data bytecode that constant data in the next statement can be added
+     * to */
+    /*@null@*/ yasm_bytecode *data_bc;
+    int merge_data;
+
     int save_input;
     YYCTYPE save_line[2][MAX_SAVED_LINE_LEN];
     int save_last;
@@ -0,0 +1,22 @@
+.macro pair a, ab=7
+.byte \a, \ab
+.endm
+
+.macro pair x
+.byte 0xff
+.endm
+
+.macro body n
+    .rept \n
+    .byte \n
+    .endr
+.endm
+
+.set count, 3
+pair 1
+pair 2, 3
+body 2
+.rept count
+  pair count
+.endr
+.byte count
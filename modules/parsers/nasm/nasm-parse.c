@@ -260,12 +260,17 @@ nasm_parser_parse(yasm_parser_nasm *parser_nasm)
                 yasm_bc_destroy(bc);
             }
             temp_bc = NULL;
+        } else if (bc && parser_nasm->data_bc &&
+                   yasm_bc_data_merge(parser_nasm->data_bc, bc)) {
+            temp_bc = parser_nasm->data_bc;
         } else if (bc) {
             temp_bc = yasm_section_bcs_append(cursect, bc);
             if (temp_bc)
                 parser_nasm->prev_bc = temp_bc;
         } else
             temp_bc = NULL;
+        if (parser_nasm->merge_data)
+            parser_nasm->data_bc = temp_bc;
         yasm_errwarn_propagate(parser_nasm->errwarns, cur_line);
 
         if (parser_nasm->save_input)
@@ -592,6 +597,20 @@ parse_exp(yasm_parser_nasm *parser_nasm)
                         goto dv_done;
                     }
                 }
+                if (curtok == INTNUM) {
+                    /* A plain number can go straight into the output
+                     * bytes, without building an expression for it.
+                     */
+                    get_peek_token(parser_nasm);
+                    if (parser_nasm->peek_token == ','
+                        || is_eol_tok(parser_nasm->peek_token)) {
+                        yasm_dvs_append_intnum(&dvs, INTNUM_val, size,
+                                               p_object->arch);
+                        yasm_intnum_destroy(INTNUM_val);
+                        get_next_token();
+                        goto dv_next;
+                    }
+                }
                 if (curtok == '?') {
                     yasm_dvs_delete(&dvs);
                     get_next_token();
@@ -656,6 +675,7 @@ error:
                     dv = yasm_dv_create_expr(e);
 dv_done:
                 yasm_dvs_append(&dvs, dv);
+dv_next:
                 if (is_eol())
                     break;
                 if (!expect(',')) {
@@ -57,6 +57,10 @@ typedef struct yasm_parser_nasm {
 
     /*@null@*/ yasm_bytecode *prev_bc;
 
+    /* Data bytecode that constant data on the next line can be added to */
+    /*@null@*/ yasm_bytecode *data_bc;
+    int merge_data;
+
     int save_input;
 
     yasm_scanner s;
@@ -53,6 +53,14 @@ nasm_do_parse(yasm_object *object, yasm_preproc *pp, int save_input,
 
     parser_nasm.save_input = save_input;
 
+    /* Lines of constant data can share a bytecode unless their line
+     * numbers are needed for a listing or debug information.
+     */
+    parser_nasm.data_bc = NULL;
+    parser_nasm.merge_data = !save_input &&
+        yasm__strcasecmp(((yasm_dbgfmt_base *)object->dbgfmt)->module->keyword,
+                         "null") == 0;
+
     parser_nasm.peek_token = NONE;
 
     parser_nasm.absstart = NULL;
@@ -113,7 +121,7 @@ tasm_parser_do_parse(yasm_object *object, yasm_preproc *pp,
                      yasm_errwarns *errwarns)
 {
     yasm_symtab_set_case_sensitive(object->symtab, 0);
-    yasm_warn_disable(YASM_WARN_IMPLICIT_SIZE_OVERRIDE);
+    yasm_warn_suppress(YASM_WARN_IMPLICIT_SIZE_OVERRIDE);
     nasm_do_parse(object, pp, save_input, linemap, errwarns, 1);
 }
 
@@ -18,16 +18,17 @@
 #include "gas-eval.h"
 
 /* The assembler symbol table. */
-static yasm_symtab *symtab;
+static YASM_THREAD_LOCAL yasm_symtab *symtab;
 
-static scanner scan;    /* Address of scanner routine */
-static efunc error;     /* Address of error reporting routine */
+static YASM_THREAD_LOCAL scanner scan;   /* Address of scanner routine */
+/* Address of error reporting routine */
+static YASM_THREAD_LOCAL efunc error;
 
-static struct tokenval *tokval;   /* The current token */
-static int i;                     /* The t_type of tokval */
+static YASM_THREAD_LOCAL struct tokenval *tokval;  /* The current token */
+static YASM_THREAD_LOCAL int i;                    /* The t_type of tokval */
 
-static void *scpriv;
-static void *epriv;
+static YASM_THREAD_LOCAL void *scpriv;
+static YASM_THREAD_LOCAL void *epriv;
 
 /*
  * Recursive-descent parser. Called with a single boolean operand,
@@ -67,7 +68,7 @@ static yasm_expr *rexp0(void), *rexp1(void), *rexp2(void), *rexp3(void);
 static yasm_expr *expr0(void), *expr1(void), *expr2(void), *expr3(void);
 static yasm_expr *expr4(void), *expr5(void), *expr6(void);
 
-static yasm_expr *(*bexpr)(void);
+static YASM_THREAD_LOCAL yasm_expr *(*bexpr)(void);
 
 static yasm_expr *rexp0(void) 
 {
@@ -32,15 +32,25 @@
 
 #define FALSE 0
 #define TRUE  1
-#define BSIZE 512
 
 #ifndef MAXPATHLEN
 #define MAXPATHLEN 1024
 #endif
 
+/* Body of a .rept block, replayed count times without copying it out. */
+typedef struct rept_block {
+    long count;         /* repetitions remaining, including the current one */
+    int cur;            /* next line of the current repetition */
+    int num_lines;
+    char **lines;
+    size_t *lengths;
+    int *line_numbers;
+} rept_block;
+
 typedef struct buffered_line {
     char *line;
     int line_number;
+    rept_block *rept;   /* if non-NULL, line is unused */
     SLIST_ENTRY(buffered_line) next;
 } buffered_line;
 
@@ -50,13 +60,34 @@ typedef struct included_file {
     SLIST_ENTRY(included_file) next;
 } included_file;
 
+/* Reference to a parameter within a macro body line: text[start,end) is
+ * replaced by the parameter's argument.
+ */
+typedef struct macro_ref {
+    size_t start, end;
+    int param;
+} macro_ref;
+
+/* Macro body line, split into literal text and parameter references when
+ * the macro is defined.
+ */
+typedef struct macro_line {
+    char *text;
+    size_t length;
+    int num_refs;
+    macro_ref *refs;
+} macro_line;
+
 typedef struct macro_entry {
     char *name;
     int num_params;
-    char **params;
+    char **params;          /* "name" or "name=default" */
     int num_lines;
-    char **lines;
-    STAILQ_ENTRY(macro_entry) next;
+    macro_line *lines;
+
+    /* arguments of the expansion in progress */
+    const char **values;
+    size_t *value_lengths;
 } macro_entry;
 
 typedef struct deferred_define {
@@ -75,6 +106,7 @@ typedef struct yasm_preproc_gas {
     yasm_preproc_base preproc;   /* base structure */
 
     FILE *in;
+    yasm_srcbuf *src;
     char *in_filename;
 
     yasm_symtab *defines;
@@ -89,7 +121,7 @@ typedef struct yasm_preproc_gas {
 
     SLIST_HEAD(buffered_lines_head, buffered_line) buffered_lines;
     SLIST_HEAD(included_files_head, included_file) included_files;
-    STAILQ_HEAD(macros_head, macro_entry) macros;
+    HAMT *macros;
 
     int in_line_number;
     int next_line_number;
@@ -99,6 +131,10 @@ typedef struct yasm_preproc_gas {
     yasm_errwarns *errwarns;
     int fatal_error;
     int detect_errors_only;
+
+    /* statistics (see gas_preproc_get_stats()) */
+    unsigned long macro_expansions;
+    unsigned long rept_expansions;
 } yasm_preproc_gas;
 
 yasm_preproc_module yasm_gas_LTX_preproc;
@@ -192,48 +228,44 @@ static int unquote(const char *arg, char *to, size_t to_size, char q, char expec
 
 /* Line-reading. */
 
-static char *read_line_from_file(yasm_preproc_gas *pp, FILE *file)
+static char *read_line_from_file(yasm_preproc_gas *pp, yasm_srcbuf *src)
 {
-    int bufsize = BSIZE;
+    const char *line;
+    size_t len;
     char *buf;
-    char *p;
-
-    buf = yasm_xmalloc((size_t)bufsize);
 
-    /* Loop to ensure entire line is read (don't want to limit line length). */
-    p = buf;
-    for (;;) {
-        if (!fgets(p, bufsize - (p - buf), file)) {
-            if (ferror(file)) {
-                yasm_error_set(YASM_ERROR_IO, N_("error when reading from file"));
-                yasm_errwarn_propagate(pp->errwarns, pp->current_line_number);
-            }
-            break;
-        }
-        p += strlen(p);
-        if (p > buf && p[-1] == '\n') {
-            break;
-        }
-        if ((p - buf) + 1 >= bufsize) {
-            /* Increase size of buffer */
-            char *oldbuf = buf;
-            bufsize *= 2;
-            buf = yasm_xrealloc(buf, (size_t) bufsize);
-            p = buf + (p - oldbuf);
+    line = yasm_srcbuf_get_line(src, &len);
+    if (!line) {
+        if (yasm_srcbuf_error(src)) {
+            yasm_error_set(YASM_ERROR_IO, N_("error when reading from file"));
+            yasm_errwarn_propagate(pp->errwarns, pp->current_line_number);
         }
-    }
-
-    if (p == buf) {
         /* No data; must be at EOF */
-        yasm_xfree(buf);
         return NULL;
     }
 
+    buf = yasm_xmalloc(len + 1);
+    memcpy(buf, line, len);
+    buf[len] = '\0';
+
     /* Strip the line ending */
     buf[strcspn(buf, "\r\n")] = '\0';
     return buf;
 }
 
+static void rept_block_destroy(rept_block *rept)
+{
+    int i;
+
+    for (i = 0; i < rept->num_lines; i++) {
+        yasm_xfree(rept->lines[i]);
+    }
+    yasm_xfree(rept->lines);
+    yasm_xfree(rept->lengths);
+    yasm_xfree(rept->line_numbers);
+    yasm_xfree(rept);
+}
+
 static char *read_line(yasm_preproc_gas *pp)
 {
     char *line;
@@ -249,19 +281,39 @@ static char *read_line(yasm_preproc_gas *pp)
 
     if (!SLIST_EMPTY(&pp->buffered_lines)) {
         buffered_line *bline = SLIST_FIRST(&pp->buffered_lines);
-        SLIST_REMOVE_HEAD(&pp->buffered_lines, next);
-        line = bline->line;
-        if (bline->line_number != -1) {
-            pp->next_line_number = bline->line_number;
+        rept_block *rept = bline->rept;
+        int line_number;
+
+        if (rept) {
+            /* Copy out the next line of the repeated block. */
+            size_t len = rept->lengths[rept->cur];
+            line = yasm_xmalloc(len + 1);
+            memcpy(line, rept->lines[rept->cur], len + 1);
+            line_number = rept->line_numbers[rept->cur];
+            if (++rept->cur == rept->num_lines) {
+                rept->cur = 0;
+                if (--rept->count == 0) {
+                    SLIST_REMOVE_HEAD(&pp->buffered_lines, next);
+                    rept_block_destroy(rept);
+                    yasm_xfree(bline);
+                }
+            }
+        } else {
+            SLIST_REMOVE_HEAD(&pp->buffered_lines, next);
+            line = bline->line;
+            line_number = bline->line_number;
+            yasm_xfree(bline);
+        }
+        if (line_number != -1) {
+            pp->next_line_number = line_number;
         }
-        yasm_xfree(bline);
         if (!SLIST_EMPTY(&pp->included_files)) {
             SLIST_FIRST(&pp->included_files)->lines_remaining--;
         }
         return line;
     }
 
-    line = read_line_from_file(pp, pp->in);
+    line = read_line_from_file(pp, pp->src);
     if (line) {
         pp->in_line_number++;
         pp->next_line_number = pp->in_line_number;
@@ -449,6 +501,52 @@ static int gas_scan(void *preproc, struct tokenval *tokval)
     return tokval->t_type;
 }
 
+/* Finds the next token in str the way gas_scan() does, but without
+ * evaluating or copying it.  Sets *start and *end to the token's extent
+ * and returns TOKEN_EOS, TOKEN_NUM, TOKEN_ID, or the token's character for
+ * anything else.  (gas_scan()'s two-character operators never start or end
+ * a symbol, so they are returned one character at a time.)
+ */
+static int scan_token(const char *str, const char **start, const char **end)
+{
+    while (isspace(*str)) {
+        str++;
+    }
+    *start = str;
+
+    if (*str == '\0') {
+        *end = str;
+        return TOKEN_EOS;
+    }
+
+    if (isdigit(*str)) {
+        if (str[0] == '0' && str[1] == 'x') {
+            str += 2;
+            while (ishex(*str)) {
+                str++;
+            }
+        } else {
+            while (isdigit(*str)) {
+                str++;
+            }
+        }
+        *end = str;
+        return TOKEN_NUM;
+    }
+
+    if (isalpha(*str) || *str == '_' || *str == '.') {
+        str++;
+        while (isalnum(*str) || *str == '$' || *str == '_') {
+            str++;
+        }
+        *end = str;
+        return TOKEN_ID;
+    }
+
+    *end = str + 1;
+    return *str;
+}
+
 static void gas_err(void *private_data, int severity, const char *fmt, ...)
 {
     va_list args;
@@ -639,6 +737,7 @@ static int eval_include(yasm_preproc_gas *pp, int unused, const char *arg1)
     char *line;
     int num_lines;
     FILE *file;
+    yasm_srcbuf *src;
     buffered_line *prev_bline;
     included_file *inc_file;
 
@@ -660,22 +759,26 @@ static int eval_include(yasm_preproc_gas *pp, int unused, const char *arg1)
         return 0;
     }
 
+    src = yasm_srcbuf_create(file);
     num_lines = 0;
     prev_bline = NULL;
-    line = read_line_from_file(pp, file);
+    line = read_line_from_file(pp, src);
     while (line) {
         buffered_line *bline = yasm_xmalloc(sizeof(buffered_line));
         bline->line = line;
         bline->line_number = -1;
+        bline->rept = NULL;
         if (prev_bline) {
             SLIST_INSERT_AFTER(prev_bline, bline, next);
         } else {
             SLIST_INSERT_HEAD(&pp->buffered_lines, bline, next);
         }
         prev_bline = bline;
-        line = read_line_from_file(pp, file);
+        line = read_line_from_file(pp, src);
         num_lines++;
     }
+    yasm_srcbuf_destroy(src);
+    fclose(file);
 
     inc_file = yasm_xmalloc(sizeof(included_file));
     inc_file->filename = yasm__xstrdup(filename);
@@ -786,11 +889,74 @@ static int eval_set(yasm_preproc_gas *pp, int allow_redefine, const char *name,
     return 1;
 }
 
+static void macro_entry_destroy(void *data)
+{
+    macro_entry *macro = data;
+    int i;
+
+    yasm_xfree(macro->name);
+    for (i = 0; i < macro->num_params; i++) {
+        yasm_xfree(macro->params[i]);
+    }
+    yasm_xfree(macro->params);
+    for (i = 0; i < macro->num_lines; i++) {
+        yasm_xfree(macro->lines[i].text);
+        yasm_xfree(macro->lines[i].refs);
+    }
+    yasm_xfree(macro->lines);
+    yasm_xfree(macro->values);
+    yasm_xfree(macro->value_lengths);
+    yasm_xfree(macro);
+}
+
+/* Splits a macro body line into literal text and "\param" references, so
+ * that expanding the macro is just a matter of splicing in the arguments.
+ */
+static void compile_macro_line(macro_entry *macro, macro_line *mline, char *text)
+{
+    const char *p = text;
+    const char *start, *end;
+    int prev_was_backslash = FALSE;
+    int type, j;
+
+    mline->text = text;
+    mline->length = strlen(text);
+    mline->num_refs = 0;
+    mline->refs = NULL;
+
+    while ((type = scan_token(p, &start, &end)) != TOKEN_EOS) {
+        p = end;
+        if (prev_was_backslash) {
+            if (type == TOKEN_ID) {
+                for (j = 0; j < macro->num_params; j++) {
+                    size_t len = strcspn(macro->params[j], "=");
+                    if ((size_t)(end - start) == len
+                        && !strncmp(start, macro->params[j], len)) {
+                        macro_ref *ref;
+
+                        mline->refs = yasm_xrealloc(mline->refs, (mline->num_refs + 1)*sizeof(macro_ref));
+                        ref = &mline->refs[mline->num_refs++];
+                        /* (the backslash is replaced as well) */
+                        ref->start = (size_t)(end - text) - len - 1;
+                        ref->end = (size_t)(end - text);
+                        ref->param = j;
+                        break;
+                    }
+                }
+            }
+            prev_was_backslash = FALSE;
+        } else if (type == '\\') {
+            prev_was_backslash = TRUE;
+        }
+    }
+}
+
 static int eval_macro(yasm_preproc_gas *pp, int unused, char *args)
 {
     char *end;
     char *line;
     long nesting = 1;
+    int replace = 0;
     macro_entry *macro = yasm_xmalloc(sizeof(macro_entry));
 
     memset(macro, 0, sizeof(macro_entry));
@@ -820,8 +986,8 @@ static int eval_macro(yasm_preproc_gas *pp, int unused, char *args)
             skip_whitespace2(&end);
         }
     }
-
-    STAILQ_INSERT_TAIL(&pp->macros, macro, next);
+    macro->values = yasm_xmalloc(macro->num_params*sizeof(const char *));
+    macro->value_lengths = yasm_xmalloc(macro->num_params*sizeof(size_t));
 
     line = read_line(pp);
     while (line) {
@@ -830,14 +996,19 @@ static int eval_macro(yasm_preproc_gas *pp, int unused, char *args)
         if (starts_with(line2, ".macro")) {
             nesting++;
         } else if (starts_with(line, ".endm") && --nesting == 0) {
+            yasm_xfree(line);
+            /* If the name is already taken, the earlier definition stays. */
+            HAMT_insert(pp->macros, macro->name, macro, &replace,
+                        macro_entry_destroy);
             return 1;
         }
         macro->num_lines++;
-        macro->lines = yasm_xrealloc(macro->lines, macro->num_lines*sizeof(char *));
-        macro->lines[macro->num_lines - 1] = line;
+        macro->lines = yasm_xrealloc(macro->lines, macro->num_lines*sizeof(macro_line));
+        compile_macro_line(macro, &macro->lines[macro->num_lines - 1], line);
         line = read_line(pp);
     }
 
+    macro_entry_destroy(macro);
     yasm_error_set(YASM_ERROR_SYNTAX, N_("unexpected EOF in \".macro\" block"));
     yasm_errwarn_propagate(pp->errwarns, yasm_linemap_get_current(pp->cur_lm));
     return 0;
@@ -850,33 +1021,21 @@ static int eval_endm(yasm_preproc_gas *pp, int unused)
     return 0;
 }
 
-static void get_param_value(macro_entry *macro, int param_index, const char *args, const char **value, int *length)
+/* Splits the arguments of a macro invocation into macro->values. */
+static void get_param_values(macro_entry *macro, const char *args)
 {
-    int arg_index = 0;
-    const char *default_value = NULL;
-    const char *end, *eq = strstr(macro->params[param_index], "=");
-
-    if (eq) {
-        default_value = eq + 1;
-    }
+    int i, arg_index = 0;
+    const char *end;
 
     skip_whitespace(&args);
     end = args;
-    while (*end) {
+    while (*end && arg_index < macro->num_params) {
         args = end;
         while (*end && !isspace(*end) && *end != ',') {
             end++;
         }
-        if (arg_index == param_index) {
-            if (end == args && default_value) {
-                *value = default_value;
-                *length = strlen(default_value);
-            } else {
-                *value = args;
-                *length = end - args;
-            }
-            return;
-        }
+        macro->values[arg_index] = args;
+        macro->value_lengths[arg_index] = (size_t) (end - args);
         arg_index++;
         skip_whitespace(&end);
         if (*end == ',') {
@@ -885,8 +1044,14 @@ static void get_param_value(macro_entry *macro, int param_index, const char *arg
         }
     }
 
-    *value = default_value;
-    *length = (default_value ? strlen(default_value) : 0);
+    /* Missing or empty arguments take the parameter's default value. */
+    for (i = 0; i < macro->num_params; i++) {
+        if (i >= arg_index || macro->value_lengths[i] == 0) {
+            const char *eq = strchr(macro->params[i], '=');
+            macro->values[i] = eq ? eq + 1 : "";
+            macro->value_lengths[i] = strlen(macro->values[i]);
+        }
+    }
 }
 
 static void expand_macro(yasm_preproc_gas *pp, macro_entry *macro, const char *args)
@@ -894,59 +1059,36 @@ static void expand_macro(yasm_preproc_gas *pp, macro_entry *macro, const char *a
     int i, j;
     buffered_line *prev_bline = NULL;
 
+    pp->macro_expansions++;
+    get_param_values(macro, args);
+
     for (i = 0; i < macro->num_lines; i++) {
+        const macro_line *mline = &macro->lines[i];
         buffered_line *bline = yasm_xmalloc(sizeof(buffered_line));
-        struct tokenval tokval;
-        int prev_was_backslash = FALSE;
-        int line_length = strlen(macro->lines[i]);
-        char *work = yasm__xstrdup(macro->lines[i]);
-        expr_state prev_state = pp->expr;
-
-        gas_scan_init(pp, &tokval, work);
-        while (gas_scan(pp, &tokval) != TOKEN_EOS) {
-            if (prev_was_backslash) {
-                if (tokval.t_type == TOKEN_ID) {
-                    for (j = 0; j < macro->num_params; j++) {
-                        char *end = strstr(macro->params[j], "=");
-                        int len = (end ? (size_t)(end - macro->params[j])
-                                       : strlen(macro->params[j]));
-                        if (!strncmp(tokval.t_charptr, macro->params[j], len)
-                            && tokval.t_charptr[len] == '\0') {
-                            /* now, find matching argument. */
-                            const char *value;
-                            char *line = work + (pp->expr.string - work);
-                            int cursor = pp->expr.string_cursor;
-                            int value_length, delta;
-
-                            get_param_value(macro, j, args, &value, &value_length);
-
-                            len++; /* leading slash */
-                            delta = value_length - len;
-                            line_length += delta;
-                            if (delta > 0) {
-                                line = yasm_xrealloc(line, line_length + 1);
-                            }
-                            memmove(line + cursor - len + value_length, line + cursor, strlen(line + cursor) + 1);
-                            memcpy(line + cursor - len, value, value_length);
-                            pp->expr.string = work = line;
-                            pp->expr.string_cursor += delta;
-                            if (pp->expr.symbol) {
-                                yasm_xfree(pp->expr.symbol);
-                                pp->expr.symbol = NULL;
-                            }
-                        }
-                    }
-                }
-                prev_was_backslash = FALSE;
-            } else if (tokval.t_type == '\\') {
-                prev_was_backslash = TRUE;
-            }
+        size_t length = mline->length;
+        size_t pos = 0;
+        char *out;
+
+        for (j = 0; j < mline->num_refs; j++) {
+            const macro_ref *ref = &mline->refs[j];
+            length = length - (ref->end - ref->start)
+                + macro->value_lengths[ref->param];
         }
-        gas_scan_cleanup(pp, &tokval);
 
-        bline->line = work + (pp->expr.string - work);
+        bline->line = out = yasm_xmalloc(length + 1);
+        for (j = 0; j < mline->num_refs; j++) {
+            const macro_ref *ref = &mline->refs[j];
+            memcpy(out, mline->text + pos, ref->start - pos);
+            out += ref->start - pos;
+            memcpy(out, macro->values[ref->param],
+                   macro->value_lengths[ref->param]);
+            out += macro->value_lengths[ref->param];
+            pos = ref->end;
+        }
+        memcpy(out, mline->text + pos, mline->length - pos + 1);
+
         bline->line_number = -1;
-        pp->expr = prev_state;
+        bline->rept = NULL;
 
         if (prev_bline) {
             SLIST_INSERT_AFTER(prev_bline, bline, next);
@@ -959,66 +1101,70 @@ static void expand_macro(yasm_preproc_gas *pp, macro_entry *macro, const char *a
 
 static int eval_rept(yasm_preproc_gas *pp, int unused, const char *arg1)
 {
-    long i, n = eval_expr(pp, arg1);
+    long n = eval_expr(pp, arg1);
     long num_lines = 0;
     long nesting = 1;
+    int max_lines = 0;
     char *line = read_line(pp);
-    buffered_line *prev_bline = NULL;
-    SLIST_HEAD(buffered_lines_head, buffered_line) lines;
+    rept_block *rept = yasm_xmalloc(sizeof(rept_block));
     int rept_start_file_line_number = pp->next_line_number - 1;
     int rept_start_output_line_number = pp->current_line_number;
 
-    SLIST_INIT(&lines);
+    rept->count = n;
+    rept->cur = 0;
+    rept->num_lines = 0;
+    rept->lines = NULL;
+    rept->lengths = NULL;
+    rept->line_numbers = NULL;
 
     while (line) {
-        skip_whitespace2(&line);
-        if (starts_with(line, ".rept")) {
+        char *text = line;
+        skip_whitespace2(&text);
+        if (starts_with(text, ".rept")) {
             nesting++;
-        } else if (starts_with(line, ".endr") && --nesting == 0) {
-            for (i = 0; i < n; i++) {
-                buffered_line *current_line;
-                prev_bline = NULL;
-                SLIST_FOREACH(current_line, &lines, next) {
-                    buffered_line *bline = yasm_xmalloc(sizeof(buffered_line));
-                    bline->line = yasm__xstrdup(current_line->line);
-                    bline->line_number = current_line->line_number;
-                    if (prev_bline) {
-                        SLIST_INSERT_AFTER(prev_bline, bline, next);
-                    } else {
-                        SLIST_INSERT_HEAD(&pp->buffered_lines, bline, next);
-                    }
-                    prev_bline = bline;
-                }
+        } else if (starts_with(text, ".endr") && --nesting == 0) {
+            /* The body is replayed from a single buffered entry; see
+             * read_line().
+             */
+            if (n > 0)
+                pp->rept_expansions += (unsigned long)n;
+            if (n > 0 && rept->num_lines > 0) {
+                buffered_line *bline = yasm_xmalloc(sizeof(buffered_line));
+                bline->line = NULL;
+                bline->line_number = -1;
+                bline->rept = rept;
+                SLIST_INSERT_HEAD(&pp->buffered_lines, bline, next);
+            } else {
+                rept_block_destroy(rept);
             }
             if (!SLIST_EMPTY(&pp->included_files)) {
                 included_file *inc_file = SLIST_FIRST(&pp->included_files);
                 inc_file->lines_remaining += n * num_lines;
             }
-            while (!SLIST_EMPTY(&lines)) {
-                buffered_line *bline = SLIST_FIRST(&lines);
-                SLIST_REMOVE_HEAD(&lines, next);
-                yasm_xfree(bline->line);
-                yasm_xfree(bline);
-            }
             yasm_xfree(line);
             return 1;
         }
         if (n > 0) {
-            buffered_line *bline = yasm_xmalloc(sizeof(buffered_line));
-            bline->line = line;
-            bline->line_number = pp->next_line_number;
-            if (prev_bline) {
-                SLIST_INSERT_AFTER(prev_bline, bline, next);
-            } else {
-                SLIST_INSERT_HEAD(&lines, bline, next);
+            size_t len = strlen(text);
+
+            memmove(line, text, len + 1);
+            if (rept->num_lines == max_lines) {
+                max_lines = max_lines ? max_lines*2 : 8;
+                rept->lines = yasm_xrealloc(rept->lines, max_lines*sizeof(char *));
+                rept->lengths = yasm_xrealloc(rept->lengths, max_lines*sizeof(size_t));
+                rept->line_numbers = yasm_xrealloc(rept->line_numbers, max_lines*sizeof(int));
             }
-            prev_bline = bline;
+            rept->lines[rept->num_lines] = line;
+            rept->lengths[rept->num_lines] = len;
+            rept->line_numbers[rept->num_lines] = pp->next_line_number;
+            rept->num_lines++;
         } else {
             yasm_xfree(line);
         }
         line = read_line(pp);
         num_lines++;
     }
+    rept_block_destroy(rept);
     yasm_linemap_set(pp->cur_lm, pp->in_filename, rept_start_output_line_number, rept_start_file_line_number, 0);
     yasm_error_set(YASM_ERROR_SYNTAX, N_("rept without matching endr"));
     yasm_errwarn_propagate(pp->errwarns, rept_start_output_line_number);
@@ -1079,37 +1225,46 @@ static int substitute_values(yasm_preproc_gas *pp, char **line_ptr)
 {
     int changed = 0;
     char *line = *line_ptr;
-    int line_length = strlen(line);
-    struct tokenval tokval;
-    expr_state prev_state = pp->expr;
-
-    gas_scan_init(pp, &tokval, line);
-    while (gas_scan(pp, &tokval) != TOKEN_EOS) {
-        if (tokval.t_type == TOKEN_ID) {
-            yasm_symrec *rec = yasm_symtab_get(pp->defines, tokval.t_charptr);
-            if (rec) {
-                int cursor = pp->expr.string_cursor;
-                int len = strlen(tokval.t_charptr);
-                char value[64];
-                int value_length = sprintf(value, "%ld", eval_expr(pp, tokval.t_charptr));
-                int delta = value_length - len;
-
-                line_length += delta;
-                if (delta > 0) {
-                    line = yasm_xrealloc(line, line_length + 1);
-                }
-                memmove(line + cursor - len + value_length, line + cursor, strlen(line + cursor) + 1);
-                memcpy(line + cursor - len, value, value_length);
-                pp->expr.string = line;
-                pp->expr.string_cursor = cursor + delta;
-                changed = 1;
+    size_t line_length = strlen(line);
+    size_t cursor = 0;
+    const char *start, *end;
+
+    for (;;) {
+        int type = scan_token(line + cursor, &start, &end);
+        size_t sym = (size_t) (start - line);
+        yasm_symrec *rec;
+        char save;
+
+        if (type == TOKEN_EOS) {
+            break;
+        }
+        cursor = (size_t) (end - line);
+        if (type != TOKEN_ID) {
+            continue;
+        }
+
+        /* Terminate the symbol in place rather than copying it out. */
+        save = line[cursor];
+        line[cursor] = '\0';
+        rec = yasm_symtab_get(pp->defines, line + sym);
+        if (rec) {
+            size_t len = cursor - sym;
+            char value[64];
+            size_t value_length = (size_t) sprintf(value, "%ld", eval_expr(pp, line + sym));
+
+            line[cursor] = save;
+            if (value_length > len) {
+                line = yasm_xrealloc(line, line_length + value_length - len + 1);
             }
-            yasm_xfree(pp->expr.symbol);
-            pp->expr.symbol = NULL;
+            memmove(line + sym + value_length, line + cursor, line_length - cursor + 1);
+            memcpy(line + sym, value, value_length);
+            line_length = line_length + value_length - len;
+            cursor = sym + value_length;
+            changed = 1;
+        } else {
+            line[cursor] = save;
         }
     }
-    gas_scan_cleanup(pp, &tokval);
-    pp->expr = prev_state;
 
     if (changed) {
         *line_ptr = line;
@@ -1123,7 +1278,7 @@ static int process_line(yasm_preproc_gas *pp, char **line_ptr)
     macro_entry *macro;
     size_t i;
     char *line = *line_ptr;
-    struct {
+    static const struct {
         const char *name;
         int nargs;
         pp_fn0_t fn;
@@ -1165,10 +1320,18 @@ static int process_line(yasm_preproc_gas *pp, char **line_ptr)
     }
 
     /* See if this is a macro call. */
-    STAILQ_FOREACH(macro, &pp->macros, next) {
-        const char *remainder = starts_with(line, macro->name);
-        if (remainder && (!*remainder || isspace(*remainder))) {
-            skip_whitespace2(&line);
+    {
+        char *remainder = line;
+        char save;
+
+        while (*remainder && !isspace(*remainder)) {
+            remainder++;
+        }
+        save = *remainder;
+        *remainder = '\0';
+        macro = HAMT_search(pp->macros, line);
+        *remainder = save;
+        if (macro) {
             expand_macro(pp, macro, remainder);
             return FALSE;
         }
@@ -1226,23 +1389,15 @@ static int process_line(yasm_preproc_gas *pp, char **line_ptr)
 /* Functions exported by the preprocessor. */
 
 static yasm_preproc *
-gas_preproc_create(const char *in_filename, yasm_symtab *symtab,
-                   yasm_linemap *lm, yasm_errwarns *errwarns)
+gas_preproc_create_src(const char *in_filename, /*@null@*/ FILE *f,
+                       yasm_srcbuf *src, yasm_symtab *symtab,
+                       yasm_linemap *lm, yasm_errwarns *errwarns)
 {
-    FILE *f;
     yasm_preproc_gas *pp = yasm_xmalloc(sizeof(yasm_preproc_gas));
 
-    if (strcmp(in_filename, "-") != 0) {
-        f = fopen(in_filename, "r");
-        if (!f) {
-            yasm__fatal(N_("Could not open input file"));
-        }
-    } else {
-        f = stdin;
-    }
-
     pp->preproc.module = &yasm_gas_LTX_preproc;
     pp->in = f;
+    pp->src = src;
     pp->in_filename = yasm__xstrdup(in_filename);
     pp->defines = yasm_symtab_create();
     SLIST_INIT(&pp->deferred_defines);
@@ -1252,7 +1407,7 @@ gas_preproc_create(const char *in_filename, yasm_symtab *symtab,
     pp->in_comment = FALSE;
     SLIST_INIT(&pp->buffered_lines);
     SLIST_INIT(&pp->included_files);
-    STAILQ_INIT(&pp->macros);
+    pp->macros = HAMT_create(0, yasm_internal_error_);
     pp->in_line_number = 0;
     pp->next_line_number = 0;
     pp->current_line_number = 0;
@@ -1260,14 +1415,48 @@ gas_preproc_create(const char *in_filename, yasm_symtab *symtab,
     pp->errwarns = errwarns;
     pp->fatal_error = 0;
     pp->detect_errors_only = 0;
+    pp->macro_expansions = 0;
+    pp->rept_expansions = 0;
 
     return (yasm_preproc *) pp;
 }
 
+static yasm_preproc *
+gas_preproc_create(const char *in_filename, yasm_symtab *symtab,
+                   yasm_linemap *lm, yasm_errwarns *errwarns)
+{
+    FILE *f;
+
+    if (strcmp(in_filename, "-") != 0) {
+        f = fopen(in_filename, "r");
+        if (!f) {
+            yasm__fatal(N_("Could not open input file"));
+        }
+    } else {
+        f = stdin;
+    }
+
+    return gas_preproc_create_src(in_filename, f, yasm_srcbuf_create(f),
+                                  symtab, lm, errwarns);
+}
+
+static yasm_preproc *
+gas_preproc_create_mem(const char *in_filename, const char *buf, size_t len,
+                       yasm_symtab *symtab, yasm_linemap *lm,
+                       yasm_errwarns *errwarns)
+{
+    return gas_preproc_create_src(in_filename, NULL,
+                                  yasm_srcbuf_create_mem(buf, len), symtab,
+                                  lm, errwarns);
+}
+
 static void
 gas_preproc_destroy(yasm_preproc *preproc)
 {
     yasm_preproc_gas *pp = (yasm_preproc_gas *) preproc;
+    yasm_srcbuf_destroy(pp->src);
+    if (pp->in && pp->in != stdin)
+        fclose(pp->in);
     yasm_xfree(pp->in_filename);
     yasm_symtab_destroy(pp->defines);
     while (!SLIST_EMPTY(&pp->deferred_defines)) {
@@ -1280,7 +1469,11 @@ gas_preproc_destroy(yasm_preproc *preproc)
     while (!SLIST_EMPTY(&pp->buffered_lines)) {
         buffered_line *bline = SLIST_FIRST(&pp->buffered_lines);
         SLIST_REMOVE_HEAD(&pp->buffered_lines, next);
-        yasm_xfree(bline->line);
+        if (bline->rept) {
+            rept_block_destroy(bline->rept);
+        } else {
+            yasm_xfree(bline->line);
+        }
         yasm_xfree(bline);
     }
     while (!SLIST_EMPTY(&pp->included_files)) {
@@ -1289,19 +1482,7 @@ gas_preproc_destroy(yasm_preproc *preproc)
         yasm_xfree(inc_file->filename);
         yasm_xfree(inc_file);
     }
-    while (!STAILQ_EMPTY(&pp->macros)) {
-        int i;
-        macro_entry *macro = STAILQ_FIRST(&pp->macros);
-        STAILQ_REMOVE_HEAD(&pp->macros, next);
-        yasm_xfree(macro->name);
-        for (i = 0; i < macro->num_params; i++)
-            yasm_xfree(macro->params[i]);
-        yasm_xfree(macro->params);
-        for (i = 0; i < macro->num_lines; i++)
-            yasm_xfree(macro->lines[i]);
-        yasm_xfree(macro->lines);
-        yasm_xfree(macro);
-    }
+    HAMT_destroy(pp->macros, macro_entry_destroy);
     yasm_xfree(preproc);
 }
 
@@ -1392,6 +1573,16 @@ gas_preproc_add_standard(yasm_preproc *preproc, const char **macros)
     /* TODO */
 }
 
+static void
+gas_preproc_get_stats(yasm_preproc *preproc, yasm_preproc_stat_func func,
+                      void *d)
+{
+    yasm_preproc_gas *pp = (yasm_preproc_gas *) preproc;
+
+    func("macro expansions", pp->macro_expansions, d);
+    func("rept expansions", pp->rept_expansions, d);
+}
+
 
 /* Define preproc structure -- see preproc.h for details */
 yasm_preproc_module yasm_gas_LTX_preproc = {
@@ -1405,5 +1596,8 @@ yasm_preproc_module yasm_gas_LTX_preproc = {
     gas_preproc_predefine_macro,
     gas_preproc_undefine_macro,
     gas_preproc_define_builtin,
-    gas_preproc_add_standard
+    gas_preproc_add_standard,
+    gas_preproc_get_stats,
+    gas_preproc_create_mem,
+    NULL
 };
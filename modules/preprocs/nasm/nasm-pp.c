@@ -39,9 +39,19 @@
 #include <libyasm/intnum.h>
 #include <libyasm/expr.h>
 #include <libyasm/file.h>
+#include <libyasm/preproc.h>
+#include <libyasm/checksum.h>
 #include <stdarg.h>
 #include <ctype.h>
 #include <limits.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#define getpid()    0
+#endif
 
 #include "nasm.h"
 #include "nasmlib.h"
@@ -63,6 +73,7 @@ struct SMacro
 {
     SMacro *next;
     char *name;
+    unsigned long hash;         /* hash(name) */
     int level;
     int casesense;
     int nparam;
@@ -91,6 +102,7 @@ struct MMacro
 {
     MMacro *next;
     char *name;
+    unsigned long hash;         /* hash(name) */
     int casesense;
     long nparam_min, nparam_max;
     int plus;                   /* is the last parameter greedy? */
@@ -191,6 +203,7 @@ struct Include
 {
     Include *next;
     FILE *fp;
+    yasm_srcbuf *src;
     Cond *conds;
     Line *expansion;
     char *fname;
@@ -335,54 +348,117 @@ static const char *tasm_directives[] = {
     "ifndef", "include", "local"
 };
 
-static int StackSize = 4;
-static const char *StackPointer = "ebp";
-static int ArgOffset = 8;
-static int LocalOffset = 4;
-static int Level = 0;
+static YASM_THREAD_LOCAL int StackSize = 4;
+static YASM_THREAD_LOCAL const char *StackPointer = "ebp";
+static YASM_THREAD_LOCAL int ArgOffset = 8;
+static YASM_THREAD_LOCAL int LocalOffset = 4;
+static YASM_THREAD_LOCAL int Level = 0;
 
 
-static Context *cstk;
-static Include *istk;
+static YASM_THREAD_LOCAL Context *cstk;
+static YASM_THREAD_LOCAL Include *istk;
 
-static FILE *first_fp = NULL;
+static YASM_THREAD_LOCAL efunc _error;          /* Pointer to client-provided error reporting function */
+static YASM_THREAD_LOCAL evalfunc evaluate;
 
-static efunc _error;            /* Pointer to client-provided error reporting function */
-static evalfunc evaluate;
+static YASM_THREAD_LOCAL int pass;              /* HACK: pass 0 = generate dependencies only */
 
-static int pass;                /* HACK: pass 0 = generate dependencies only */
+static YASM_THREAD_LOCAL unsigned long unique;  /* unique identifier numbers */
 
-static unsigned long unique;    /* unique identifier numbers */
+static YASM_THREAD_LOCAL Line *builtindef = NULL;
+static YASM_THREAD_LOCAL Line *stddef = NULL;
+static YASM_THREAD_LOCAL Line *predef = NULL;
+static YASM_THREAD_LOCAL int first_line = 1;
 
-static Line *builtindef = NULL;
-static Line *stddef = NULL;
-static Line *predef = NULL;
-static int first_line = 1;
+static YASM_THREAD_LOCAL ListGen *list;
+
+/*
+ * The precompiled macro cache (see pp_macro_cache()). While the
+ * prelude is being processed in order to be cached, the files it
+ * includes are recorded, along with enough of the preprocessor
+ * state to tell afterwards whether it did anything but define
+ * macros.
+ */
+typedef struct CacheFile
+{
+    char *name;                 /* name given to %include */
+    long parent;                /* index of including file, -1 if none */
+    char *path;                 /* file actually opened */
+    unsigned char digest[16];   /* MD5 of its contents */
+} CacheFile;
 
-static ListGen *list;
+static YASM_THREAD_LOCAL struct
+{
+    char *filename;             /* cache file, NULL if not caching */
+    unsigned char key[16];      /* MD5 of the prelude */
+    int recording;              /* processing the prelude to cache it */
+    int is_volatile;            /* prelude used environment or position */
+    unsigned long messages;     /* errors and warnings issued */
+    CacheFile *files;           /* files included by the prelude */
+    long nfiles, maxfiles;
+    unsigned long lines;        /* lines output before the prelude */
+    char *fname;                /* current file and line before it */
+    long linnum;
+    int level, stacksize, argoffset, localoffset;
+    const char *stackpointer;
+} macro_cache;
 
 /*
- * The number of hash values we use for the macro lookup tables.
- * FIXME: We should *really* be able to configure this at run time,
- * or even have the hash table automatically expanding when necessary.
+ * The macro lookup tables map a case-folded macro name to the list
+ * of macros (of either case sensitivity) defined with that name.
+ * They use open addressing with linear probing, and double in size
+ * whenever they become half full.  Slots are never removed; a slot
+ * whose list has become empty is simply reused if the name is
+ * defined again.
  */
-#define NHASH 4096
+typedef struct MacroSlot
+{
+    unsigned long hash;
+    char *key;                  /* folded name, NULL if slot is unused */
+    union
+    {
+        SMacro *s;
+        MMacro *m;
+    } list;
+} MacroSlot;
+
+typedef struct MacroTable
+{
+    MacroSlot *slots;
+    unsigned long size;         /* zero or a power of two */
+    unsigned long used;
+} MacroTable;
+
+#define MACRO_TABLE_MINSIZE 256
 
 /*
  * The current set of multi-line macros we have defined.
  */
-static MMacro *mmacros[NHASH];
+static YASM_THREAD_LOCAL MacroTable mmacros;
 
 /*
  * The current set of single-line macros we have defined.
  */
-static SMacro *smacros[NHASH];
+static YASM_THREAD_LOCAL MacroTable smacros;
+
+/*
+ * Macro table statistics, reset by pp_reset().
+ */
+static YASM_THREAD_LOCAL struct
+{
+    unsigned long lookups;      /* number of table lookups */
+    unsigned long probes;       /* total slots inspected by lookups */
+    unsigned long max_probe;    /* longest single probe sequence */
+    unsigned long grows;        /* number of table resizes */
+    unsigned long sexpansions;  /* single-line macro expansions */
+    unsigned long mexpansions;  /* multi-line macro expansions */
+} macro_stats;
 
 /*
  * The multi-line macro we are currently defining, or the %rep
  * block we are currently reading, if any.
  */
-static MMacro *defining;
+static YASM_THREAD_LOCAL MMacro *defining;
 
 /*
  * The number of macro parameters to allocate space for at a time.
@@ -447,19 +523,62 @@ static const char *tasm_compat_macros[] =
     NULL
 };
 
-static int nested_mac_count, nested_rep_count;
+static YASM_THREAD_LOCAL int nested_mac_count, nested_rep_count;
 
 /*
  * Tokens are allocated in blocks to improve speed
  */
 #define TOKEN_BLOCKSIZE 4096
-static Token *freeTokens = NULL;
+static YASM_THREAD_LOCAL Token *freeTokens = NULL;
 struct Blocks {
         Blocks *next;
         void *chunk;
 };
 
-static Blocks blocks = { NULL, NULL };
+static YASM_THREAD_LOCAL Blocks blocks = { NULL, NULL };
+
+/*
+ * The string pool. The text of every token, and the name of every
+ * macro, is interned here: each distinct string is stored exactly
+ * once, in chunks obtained from new_Block(), and is never modified
+ * or freed individually. So tokens need no allocation of their own
+ * for their text, and case-sensitive comparisons of macro names
+ * against token text reduce to pointer comparisons. The pool is
+ * released along with the token blocks.
+ */
+#define POOL_CHUNKSIZE 65536
+#define POOL_MINSIZE 4096
+
+typedef struct PoolSlot
+{
+    unsigned long hash;
+    size_t len;
+    char *str;                  /* NULL if slot is unused */
+} PoolSlot;
+
+static YASM_THREAD_LOCAL struct
+{
+    PoolSlot *slots;            /* open addressing hash table */
+    unsigned long size;         /* zero or a power of two */
+    unsigned long used;
+    char *chunk;                /* free space in the current chunk */
+    size_t chunk_left;
+} pool;
+
+/*
+ * Token and string pool statistics, reset by pp_reset().
+ */
+static YASM_THREAD_LOCAL struct
+{
+    unsigned long tokens;       /* tokens created */
+    unsigned long token_blocks; /* blocks of TOKEN_BLOCKSIZE tokens */
+    unsigned long interns;      /* strings interned */
+    unsigned long intern_bytes; /* total length of strings interned */
+    unsigned long pool_bytes;   /* bytes of distinct strings stored */
+    unsigned long pool_chunks;  /* chunks allocated for the pool */
+    unsigned long lines;        /* lines returned by pp_getline() */
+    unsigned long line_bytes;   /* total length of those lines */
+} pool_stats;
 
 /*
  * Forward declarations.
@@ -472,10 +591,14 @@ static void make_tok_num(Token * tok, yasm_intnum *val);
 static void error(int severity, const char *fmt, ...);
 static void *new_Block(size_t size);
 static void delete_Blocks(void);
+static char *pool_intern(const char *text, size_t len);
+static char *pool_intern_free(char *text);
 static Token *new_Token(Token * next, int type, const char *text,
                         size_t txtlen);
+static Token *copy_Token(Token * next, const Token * src);
 static Token *delete_Token(Token * t);
 static Token *tokenise(char *line);
+static void cache_add_file(const char *name, const char *path);
 
 /*
  * Macros for safe checking of token pointers, avoid *(NULL)
@@ -497,9 +620,9 @@ typedef struct TMEndItem {
     struct TMEndItem *next;
 } TMEndItem;
 
-static TMEndItem *EndmStack = NULL, *EndsStack = NULL;
+static YASM_THREAD_LOCAL TMEndItem *EndmStack = NULL, *EndsStack = NULL;
 
-char **TMParameters;
+YASM_THREAD_LOCAL char **TMParameters;
 
 struct TStrucField {
     char *name;
@@ -511,14 +634,14 @@ struct TStruc {
     struct TStrucField *fields, *lastField;
     struct TStruc *next;
 };
-static struct TStruc *TStrucs = NULL;
-static int inTstruc = 0;
+static YASM_THREAD_LOCAL struct TStruc *TStrucs = NULL;
+static YASM_THREAD_LOCAL int inTstruc = 0;
 
 struct TSegmentAssume {
     char *segreg;
     char *segment;
 };
-struct TSegmentAssume *TAssumes;
+YASM_THREAD_LOCAL struct TSegmentAssume *TAssumes;
 
 const char *tasm_get_segment_register(const char *segment)
 {
@@ -1022,10 +1145,8 @@ static Token * tasm_join_tokens(Token *tline)
             else if (!prev->text || !next->text)
                 error(ERR_FATAL, "can't handle empty token around &");
             else {
-                int lenp = strlen(prev->text);
-                int lenn = strlen(next->text);
-                prev->text = nasm_realloc(prev->text, lenp + lenn + 1);
-                strncpy(prev->text + lenp, next->text, lenn + 1);
+                prev->text = pool_intern_free(nasm_strcat(prev->text,
+                                                          next->text));
                 (void) delete_Token(t);
                 prev->next = delete_Token(next);
                 t = prev;
@@ -1094,31 +1215,22 @@ prepreproc(char *line)
 /*
  * The hash function for macro lookups. Note that due to some
  * macros having case-insensitive names, the hash function must be
- * invariant under case changes. We implement this by applying a
- * perfectly normal hash function to the uppercase of the string.
+ * invariant under case changes. We implement this by applying FNV-1a
+ * to the string as folded to uppercase through hash_fold[], which
+ * is filled in by pp_reset().
  */
-static int
-hash(char *s)
-{
-    unsigned int h = 0;
-    unsigned int i = 0;
-    /*
-     * Powers of three, mod 31.
-     */
-    static const int multipliers[] = {
-        1, 3, 9, 27, 19, 26, 16, 17, 20, 29, 25, 13, 8, 24, 10,
-        30, 28, 22, 4, 12, 5, 15, 14, 11, 2, 6, 18, 23, 7, 21
-    };
+static YASM_THREAD_LOCAL unsigned char hash_fold[256];
 
+static unsigned long
+hash(const char *s)
+{
+    unsigned long h = 2166136261UL;
 
     while (*s)
     {
-        h += multipliers[i] * (unsigned char) (toupper(*s));
-        s++;
-        if (++i >= elements(multipliers))
-            i = 0;
+        h ^= hash_fold[(unsigned char)*s++];
+        h = (h * 16777619UL) & 0xffffffffUL;
     }
-    h %= NHASH;
     return h;
 }
 
@@ -1156,13 +1268,177 @@ free_llist(Line * list_)
 static void
 free_mmacro(MMacro * m)
 {
-    nasm_free(m->name);
     free_tlist(m->dlist);
     nasm_free(m->defaults);
     free_llist(m->expansion);
     nasm_free(m);
 }
 
+/*
+ * Free an SMacro
+ */
+static void
+free_smacro(SMacro * s)
+{
+    free_tlist(s->expansion);
+    nasm_free(s);
+}
+
+/*
+ * Compare a folded macro table key against a macro name.
+ */
+static int
+macro_key_equal(const char *key, const char *name)
+{
+    while (*key && *key == (char)hash_fold[(unsigned char)*name])
+    {
+        key++;
+        name++;
+    }
+    return *key == (char)hash_fold[(unsigned char)*name];
+}
+
+/*
+ * Double the size of a macro table (or allocate it, if empty).
+ * Since each slot records its hash, the keys need not be rehashed.
+ */
+static void
+macro_table_grow(MacroTable * t)
+{
+    MacroSlot *old = t->slots;
+    unsigned long oldsize = t->size, i, j;
+
+    t->size = oldsize ? oldsize * 2 : MACRO_TABLE_MINSIZE;
+    t->slots = nasm_malloc(t->size * sizeof(MacroSlot));
+    for (i = 0; i < t->size; i++)
+        t->slots[i].key = NULL;
+
+    for (i = 0; i < oldsize; i++)
+    {
+        if (!old[i].key)
+            continue;
+        for (j = old[i].hash & (t->size - 1); t->slots[j].key;
+                j = (j + 1) & (t->size - 1))
+            ;
+        t->slots[j] = old[i];
+    }
+    nasm_free(old);
+    macro_stats.grows++;
+}
+
+/*
+ * Find the slot for a macro name in a macro table, given the name's
+ * hash. If there is none, return NULL, or if `create' is set, claim
+ * a new (empty) slot for it; this may resize the table, so any slot
+ * or list head pointers previously obtained become invalid.
+ */
+static MacroSlot *
+macro_slot(MacroTable * t, const char *name, unsigned long h, int create)
+{
+    MacroSlot *slot;
+    unsigned long i, probe = 0;
+
+    if (create && (t->used + 1) * 2 > t->size)
+        macro_table_grow(t);
+    if (t->size == 0)
+        return NULL;
+
+    macro_stats.lookups++;
+    for (i = h & (t->size - 1);; i = (i + 1) & (t->size - 1))
+    {
+        slot = &t->slots[i];
+        probe++;
+        if (!slot->key ||
+                (slot->hash == h && macro_key_equal(slot->key, name)))
+            break;
+    }
+    macro_stats.probes += probe;
+    if (probe > macro_stats.max_probe)
+        macro_stats.max_probe = probe;
+
+    if (slot->key)
+        return slot;
+    if (!create)
+        return NULL;
+
+    slot->hash = h;
+    slot->key = nasm_strdup(name);
+    for (i = 0; slot->key[i]; i++)
+        slot->key[i] = (char)hash_fold[(unsigned char)slot->key[i]];
+    slot->list.s = NULL;
+    t->used++;
+    return slot;
+}
+
+/*
+ * Get the list of single-line macros with a given name (and hash),
+ * or the list head to insert a new one into.
+ */
+static SMacro *
+smacro_list(const char *name, unsigned long h)
+{
+    MacroSlot *slot = macro_slot(&smacros, name, h, FALSE);
+    return slot ? slot->list.s : NULL;
+}
+
+static SMacro **
+smacro_head(const char *name, unsigned long h)
+{
+    return &macro_slot(&smacros, name, h, TRUE)->list.s;
+}
+
+/*
+ * The same, for multi-line macros.
+ */
+static MMacro *
+mmacro_list(const char *name, unsigned long h)
+{
+    MacroSlot *slot = macro_slot(&mmacros, name, h, FALSE);
+    return slot ? slot->list.m : NULL;
+}
+
+static MMacro **
+mmacro_head(const char *name, unsigned long h)
+{
+    return &macro_slot(&mmacros, name, h, TRUE)->list.m;
+}
+
+/*
+ * Free all the macros in both macro tables, and the tables themselves.
+ */
+static void
+free_macro_tables(void)
+{
+    unsigned long i;
+
+    for (i = 0; i < mmacros.size; i++)
+    {
+        while (mmacros.slots[i].key && mmacros.slots[i].list.m)
+        {
+            MMacro *m = mmacros.slots[i].list.m;
+            mmacros.slots[i].list.m = m->next;
+            free_mmacro(m);
+        }
+        nasm_free(mmacros.slots[i].key);
+    }
+    for (i = 0; i < smacros.size; i++)
+    {
+        while (smacros.slots[i].key && smacros.slots[i].list.s)
+        {
+            SMacro *s = smacros.slots[i].list.s;
+            smacros.slots[i].list.s = s->next;
+            free_smacro(s);
+        }
+        nasm_free(smacros.slots[i].key);
+    }
+    nasm_free(mmacros.slots);
+    nasm_free(smacros.slots);
+    mmacros.slots = NULL;
+    mmacros.size = mmacros.used = 0;
+    smacros.slots = NULL;
+    smacros.size = smacros.used = 0;
+}
+
 /*
  * Pop the context stack.
  */
@@ -1178,7 +1454,6 @@ ctx_pop(void)
     {
         s = smac;
         smac = smac->next;
-        nasm_free(s->name);
         free_tlist(s->expansion);
         nasm_free(s);
     }
@@ -1186,7 +1461,6 @@ ctx_pop(void)
     nasm_free(c);
 }
 
-#define BUF_DELTA 512
 /*
  * Read a line from the top file in istk, handling multiple CR/LFs
  * at the end of the line read, and handling spurious ^Zs. Will
@@ -1196,53 +1470,62 @@ ctx_pop(void)
 static char *
 read_line(void)
 {
-    char *buffer, *p, *q;
-    int bufsize, continued_count;
+    char *buffer, *p;
+    const char *line;
+    size_t len, bufsize;
+    int continued_count;
 
-    bufsize = BUF_DELTA;
-    buffer = nasm_malloc(BUF_DELTA);
-    p = buffer;
+    line = yasm_srcbuf_get_line(istk->src, &len);
+    if (!line)
+        return NULL;
+
+    /* Lines are sliced straight out of the source buffer; the common case
+     * (no continuation) is a single copy. */
+    bufsize = len + 1;
+    buffer = nasm_malloc(bufsize);
+    memcpy(buffer, line, len);
+    p = buffer + len;
     continued_count = 0;
-    while (1)
+    while (p > buffer && p[-1] == '\n')
     {
-        q = fgets(p, bufsize - (int)(p - buffer), istk->fp);
-        if (!q)
+        /* Convert backslash-CRLF line continuation sequences into
+           nothing at all (for DOS and Windows) */
+        if (((p - 2) > buffer) && (p[-3] == '\\') && (p[-2] == '\r'))
+            p -= 3;
+        /* Also convert backslash-LF line continuation sequences into
+           nothing at all (for Unix) */
+        else if (((p - 1) > buffer) && (p[-2] == '\\'))
+            p -= 2;
+        else
             break;
-        p += strlen(p);
-        if (p > buffer && p[-1] == '\n')
+        continued_count++;
+
+        line = yasm_srcbuf_get_line(istk->src, &len);
+        if (!line)
         {
-           /* Convert backslash-CRLF line continuation sequences into
-              nothing at all (for DOS and Windows) */
-           if (((p - 2) > buffer) && (p[-3] == '\\') && (p[-2] == '\r')) {
-               p -= 3;
-               *p = 0;
-               continued_count++;
-           }
-           /* Also convert backslash-LF line continuation sequences into
-              nothing at all (for Unix) */
-           else if (((p - 1) > buffer) && (p[-2] == '\\')) {
-               p -= 2;
-               *p = 0;
-               continued_count++;
-           }
-           else {
-               break;
-           }
+            if (p == buffer)
+            {
+                nasm_free(buffer);
+                return NULL;
+            }
+            break;
         }
-        if (p - buffer > bufsize - 10)
+        if ((size_t)(p - buffer) + len + 1 > bufsize)
         {
-            long offset = (long)(p - buffer);
-            bufsize += BUF_DELTA;
-            buffer = nasm_realloc(buffer, (size_t)bufsize);
+            size_t offset = (size_t)(p - buffer);
+            bufsize = offset + len + 1;
+            if (bufsize < offset * 2)
+                bufsize = offset * 2;
+            buffer = nasm_realloc(buffer, bufsize);
             p = buffer + offset;        /* prevent stale-pointer problems */
         }
+        memcpy(p, line, len);
+        p += len;
     }
+    *p = '\0';
 
-    if (!q && p == buffer)
-    {
-        nasm_free(buffer);
-        return NULL;
-    }
+    /* Embedded NULs end the line, as they did when read with fgets() */
+    p = buffer + strlen(buffer);
 
     nasm_src_set_linnum(nasm_src_get_linnum() + istk->lineinc + (continued_count * istk->lineinc));
 
@@ -1416,8 +1699,12 @@ tokenise(char *line)
         /* Handle unterminated string */
         if (type == -1)
         {
-            *tail = t = new_Token(NULL, TOK_STRING, line, (size_t)(p-line)+1);
-            t->text[p-line] = *line;
+            char *str = nasm_malloc((size_t)(p-line)+2);
+            memcpy(str, line, (size_t)(p-line));
+            str[p-line] = *line;
+            str[p-line+1] = '\0';
+            *tail = t = new_Token(NULL, TOK_STRING, str, 0);
+            nasm_free(str);
             tail = &t->next;
         }
         else if (type != TOK_COMMENT)
@@ -1478,6 +1765,108 @@ delete_Blocks(void)
         }
 }       
 
+/*
+ * Double the size of the string pool hash table (or allocate it).
+ */
+static void
+pool_grow(void)
+{
+    PoolSlot *old = pool.slots;
+    unsigned long oldsize = pool.size, i, j;
+
+    pool.size = oldsize ? oldsize * 2 : POOL_MINSIZE;
+    pool.slots = nasm_malloc(pool.size * sizeof(PoolSlot));
+    for (i = 0; i < pool.size; i++)
+        pool.slots[i].str = NULL;
+
+    for (i = 0; i < oldsize; i++)
+    {
+        if (!old[i].str)
+            continue;
+        for (j = old[i].hash & (pool.size - 1); pool.slots[j].str;
+                j = (j + 1) & (pool.size - 1))
+            ;
+        pool.slots[j] = old[i];
+    }
+    nasm_free(old);
+}
+
+/*
+ * Return the pooled copy of the first `len' characters of `text'
+ * (or fewer, if a NUL comes first).
+ */
+static char *
+pool_intern(const char *text, size_t len)
+{
+    PoolSlot *slot;
+    unsigned long h = 2166136261UL, i;
+
+    for (i = 0; i < len && text[i]; i++)
+    {
+        h ^= (unsigned char)text[i];
+        h = (h * 16777619UL) & 0xffffffffUL;
+    }
+    len = i;
+
+    pool_stats.interns++;
+    pool_stats.intern_bytes += len;
+
+    if ((pool.used + 1) * 2 > pool.size)
+        pool_grow();
+    for (i = h & (pool.size - 1);; i = (i + 1) & (pool.size - 1))
+    {
+        slot = &pool.slots[i];
+        if (!slot->str)
+            break;
+        if (slot->hash == h && slot->len == len &&
+                memcmp(slot->str, text, len) == 0)
+            return slot->str;
+    }
+
+    if (len + 1 > pool.chunk_left)
+    {
+        size_t size = len + 1 > POOL_CHUNKSIZE ? len + 1 : POOL_CHUNKSIZE;
+        pool.chunk = new_Block(size);
+        pool.chunk_left = size;
+        pool_stats.pool_chunks++;
+    }
+    slot->hash = h;
+    slot->len = len;
+    slot->str = pool.chunk;
+    memcpy(slot->str, text, len);
+    slot->str[len] = '\0';
+    pool.chunk += len + 1;
+    pool.chunk_left -= len + 1;
+    pool.used++;
+    pool_stats.pool_bytes += len + 1;
+    return slot->str;
+}
+
+/*
+ * Intern an allocated string, and free it.
+ */
+static char *
+pool_intern_free(char *text)
+{
+    char *pooled = pool_intern(text, strlen(text));
+    nasm_free(text);
+    return pooled;
+}
+
+/*
+ * Release the string pool hash table; the strings themselves are
+ * released by delete_Blocks().
+ */
+static void
+pool_cleanup(void)
+{
+    nasm_free(pool.slots);
+    pool.slots = NULL;
+    pool.size = pool.used = 0;
+    pool.chunk = NULL;
+    pool.chunk_left = 0;
+}
+
 /*
  *  this function creates a new Token and passes a pointer to it 
  *  back to the caller.  It sets the type and text elements, and
@@ -1492,6 +1881,7 @@ new_Token(Token * next, int type, const char *text, size_t txtlen)
     if (freeTokens == NULL)
     {
         freeTokens = (Token *)new_Block(TOKEN_BLOCKSIZE * sizeof(Token));
+        pool_stats.token_blocks++;
         for (i = 0; i < TOKEN_BLOCKSIZE - 1; i++)
             freeTokens[i].next = &freeTokens[i + 1];
         freeTokens[i].next = NULL;
@@ -1509,10 +1899,21 @@ new_Token(Token * next, int type, const char *text, size_t txtlen)
     {
         if (txtlen == 0)
             txtlen = strlen(text);
-        t->text = nasm_malloc(1 + txtlen);
-        strncpy(t->text, text, txtlen);
-        t->text[txtlen] = '\0';
+        t->text = pool_intern(text, txtlen);
     }
+    pool_stats.tokens++;
+    return t;
+}
+
+/*
+ *  this function creates a new Token with the same type and (pooled)
+ *  text as an existing one.
+ */
+static Token *
+copy_Token(Token * next, const Token * src)
+{
+    Token *t = new_Token(next, src->type, NULL, 0);
+    t->text = src->text;
     return t;
 }
 
@@ -1520,7 +1921,6 @@ static Token *
 delete_Token(Token * t)
 {
     Token *next = t->next;
-    nasm_free(t->text);
     t->next = freeTokens;
     freeTokens = t;
     return next;
@@ -1544,9 +1944,9 @@ detoken(Token * tlist, int expand_locals)
         if (t->type == TOK_PREPROC_ID && t->text[1] == '!')
         {
             char *p2 = getenv(t->text + 2);
-            nasm_free(t->text);
+            macro_cache.is_volatile = TRUE;
             if (p2)
-                t->text = nasm_strdup(p2);
+                t->text = pool_intern(p2, strlen(p2));
             else
                 t->text = NULL;
         }
@@ -1559,13 +1959,11 @@ detoken(Token * tlist, int expand_locals)
             if (ctx)
             {
                 char buffer[40];
-                char *p2, *q = t->text + 2;
+                char *q = t->text + 2;
 
                 q += strspn(q, "$");
                 sprintf(buffer, "..@%lu.", ctx->number);
-                p2 = nasm_strcat(buffer, q);
-                nasm_free(t->text);
-                t->text = p2;
+                t->text = pool_intern_free(nasm_strcat(buffer, q));
             }
         }
         if (t->type == TOK_WHITESPACE)
@@ -1709,14 +2107,14 @@ ppscan(void *private_data, struct tokenval *tokval)
 }
 
 /*
- * Compare a string to the name of an existing macro; this is a
- * simple wrapper which calls either strcmp or nasm_stricmp
- * depending on the value of the `casesense' parameter.
+ * Compare a string to the name of an existing macro. Both must be
+ * interned in the string pool, so that a case-sensitive comparison
+ * is a pointer comparison; otherwise nasm_stricmp is used.
  */
 static int
 mstrcmp(char *p, char *q, int casesense)
 {
-    return casesense ? strcmp(p, q) : nasm_stricmp(p, q);
+    return casesense ? (p != q) : nasm_stricmp(p, q);
 }
 
 /*
@@ -1810,6 +2208,7 @@ inc_fopen(char *file, char **newname)
          */
         *p2 = '\0';
         env = getenv(p1+1);
+        macro_cache.is_volatile = TRUE;
         if (!env) {
             /* warn, restore %, and continue looking */
             error(ERR_WARNING, "environment variable `%s' does not exist",
@@ -1895,6 +2294,7 @@ smacro_defined(Context * ctx, char *name, int nparam, SMacro ** defn,
         int nocase)
 {
     SMacro *m;
+    unsigned long h = hash(name);
     int highest_level = -1;
 
     if (ctx)
@@ -1908,11 +2308,11 @@ smacro_defined(Context * ctx, char *name, int nparam, SMacro ** defn,
         m = ctx->localmac;
     }
     else
-        m = smacros[hash(name)];
+        m = smacro_list(name, h);
 
     while (m)
     {
-        if (!mstrcmp(m->name, name, m->casesense && nocase) &&
+        if (m->hash == h && !mstrcmp(m->name, name, m->casesense && nocase) &&
                 (nparam <= 0 || m->nparam == 0 || nparam == m->nparam) && (highest_level < 0 || m->level > highest_level))
         {
             highest_level = m->level;
@@ -2100,13 +2500,21 @@ if_condition(Token * tline, int i)
                     j = FALSE;  /* found mismatching tokens */
                     break;
                 }
-                /* Unify surrounding quotes for strings */
-                if (t->type == TOK_STRING)
+                /* Ignore surrounding quotes for strings */
+                if (t->type == TOK_STRING && strlen(t->text) >= 2)
                 {
-                    tt->text[0] = t->text[0];
-                    tt->text[strlen(tt->text) - 1] = t->text[0];
+                    size_t len = strlen(t->text) - 2;
+                    if (strlen(tt->text) != len + 2 ||
+                            (casesense ?
+                                strncmp(tt->text + 1, t->text + 1, len) :
+                                nasm_strnicmp(tt->text + 1, t->text + 1, len))
+                            != 0)
+                    {
+                        j = FALSE;  /* found mismatching tokens */
+                        break;
+                    }
                 }
-                if (mstrcmp(tt->text, t->text, casesense) != 0)
+                else if (mstrcmp(tt->text, t->text, casesense) != 0)
                 {
                     j = FALSE;  /* found mismatching tokens */
                     break;
@@ -2198,7 +2606,7 @@ if_condition(Token * tline, int i)
                 tline = tline->next;
                 searching.plus = TRUE;
             }
-            mmac = mmacros[hash(searching.name)];
+            mmac = mmacro_list(searching.name, hash(searching.name));
             while (mmac)
             {
                 if (!strcmp(mmac->name, searching.name) &&
@@ -2302,14 +2710,17 @@ if_condition(Token * tline, int i)
 /*
  * Expand macros in a string. Used in %error and %include directives.
  * First tokenise the string, apply "expand_smacro" and then de-tokenise back.
- * The returned variable should ALWAYS be freed after usage.
+ * The passed string is freed and replaced by the result, which should
+ * ALWAYS be freed after usage.
  */
 static void
 expand_macros_in_string(char **p)
 {
     Token *line = tokenise(*p);
+    nasm_free(*p);
     line = expand_smacro(line);
     *p = detoken(line, FALSE);
+    free_tlist(line);
 }
 
 /**
@@ -2334,7 +2745,8 @@ do_directive(Token * tline)
     Context *ctx;
     Cond *cond;
     SMacro *smac, **smhead;
-    MMacro *mmac;
+    MMacro *mmac, **mmhead;
+    unsigned long mhash;
     Token *t, *tt, *param_start, *macro_start, *last, **tptr, *origline;
     Line *l;
     struct tokenval tokval;
@@ -2684,23 +3096,7 @@ do_directive(Token * tline)
             if (tline->next)
                 error(ERR_WARNING,
                         "trailing garbage after `%%clear' ignored");
-            for (j = 0; j < NHASH; j++)
-            {
-                while (mmacros[j])
-                {
-                    MMacro *m2 = mmacros[j];
-                    mmacros[j] = m2->next;
-                    free_mmacro(m2);
-                }
-                while (smacros[j])
-                {
-                    SMacro *s = smacros[j];
-                    smacros[j] = smacros[j]->next;
-                    nasm_free(s->name);
-                    free_tlist(s->expansion);
-                    nasm_free(s);
-                }
-            }
+            free_macro_tables();
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -2718,17 +3114,18 @@ do_directive(Token * tline)
                 error(ERR_WARNING,
                         "trailing garbage after `%%include' ignored");
             if (tline->type != TOK_INTERNAL_STRING)
-            {
-                p = tline->text + 1;    /* point past the quote to the name */
-                p[strlen(p) - 1] = '\0';        /* remove the trailing quote */
-            }
+                /* remove the surrounding quotes */
+                p = nasm_strndup(tline->text + 1, strlen(tline->text) - 2);
             else
-                p = tline->text;        /* internal_string is easier */
+                p = nasm_strdup(tline->text);   /* internal_string is easier */
             expand_macros_in_string(&p);
             inc = nasm_malloc(sizeof(Include));
             inc->next = istk;
             inc->conds = NULL;
             inc->fp = inc_fopen(p, &newname);
+            if (macro_cache.recording)
+                cache_add_file(p, newname);
+            inc->src = yasm_srcbuf_create(inc->fp);
             inc->fname = nasm_src_set_fname(newname);
             inc->lineno = nasm_src_set_linnum(0);
             inc->lineinc = 1;
@@ -2808,10 +3205,14 @@ do_directive(Token * tline)
                         "`%%endscope': already popped all levels");
             else
             {
-                for (k = 0; k < NHASH; k++)
+                unsigned long slot;
+
+                for (slot = 0; slot < smacros.size; slot++)
                 {
-                    SMacro **smlast = &smacros[k];
-                    smac = smacros[k];
+                    SMacro **smlast = &smacros.slots[slot].list.s;
+                    if (!smacros.slots[slot].key)
+                        continue;
+                    smac = *smlast;
                     while (smac)
                     {
                         if (smac->level < Level)
@@ -2822,7 +3223,6 @@ do_directive(Token * tline)
                         else
                         {
                             *smlast = smac->next;
-                            nasm_free(smac->name);
                             free_tlist(smac->expansion);
                             nasm_free(smac);
                             smac = *smlast;
@@ -2843,7 +3243,6 @@ do_directive(Token * tline)
                         else
                         {
                             *smlast = smac->next;
-                            nasm_free(smac->name);
                             free_tlist(smac->expansion);
                             nasm_free(smac);
                             smac = *smlast;
@@ -2861,8 +3260,8 @@ do_directive(Token * tline)
             skip_white_(tline);
             if (tok_type_(tline, TOK_STRING))
             {
-                p = tline->text + 1;    /* point past the quote to the name */
-                p[strlen(p) - 1] = '\0';        /* remove the trailing quote */
+                /* remove the surrounding quotes */
+                p = nasm_strndup(tline->text + 1, strlen(tline->text) - 2);
                 expand_macros_in_string(&p);
                 error(ERR_NONFATAL, "%s", p);
                 nasm_free(p);
@@ -2990,7 +3389,8 @@ do_directive(Token * tline)
                 return DIRECTIVE_FOUND;
             }
             defining = nasm_malloc(sizeof(MMacro));
-            defining->name = nasm_strdup(tline->text);
+            defining->name = tline->text;
+            defining->hash = hash(defining->name);
             defining->casesense = (i == PP_MACRO);
             defining->plus = FALSE;
             defining->nolist = FALSE;
@@ -3050,7 +3450,7 @@ do_directive(Token * tline)
                 tline = tline->next;
                 defining->nolist = TRUE;
             }
-            mmac = mmacros[hash(defining->name)];
+            mmac = mmacro_list(defining->name, defining->hash);
             while (mmac)
             {
                 if (!strcmp(mmac->name, defining->name) &&
@@ -3093,9 +3493,9 @@ do_directive(Token * tline)
                         tline->text);
                 return DIRECTIVE_FOUND;
             }
-            k = hash(defining->name);
-            defining->next = mmacros[k];
-            mmacros[k] = defining;
+            mmhead = mmacro_head(defining->name, defining->hash);
+            defining->next = *mmhead;
+            *mmhead = defining;
             defining = NULL;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
@@ -3203,6 +3603,7 @@ do_directive(Token * tline)
             tmp_defining = defining;
             defining = nasm_malloc(sizeof(MMacro));
             defining->name = NULL;      /* flags this macro as a %rep block */
+            defining->hash = 0;
             defining->casesense = 0;
             defining->plus = FALSE;
             defining->nolist = nolist;
@@ -3284,8 +3685,9 @@ do_directive(Token * tline)
             }
 
             ctx = get_ctx(tline->text, FALSE);
+            mhash = hash(tline->text);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = smacro_head(tline->text, mhash);
             else
                 smhead = &ctx->localmac;
             mname = tline->text;
@@ -3386,7 +3788,6 @@ do_directive(Token * tline)
                      * take over an existing SMacro structure. This means 
                      * freeing what was already in it.
                      */
-                    nasm_free(smac->name);
                     free_tlist(smac->expansion);
                 }
                 else
@@ -3402,7 +3803,8 @@ do_directive(Token * tline)
                 smac->next = *smhead;
                 *smhead = smac;
             }
-            smac->name = nasm_strdup(mname);
+            smac->name = mname;
+            smac->hash = mhash;
             smac->casesense = ((i == PP_DEFINE) || (i == PP_XDEFINE));
             smac->nparam = nparam;
             smac->level = Level;
@@ -3431,8 +3833,9 @@ do_directive(Token * tline)
 
             /* Find the context that symbol belongs to */
             ctx = get_ctx(tline->text, FALSE);
+            mhash = hash(tline->text);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = smacro_head(tline->text, mhash);
             else
                 smhead = &ctx->localmac;
 
@@ -3449,7 +3852,6 @@ do_directive(Token * tline)
                 if (*s)
                 {
                     *s = smac->next;
-                    nasm_free(smac->name);
                     free_tlist(smac->expansion);
                     nasm_free(smac);
                 }
@@ -3471,8 +3873,9 @@ do_directive(Token * tline)
                 return DIRECTIVE_FOUND;
             }
             ctx = get_ctx(tline->text, FALSE);
+            mhash = hash(tline->text);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = smacro_head(tline->text, mhash);
             else
                 smhead = &ctx->localmac;
             mname = tline->text;
@@ -3517,7 +3920,6 @@ do_directive(Token * tline)
                      * existing SMacro structure. This means freeing
                      * what was already in it.
                      */
-                    nasm_free(smac->name);
                     free_tlist(smac->expansion);
                 }
             }
@@ -3527,7 +3929,8 @@ do_directive(Token * tline)
                 smac->next = *smhead;
                 *smhead = smac;
             }
-            smac->name = nasm_strdup(mname);
+            smac->name = mname;
+            smac->hash = mhash;
             smac->casesense = (i == PP_STRLEN);
             smac->nparam = 0;
             smac->level = 0;
@@ -3551,8 +3954,9 @@ do_directive(Token * tline)
                 return DIRECTIVE_FOUND;
             }
             ctx = get_ctx(tline->text, FALSE);
+            mhash = hash(tline->text);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = smacro_head(tline->text, mhash);
             else
                 smhead = &ctx->localmac;
             mname = tline->text;
@@ -3596,16 +4000,16 @@ do_directive(Token * tline)
 
             macro_start = nasm_malloc(sizeof(*macro_start));
             macro_start->next = NULL;
-            macro_start->text = nasm_strdup("'''");
             if (yasm_intnum_sign(intn) == 1
                     && yasm_intnum_get_uint(intn) < strlen(t->text) - 1)
             {
-                macro_start->text[1] = t->text[yasm_intnum_get_uint(intn)];
+                char substr[3];
+                substr[0] = substr[2] = '\'';
+                substr[1] = t->text[yasm_intnum_get_uint(intn)];
+                macro_start->text = pool_intern(substr, 3);
             }
             else
-            {
-                macro_start->text[2] = '\0';
-            }
+                macro_start->text = pool_intern("''", 2);
             yasm_expr_destroy(evalresult);
             macro_start->type = TOK_STRING;
             macro_start->mac = NULL;
@@ -3628,7 +4032,6 @@ do_directive(Token * tline)
                      * existing SMacro structure. This means freeing
                      * what was already in it.
                      */
-                    nasm_free(smac->name);
                     free_tlist(smac->expansion);
                 }
             }
@@ -3638,7 +4041,8 @@ do_directive(Token * tline)
                 smac->next = *smhead;
                 *smhead = smac;
             }
-            smac->name = nasm_strdup(mname);
+            smac->name = mname;
+            smac->hash = mhash;
             smac->casesense = (i == PP_SUBSTR);
             smac->nparam = 0;
             smac->level = 0;
@@ -3665,8 +4069,9 @@ do_directive(Token * tline)
                 return DIRECTIVE_FOUND;
             }
             ctx = get_ctx(tline->text, FALSE);
+            mhash = hash(tline->text);
             if (!ctx)
-                smhead = &smacros[hash(tline->text)];
+                smhead = smacro_head(tline->text, mhash);
             else
                 smhead = &ctx->localmac;
             mname = tline->text;
@@ -3724,7 +4129,6 @@ do_directive(Token * tline)
                      * existing SMacro structure. This means freeing
                      * what was already in it.
                      */
-                    nasm_free(smac->name);
                     free_tlist(smac->expansion);
                 }
             }
@@ -3734,7 +4138,8 @@ do_directive(Token * tline)
                 smac->next = *smhead;
                 *smhead = smac;
             }
-            smac->name = nasm_strdup(mname);
+            smac->name = mname;
+            smac->hash = mhash;
             smac->casesense = (i == PP_ASSIGN);
             smac->nparam = 0;
             smac->level = 0;
@@ -3904,9 +4309,7 @@ expand_mmac_params(Token * tline)
                                 is_fst = 0;
                             for (i = 0; i < mac->paramlen[k]; i++)
                             {
-                                *tail =
-                                        new_Token(NULL, tt->type, tt->text,
-                                        0);
+                                *tail = copy_Token(NULL, tt);
                                 tail = &(*tail)->next;
                                 tt = tt->next;
                             }
@@ -4004,9 +4407,7 @@ expand_mmac_params(Token * tline)
                             {
                                 for (i = 0; i < mac->paramlen[n]; i++)
                                 {
-                                    *tail =
-                                            new_Token(NULL, tt->type, tt->text,
-                                            0);
+                                    *tail = copy_Token(NULL, tt);
                                     tail = &(*tail)->next;
                                     tt = tt->next;
                                 }
@@ -4026,8 +4427,7 @@ expand_mmac_params(Token * tline)
                 *tail = t;
                 tail = &t->next;
                 t->type = type;
-                nasm_free(t->text);
-                t->text = text;
+                t->text = pool_intern_free(text);
                 t->mac = NULL;
             }
             continue;
@@ -4054,18 +4454,14 @@ expand_mmac_params(Token * tline)
             case TOK_ID:
                 if (tt->type == TOK_ID || tt->type == TOK_NUMBER)
                 {
-                    char *tmp = nasm_strcat(t->text, tt->text);
-                    nasm_free(t->text);
-                    t->text = tmp;
+                    t->text = pool_intern_free(nasm_strcat(t->text, tt->text));
                     t->next = delete_Token(tt);
                 }
                 break;
             case TOK_NUMBER:
                 if (tt->type == TOK_NUMBER)
                 {
-                    char *tmp = nasm_strcat(t->text, tt->text);
-                    nasm_free(t->text);
-                    t->text = tmp;
+                    t->text = pool_intern_free(nasm_strcat(t->text, tt->text));
                     t->next = delete_Token(tt);
                 }
                 break;
@@ -4089,6 +4485,7 @@ expand_smacro(Token * tline)
     Token **params;
     int *paramsize;
     int nparam, sparam, brackets, rescan;
+    unsigned long mhash;
     Token *org_tline = tline;
     Context *ctx;
     char *mname;
@@ -4101,11 +4498,8 @@ expand_smacro(Token * tline)
      */
     if (org_tline)
     {
-        tline =
-                new_Token(org_tline->next, org_tline->type, org_tline->text,
-                0);
+        tline = copy_Token(org_tline->next, org_tline);
         tline->mac = org_tline->mac;
-        nasm_free(org_tline->text);
         org_tline->text = NULL;
     }
 
@@ -4122,8 +4516,9 @@ expand_smacro(Token * tline)
                 ctx = get_ctx(mname, TRUE);
             else
                 ctx = NULL;
+            mhash = hash(mname);
             if (!ctx)
-                head = smacros[hash(mname)];
+                head = smacro_list(mname, mhash);
             else
                 head = ctx->localmac;
             /*
@@ -4133,7 +4528,7 @@ expand_smacro(Token * tline)
              * necessary.
              */
             for (m = head; m; m = m->next)
-                if (!mstrcmp(m->name, mname, m->casesense))
+                if (m->hash == mhash && !mstrcmp(m->name, mname, m->casesense))
                     break;
             if (m)
             {
@@ -4152,14 +4547,17 @@ expand_smacro(Token * tline)
                         if (!strcmp("__FILE__", m->name))
                         {
                             long num = 0;
-                            nasm_src_get(&num, &(tline->text));
-                            nasm_quote(&(tline->text));
+                            char *fname = NULL;
+                            macro_cache.is_volatile = TRUE;
+                            nasm_src_get(&num, &fname);
+                            nasm_quote(&fname);
+                            tline->text = pool_intern_free(fname);
                             tline->type = TOK_STRING;
                             continue;
                         }
                         if (!strcmp("__LINE__", m->name))
                         {
-                            nasm_free(tline->text);
+                            macro_cache.is_volatile = TRUE;
                             make_tok_num(tline, yasm_intnum_create_int(nasm_src_get_linnum()));
                             continue;
                         }
@@ -4332,6 +4730,7 @@ expand_smacro(Token * tline)
                     tt = new_Token(tline, TOK_SMAC_END, NULL, 0);
                     tt->mac = m;
                     m->in_progress = TRUE;
+                    macro_stats.sexpansions++;
                     tline = tt;
                     for (t = m->expansion; t; t = t->next)
                     {
@@ -4346,8 +4745,7 @@ expand_smacro(Token * tline)
                                     --i >= 0;)
                             {
                                 pt = *ptail =
-                                        new_Token(tline, ttt->type, ttt->text,
-                                        0);
+                                        copy_Token(tline, ttt);
                                 ptail = &pt->next;
                                 ttt = ttt->next;
                             }
@@ -4355,7 +4753,7 @@ expand_smacro(Token * tline)
                         }
                         else
                         {
-                            tt = new_Token(tline, t->type, t->text, 0);
+                            tt = copy_Token(tline, t);
                             tline = tt;
                         }
                     }
@@ -4406,10 +4804,8 @@ expand_smacro(Token * tline)
                 t->next->type == TOK_PREPROC_ID ||
                 t->next->type == TOK_NUMBER)
         {
-            char *p = nasm_strcat(t->text, t->next->text);
-            nasm_free(t->text);
+            t->text = pool_intern_free(nasm_strcat(t->text, t->next->text));
             t->next = delete_Token(t->next);
-            t->text = p;
             rescan = 1;
         }
         else if (t->next->type == TOK_WHITESPACE && t->next->next &&
@@ -4532,7 +4928,7 @@ is_mmacro(Token * tline, Token *** params_array)
     Token **params;
     int nparam;
 
-    head = mmacros[hash(tline->text)];
+    head = mmacro_list(tline->text, hash(tline->text));
 
     /*
      * Efficiency: first we see if any macro exists with the given
@@ -4727,6 +5123,7 @@ expand_mmacro(Token * tline)
     ll->finishes = m;
     ll->first = NULL;
     istk->expansion = ll;
+    macro_stats.mexpansions++;
 
     m->in_progress = TRUE;
     m->params = params;
@@ -4761,7 +5158,7 @@ expand_mmacro(Token * tline)
                 if (!x)
                     continue;
             }
-            tt = *tail = new_Token(NULL, x->type, x->text, 0);
+            tt = *tail = copy_Token(NULL, x);
             tail = &tt->next;
         }
         *tail = NULL;
@@ -4820,6 +5217,7 @@ error(int severity, const char *fmt, ...)
 #endif
     va_end(arg);
 
+    macro_cache.messages++;
     if (istk && istk->mstk && istk->mstk->name)
         _error(severity | ERR_PASS1, "(%s:%d) %s", istk->mstk->name,
                 istk->mstk->lineno, buff);
@@ -4827,13 +5225,745 @@ error(int severity, const char *fmt, ...)
         _error(severity | ERR_PASS1, "%s", buff);
 }
 
+/*
+ * Precompiled macro cache.
+ *
+ * The builtin and standard macros, the command line predefines and
+ * the pre-included files (together, the "prelude") are processed
+ * again by every run, although for a given set of options they
+ * almost always just define the same macros. If a cache file has
+ * been set with pp_macro_cache(), the macro tables as they stand
+ * after the prelude are written to it, and later runs with the
+ * same prelude read them back in (in a single, memory-mapped read)
+ * instead of processing the prelude at all.
+ *
+ * A cache is only used if its key, the MD5 of the prelude lines
+ * and the yasm version, matches; and if each file the prelude
+ * included is still found in the same place, with the same MD5.
+ * A prelude is only cached if all it did was define macros: it
+ * must produce no output and no errors or warnings, leave no
+ * condition, context or macro definition open, and not depend on
+ * the environment, __FILE__ or __LINE__.
+ *
+ * The cache file consists of an 8-byte magic number and the
+ * 16-byte key, followed by the included files, the `unique'
+ * counter, a table of all the macro names and token texts, the
+ * single-line macros and the multi-line macros. All numbers are
+ * 32-bit little-endian; a string is its length and then its
+ * characters (length 0xFFFFFFFF denoting NULL); a text is an
+ * index into the string table, plus one (zero denoting NULL), so
+ * that loading interns each distinct string only once; a token
+ * list is a sequence of (type, text) pairs ended by a zero type;
+ * and counts precede the file, string and macro lists and the
+ * lines of a multi-line macro.
+ */
+static const char cache_magic[8] = "YNPPMC2\n";
+
+#define CACHE_HEADER_SIZE   24
+#define CACHE_NULL          0xFFFFFFFFUL
+
+typedef struct CacheBuf
+{
+    unsigned char *data;
+    size_t len, size;
+} CacheBuf;
+
+/*
+ * The string table being built for a cache. Since token texts and
+ * macro names are pooled, strings are looked up by address.
+ */
+typedef struct CacheStrTab
+{
+    const char **strs;          /* strings, in index order */
+    unsigned long nstrs, maxstrs;
+    unsigned long *slots;       /* hash table of indices plus one */
+    unsigned long size;         /* zero or a power of two */
+} CacheStrTab;
+
+typedef struct CacheReader
+{
+    const unsigned char *p, *end;
+    int bad;                    /* set on reading bad data */
+    char **strs;                /* the (pooled) string table */
+    unsigned long nstrs;
+} CacheReader;
+
+/*
+ * Append `n' bytes to a cache buffer, returning where to put them.
+ */
+static unsigned char *
+cache_put(CacheBuf * b, size_t n)
+{
+    unsigned char *p;
+
+    if (b->len + n > b->size)
+    {
+        b->size = b->size * 2 + n + 4096;
+        b->data = nasm_realloc(b->data, b->size);
+    }
+    p = b->data + b->len;
+    b->len += n;
+    return p;
+}
+
+static void
+cache_put_32(CacheBuf * b, unsigned long val)
+{
+    unsigned char *p = cache_put(b, 4);
+    YASM_SAVE_32_L(p, val & 0xFFFFFFFFUL);
+}
+
+static void
+cache_put_str(CacheBuf * b, const char *str)
+{
+    size_t len;
+
+    if (!str)
+    {
+        cache_put_32(b, CACHE_NULL);
+        return;
+    }
+    len = strlen(str);
+    cache_put_32(b, (unsigned long)len);
+    memcpy(cache_put(b, len), str, len);
+}
+
+#define CACHE_STR_HASH(str) \
+    ((unsigned long)((size_t)(str) >> 3) * 2654435761UL)
+
+/*
+ * Put a text, by its index in the string table `st', or as a
+ * string if `st' is NULL.
+ */
 static void
-pp_reset(FILE *f, const char *file, int apass, efunc errfunc, evalfunc eval,
-        ListGen * listgen)
+cache_put_text(CacheBuf * b, CacheStrTab * st, const char *text)
+{
+    unsigned long i, j, index;
+
+    if (!st)
+    {
+        cache_put_str(b, text);
+        return;
+    }
+    if (!text)
+    {
+        cache_put_32(b, 0);
+        return;
+    }
+
+    if ((st->nstrs + 1) * 2 > st->size)
+    {
+        /* grow the hash table */
+        unsigned long oldsize = st->size, *old = st->slots;
+
+        st->size = oldsize ? oldsize * 2 : 4096;
+        st->slots = nasm_malloc(st->size * sizeof(unsigned long));
+        memset(st->slots, 0, st->size * sizeof(unsigned long));
+        for (i = 0; i < oldsize; i++)
+        {
+            if (!old[i])
+                continue;
+            for (j = CACHE_STR_HASH(st->strs[old[i] - 1]) & (st->size - 1);
+                    st->slots[j]; j = (j + 1) & (st->size - 1))
+                ;
+            st->slots[j] = old[i];
+        }
+        nasm_free(old);
+    }
+
+    for (i = CACHE_STR_HASH(text) & (st->size - 1); st->slots[i];
+            i = (i + 1) & (st->size - 1))
+        if (st->strs[st->slots[i] - 1] == text)
+            break;
+    index = st->slots[i];
+    if (!index)
+    {
+        if (st->nstrs == st->maxstrs)
+        {
+            st->maxstrs = st->maxstrs * 2 + 1024;
+            st->strs = nasm_realloc(st->strs,
+                    st->maxstrs * sizeof(const char *));
+        }
+        st->strs[st->nstrs++] = text;
+        index = st->slots[i] = st->nstrs;
+    }
+    cache_put_32(b, index);
+}
+
+static void
+cache_put_tlist(CacheBuf * b, CacheStrTab * st, const Token * t)
+{
+    for (; t; t = t->next)
+    {
+        cache_put_32(b, (unsigned long)t->type);
+        cache_put_text(b, st, t->text);
+    }
+    cache_put_32(b, 0);
+}
+
+static void
+cache_put_llist(CacheBuf * b, CacheStrTab * st, const Line * l)
+{
+    const Line *ll;
+    unsigned long n = 0;
+
+    for (ll = l; ll; ll = ll->next)
+        n++;
+    cache_put_32(b, n);
+    for (; l; l = l->next)
+        cache_put_tlist(b, st, l->first);
+}
+
+static unsigned long
+cache_get_32(CacheReader * r)
+{
+    unsigned long val;
+
+    if (r->end - r->p < 4)
+    {
+        r->bad = TRUE;
+        r->p = r->end;
+        return 0;
+    }
+    YASM_LOAD_32_L(val, r->p);
+    r->p += 4;
+    return val & 0xFFFFFFFFUL;  /* the top byte may be sign extended */
+}
+
+static long
+cache_get_s32(CacheReader * r)
+{
+    unsigned long val = cache_get_32(r);
+
+    if (val & 0x80000000UL)
+        return -(long)(0xFFFFFFFFUL - val) - 1;
+    return (long)val;
+}
+
+/*
+ * Get a string, which is not NUL-terminated; returns NULL (with
+ * `*len' zero) for a NULL string.
+ */
+static const char *
+cache_get_str(CacheReader * r, size_t * len)
+{
+    unsigned long n = cache_get_32(r);
+    const char *str;
+
+    *len = 0;
+    if (r->bad || n == CACHE_NULL)
+        return NULL;
+    if ((unsigned long)(r->end - r->p) < n)
+    {
+        r->bad = TRUE;
+        r->p = r->end;
+        return NULL;
+    }
+    str = (const char *)r->p;
+    r->p += n;
+    *len = n;
+    return str;
+}
+
+static char *
+cache_get_text(CacheReader * r)
+{
+    unsigned long index = cache_get_32(r);
+
+    if (index > r->nstrs)
+    {
+        r->bad = TRUE;
+        return NULL;
+    }
+    return index ? r->strs[index - 1] : NULL;
+}
+
+static Token *
+cache_get_tlist(CacheReader * r)
+{
+    Token *head = NULL, **tail = &head;
+    unsigned long type;
+    char *text;
+
+    while ((type = cache_get_32(r)) != 0)
+    {
+        text = cache_get_text(r);
+        if (r->bad || type == TOK_SMAC_END)
+        {
+            r->bad = TRUE;
+            break;
+        }
+        *tail = new_Token(NULL, (int)type, NULL, 0);
+        if (type != TOK_WHITESPACE)
+            (*tail)->text = text;
+        tail = &(*tail)->next;
+    }
+    return head;
+}
+
+/*
+ * Compute the cache key for the current prelude.
+ */
+static void
+cache_make_key(void)
+{
+    CacheBuf b = { NULL, 0, 0 };
+
+    cache_put_str(&b, PACKAGE_STRING);
+    cache_put_llist(&b, NULL, builtindef);
+    cache_put_llist(&b, NULL, stddef);
+    cache_put_llist(&b, NULL, predef);
+    yasm_checksum_buf(YASM_CHECKSUM_MD5, b.data, b.len, macro_cache.key);
+    nasm_free(b.data);
+}
+
+static void
+cache_free_files(void)
+{
+    long i;
+
+    for (i = 0; i < macro_cache.nfiles; i++)
+    {
+        nasm_free(macro_cache.files[i].name);
+        nasm_free(macro_cache.files[i].path);
+    }
+    nasm_free(macro_cache.files);
+    macro_cache.files = NULL;
+    macro_cache.nfiles = macro_cache.maxfiles = 0;
+    nasm_free(macro_cache.fname);
+    macro_cache.fname = NULL;
+}
+
+static CacheFile *
+cache_new_file(void)
+{
+    if (macro_cache.nfiles == macro_cache.maxfiles)
+    {
+        macro_cache.maxfiles = macro_cache.maxfiles * 2 + 16;
+        macro_cache.files = nasm_realloc(macro_cache.files,
+                macro_cache.maxfiles * sizeof(CacheFile));
+    }
+    return &macro_cache.files[macro_cache.nfiles++];
+}
+
+/*
+ * Record a file included by the prelude: `name' as given to
+ * %include, which was found at `path'.
+ */
+static void
+cache_add_file(const char *name, const char *path)
+{
+    CacheFile *f;
+    long parent = -1;
+
+    /* The includer is the last such file, unless it's the main one */
+    if (istk->next)
+    {
+        for (parent = macro_cache.nfiles - 1; parent >= 0; parent--)
+            if (!strcmp(macro_cache.files[parent].path,
+                        nasm_src_get_fname()))
+                break;
+        if (parent < 0)
+            macro_cache.is_volatile = TRUE;
+    }
+
+    f = cache_new_file();
+    f->name = nasm_strdup(name);
+    f->parent = parent;
+    f->path = nasm_strdup(path);
+    if (yasm_checksum_file(path, YASM_CHECKSUM_MD5, f->digest) != 0)
+        macro_cache.is_volatile = TRUE;
+}
+
+/*
+ * Check that a recorded file is still the one the prelude would
+ * include, and still has the same contents.
+ */
+static int
+cache_check_file(const CacheFile * f)
+{
+    unsigned char digest[16];
+    const char *from;
+    char *combine = NULL;
+    FILE *fp;
+    int ok;
+
+    from = f->parent < 0 ? nasm_src_get_fname() :
+        macro_cache.files[f->parent].path;
+    fp = yasm_fopen_include(f->name, from, "r", &combine);
+    if (!fp)
+        return FALSE;
+    fclose(fp);
+    ok = !strcmp(combine, f->path) &&
+        yasm_checksum_file(f->path, YASM_CHECKSUM_MD5, digest) == 0 &&
+        !memcmp(digest, f->digest, 16);
+    nasm_free(combine);
+    return ok;
+}
+
+/*
+ * Read the included file records from a cache, and check them.
+ */
+static int
+cache_load_files(CacheReader * r)
+{
+    unsigned long i, n = cache_get_32(r);
+    const char *str;
+    size_t len;
+
+    for (i = 0; i < n && !r->bad; i++)
+    {
+        CacheFile *f = cache_new_file();
+
+        f->name = NULL;
+        f->path = NULL;
+        str = cache_get_str(r, &len);
+        if (str)
+            f->name = nasm_strndup(str, len);
+        f->parent = cache_get_s32(r);
+        str = cache_get_str(r, &len);
+        if (str)
+            f->path = nasm_strndup(str, len);
+        if (r->end - r->p < 16)
+            r->bad = TRUE;
+        if (r->bad || !f->name || !f->path || f->parent < -1 ||
+                f->parent >= (long)i)
+            return FALSE;
+        memcpy(f->digest, r->p, 16);
+        r->p += 16;
+        if (!cache_check_file(f))
+            return FALSE;
+    }
+    return !r->bad;
+}
+
+/*
+ * Read the string table and define the macros in a cache. Each
+ * macro is added at the end of its list, so the lists come out in
+ * the order they were written in.
+ */
+static void
+cache_load_macros(CacheReader * r)
+{
+    unsigned long i, j, n, nlines;
+    const char *str;
+    char *name;
+    size_t len;
+
+    n = cache_get_32(r);
+    if ((unsigned long)(r->end - r->p) / 4 < n)
+    {
+        r->bad = TRUE;
+        return;
+    }
+    r->strs = nasm_malloc((n ? n : 1) * sizeof(char *));
+    for (i = 0; i < n && !r->bad; i++)
+    {
+        str = cache_get_str(r, &len);
+        r->strs[i] = str ? pool_intern(str, len) : NULL;
+    }
+    r->nstrs = n;
+
+    n = cache_get_32(r);
+    for (i = 0; i < n && !r->bad; i++)
+    {
+        SMacro *s, **tail;
+
+        name = cache_get_text(r);
+        if (!name)
+        {
+            r->bad = TRUE;
+            break;
+        }
+        s = nasm_malloc(sizeof(SMacro));
+        s->next = NULL;
+        s->name = name;
+        s->hash = hash(name);
+        s->casesense = (int)cache_get_32(r);
+        s->nparam = (int)cache_get_32(r);
+        s->level = (int)cache_get_32(r);
+        s->in_progress = FALSE;
+        s->expansion = cache_get_tlist(r);
+        for (tail = smacro_head(name, s->hash); *tail;
+                tail = &(*tail)->next)
+            ;
+        *tail = s;
+    }
+
+    n = cache_get_32(r);
+    for (i = 0; i < n && !r->bad; i++)
+    {
+        MMacro *m, **tail;
+        Line **ltail;
+
+        name = cache_get_text(r);
+        if (!name)
+        {
+            r->bad = TRUE;
+            break;
+        }
+        m = nasm_malloc(sizeof(MMacro));
+        memset(m, 0, sizeof(MMacro));
+        m->name = name;
+        m->hash = hash(name);
+        m->casesense = (int)cache_get_32(r);
+        m->nparam_min = cache_get_s32(r);
+        m->nparam_max = cache_get_s32(r);
+        m->plus = (int)cache_get_32(r);
+        m->nolist = (int)cache_get_32(r);
+        m->dlist = cache_get_tlist(r);
+        if (m->dlist)
+            count_mmac_params(m->dlist, &m->ndefs, &m->defaults);
+        nlines = cache_get_32(r);
+        ltail = &m->expansion;
+        for (j = 0; j < nlines && !r->bad; j++)
+        {
+            Line *l = nasm_malloc(sizeof(Line));
+            l->next = NULL;
+            l->finishes = NULL;
+            l->first = cache_get_tlist(r);
+            *ltail = l;
+            ltail = &l->next;
+        }
+        for (tail = mmacro_head(name, m->hash); *tail;
+                tail = &(*tail)->next)
+            ;
+        *tail = m;
+    }
+}
+
+/*
+ * Define the prelude's macros from the cache, if it's valid for
+ * this prelude. Returns TRUE if it was used.
+ */
+static int
+cache_load(void)
+{
+    FILE *fp;
+    yasm_srcbuf *src;
+    CacheReader r;
+    unsigned long saved_unique;
+    size_t len;
+    long i;
+    int ok = FALSE;
+
+    cache_make_key();
+    fp = fopen(macro_cache.filename, "rb");
+    if (!fp)
+        return FALSE;
+    src = yasm_srcbuf_create(fp);
+    r.p = (const unsigned char *)yasm_srcbuf_get_rest(src, &len);
+    r.end = r.p + len;
+    r.bad = FALSE;
+    r.strs = NULL;
+    r.nstrs = 0;
+
+    if (len >= CACHE_HEADER_SIZE && !memcmp(r.p, cache_magic, 8) &&
+            !memcmp(r.p + 8, macro_cache.key, 16))
+    {
+        r.p += CACHE_HEADER_SIZE;
+        if (cache_load_files(&r))
+        {
+            saved_unique = unique;
+            unique = cache_get_32(&r);
+            cache_load_macros(&r);
+            if (r.bad)
+            {
+                /* the tables were empty to start with */
+                free_macro_tables();
+                unique = saved_unique;
+            }
+            else
+                ok = TRUE;
+        }
+    }
+
+    nasm_free(r.strs);
+    yasm_srcbuf_destroy(src);
+    fclose(fp);
+    if (ok)
+        for (i = 0; i < macro_cache.nfiles; i++)
+            nasm_preproc_add_dep(macro_cache.files[i].path);
+    cache_free_files();
+    return ok;
+}
+
+/*
+ * Start recording the prelude, which is about to be processed.
+ */
+static void
+cache_start(void)
+{
+    macro_cache.recording = TRUE;
+    macro_cache.is_volatile = FALSE;
+    macro_cache.messages = 0;
+    macro_cache.lines = pool_stats.lines;
+    macro_cache.fname = nasm_strdup(nasm_src_get_fname());
+    macro_cache.linnum = nasm_src_get_linnum();
+    macro_cache.level = Level;
+    macro_cache.stacksize = StackSize;
+    macro_cache.argoffset = ArgOffset;
+    macro_cache.localoffset = LocalOffset;
+    macro_cache.stackpointer = StackPointer;
+}
+
+/*
+ * Determine whether the prelude just processed did nothing but
+ * define macros which can be written out.
+ */
+static int
+cache_prelude_clean(void)
+{
+    unsigned long i;
+    SMacro *s;
+    MMacro *m;
+    Token *t;
+
+    if (macro_cache.is_volatile || macro_cache.messages != 0 ||
+            defining || cstk || istk->next || istk->conds ||
+            istk->mstk || istk->expansion ||
+            pool_stats.lines != macro_cache.lines ||
+            nasm_src_get_linnum() != macro_cache.linnum ||
+            strcmp(nasm_src_get_fname(), macro_cache.fname) ||
+            Level != macro_cache.level ||
+            StackSize != macro_cache.stacksize ||
+            ArgOffset != macro_cache.argoffset ||
+            LocalOffset != macro_cache.localoffset ||
+            StackPointer != macro_cache.stackpointer)
+        return FALSE;
+
+    for (i = 0; i < smacros.size; i++)
+        for (s = smacros.slots[i].key ? smacros.slots[i].list.s : NULL;
+                s; s = s->next)
+        {
+            if (s->in_progress)
+                return FALSE;
+            for (t = s->expansion; t; t = t->next)
+                if (t->type == TOK_SMAC_END)
+                    return FALSE;
+        }
+    for (i = 0; i < mmacros.size; i++)
+        for (m = mmacros.slots[i].key ? mmacros.slots[i].list.m : NULL;
+                m; m = m->next)
+            if (m->in_progress || m->nparam_min < -0x7FFFFFFFL ||
+                    m->nparam_max > 0x7FFFFFFFL)
+                return FALSE;
+    return TRUE;
+}
+
+/*
+ * Write out the macro tables, if the prelude (which has just been
+ * processed) can be cached. Any failure to write simply leaves the
+ * cache as it was.
+ */
+static void
+cache_save(void)
+{
+    CacheBuf b = { NULL, 0, 0 }, body = { NULL, 0, 0 };
+    CacheStrTab st = { NULL, 0, 0, NULL, 0 };
+    unsigned long i, n;
+    char *tmpname;
+    FILE *fp;
+    SMacro *s;
+    MMacro *m;
+    long f;
+    int ok;
+
+    macro_cache.recording = FALSE;
+    if (!cache_prelude_clean())
+    {
+        cache_free_files();
+        return;
+    }
+
+    /* The macros go after the string table, which they build */
+    for (i = 0, n = 0; i < smacros.size; i++)
+        for (s = smacros.slots[i].key ? smacros.slots[i].list.s : NULL;
+                s; s = s->next)
+            n++;
+    cache_put_32(&body, n);
+    for (i = 0; i < smacros.size; i++)
+        for (s = smacros.slots[i].key ? smacros.slots[i].list.s : NULL;
+                s; s = s->next)
+        {
+            cache_put_text(&body, &st, s->name);
+            cache_put_32(&body, (unsigned long)s->casesense);
+            cache_put_32(&body, (unsigned long)s->nparam);
+            cache_put_32(&body, (unsigned long)s->level);
+            cache_put_tlist(&body, &st, s->expansion);
+        }
+
+    for (i = 0, n = 0; i < mmacros.size; i++)
+        for (m = mmacros.slots[i].key ? mmacros.slots[i].list.m : NULL;
+                m; m = m->next)
+            n++;
+    cache_put_32(&body, n);
+    for (i = 0; i < mmacros.size; i++)
+        for (m = mmacros.slots[i].key ? mmacros.slots[i].list.m : NULL;
+                m; m = m->next)
+        {
+            cache_put_text(&body, &st, m->name);
+            cache_put_32(&body, (unsigned long)m->casesense);
+            cache_put_32(&body, (unsigned long)m->nparam_min);
+            cache_put_32(&body, (unsigned long)m->nparam_max);
+            cache_put_32(&body, (unsigned long)m->plus);
+            cache_put_32(&body, (unsigned long)m->nolist);
+            cache_put_tlist(&body, &st, m->dlist);
+            cache_put_llist(&body, &st, m->expansion);
+        }
+
+    memcpy(cache_put(&b, 8), cache_magic, 8);
+    memcpy(cache_put(&b, 16), macro_cache.key, 16);
+    cache_put_32(&b, (unsigned long)macro_cache.nfiles);
+    for (f = 0; f < macro_cache.nfiles; f++)
+    {
+        cache_put_str(&b, macro_cache.files[f].name);
+        cache_put_32(&b, (unsigned long)macro_cache.files[f].parent);
+        cache_put_str(&b, macro_cache.files[f].path);
+        memcpy(cache_put(&b, 16), macro_cache.files[f].digest, 16);
+    }
+    cache_free_files();
+    cache_put_32(&b, unique);
+    cache_put_32(&b, st.nstrs);
+    for (i = 0; i < st.nstrs; i++)
+        cache_put_str(&b, st.strs[i]);
+    memcpy(cache_put(&b, body.len), body.data, body.len);
+    nasm_free(body.data);
+    nasm_free(st.strs);
+    nasm_free(st.slots);
+
+    /*
+     * Write to a temporary file, and rename it into place, so that
+     * concurrent runs never see a partly written cache.  The name is
+     * unique to this process (pid) and thread (address of a local).
+     */
+    tmpname = nasm_malloc(strlen(macro_cache.filename) + 40);
+    sprintf(tmpname, "%s.%lx.%lx", macro_cache.filename,
+            (unsigned long)getpid(), (unsigned long)(size_t)&b);
+    fp = fopen(tmpname, "wb");
+    if (fp)
+    {
+        ok = fwrite(b.data, 1, b.len, fp) == b.len;
+        ok = fclose(fp) == 0 && ok;
+        if (ok && rename(tmpname, macro_cache.filename) != 0)
+        {
+            /* rename() may not replace an existing file */
+            remove(macro_cache.filename);
+            ok = rename(tmpname, macro_cache.filename) == 0;
+        }
+        if (!ok)
+            remove(tmpname);
+    }
+    nasm_free(tmpname);
+    nasm_free(b.data);
+}
+
+static void
+pp_reset(yasm_srcbuf *src, const char *file, int apass, efunc errfunc,
+        evalfunc eval, ListGen * listgen)
 {
     int h;
 
-    first_fp = f;
     _error = errfunc;
     cstk = NULL;
     istk = nasm_malloc(sizeof(Include));
@@ -4841,7 +5971,8 @@ pp_reset(FILE *f, const char *file, int apass, efunc errfunc, evalfunc eval,
     istk->conds = NULL;
     istk->expansion = NULL;
     istk->mstk = NULL;
-    istk->fp = f;
+    istk->fp = NULL;            /* owned by the caller */
+    istk->src = src;
     istk->fname = NULL;
     nasm_free(nasm_src_set_fname(nasm_strdup(file)));
     nasm_src_set_linnum(0);
@@ -4849,11 +5980,10 @@ pp_reset(FILE *f, const char *file, int apass, efunc errfunc, evalfunc eval,
     defining = NULL;
     nested_mac_count = 0;
     nested_rep_count = 0;
-    for (h = 0; h < NHASH; h++)
-    {
-        mmacros[h] = NULL;
-        smacros[h] = NULL;
-    }
+    for (h = 0; h < 256; h++)
+        hash_fold[h] = (unsigned char)toupper(h);
+    memset(&macro_stats, 0, sizeof(macro_stats));
+    memset(&pool_stats, 0, sizeof(pool_stats));
     unique = 0;
     if (tasm_compatible_mode) {
         pp_extra_stdmac(tasm_compat_macros);
@@ -4862,6 +5992,7 @@ pp_reset(FILE *f, const char *file, int apass, efunc errfunc, evalfunc eval,
     evaluate = eval;
     pass = apass;
     first_line = 1;
+    macro_cache.recording = FALSE;
 }
 
 /*
@@ -4882,7 +6013,7 @@ poke_predef(Line *predef_lines)
         tail = &head;
         for (t = pd->first; t; t = t->next)
         {
-            *tail = new_Token(NULL, t->type, t->text, 0);
+            *tail = copy_Token(NULL, t);
             tail = &(*tail)->next;
         }
         l = nasm_malloc(sizeof(Line));
@@ -4909,10 +6040,15 @@ pp_getline(void)
 
         if (first_line)
         {
-            /* Reverse order */
-            poke_predef(predef);
-            poke_predef(stddef);
-            poke_predef(builtindef);
+            if (!macro_cache.filename || !cache_load())
+            {
+                if (macro_cache.filename)
+                    cache_start();
+                /* Reverse order */
+                poke_predef(predef);
+                poke_predef(stddef);
+                poke_predef(builtindef);
+            }
             first_line = 0;
         }
 
@@ -4953,7 +6089,7 @@ pp_getline(void)
                     {
                         if (t->text || t->type == TOK_WHITESPACE)
                         {
-                            tt = *tail = new_Token(NULL, t->type, t->text, 0);
+                            tt = *tail = copy_Token(NULL, t);
                             tail = &tt->next;
                         }
                     }
@@ -5023,6 +6159,8 @@ pp_getline(void)
                 nasm_free(p);
                 break;
             }
+            if (macro_cache.recording && !istk->next)
+                cache_save();   /* the prelude is done */
             line = read_line();
             if (line)
             {                   /* from the current input file */
@@ -5036,7 +6174,8 @@ pp_getline(void)
              */
             {
                 Include *i = istk;
-                if (i->fp != first_fp)
+                yasm_srcbuf_destroy(i->src);
+                if (i->fp)
                     fclose(i->fp);
                 if (i->conds)
                     error(ERR_FATAL, "expected `%%endif' before end of file");
@@ -5127,6 +6266,8 @@ pp_getline(void)
 
                 line = detoken(tline, TRUE);
                 free_tlist(tline);
+                pool_stats.lines++;
+                pool_stats.line_bytes += strlen(line);
                 break;
             }
             else
@@ -5142,8 +6283,6 @@ pp_getline(void)
 static void
 pp_cleanup(int pass_)
 {
-    int h;
-
     if (pass_ == 1)
     {
         if (defining)
@@ -5156,28 +6295,13 @@ pp_cleanup(int pass_)
     }
     while (cstk)
         ctx_pop();
-    for (h = 0; h < NHASH; h++)
-    {
-        while (mmacros[h])
-        {
-            MMacro *m = mmacros[h];
-            mmacros[h] = mmacros[h]->next;
-            free_mmacro(m);
-        }
-        while (smacros[h])
-        {
-            SMacro *s = smacros[h];
-            smacros[h] = smacros[h]->next;
-            nasm_free(s->name);
-            free_tlist(s->expansion);
-            nasm_free(s);
-        }
-    }
+    free_macro_tables();
     while (istk)
     {
         Include *i = istk;
         istk = istk->next;
-        if (i->fp != first_fp)
+        yasm_srcbuf_destroy(i->src);
+        if (i->fp)
             fclose(i->fp);
         nasm_free(i->fname);
         nasm_free(i);
@@ -5192,7 +6316,12 @@ pp_cleanup(int pass_)
                 builtindef = NULL;
                 stddef = NULL;
                 predef = NULL;
+                cache_free_files();
+                nasm_free(macro_cache.filename);
+                macro_cache.filename = NULL;
+                macro_cache.recording = FALSE;
                 freeTokens = NULL;
+                pool_cleanup();
                 delete_Blocks();
                 blocks.next = NULL;
                 blocks.chunk = NULL;
@@ -5302,10 +6431,46 @@ pp_extra_stdmac(const char **macros)
     }
 }
 
+/*
+ * Cache the macros defined by the prelude in the given file (see
+ * "Precompiled macro cache" above). Not supported in TASM mode.
+ */
+void
+pp_macro_cache(const char *filename)
+{
+    nasm_free(macro_cache.filename);
+    macro_cache.filename = tasm_compatible_mode ? NULL :
+        nasm_strdup(filename);
+}
+
+void
+pp_get_stats(yasm_preproc_stat_func func, void *d)
+{
+    func("smacro table slots", smacros.size, d);
+    func("smacro names", smacros.used, d);
+    func("mmacro table slots", mmacros.size, d);
+    func("mmacro names", mmacros.used, d);
+    func("macro table lookups", macro_stats.lookups, d);
+    func("macro table probes", macro_stats.probes, d);
+    func("macro table longest probe", macro_stats.max_probe, d);
+    func("macro table resizes", macro_stats.grows, d);
+    func("smacro expansions", macro_stats.sexpansions, d);
+    func("mmacro expansions", macro_stats.mexpansions, d);
+    func("tokens created", pool_stats.tokens, d);
+    func("token blocks allocated", pool_stats.token_blocks, d);
+    func("strings interned", pool_stats.interns, d);
+    func("bytes interned", pool_stats.intern_bytes, d);
+    func("string pool strings", pool.used, d);
+    func("string pool bytes", pool_stats.pool_bytes, d);
+    func("string pool chunks allocated", pool_stats.pool_chunks, d);
+    func("lines output", pool_stats.lines, d);
+    func("bytes output", pool_stats.line_bytes, d);
+}
+
 static void
 make_tok_num(Token * tok, yasm_intnum *val)
 {
-    tok->text = yasm_intnum_get_str(val);
+    tok->text = pool_intern_free(yasm_intnum_get_str(val));
     tok->type = TOK_NUMBER;
     yasm_intnum_destroy(val);
 }
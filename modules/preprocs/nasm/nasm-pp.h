@@ -14,6 +14,8 @@ void pp_pre_define (char *);
 void pp_pre_undefine (char *);
 void pp_builtin_define (char *);
 void pp_extra_stdmac (const char **);
+void pp_get_stats (yasm_preproc_stat_func, void *);
+void pp_macro_cache (const char *);
 
 extern Preproc nasmpp;
 
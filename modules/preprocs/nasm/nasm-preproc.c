@@ -42,12 +42,12 @@ typedef struct yasm_preproc_nasm {
     long prior_linnum;
     int lineinc;
 } yasm_preproc_nasm;
-yasm_symtab *nasm_symtab;
-static yasm_linemap *cur_lm;
-static yasm_errwarns *cur_errwarns;
-int tasm_compatible_mode = 0;
-int tasm_locals;
-const char *tasm_segment;
+YASM_THREAD_LOCAL yasm_symtab *nasm_symtab;
+static YASM_THREAD_LOCAL yasm_linemap *cur_lm;
+static YASM_THREAD_LOCAL yasm_errwarns *cur_errwarns;
+YASM_THREAD_LOCAL int tasm_compatible_mode = 0;
+YASM_THREAD_LOCAL int tasm_locals;
+YASM_THREAD_LOCAL const char *tasm_segment;
 
 #include "nasm-version.c"
 
@@ -56,8 +56,9 @@ typedef struct preproc_dep {
     char *name;
 } preproc_dep;
 
-static STAILQ_HEAD(preproc_dep_head, preproc_dep) *preproc_deps;
-static int done_dep_preproc;
+static YASM_THREAD_LOCAL STAILQ_HEAD(preproc_dep_head, preproc_dep)
+    *preproc_deps;
+static YASM_THREAD_LOCAL int done_dep_preproc;
 
 yasm_preproc_module yasm_nasm_LTX_preproc;
 
@@ -131,22 +132,14 @@ nasm_efunc(int severity, const char *fmt, ...)
 }
 
 static yasm_preproc *
-nasm_preproc_create(const char *in_filename, yasm_symtab *symtab,
-                    yasm_linemap *lm, yasm_errwarns *errwarns)
+nasm_preproc_create_src(const char *in_filename, /*@null@*/ FILE *f,
+                        yasm_srcbuf *src, yasm_symtab *symtab,
+                        yasm_linemap *lm, yasm_errwarns *errwarns)
 {
-    FILE *f;
     yasm_preproc_nasm *preproc_nasm = yasm_xmalloc(sizeof(yasm_preproc_nasm));
 
     preproc_nasm->preproc.module = &yasm_nasm_LTX_preproc;
 
-    if (strcmp(in_filename, "-") != 0) {
-        f = fopen(in_filename, "r");
-        if (!f)
-            yasm__fatal( N_("Could not open input file") );
-    }
-    else
-        f = stdin;
-
     preproc_nasm->in = f;
     nasm_symtab = symtab;
     cur_lm = lm;
@@ -157,18 +150,57 @@ nasm_preproc_create(const char *in_filename, yasm_symtab *symtab,
     preproc_nasm->file_name = NULL;
     preproc_nasm->prior_linnum = 0;
     preproc_nasm->lineinc = 0;
-    nasmpp.reset(f, in_filename, 2, nasm_efunc, nasm_evaluate, &nil_list);
+    nasmpp.reset(src, in_filename, 2, nasm_efunc, nasm_evaluate, &nil_list);
 
     pp_extra_stdmac(nasm_version_mac);
 
     return (yasm_preproc *)preproc_nasm;
 }
 
+static yasm_preproc *
+nasm_preproc_open(const char *in_filename, yasm_symtab *symtab,
+                  yasm_linemap *lm, yasm_errwarns *errwarns)
+{
+    FILE *f;
+
+    if (strcmp(in_filename, "-") != 0) {
+        f = fopen(in_filename, "r");
+        if (!f)
+            yasm__fatal( N_("Could not open input file") );
+    }
+    else
+        f = stdin;
+
+    return nasm_preproc_create_src(in_filename, f, yasm_srcbuf_create(f),
+                                   symtab, lm, errwarns);
+}
+
+static yasm_preproc *
+nasm_preproc_create(const char *in_filename, yasm_symtab *symtab,
+                    yasm_linemap *lm, yasm_errwarns *errwarns)
+{
+    tasm_compatible_mode = 0;
+    return nasm_preproc_open(in_filename, symtab, lm, errwarns);
+}
+
+static yasm_preproc *
+nasm_preproc_create_mem(const char *in_filename, const char *buf, size_t len,
+                        yasm_symtab *symtab, yasm_linemap *lm,
+                        yasm_errwarns *errwarns)
+{
+    tasm_compatible_mode = 0;
+    return nasm_preproc_create_src(in_filename, NULL,
+                                   yasm_srcbuf_create_mem(buf, len), symtab,
+                                   lm, errwarns);
+}
+
 static void
 nasm_preproc_destroy(yasm_preproc *preproc)
 {
     yasm_preproc_nasm *preproc_nasm = (yasm_preproc_nasm *)preproc;
     nasmpp.cleanup(0);
+    if (preproc_nasm->in && preproc_nasm->in != stdin)
+        fclose(preproc_nasm->in);
     if (preproc_nasm->line)
         yasm_xfree(preproc_nasm->line);
     if (preproc_nasm->file_name)
@@ -304,6 +336,19 @@ nasm_preproc_add_standard(yasm_preproc *preproc, const char **macros)
     pp_extra_stdmac(macros);
 }
 
+static void
+nasm_preproc_get_stats(yasm_preproc *preproc, yasm_preproc_stat_func func,
+                       void *d)
+{
+    pp_get_stats(func, d);
+}
+
+static void
+nasm_preproc_set_macro_cache(yasm_preproc *preproc, const char *filename)
+{
+    pp_macro_cache(filename);
+}
+
 /* Define preproc structure -- see preproc.h for details */
 yasm_preproc_module yasm_nasm_LTX_preproc = {
     "Real NASM Preprocessor",
@@ -316,7 +361,10 @@ yasm_preproc_module yasm_nasm_LTX_preproc = {
     nasm_preproc_predefine_macro,
     nasm_preproc_undefine_macro,
     nasm_preproc_define_builtin,
-    nasm_preproc_add_standard
+    nasm_preproc_add_standard,
+    nasm_preproc_get_stats,
+    nasm_preproc_create_mem,
+    nasm_preproc_set_macro_cache
 };
 
 static yasm_preproc *
@@ -324,7 +372,18 @@ tasm_preproc_create(const char *in_filename, yasm_symtab *symtab,
                     yasm_linemap *lm, yasm_errwarns *errwarns)
 {
     tasm_compatible_mode = 1;
-    return nasm_preproc_create(in_filename, symtab, lm, errwarns);
+    return nasm_preproc_open(in_filename, symtab, lm, errwarns);
+}
+
+static yasm_preproc *
+tasm_preproc_create_mem(const char *in_filename, const char *buf, size_t len,
+                        yasm_symtab *symtab, yasm_linemap *lm,
+                        yasm_errwarns *errwarns)
+{
+    tasm_compatible_mode = 1;
+    return nasm_preproc_create_src(in_filename, NULL,
+                                   yasm_srcbuf_create_mem(buf, len), symtab,
+                                   lm, errwarns);
 }
 
 yasm_preproc_module yasm_tasm_LTX_preproc = {
@@ -338,5 +397,8 @@ yasm_preproc_module yasm_tasm_LTX_preproc = {
     nasm_preproc_predefine_macro,
     nasm_preproc_undefine_macro,
     nasm_preproc_define_builtin,
-    nasm_preproc_add_standard
+    nasm_preproc_add_standard,
+    nasm_preproc_get_stats,
+    tasm_preproc_create_mem,
+    NULL
 };
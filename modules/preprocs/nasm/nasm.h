@@ -201,16 +201,20 @@ enum {                                 /* token types, other than chars */
 typedef yasm_expr *(*evalfunc) (scanner sc, void *scprivate, struct tokenval *tv,
                            int critical, efunc error);
 
+struct yasm_srcbuf;
+
 /*
  * Preprocessors ought to look like this:
  */
 typedef struct {
     /*
-     * Called at the start of a pass; given a file name, the number
+     * Called at the start of a pass; given the source (which the
+     * preprocessor takes ownership of), a file name, the number
      * of the pass, an error reporting function, an evaluator
      * function, and a listing generator to talk to.
      */
-    void (*reset) (FILE *, const char *, int, efunc, evalfunc, ListGen *);
+    void (*reset) (struct yasm_srcbuf *, const char *, int, efunc, evalfunc,
+                   ListGen *);
 
     /*
      * Called to fetch a line of preprocessed source. The line
@@ -275,9 +279,9 @@ enum {
 
 #define elements(x)     ( sizeof(x) / sizeof(*(x)) )
 
-extern int tasm_compatible_mode;
-extern int tasm_locals;
-extern const char *tasm_segment;
+extern YASM_THREAD_LOCAL int tasm_compatible_mode;
+extern YASM_THREAD_LOCAL int tasm_locals;
+extern YASM_THREAD_LOCAL const char *tasm_segment;
 const char *tasm_get_segment_register(const char *segment);
 
 #endif
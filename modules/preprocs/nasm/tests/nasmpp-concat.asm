@@ -0,0 +1,36 @@
+; Token text that is modified or rebuilt during preprocessing
+%define FOO 1
+%idefine Bar 3
+db FOO, BAR, bar, Bar
+%ifidn 'abc', "abc"
+db 'a'
+%endif
+%ifidn 'abc', 'abd'
+db 'b'
+%endif
+%ifidni 'ABC', "abc"
+db 'c'
+%endif
+%ifidn x, X
+db 'd'
+%endif
+%ifidni x, X
+db 'e'
+%endif
+%substr s1 'hello' 2
+%substr s2 'hello' 9
+db s1, s2
+%define cat(a,b) a %+ b
+%define abcdef 7
+db cat(abc,def)
+%assign n 0
+%rep 3
+%assign n n+1
+db n
+%endrep
+%macro m1 2
+  %%lbl: db %1, %2, %0
+  dw %%lbl
+%endmacro
+m1 4, 5
+m1 6, 7
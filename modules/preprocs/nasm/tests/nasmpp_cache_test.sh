@@ -0,0 +1,91 @@
+#! /bin/sh
+# Record and reuse a --macro-cache, and check that changing the -P prelude
+# or the include path it was recorded with makes yasm write it again.  A
+# cache that was reused is still the same file (it was not renamed over).
+
+YASM_TEST_SUITE=1
+export YASM_TEST_SUITE
+
+case `echo "testing\c"; echo 1,2,3`,`echo -n testing; echo 1,2,3` in
+  *c*,-n*) ECHO_N= ECHO_C='
+' ECHO_T='      ' ;;
+  *c*,*  ) ECHO_N=-n ECHO_C= ECHO_T= ;;
+  *)       ECHO_N= ECHO_C='\c' ECHO_T= ;;
+esac
+
+dir=results/nasmpp_cache
+cache=${dir}/macros.cache
+
+rm -rf ${dir}
+mkdir -p ${dir}/incA ${dir}/incB >/dev/null 2>&1
+
+echo '%define VAL 0x11' > ${dir}/incA/defs.inc
+echo '%define VAL 0x22' > ${dir}/incB/defs.inc
+printf '%%include "defs.inc"\n%%define BASE 1\n' > ${dir}/prelude1.inc
+printf '%%include "defs.inc"\n%%define BASE 2\n' > ${dir}/prelude2.inc
+echo 'db VAL, BASE' > ${dir}/in.asm
+
+passedct=0
+failedct=0
+
+# run <name> <prelude> <include dir> <expected hex>
+# (the prelude is looked for next to the source file)
+run()
+{
+    rm -f ${dir}/$1
+    sh -c "./yasm -f bin -P $2 -I ${dir}/$3/ --macro-cache=${cache} -o ${dir}/$1 ${dir}/in.asm 2>${dir}/$1.ew" >/dev/null 2>/dev/null
+    test $? -eq 0 && test \! -s ${dir}/$1.ew && test -f ${cache} \
+        && test "`od -An -tx1 ${dir}/$1 | tr -d ' \n'`" = "$4"
+}
+
+pass()
+{
+    echo $ECHO_N ".$ECHO_C"
+    passedct=`expr $passedct + 1`
+}
+
+fail()
+{
+    echo $ECHO_N "F$ECHO_C"
+    eval "failed$failedct='F: $1'"
+    failedct=`expr $failedct + 1`
+}
+
+echo $ECHO_N "Test nasmpp_cache_test: $ECHO_C"
+
+# Record
+if run record prelude1.inc incA 1101; then pass
+else fail "recording the cache failed"; fi
+
+# Reuse: same output, and the cache is left alone
+ln ${cache} ${dir}/cache.1
+if run reuse prelude1.inc incA 1101 && test ${cache} -ef ${dir}/cache.1 \
+    && cmp -s ${dir}/record ${dir}/reuse; then pass
+else fail "cache was not reused"; fi
+
+# Different -P prelude: rewritten
+rm -f ${dir}/cache.1
+ln ${cache} ${dir}/cache.1
+if run prelude prelude2.inc incA 1102 \
+    && test \! ${cache} -ef ${dir}/cache.1; then pass
+else fail "cache was not rewritten for a new prelude"; fi
+
+# Different include path (prelude includes a different defs.inc): rewritten
+rm -f ${dir}/cache.1
+ln ${cache} ${dir}/cache.1
+if run incpath prelude2.inc incB 2202 \
+    && test \! ${cache} -ef ${dir}/cache.1; then pass
+else fail "cache was not rewritten for a new include path"; fi
+
+ct=`expr $failedct + $passedct`
+per=`expr 100 \* $passedct / $ct`
+
+echo " +$passedct-$failedct/$ct $per%"
+i=0
+while test $i -lt $failedct; do
+    eval "failure=\$failed$i"
+    echo " ** $failure"
+    i=`expr $i + 1`
+done
+
+exit $failedct
@@ -29,24 +29,37 @@
 #include <libyasm.h>
 
 
-#define BSIZE 512
-
 typedef struct yasm_preproc_raw {
     yasm_preproc_base preproc;   /* base structure */
 
     FILE *in;
+    yasm_srcbuf *src;
     yasm_linemap *cur_lm;
     yasm_errwarns *errwarns;
 } yasm_preproc_raw;
 
 yasm_preproc_module yasm_raw_LTX_preproc;
 
+static yasm_preproc *
+raw_preproc_create_src(/*@null@*/ FILE *f, yasm_srcbuf *src,
+                       yasm_linemap *lm, yasm_errwarns *errwarns)
+{
+    yasm_preproc_raw *preproc_raw = yasm_xmalloc(sizeof(yasm_preproc_raw));
+
+    preproc_raw->preproc.module = &yasm_raw_LTX_preproc;
+    preproc_raw->in = f;
+    preproc_raw->src = src;
+    preproc_raw->cur_lm = lm;
+    preproc_raw->errwarns = errwarns;
+
+    return (yasm_preproc *)preproc_raw;
+}
+
 static yasm_preproc *
 raw_preproc_create(const char *in_filename, yasm_symtab *symtab,
                    yasm_linemap *lm, yasm_errwarns *errwarns)
 {
     FILE *f;
-    yasm_preproc_raw *preproc_raw = yasm_xmalloc(sizeof(yasm_preproc_raw));
 
     if (strcmp(in_filename, "-") != 0) {
         f = fopen(in_filename, "r");
@@ -56,17 +69,25 @@ raw_preproc_create(const char *in_filename, yasm_symtab *symtab,
     else
         f = stdin;
 
-    preproc_raw->preproc.module = &yasm_raw_LTX_preproc;
-    preproc_raw->in = f;
-    preproc_raw->cur_lm = lm;
-    preproc_raw->errwarns = errwarns;
+    return raw_preproc_create_src(f, yasm_srcbuf_create(f), lm, errwarns);
+}
 
-    return (yasm_preproc *)preproc_raw;
+static yasm_preproc *
+raw_preproc_create_mem(const char *in_filename, const char *buf, size_t len,
+                       yasm_symtab *symtab, yasm_linemap *lm,
+                       yasm_errwarns *errwarns)
+{
+    return raw_preproc_create_src(NULL, yasm_srcbuf_create_mem(buf, len), lm,
+                                  errwarns);
 }
 
 static void
 raw_preproc_destroy(yasm_preproc *preproc)
 {
+    yasm_preproc_raw *preproc_raw = (yasm_preproc_raw *)preproc;
+    yasm_srcbuf_destroy(preproc_raw->src);
+    if (preproc_raw->in && preproc_raw->in != stdin)
+        fclose(preproc_raw->in);
     yasm_xfree(preproc);
 }
 
@@ -74,40 +95,25 @@ static char *
 raw_preproc_get_line(yasm_preproc *preproc)
 {
     yasm_preproc_raw *preproc_raw = (yasm_preproc_raw *)preproc;
-    int bufsize = BSIZE;
-    char *buf = yasm_xmalloc((size_t)bufsize);
-    char *p;
-
-    /* Loop to ensure entire line is read (don't want to limit line length). */
-    p = buf;
-    for (;;) {
-        if (!fgets(p, bufsize-(p-buf), preproc_raw->in)) {
-            if (ferror(preproc_raw->in)) {
-                yasm_error_set(YASM_ERROR_IO,
-                               N_("error when reading from file"));
-                yasm_errwarn_propagate(preproc_raw->errwarns,
-                    yasm_linemap_get_current(preproc_raw->cur_lm));
-            }
-            break;
-        }
-        p += strlen(p);
-        if (p > buf && p[-1] == '\n')
-            break;
-        if ((p-buf)+1 >= bufsize) {
-            /* Increase size of buffer */
-            char *oldbuf = buf;
-            bufsize *= 2;
-            buf = yasm_xrealloc(buf, (size_t)bufsize);
-            p = buf + (p-oldbuf);
+    const char *line;
+    size_t len;
+    char *buf;
+
+    line = yasm_srcbuf_get_line(preproc_raw->src, &len);
+    if (!line) {
+        if (yasm_srcbuf_error(preproc_raw->src)) {
+            yasm_error_set(YASM_ERROR_IO, N_("error when reading from file"));
+            yasm_errwarn_propagate(preproc_raw->errwarns,
+                yasm_linemap_get_current(preproc_raw->cur_lm));
         }
-    }
-
-    if (p == buf) {
         /* No data; must be at EOF */
-        yasm_xfree(buf);
         return NULL;
     }
 
+    buf = yasm_xmalloc(len+1);
+    memcpy(buf, line, len);
+    buf[len] = '\0';
+
     /* Strip the line ending */
     buf[strcspn(buf, "\r\n")] = '\0';
 
@@ -165,5 +171,8 @@ yasm_preproc_module yasm_raw_LTX_preproc = {
     raw_preproc_predefine_macro,
     raw_preproc_undefine_macro,
     raw_preproc_define_builtin,
-    raw_preproc_add_standard
+    raw_preproc_add_standard,
+    NULL,
+    raw_preproc_create_mem,
+    NULL
 };
@@ -1016,5 +1016,8 @@ yasm_preproc_module yasm_yapp_LTX_preproc = {
     yapp_preproc_predefine_macro,
     yapp_preproc_undefine_macro,
     yapp_preproc_define_builtin,
-    yapp_preproc_add_standard
+    yapp_preproc_add_standard,
+    NULL,
+    NULL,
+    NULL
 };
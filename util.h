@@ -119,6 +119,17 @@
 
 #include <libyasm/compat-queue.h>
 
+/* Storage class for libyasm state that must be private to each thread
+ * (scratch bitvects, the error/warning indicators, etc).  Worker threads
+ * (see libyasm/parallel.h) are only used when this is available.
+ */
+#if defined(HAVE_PTHREAD) && defined(__GNUC__) && !defined(WITH_DMALLOC)
+# define YASM_THREAD_LOCAL      __thread
+# define YASM_HAVE_THREADS      1
+#else
+# define YASM_THREAD_LOCAL
+#endif
+
 #ifdef WITH_DMALLOC
 # include <dmalloc.h>
 # define yasm__xstrdup(str)             xstrdup(str)